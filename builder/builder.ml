@@ -310,16 +310,27 @@ let main () =
     if delete_on_exit then unlink_on_exit template;
     template in
 
-  (* Check the signature of the file. *)
-  let () =
+  (* Check the signature of the file.
+   *
+   * Checksums are computed in the background, so that the template
+   * can be uncompressed at the same time.  'wait_for_checksums'
+   * must be called before the template is used for anything else
+   * (see where the plan is carried out below).
+   *)
+  let wait_for_checksums =
     match entry with
     (* New-style: Using a checksum. *)
     | { Index.checksums = Some csums } ->
-      (try Checksums.verify_checksums csums template
-      with Checksums.Mismatched_checksum (csum, csum_actual) ->
-        error (f_"%s checksum of template did not match the expected checksum!\n  found checksum: %s\n  expected checksum: %s\nTry:\n - Use the '-v' option and look for earlier error messages.\n - Delete the cache: virt-builder --delete-cache\n - Check no one has tampered with the website or your network!")
-          (Checksums.string_of_csum_t csum) csum_actual (Checksums.string_of_csum csum)
-      )
+      let wait = Checksums.start_verify_checksums csums template in
+      let waited = ref false in
+      fun () ->
+        if not !waited then (
+          waited := true;
+          try wait ()
+          with Checksums.Mismatched_checksum (csum, csum_actual) ->
+            error (f_"%s checksum of template did not match the expected checksum!\n  found checksum: %s\n  expected checksum: %s\nTry:\n - Use the '-v' option and look for earlier error messages.\n - Delete the cache: virt-builder --delete-cache\n - Check no one has tampered with the website or your network!")
+              (Checksums.string_of_csum_t csum) csum_actual (Checksums.string_of_csum csum)
+        )
 
     | { Index.checksums = None } ->
       (* Old-style: detached signature. *)
@@ -332,7 +343,8 @@ let main () =
           if delete_on_exit then unlink_on_exit sigfile;
           Some sigfile in
 
-      Sigchecker.verify_detached sigchecker template sigfile in
+      Sigchecker.verify_detached sigchecker template sigfile;
+      fun () -> () in
 
   (* For an explanation of the Planner, see:
    * http://rwmj.wordpress.com/2013/12/14/writing-a-planner-to-solve-a-tricky-programming-optimization-problem/
@@ -563,9 +575,13 @@ let main () =
   in
   at_exit delete_file;
 
-  (* Carry out the plan. *)
-  List.iter (
-    function
+  (* Carry out the plan.
+   *
+   * Copying or uncompressing the template only reads it, so that can
+   * overlap with computing the checksums.  Any other task, and any
+   * later task, has to wait until the template has been verified.
+   *)
+  let carry_out_step = function
     | itags, `Copy, otags ->
       let ifile = List.assoc `Filename itags in
       let ofile = List.assoc `Filename otags in
@@ -643,7 +659,18 @@ let main () =
         (quote ifile) (quote oformat) (quote (qemu_input_filename ofile))
         (if verbose () then "" else " >/dev/null 2>&1") in
       if shell_command cmd <> 0 then exit 1
+  in
+
+  List.iter (
+    fun ((_, task, _) as step) ->
+      (match task with
+       | `Copy | `Pxzcat -> ()
+       | _ -> wait_for_checksums ()
+      );
+      carry_out_step step;
+      wait_for_checksums ()
   ) plan;
+  wait_for_checksums ();
 
   (* Now mount the output disk so we can make changes. *)
   message (f_"Opening the new disk");
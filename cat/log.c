@@ -56,6 +56,7 @@ int inspector = 1;
 
 static int do_log (void);
 static int do_log_journal (void);
+static void free_journal_entry (struct guestfs_xattr_list *xattrs);
 static int do_log_text_file (const char *filename);
 static int do_log_windows_evtx (void);
 
@@ -316,93 +317,256 @@ static const char *const log_level_table[] = {
   [LOG_DEBUG] = "debug"
 };
 
+/* Display a single journal entry.  Returns -1 if the entry could
+ * not be displayed.
+ */
 static int
-do_log_journal (void)
+print_journal_entry (const struct guestfs_xattr_list *xattrs, int64_t ts)
 {
-  int r;
-  unsigned errors = 0;
+  const char *priority_str, *identifier, *comm, *pid, *message;
+  size_t priority_len, identifier_len, comm_len, pid_len, message_len;
+  int priority = LOG_INFO;
 
-  if (guestfs_journal_open (g, JOURNAL_DIR) == -1)
+  /* The question is what fields to display.  We should probably
+   * make this configurable, but for now use the "short" format from
+   * journalctl.  (XXX)
+   */
+
+  priority_str = get_journal_field (xattrs, "PRIORITY", &priority_len);
+  //hostname = get_journal_field (xattrs, "_HOSTNAME", &hostname_len);
+  identifier = get_journal_field (xattrs, "SYSLOG_IDENTIFIER",
+                                  &identifier_len);
+  comm = get_journal_field (xattrs, "_COMM", &comm_len);
+  pid = get_journal_field (xattrs, "_PID", &pid_len);
+  message = get_journal_field (xattrs, "MESSAGE", &message_len);
+
+  /* Timestamp. */
+  if (ts >= 0) {
+    char buf[64];
+    time_t t = ts / 1000000;
+    struct tm tm;
+
+    if (strftime (buf, sizeof buf, "%b %d %H:%M:%S",
+                  localtime_r (&t, &tm)) <= 0) {
+      fprintf (stderr, _("%s: could not format journal entry timestamp\n"),
+               getprogname ());
+      return -1;
+    }
+    fputs (buf, stdout);
+  }
+
+  /* Hostname. */
+  /* We don't print this because it is assumed each line from the
+   * guest will have the same hostname.  (XXX)
+   */
+  //if (hostname)
+  //  printf (" %.*s", (int) hostname_len, hostname);
+
+  /* Identifier. */
+  if (identifier)
+    printf (" %.*s", (int) identifier_len, identifier);
+  else if (comm)
+    printf (" %.*s", (int) comm_len, comm);
+
+  /* PID */
+  if (pid)
+    printf ("[%.*s]", (int) pid_len, pid);
+
+  /* Log level. */
+  if (priority_str && *priority_str >= '0' && *priority_str <= '7')
+    priority = *priority_str - '0';
+
+  printf (" %s:", log_level_table[priority]);
+
+  /* Message. */
+  if (message)
+    printf (" %.*s", (int) message_len, message);
+
+  printf ("\n");
+  return 0;
+}
+
+/* Read a big-endian 64 bit integer from the output of
+ * guestfs_journal_export.  Returns 0 at the end of the file.
+ */
+static int
+read_be64 (FILE *fp, uint64_t *v)
+{
+  unsigned char buf[8];
+  size_t i, n;
+
+  n = fread (buf, 1, sizeof buf, fp);
+  if (n == 0 && feof (fp))
+    return 0;
+  if (n != sizeof buf)
     return -1;
 
-  while ((r = guestfs_journal_next (g)) > 0) {
-    CLEANUP_FREE_XATTR_LIST struct guestfs_xattr_list *xattrs = NULL;
-    const char *priority_str, *identifier, *comm, *pid, *message;
-    size_t priority_len, identifier_len, comm_len, pid_len, message_len;
-    int priority = LOG_INFO;
-    int64_t ts;
+  *v = 0;
+  for (i = 0; i < sizeof buf; ++i)
+    *v = (*v << 8) | buf[i];
+  return 1;
+}
 
-    /* The question is what fields to display.  We should probably
-     * make this configurable, but for now use the "short" format from
-     * journalctl.  (XXX)
-     */
+/* Read one entry from the output of guestfs_journal_export.  Returns
+ * 1 if an entry was read, 0 at the end of the file, or -1 if the
+ * file is truncated or corrupt.
+ */
+static int
+read_journal_entry (FILE *fp, struct guestfs_xattr_list **xattrs_rtn,
+                    uint64_t *ts_rtn)
+{
+  struct guestfs_xattr_list *xattrs;
+  uint64_t nr_fields, len;
+  char *field, *p;
+  size_t i;
+  int r;
 
-    xattrs = guestfs_journal_get (g);
-    if (xattrs == NULL)
-      return -1;
+  r = read_be64 (fp, ts_rtn);
+  if (r <= 0)
+    return r;
+  if (read_be64 (fp, &nr_fields) != 1 || nr_fields > UINT32_MAX)
+    return -1;
 
-    ts = guestfs_journal_get_realtime_usec (g); /* error checked below */
-
-    priority_str = get_journal_field (xattrs, "PRIORITY", &priority_len);
-    //hostname = get_journal_field (xattrs, "_HOSTNAME", &hostname_len);
-    identifier = get_journal_field (xattrs, "SYSLOG_IDENTIFIER",
-                                    &identifier_len);
-    comm = get_journal_field (xattrs, "_COMM", &comm_len);
-    pid = get_journal_field (xattrs, "_PID", &pid_len);
-    message = get_journal_field (xattrs, "MESSAGE", &message_len);
-
-    /* Timestamp. */
-    if (ts >= 0) {
-      char buf[64];
-      time_t t = ts / 1000000;
-      struct tm tm;
-
-      if (strftime (buf, sizeof buf, "%b %d %H:%M:%S",
-                    localtime_r (&t, &tm)) <= 0) {
-        fprintf (stderr, _("%s: could not format journal entry timestamp\n"),
-                 getprogname ());
-        errors++;
-        continue;
-      }
-      fputs (buf, stdout);
+  xattrs = malloc (sizeof *xattrs);
+  if (xattrs == NULL)
+    error (EXIT_FAILURE, errno, "malloc");
+  xattrs->len = 0;
+  xattrs->val = calloc (nr_fields, sizeof (struct guestfs_xattr));
+  if (xattrs->val == NULL && nr_fields > 0)
+    error (EXIT_FAILURE, errno, "calloc");
+
+  for (i = 0; i < nr_fields; ++i) {
+    if (read_be64 (fp, &len) != 1 || len > SIZE_MAX - 1)
+      goto corrupt;
+    field = malloc (len + 1);
+    if (field == NULL)
+      error (EXIT_FAILURE, errno, "malloc");
+    if (fread (field, 1, len, fp) != len) {
+      free (field);
+      goto corrupt;
+    }
+    field[len] = '\0';
+
+    p = memchr (field, '=', len);
+    if (p == NULL) {
+      free (field);
+      goto corrupt;
     }
+    *p = '\0';
 
-    /* Hostname. */
-    /* We don't print this because it is assumed each line from the
-     * guest will have the same hostname.  (XXX)
+    /* The attrval points into the same allocation as the attrname,
+     * so it must not be freed separately.
      */
-    //if (hostname)
-    //  printf (" %.*s", (int) hostname_len, hostname);
+    xattrs->val[i].attrname = field;
+    xattrs->val[i].attrval = p+1;
+    xattrs->val[i].attrval_len = len - (p+1 - field);
+    xattrs->len++;
+  }
 
-    /* Identifier. */
-    if (identifier)
-      printf (" %.*s", (int) identifier_len, identifier);
-    else if (comm)
-      printf (" %.*s", (int) comm_len, comm);
+  *xattrs_rtn = xattrs;
+  return 1;
 
-    /* PID */
-    if (pid)
-      printf ("[%.*s]", (int) pid_len, pid);
+ corrupt:
+  free_journal_entry (xattrs);
+  return -1;
+}
 
-    /* Log level. */
-    if (priority_str && *priority_str >= '0' && *priority_str <= '7')
-      priority = *priority_str - '0';
+static void
+free_journal_entry (struct guestfs_xattr_list *xattrs)
+{
+  size_t i;
 
-    printf (" %s:", log_level_table[priority]);
+  if (xattrs) {
+    for (i = 0; i < xattrs->len; ++i)
+      free (xattrs->val[i].attrname);
+    free (xattrs->val);
+    free (xattrs);
+  }
+}
 
-    /* Message. */
-    if (message)
-      printf (" %.*s", (int) message_len, message);
+/* The journal is exported in a single call, and displayed as it
+ * arrives by a child process reading the other end of a pipe.
+ * Reading the journal one entry at a time would cost several round
+ * trips per entry.
+ */
+static int
+do_log_journal (void)
+{
+  /* Only export the fields which are displayed. */
+  const char *fields[] = { "PRIORITY", "SYSLOG_IDENTIFIER", "_COMM",
+                           "_PID", "MESSAGE", NULL };
+  char dev_fd[64];
+  int fd[2];
+  pid_t pid;
+  int r, status;
 
-    printf ("\n");
+  if (guestfs_journal_open (g, JOURNAL_DIR) == -1)
+    return -1;
+
+  if (pipe2 (fd, O_CLOEXEC) == -1) {
+    perror ("pipe2");
+    guestfs_journal_close (g);
+    return -1;
   }
-  if (r == -1)                  /* error from guestfs_journal_next */
+
+  fflush (stdout);
+  pid = fork ();
+  if (pid == -1) {
+    perror ("fork");
+    close (fd[0]);
+    close (fd[1]);
+    guestfs_journal_close (g);
     return -1;
+  }
+
+  if (pid == 0) {               /* Child: display the entries. */
+    struct guestfs_xattr_list *xattrs;
+    uint64_t ts;
+    FILE *fp;
+    unsigned errors = 0;
+
+    close (fd[1]);
+    fp = fdopen (fd[0], "r");
+    if (fp == NULL) {
+      perror ("fdopen");
+      _exit (EXIT_FAILURE);
+    }
+
+    while ((r = read_journal_entry (fp, &xattrs, &ts)) > 0) {
+      if (print_journal_entry (xattrs, ts) == -1)
+        errors++;
+      free_journal_entry (xattrs);
+    }
+    fclose (fp);
+    fflush (stdout);
+
+    if (r == -1) {
+      fprintf (stderr, _("%s: journal export is truncated or corrupt\n"),
+               getprogname ());
+      _exit (EXIT_FAILURE);
+    }
+    _exit (errors > 0 ? EXIT_FAILURE : EXIT_SUCCESS);
+  }
+
+  /* Parent. */
+  close (fd[0]);
+  snprintf (dev_fd, sizeof dev_fd, "/dev/fd/%d", fd[1]);
+  r = guestfs_journal_export (g, dev_fd,
+                              GUESTFS_JOURNAL_EXPORT_FIELDS, (char **) fields,
+                              -1);
+  close (fd[1]);
+
+  if (waitpid (pid, &status, 0) == -1) {
+    perror ("waitpid");
+    r = -1;
+  }
+  else if (!WIFEXITED (status) || WEXITSTATUS (status) != 0)
+    r = -1;
 
   if (guestfs_journal_close (g) == -1)
-    return -1;
+    r = -1;
 
-  return errors > 0 ? -1 : 0;
+  return r;
 }
 
 static int
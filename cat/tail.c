@@ -29,10 +29,16 @@
 #include <error.h>
 #include <locale.h>
 #include <assert.h>
+#include <poll.h>
 #include <libintl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 
+#if defined(HAVE_SYS_INOTIFY_H) && defined(HAVE_INOTIFY_INIT1)
+#include <sys/inotify.h>
+#define USE_INOTIFY 1
+#endif
+
 #include "getprogname.h"
 #include "ignore-value.h"
 
@@ -54,6 +60,12 @@ int inspector = 1;
 
 static int do_tail (int argc, char *argv[], struct drv *drvs, struct mp *mps);
 static time_t disk_mtime (struct drv *drvs);
+static int can_remount (struct drv *drvs);
+static int watch_drives (struct drv *drvs);
+static int wait_for_change (int watch_fd, int interval, struct drv *drvs);
+static char **get_remount_list (void);
+static void mount_remount_list (char *const *remount_list);
+static void remount (char *const *remount_list);
 static int reopen_handle (void);
 
 static void __attribute__((noreturn))
@@ -249,6 +261,13 @@ do_tail (int argc, char *argv[], /* list of files in the guest */
   time_t drvt;
   int first_iteration = 1;
   int prev_file_displayed = -1;
+  int launched = 0;
+  int keep_alive;
+  int watch_fd;
+  int windows = 0;
+  char *root = NULL;
+  CLEANUP_FREE_STRING_LIST char **roots = NULL;
+  CLEANUP_FREE_STRING_LIST char **remount_list = NULL;
   CLEANUP_FREE struct follow *file = NULL;
 
   /* Allocate storage to track each file. */
@@ -268,37 +287,73 @@ do_tail (int argc, char *argv[], /* list of files in the guest */
   if (drvt == (time_t)-1)
     return -1;
 
+  /* If possible, keep the appliance running between iterations and
+   * only remount the filesystems, which is much faster than
+   * relaunching.  See can_remount for when this is safe.
+   */
+  keep_alive = can_remount (drvs);
+
+  /* Try to get notified when the disk images are written to, so
+   * we don't have to poll them.
+   */
+  watch_fd = watch_drives (drvs);
+
   while (!quit) {
     time_t t;
     int i;
-    int windows = 0;
-    char *root;
-    CLEANUP_FREE_STRING_LIST char **roots = NULL;
     int processed;
 
-    /* Add drives, inspect and mount. */
-    add_drives (drvs, 'a');
-
-    if (guestfs_launch (g) == -1)
-      return -1;
+    if (!launched) {
+      /* Add drives, inspect and mount. */
+      add_drives (drvs, 'a');
 
-    if (mps != NULL)
-      mount_mps (mps);
-    else
-      inspect_mount ();
+      if (guestfs_launch (g) == -1)
+        return -1;
 
-    if (inspector) {
-      /* Get root mountpoint.  See: fish/inspect.c:inspect_mount */
-      roots = guestfs_inspect_get_roots (g);
+      if (remount_list != NULL)
+        mount_remount_list (remount_list);
+      else {
+        if (mps != NULL)
+          mount_mps (mps);
+        else
+          inspect_mount ();
+
+        if (inspector) {
+          /* Get root mountpoint.  See: fish/inspect.c:inspect_mount */
+          guestfs_int_free_string_list (roots);
+          roots = guestfs_inspect_get_roots (g);
+
+          assert (roots);
+          assert (roots[0] != NULL);
+          assert (roots[1] == NULL);
+          root = roots[0];
+
+          /* Windows?  Special handling is required. */
+          windows = is_windows (g, root);
+        }
 
-      assert (roots);
-      assert (roots[0] != NULL);
-      assert (roots[1] == NULL);
-      root = roots[0];
+        if (keep_alive) {
+          /* Inspecting and mounting the filesystems may have replayed
+           * their journals into the overlay, which would then hide
+           * later writes by the guest to the same blocks.  So
+           * relaunch once with a clean overlay, and from now on only
+           * mount the filesystems in a way that writes nothing.
+           */
+          remount_list = get_remount_list ();
+          if (remount_list == NULL)
+            keep_alive = 0;
+          else {
+            if (reopen_handle () == -1)
+              return -1;
+            continue;
+          }
+        }
+      }
 
-      /* Windows?  Special handling is required. */
-      windows = is_windows (g, root);
+      launched = 1;
     }
+    else
+      remount (remount_list);
 
     /* Check files here. */
     processed = 0;
@@ -337,7 +392,6 @@ do_tail (int argc, char *argv[], /* list of files in the guest */
       }
       else {
         CLEANUP_FREE_STRING_LIST char **lines = NULL;
-        CLEANUP_FREE char *content = NULL;
 
         processed++;
 
@@ -356,26 +410,33 @@ do_tail (int argc, char *argv[], /* list of files in the guest */
             printf ("\n\n--- %s ---\n\n", filename);
           prev_file_displayed = i;
 
-          /* If the file grew, display all the new content unless
-           * it's a lot, in which case display the last few lines.
-           * If the file shrank, display the last few lines.
-           * If the file stayed the same size [note that the file
-           * has changed -- see above], redisplay the last few lines.
+          /* If the file grew, display all the new content, unless
+           * it's a lot the first time we see the file (or if we have
+           * to relaunch the appliance between checks), in which case
+           * display the last few lines.  If the file shrank, display
+           * the last few lines.  If the file stayed the same size
+           * [note that the file has changed -- see above], redisplay
+           * the last few lines.
            */
-          if (stat->st_size > file[i].size + 10000) { /* grew a lot */
+          if (stat->st_size > file[i].size + 10000 && /* grew a lot */
+              (first_iteration || !keep_alive)) {
             goto show_tail;
           }
-          else if (stat->st_size > file[i].size) { /* grew a bit */
-            int count = stat->st_size - file[i].size;
-            size_t r;
+          else if (stat->st_size > file[i].size) { /* grew */
+            int r;
+
+            /* Only the newly appended bytes are downloaded, and they
+             * are copied straight to stdout.  If that fails, fall back
+             * to displaying the last few lines.
+             */
+            fflush (stdout);
             guestfs_push_error_handler (g, NULL, NULL);
-            content = guestfs_pread (g, filename, count, file[i].size, &r);
+            r = guestfs_download_offset (g, filename, "/dev/stdout",
+                                         file[i].size,
+                                         stat->st_size - file[i].size);
             guestfs_pop_error_handler (g);
-            if (content) {
-              size_t j;
-              for (j = 0; j < r; ++j)
-                putchar (content[j]);
-            }
+            if (r == -1)
+              goto show_tail;
           }
           else if (stat->st_size <= file[i].size) { /* shrank or same size */
           show_tail:
@@ -414,26 +475,249 @@ do_tail (int argc, char *argv[], /* list of files in the guest */
       }
     }
 
-    /* Do nothing until something happens on the disk image.  Even if
-     * the drive changes, always wait min. 30 seconds.  For libvirt
-     * (-d) and remote sources we cannot check this so we have to use
-     * a fixed (5 minute) delay instead.  Also we recheck every so
-     * often even if nothing seems to have changed.  (XXX Can we do
-     * better?)
+    /* Do nothing until something happens on the disk image.  If
+     * we have to relaunch the appliance, always wait min. 30 seconds.
      */
-    for (i = 0; i < 10 /* 30 seconds * 10 = 5 mins */; ++i) {
-      time (&t);
-      sleep (30);
-      drvt = disk_mtime (drvs);
-      if (drvt == (time_t)-1)
+    if (wait_for_change (watch_fd, keep_alive ? 1 : 30, drvs) == -1)
+      return -1;
+
+    if (!keep_alive) {
+      if (reopen_handle () == -1)
         return -1;
-      if (drvt-t < 30) break;
+      launched = 0;
     }
 
-    if (reopen_handle () == -1)
+    first_iteration = 0;
+  }
+
+  if (watch_fd >= 0)
+    close (watch_fd);
+
+  return 0;
+}
+
+/* Keeping the appliance running and just remounting the filesystems
+ * only works if the appliance sees new data written to the disk
+ * images.  That is true for local raw images: the read-only drives
+ * have an overlay, but it only holds blocks written by the appliance
+ * and all other reads go to the file.  It is not true for other
+ * formats such as qcow2, where qemu caches the image metadata, nor
+ * for libvirt or remote drives, where we don't know what the format
+ * is.
+ *
+ * The filesystems must also be mounted without writing anything to
+ * the overlay, see get_remount_list.
+ */
+static int
+can_remount (struct drv *drvs)
+{
+  for (; drvs != NULL; drvs = drvs->next) {
+    CLEANUP_FREE char *format = NULL;
+
+    if (drvs->type != drv_a)
+      return 0;
+
+    if (drvs->a.format)
+      format = strdup (drvs->a.format);
+    else {
+      guestfs_push_error_handler (g, NULL, NULL);
+      format = guestfs_disk_format (g, drvs->a.filename);
+      guestfs_pop_error_handler (g);
+    }
+    if (format == NULL || STRNEQ (format, "raw"))
+      return 0;
+  }
+
+  return 1;
+}
+
+static int
+compare_mountpoints_len (const void *p1, const void *p2)
+{
+  const char *mp1 = ((char * const *) p1)[1];
+  const char *mp2 = ((char * const *) p2)[1];
+  return strlen (mp1) - strlen (mp2);
+}
+
+/* Return the list of filesystems which are mounted now, as (device,
+ * mountpoint, options) triples in mount order, where the options stop
+ * the kernel from writing to the device.  Mounting a filesystem with
+ * a dirty journal read-only still replays the journal, which would
+ * write to the overlay, so ext3/ext4 are mounted with 'noload' and
+ * xfs with 'norecovery'.  Changes which are still only in the journal
+ * then show up once the guest has written them back.
+ *
+ * Returns NULL if any of the filesystems cannot be mounted like this
+ * (or is on an encrypted device, which would have to be opened again
+ * after relaunching).  The appliance must then be relaunched for each
+ * check.
+ */
+static char **
+get_remount_list (void)
+{
+  CLEANUP_FREE_STRING_LIST char **fses = NULL;
+  char **ret;
+  size_t i, n;
+
+  fses = guestfs_mountpoints (g);
+  if (fses == NULL)
+    exit (EXIT_FAILURE);
+
+  n = guestfs_int_count_strings (fses) / 2;
+  qsort (fses, n, 2 * sizeof (char *), compare_mountpoints_len);
+
+  ret = calloc (3 * n + 1, sizeof (char *));
+  if (ret == NULL) {
+    perror ("calloc");
+    exit (EXIT_FAILURE);
+  }
+
+  for (i = 0; i < n; ++i) {
+    const char *device = fses[2*i], *mountpoint = fses[2*i+1];
+    CLEANUP_FREE char *type = NULL;
+    const char *options;
+
+    if (STRPREFIX (device, "/dev/mapper/") && guestfs_is_lv (g, device) <= 0)
+      goto unsupported;
+
+    type = guestfs_vfs_type (g, device);
+    if (type == NULL)
+      goto unsupported;
+    if (STREQ (type, "ext2"))
+      options = "ro";
+    else if (STREQ (type, "ext3") || STREQ (type, "ext4"))
+      options = "ro,noload";
+    else if (STREQ (type, "xfs"))
+      options = "ro,norecovery";
+    else
+      goto unsupported;
+
+    ret[3*i] = strdup (device);
+    ret[3*i+1] = strdup (mountpoint);
+    ret[3*i+2] = strdup (options);
+    if (ret[3*i] == NULL || ret[3*i+1] == NULL || ret[3*i+2] == NULL) {
+      perror ("strdup");
+      exit (EXIT_FAILURE);
+    }
+  }
+
+  return ret;
+
+ unsupported:
+  guestfs_int_free_string_list (ret);
+  return NULL;
+}
+
+static void
+mount_remount_list (char *const *remount_list)
+{
+  size_t i;
+
+  for (i = 0; remount_list[i] != NULL; i += 3) {
+    if (guestfs_mount_options (g, remount_list[i+2],
+                               remount_list[i], remount_list[i+1]) == -1)
+      exit (EXIT_FAILURE);
+  }
+}
+
+/* Make sure the next check sees the current contents of the disk
+ * images.  The filesystems are unmounted and the appliance kernel's
+ * caches are dropped, then everything is mounted again.
+ */
+static void
+remount (char *const *remount_list)
+{
+  if (guestfs_umount_all (g) == -1 ||
+      guestfs_drop_caches (g, 3) == -1)
+    exit (EXIT_FAILURE);
+
+  mount_remount_list (remount_list);
+}
+
+/* Return an inotify file descriptor watching all the local disk
+ * images, or -1 if this is not possible (in which case we fall back
+ * to polling the mtime of the images).
+ */
+static int
+watch_drives (struct drv *drvs)
+{
+#ifdef USE_INOTIFY
+  int fd;
+
+  fd = inotify_init1 (IN_NONBLOCK|IN_CLOEXEC);
+  if (fd == -1)
+    return -1;
+
+  for (; drvs != NULL; drvs = drvs->next) {
+    if (drvs->type != drv_a ||
+        inotify_add_watch (fd, drvs->a.filename,
+                           IN_MODIFY|IN_CLOSE_WRITE|IN_ATTRIB) == -1) {
+      close (fd);
       return -1;
+    }
+  }
 
-    first_iteration = 0;
+  return fd;
+#else
+  return -1;
+#endif
+}
+
+/* Wait until something happens on the disk images.
+ *
+ * If we are watching the disk images with inotify, wake up as soon
+ * as they are written, but not sooner than 'interval' seconds after
+ * the last check, since a running guest writes to its disk
+ * continuously.  Otherwise check the mtime of the disk images every
+ * 30 seconds.  For libvirt (-d) and remote sources we cannot check
+ * either, so we have to use a fixed (5 minute) delay instead.  Also
+ * we recheck every 5 minutes even if nothing seems to have changed.
+ *
+ * This returns early (with no error) if the user hits ^C.
+ */
+static int
+wait_for_change (int watch_fd, int interval, struct drv *drvs)
+{
+  time_t t, drvt;
+  int i;
+
+#ifdef USE_INOTIFY
+  if (watch_fd >= 0) {
+    struct pollfd pollfd;
+    char buf[4096];
+    ssize_t r;
+
+    sleep (interval);
+
+    pollfd.fd = watch_fd;
+    pollfd.events = POLLIN;
+    pollfd.revents = 0;
+    r = poll (&pollfd, 1, 300 * 1000);
+    if (r == -1 && errno != EINTR) {
+      perror ("poll");
+      return -1;
+    }
+
+    /* Discard the events, we only care that there were some. */
+    do {
+      r = read (watch_fd, buf, sizeof buf);
+    } while (r > 0);
+    if (r == -1 && errno != EAGAIN && errno != EINTR) {
+      perror ("read: inotify");
+      return -1;
+    }
+
+    return 0;
+  }
+#endif
+
+  for (i = 0; !quit && i < 10 /* 30 seconds * 10 = 5 mins */; ++i) {
+    time (&t);
+    sleep (30);
+    drvt = disk_mtime (drvs);
+    if (drvt == (time_t)-1)
+      return -1;
+    if (drvt-t < 30) break;
   }
 
   return 0;
@@ -0,0 +1,130 @@
+#!/bin/bash -
+# libguestfs
+# Copyright (C) 2016 Red Hat Inc.
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+# Test that virt-tail keeps the appliance running and only remounts
+# the filesystems between checks when following a file on a local raw
+# disk image.  As in test-virt-tail.sh, a guestfish instance appends
+# to the file while virt-tail runs.  The filesystem is ext4 so that
+# it has a journal, which must not be replayed into the overlay.
+#
+# With -x, the trace shows that the appliance was launched only
+# twice (the second time to start with a clean overlay, see
+# cat/tail.c), and that the filesystems were remounted in between.
+
+export LANG=C
+set -e
+set -x
+
+# See test-virt-tail.sh.
+if [ "$(guestfish get-backend)" != "direct" ]; then
+    echo "$0: test skipped because default backend is not 'direct'"
+    exit 77
+fi
+
+out=test-virt-tail-keep-alive.out
+err=test-virt-tail-keep-alive.err
+disk=test-virt-tail-keep-alive.disk
+
+rm -f $out $err $disk
+
+tailpid=0
+
+eval `guestfish --listen`
+
+# Clean up if the script is killed or exits early.
+cleanup ()
+{
+    status=$?
+    set +e
+    guestfish --remote exit
+    if [ "$tailpid" -gt 0 ]; then kill "$tailpid"; fi
+
+    # Don't delete the output files if non-zero exit.
+    if [ "$status" -eq 0 ]; then rm -f $disk $out $err; fi
+
+    exit $status
+}
+trap cleanup INT QUIT TERM EXIT ERR
+
+# Create the raw disk.
+guestfish --remote sparse $disk 100M
+guestfish --remote run
+guestfish --remote part-disk /dev/sda mbr
+guestfish --remote mkfs ext4 /dev/sda1
+guestfish --remote mount /dev/sda1 /
+
+guestfish --remote write /tail 'line 1
+'
+guestfish --remote sync
+
+$VG virt-tail -x --format=raw -a $disk -m /dev/sda1 /tail > $out 2> $err &
+tailpid=$!
+
+# Wait for a line of output to appear.
+wait_for ()
+{
+    for retry in `seq 0 600`; do
+        if grep -sq "$1" $out; then return 0; fi
+        sleep 1
+    done
+    echo "$0: error: '$1' did not appear in the output"
+    exit 1
+}
+
+wait_for "line 1"
+
+# Append to the file a few times, so that virt-tail has to pick up
+# the new content with the same appliance more than once.
+for i in 2 3 4; do
+    guestfish --remote write-append /tail "line $i
+"
+    guestfish --remote sync
+    wait_for "line $i"
+done
+
+# Delete the file.  This should cause virt-tail to exit gracefully.
+guestfish --remote rm /tail
+guestfish --remote sync
+
+wait "$tailpid"
+tailstatus=$?
+tailpid=0
+if [ "$tailstatus" -ne 0 ]; then
+    echo "$0: error: non-zero exit status from virt-tail: $tailstatus"
+    exit 1
+fi
+
+# Each line must have been displayed exactly once.
+for i in 1 2 3 4; do
+    if [ "$(grep -c "^line $i\$" $out)" -ne 1 ]; then
+        cat $out
+        echo "$0: error: line $i not displayed exactly once"
+        exit 1
+    fi
+done
+
+launches="$(grep -c '^libguestfs: trace: launch$' $err)"
+if [ "$launches" -ne 2 ]; then
+    echo "$0: error: appliance launched $launches times, expected 2"
+    exit 1
+fi
+grep -sq '^libguestfs: trace: drop_caches 3$' $err
+grep -sq '^libguestfs: trace: mount_options "ro,noload" "/dev/sda1" "/"$' $err
+
+# cleanup() is called implicitly which cleans up everything.
+exit 0
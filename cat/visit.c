@@ -40,8 +40,6 @@
 
 #include "visit.h"
 
-static int _visit (guestfs_h *g, int depth, const char *dir, visitor_function f, void *opaque);
-
 /**
  * Visit every file and directory in a guestfs filesystem, starting
  * at C<dir>.
@@ -60,6 +58,10 @@ static int _visit (guestfs_h *g, int depth, const char *dir, visitor_function f,
  * Also passed to this function is an C<opaque> pointer which is
  * passed through to the visitor function.
  *
+ * The whole tree is fetched with a single call to C<guestfs_walk>.
+ * C<f> is called in the same order as a recursive traversal would
+ * (each directory is followed by its contents, sorted by name).
+ *
  * Returns C<0> if everything went OK, or C<-1> if there was an error.
  * Error handling is not particularly well defined.  It will either
  * set an error in the libguestfs handle or print an error on stderr,
@@ -68,100 +70,91 @@ static int _visit (guestfs_h *g, int depth, const char *dir, visitor_function f,
 int
 visit (guestfs_h *g, const char *dir, visitor_function f, void *opaque)
 {
-  return _visit (g, 0, dir, f, opaque);
-}
-
-static int
-_visit (guestfs_h *g, int depth, const char *dir,
-        visitor_function f, void *opaque)
-{
-  /* Call 'f' with the top directory.  Note that ordinary recursive
-   * visits will not otherwise do this, so we have to have a special
-   * case.
-   */
-  if (depth == 0) {
-    CLEANUP_FREE_STATNS struct guestfs_statns *stat = NULL;
-    CLEANUP_FREE_XATTR_LIST struct guestfs_xattr_list *xattrs = NULL;
-    int r;
-
-    stat = guestfs_lstatns (g, dir);
-    if (stat == NULL)
-      return -1;
-
-    xattrs = guestfs_lgetxattrs (g, dir);
-    if (xattrs == NULL)
-      return -1;
-
-    r = f (dir, NULL, stat, xattrs, opaque);
-
-    if (r == -1)
-      return -1;
-  }
-
-  size_t i, xattrp;
-  CLEANUP_FREE_STRING_LIST char **names = NULL;
-  CLEANUP_FREE_STAT_LIST struct guestfs_statns_list *stats = NULL;
-  CLEANUP_FREE_XATTR_LIST struct guestfs_xattr_list *xattrs = NULL;
-
-  names = guestfs_ls (g, dir);
-  if (names == NULL)
-    return -1;
-
-  stats = guestfs_lstatnslist (g, dir, names);
-  if (stats == NULL)
-    return -1;
+  CLEANUP_FREE_WALK_ENTRY_LIST struct guestfs_walk_entry_list *entries = NULL;
+  size_t i, j, k;
 
-  xattrs = guestfs_lxattrlist (g, dir, names);
-  if (xattrs == NULL)
+  entries = guestfs_walk (g, dir);
+  if (entries == NULL)
     return -1;
 
-  /* Call function on everything in this directory. */
-  for (i = 0, xattrp = 0; names[i] != NULL; ++i, ++xattrp) {
+  for (i = 0; i < entries->len; i = j) {
+    const struct guestfs_walk_entry *entry = &entries->val[i];
+    CLEANUP_FREE char *parent = NULL;
     CLEANUP_FREE char *path = NULL;
-    CLEANUP_FREE char *attrval = NULL;
-    struct guestfs_xattr_list file_xattrs;
-    size_t nr_xattrs;
-
-    assert (stats->len >= i);
-    assert (xattrs->len >= xattrp);
-
-    /* Find the list of extended attributes for this file. */
-    assert (strlen (xattrs->val[xattrp].attrname) == 0);
+    CLEANUP_FREE struct guestfs_xattr *xattr_val = NULL;
+    struct guestfs_statns stat;
+    struct guestfs_xattr_list xattrs;
+    const char *p;
+    int r;
 
-    if (xattrs->val[xattrp].attrval_len == 0) {
-      fprintf (stderr, _("%s: error getting extended attrs for %s %s\n"),
-               getprogname (), dir, names[i]);
-      return -1;
-    }
-    /* attrval is not \0-terminated. */
-    attrval = malloc (xattrs->val[xattrp].attrval_len + 1);
-    if (attrval == NULL) {
-      perror ("malloc");
+    if (STRNEQ (entry->we_attrname, "")) {
+      fprintf (stderr, _("%s: error: unexpected extended attribute entry\n"),
+               getprogname ());
       return -1;
     }
-    memcpy (attrval, xattrs->val[xattrp].attrval,
-            xattrs->val[xattrp].attrval_len);
-    attrval[xattrs->val[xattrp].attrval_len] = '\0';
-    if (sscanf (attrval, "%zu", &nr_xattrs) != 1) {
-      fprintf (stderr, _("%s: error: cannot parse xattr count for %s %s\n"),
-               getprogname (), dir, names[i]);
-      return -1;
-    }
-
-    file_xattrs.len = nr_xattrs;
-    file_xattrs.val = &xattrs->val[xattrp+1];
-    xattrp += nr_xattrs;
 
-    /* Call the function. */
-    if (f (dir, names[i], &stats->val[i], &file_xattrs, opaque) == -1)
-      return -1;
+    /* The extended attributes of the file follow the file entry. */
+    for (j = i+1;
+         j < entries->len && STRNEQ (entries->val[j].we_attrname, "");
+         ++j)
+      ;
+
+    xattrs.len = j - i - 1;
+    xattrs.val = NULL;
+    if (xattrs.len > 0) {
+      xattr_val = malloc (xattrs.len * sizeof (struct guestfs_xattr));
+      if (xattr_val == NULL) {
+        perror ("malloc");
+        return -1;
+      }
+      for (k = 0; k < xattrs.len; ++k) {
+        const struct guestfs_walk_entry *xentry = &entries->val[i+1+k];
+
+        xattr_val[k].attrname = xentry->we_attrname;
+        xattr_val[k].attrval_len = xentry->we_attrval_len;
+        xattr_val[k].attrval = xentry->we_attrval;
+      }
+      xattrs.val = xattr_val;
+    }
 
-    /* Recursively call visit, but only on directories. */
-    if (is_dir (stats->val[i].st_mode)) {
-      path = full_path (dir, names[i]);
-      if (_visit (g, depth + 1, path, f, opaque) == -1)
+    memset (&stat, 0, sizeof stat);
+    stat.st_dev = entry->we_dev;
+    stat.st_ino = entry->we_ino;
+    stat.st_mode = entry->we_mode;
+    stat.st_nlink = entry->we_nlink;
+    stat.st_uid = entry->we_uid;
+    stat.st_gid = entry->we_gid;
+    stat.st_rdev = entry->we_rdev;
+    stat.st_size = entry->we_size;
+    stat.st_blksize = entry->we_blksize;
+    stat.st_blocks = entry->we_blocks;
+    stat.st_atime_sec = entry->we_atime_sec;
+    stat.st_atime_nsec = entry->we_atime_nsec;
+    stat.st_mtime_sec = entry->we_mtime_sec;
+    stat.st_mtime_nsec = entry->we_mtime_nsec;
+    stat.st_ctime_sec = entry->we_ctime_sec;
+    stat.st_ctime_nsec = entry->we_ctime_nsec;
+
+    /* The top directory has an empty name.  Other entries have a
+     * path relative to the top directory, which has to be split
+     * into the directory and the file name.
+     */
+    if (STREQ (entry->we_name, ""))
+      r = f (dir, NULL, &stat, &xattrs, opaque);
+    else if ((p = strrchr (entry->we_name, '/')) == NULL)
+      r = f (dir, entry->we_name, &stat, &xattrs, opaque);
+    else {
+      parent = strndup (entry->we_name, p - entry->we_name);
+      if (parent == NULL) {
+        perror ("strndup");
         return -1;
+      }
+      path = full_path (dir, parent);
+      r = f (path, p+1, &stat, &xattrs, opaque);
     }
+
+    if (r == -1)
+      return -1;
   }
 
   return 0;
@@ -23,6 +23,11 @@
 #include <string.h>
 #include <unistd.h>
 #include <limits.h>
+#include <fcntl.h>
+
+#ifdef HAVE_BLKID
+#include <blkid.h>
+#endif
 
 #include "daemon.h"
 #include "actions.h"
@@ -237,3 +242,191 @@ do_blkid (const char *device)
   else
     return blkid_without_p_i_opt (device);
 }
+
+/* Probe a single device for guestfs_internal_probe_devices.  Errors
+ * are not fatal: the fields of a device which cannot be probed are
+ * left empty, the same as if it did not contain a filesystem.
+ */
+#ifdef HAVE_BLKID
+
+/* Use the same low-level probing as blkid(8) does for its cache. */
+static int
+probe_device (const char *device, guestfs_int_internal_probe *p)
+{
+  blkid_probe pr;
+  const char *v;
+  int r;
+
+  pr = blkid_new_probe_from_filename (device);
+  if (pr == NULL) {
+    if (verbose)
+      fprintf (stderr, "blkid: %s: cannot create probe\n", device);
+    return 0;
+  }
+
+  blkid_probe_enable_superblocks (pr, 1);
+  blkid_probe_set_superblocks_flags (pr,
+                                     BLKID_SUBLKS_LABEL | BLKID_SUBLKS_UUID |
+                                     BLKID_SUBLKS_TYPE);
+  blkid_probe_enable_partitions (pr, 1);
+  blkid_probe_set_partitions_flags (pr, BLKID_PARTS_ENTRY_DETAILS);
+
+  p->ipr_size = blkid_probe_get_size (pr);
+
+  r = blkid_do_safeprobe (pr);
+  if (r == 0) {
+    if (blkid_probe_lookup_value (pr, "TYPE", &v, NULL) == 0 &&
+        (p->ipr_type = strdup (v)) == NULL)
+      goto error;
+    if (blkid_probe_lookup_value (pr, "LABEL", &v, NULL) == 0 &&
+        (p->ipr_label = strdup (v)) == NULL)
+      goto error;
+    if (blkid_probe_lookup_value (pr, "UUID", &v, NULL) == 0 &&
+        (p->ipr_uuid = strdup (v)) == NULL)
+      goto error;
+    if (blkid_probe_lookup_value (pr, "PART_ENTRY_UUID", &v, NULL) == 0 &&
+        (p->ipr_partuuid = strdup (v)) == NULL)
+      goto error;
+  }
+  else if (r < 0 && verbose)
+    fprintf (stderr, "blkid: %s: probe failed or ambivalent result (%d)\n",
+             device, r);
+
+  blkid_free_probe (pr);
+  return 0;
+
+ error:
+  reply_with_perror ("strdup");
+  blkid_free_probe (pr);
+  return -1;
+}
+
+#else /* !HAVE_BLKID */
+
+/* Without libblkid, run the blkid program once for each device. */
+static int
+set_probe_tag (guestfs_int_internal_probe *p, const char *tag, char *value)
+{
+  char **field;
+  char *src, *dst;
+
+  if (STREQ (tag, "TYPE"))
+    field = &p->ipr_type;
+  else if (STREQ (tag, "LABEL"))
+    field = &p->ipr_label;
+  else if (STREQ (tag, "UUID"))
+    field = &p->ipr_uuid;
+  else if (STREQ (tag, "PARTUUID"))
+    field = &p->ipr_partuuid;
+  else
+    return 0;
+
+  /* blkid -o export escapes unsafe characters with a backslash. */
+  for (src = dst = value; *src; ++src) {
+    if (*src == '\\' && src[1] != '\0')
+      src++;
+    *dst++ = *src;
+  }
+  *dst = '\0';
+
+  free (*field);
+  *field = strdup (value);
+  if (*field == NULL) {
+    reply_with_perror ("strdup");
+    return -1;
+  }
+  return 0;
+}
+
+static int
+probe_device (const char *device, guestfs_int_internal_probe *p)
+{
+  CLEANUP_FREE char *out = NULL, *err = NULL;
+  CLEANUP_FREE_STRING_LIST char **lines = NULL;
+  size_t i;
+  int fd, r;
+
+  fd = open (device, O_RDONLY|O_CLOEXEC);
+  if (fd >= 0) {
+    p->ipr_size = lseek (fd, 0, SEEK_END);
+    close (fd);
+  }
+
+  r = commandr (&out, &err, str_blkid, "-c", "/dev/null",
+                "-o", "export", device, NULL);
+  if (r != 0) {
+    /* 2 means that nothing was found. */
+    if (r != 2 && verbose)
+      fprintf (stderr, "blkid: %s: %s\n", device, err ? err : "");
+    return 0;
+  }
+
+  lines = split_lines (out);
+  if (lines == NULL)
+    return -1;
+
+  for (i = 0; lines[i] != NULL; ++i) {
+    char *eq = strchr (lines[i], '=');
+
+    if (eq == NULL)
+      continue;
+    *eq = '\0';
+    if (set_probe_tag (p, lines[i], eq+1) == -1)
+      return -1;
+  }
+
+  return 0;
+}
+
+#endif /* !HAVE_BLKID */
+
+guestfs_int_internal_probe_list *
+do_internal_probe_devices (char *const *devices)
+{
+  guestfs_int_internal_probe_list *r;
+  size_t i, n = count_strings (devices);
+
+  r = calloc (1, sizeof *r);
+  if (r == NULL) {
+    reply_with_perror ("calloc");
+    return NULL;
+  }
+  r->guestfs_int_internal_probe_list_val =
+    calloc (n, sizeof (guestfs_int_internal_probe));
+  if (r->guestfs_int_internal_probe_list_val == NULL) {
+    reply_with_perror ("calloc");
+    free (r);
+    return NULL;
+  }
+  r->guestfs_int_internal_probe_list_len = n;
+
+  for (i = 0; i < n; ++i) {
+    guestfs_int_internal_probe *p = &r->guestfs_int_internal_probe_list_val[i];
+
+    p->ipr_size = -1;
+    p->ipr_device = strdup (devices[i]);
+    if (p->ipr_device == NULL) {
+      reply_with_perror ("strdup");
+      goto error;
+    }
+    if (probe_device (devices[i], p) == -1)
+      goto error;
+
+    /* XDR cannot send NULL strings. */
+    if ((p->ipr_type == NULL && (p->ipr_type = strdup ("")) == NULL) ||
+        (p->ipr_label == NULL && (p->ipr_label = strdup ("")) == NULL) ||
+        (p->ipr_uuid == NULL && (p->ipr_uuid = strdup ("")) == NULL) ||
+        (p->ipr_partuuid == NULL &&
+         (p->ipr_partuuid = strdup ("")) == NULL)) {
+      reply_with_perror ("strdup");
+      goto error;
+    }
+  }
+
+  return r;
+
+ error:
+  xdr_free ((xdrproc_t) xdr_guestfs_int_internal_probe_list, (char *) r);
+  free (r);
+  return NULL;
+}
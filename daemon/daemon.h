@@ -24,6 +24,7 @@
 #include <stdint.h>
 #include <errno.h>
 #include <unistd.h>
+#include <sys/uio.h>
 
 #include <rpc/types.h>
 #include <rpc/xdr.h>
@@ -70,6 +71,8 @@ extern int is_root_device (const char *device);
 
 extern int xwrite (int sock, const void *buf, size_t len)
   __attribute__((__warn_unused_result__));
+extern int xwritev (int sock, struct iovec *iov, int iovcnt)
+  __attribute__((__warn_unused_result__));
 extern int xread (int sock, void *buf, size_t len)
   __attribute__((__warn_unused_result__));
 
@@ -199,6 +202,28 @@ extern int lv_canonical (const char *device, char **ret);
 extern void copy_lvm (void);
 extern void start_lvmetad (void);
 
+/*-- in parttable.c --*/
+struct parttable_entry {
+  int num;                      /* Partition number. */
+  int64_t start, end, size;     /* In bytes, end is inclusive. */
+  int mbr_id;                   /* MBR partition type byte, -1 for GPT. */
+  int bootable;                 /* MBR active flag. */
+  const char *mbr_part_type;    /* "primary", "extended" or "logical". */
+  char gpt_type[37];            /* GPT type GUID, "" for MBR. */
+  char gpt_guid[37];            /* GPT unique GUID, "" for MBR. */
+};
+
+struct parttable {
+  const char *parttype;         /* "msdos" or "gpt". */
+  char disk_guid[37];           /* GPT disk GUID, "" for MBR. */
+  size_t nr_entries;
+  struct parttable_entry *entries;
+};
+
+extern const struct parttable *read_parttable (const char *device);
+extern const struct parttable_entry *parttable_find (const struct parttable *t, int partnum);
+extern void invalidate_parttable (const char *device);
+
 /*-- in zero.c --*/
 extern void wipe_device_before_mkfs (const char *device);
 
@@ -217,9 +242,10 @@ augeas_is_version (int major, int minor, int patch)
   return augeas_version >= ((major << 16) | (minor << 8) | patch);
 }
 
-/*-- hivex.c, journal.c --*/
+/*-- hivex.c, journal.c, file-handle.c --*/
 extern void hivex_finalize (void);
 extern void journal_finalize (void);
+extern void file_handles_finalize (void);
 
 /*-- in proto.c --*/
 extern void main_loop (int sock) __attribute__((noreturn));
@@ -286,14 +312,22 @@ extern int cancel_receive (void);
 
 /* daemon functions that return files (FileOut) should call
  * reply, then send_file_* for each FileOut parameter.
- * Note max write size if GUESTFS_MAX_CHUNK_SIZE.
+ * send_file_write splits buf into chunks of at most chunk_size
+ * bytes, so callers can pass buffers up to GUESTFS_MAX_CHUNK_SIZE
+ * (or larger).
  */
+extern size_t chunk_size;
 extern int send_file_write (const void *buf, size_t len);
 extern int send_file_end (int cancel);
 
 /* only call this if there is a FileOut parameter */
 extern void reply (xdrproc_t xdrp, char *ret);
 
+/* Used by the generated stubs of functions with a streamed reply
+ * (stream_reply in generator/actions.ml) instead of reply.
+ */
+extern void reply_stream (xdrproc_t xdrp, char *ret);
+
 /* Notify progress to caller.  This function is self-rate-limiting so
  * you can call it as often as necessary.  Actions which call this
  * should add 'Progress' note in generator.
@@ -322,22 +356,13 @@ extern void pulse_mode_cancel (void);
  */
 extern void notify_progress_no_ratelimit (uint64_t position, uint64_t total, const struct timeval *now);
 
-/* Return true iff the buffer is all zero bytes.
- *
- * Note that gcc is smart enough to optimize this properly:
- * http://stackoverflow.com/questions/1493936/faster-means-of-checking-for-an-empty-buffer-in-c/1493989#1493989
+/* Return true iff the buffer is all zero bytes.  This uses the
+ * vectorized implementation in src/is-zero.c.
  */
 static inline int
 is_zero (const char *buffer, size_t size)
 {
-  size_t i;
-
-  for (i = 0; i < size; ++i) {
-    if (buffer[i] != 0)
-      return 0;
-  }
-
-  return 1;
+  return guestfs_int_is_zero (buffer, size);
 }
 
 /* Helper for building up short lists of arguments.  Your code has to
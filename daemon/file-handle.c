@@ -0,0 +1,244 @@
+/* libguestfs - the guestfsd daemon
+ * Copyright (C) 2016 Red Hat Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * Handle-based file access, used by L<guestfs(3)/guestfs_mount_local>.
+ *
+ * C<guestfs_pread> and C<guestfs_pwrite> have to look up the path and
+ * open and close the file on every call.  Instead the library can
+ * open a file once (C<internal_file_open>), and then read and write
+ * it using the returned handle.
+ *
+ * Each handle keeps its file descriptor open until it is closed, so
+ * that it still refers to the same file if the file is renamed or
+ * unlinked, as the caller expects.  The number of handles is bounded,
+ * and opening another one fails with C<EMFILE>.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include "guestfs_protocol.h"
+#include "daemon.h"
+#include "actions.h"
+
+/* Maximum number of handles open at any one time.  This leaves
+ * plenty of file descriptors for the rest of the daemon below the
+ * default limit of 1024.
+ */
+#define MAX_FILE_HANDLES 512
+
+struct open_file {
+  char *path;                   /* NULL if this slot is free. */
+  int write;                    /* Opened for writing. */
+  int fd;
+};
+
+static struct open_file *handles = NULL;
+static size_t nr_handles = 0;   /* Number of allocated slots. */
+
+/* Close all handles (called before unmounting filesystems and on
+ * daemon exit).
+ */
+void file_handles_finalize (void) __attribute__((destructor));
+void
+file_handles_finalize (void)
+{
+  size_t i;
+
+  for (i = 0; i < nr_handles; ++i) {
+    if (handles[i].fd >= 0)
+      close (handles[i].fd);
+    free (handles[i].path);
+  }
+  free (handles);
+  handles = NULL;
+  nr_handles = 0;
+}
+
+/* Look up the handle. */
+static struct open_file *
+get_handle (int handle)
+{
+  if (handle < 0 || (size_t) handle >= nr_handles ||
+      handles[handle].path == NULL) {
+    reply_with_error ("%d: invalid file handle", handle);
+    return NULL;
+  }
+
+  return &handles[handle];
+}
+
+int
+do_internal_file_open (const char *path, int write)
+{
+  struct open_file *h;
+  size_t i;
+  int fd;
+
+  for (i = 0; i < nr_handles; ++i) {
+    if (handles[i].path == NULL)
+      break;
+  }
+
+  if (i == nr_handles) {
+    struct open_file *new_handles;
+    size_t n;
+
+    if (nr_handles >= MAX_FILE_HANDLES) {
+      reply_with_error_errno (EMFILE, "too many open file handles");
+      return -1;
+    }
+
+    n = nr_handles == 0 ? 16 : nr_handles * 2;
+    new_handles = realloc (handles, n * sizeof (struct open_file));
+    if (new_handles == NULL) {
+      reply_with_perror ("realloc");
+      return -1;
+    }
+    handles = new_handles;
+    for (; nr_handles < n; ++nr_handles) {
+      handles[nr_handles].path = NULL;
+      handles[nr_handles].fd = -1;
+    }
+  }
+
+  CHROOT_IN;
+  fd = open (path, (write ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+  CHROOT_OUT;
+  if (fd == -1) {
+    reply_with_perror ("open: %s", path);
+    return -1;
+  }
+
+  h = &handles[i];
+  h->path = strdup (path);
+  if (h->path == NULL) {
+    reply_with_perror ("strdup");
+    close (fd);
+    return -1;
+  }
+  h->write = write;
+  h->fd = fd;
+
+  return i;
+}
+
+char *
+do_internal_file_pread (int handle, int count, int64_t offset, size_t *size_r)
+{
+  struct open_file *h;
+  ssize_t r;
+  char *buf;
+
+  if (count < 0) {
+    reply_with_error ("count is negative");
+    return NULL;
+  }
+  if (offset < 0) {
+    reply_with_error ("offset is negative");
+    return NULL;
+  }
+  /* See the comment in pread_fd in file.c. */
+  if (count >= GUESTFS_MESSAGE_MAX) {
+    reply_with_error ("count is too large for the protocol, use smaller reads");
+    return NULL;
+  }
+
+  h = get_handle (handle);
+  if (h == NULL)
+    return NULL;
+
+  buf = malloc (count);
+  if (buf == NULL) {
+    reply_with_perror ("malloc");
+    return NULL;
+  }
+
+  r = pread (h->fd, buf, count, offset);
+  if (r == -1) {
+    reply_with_perror ("pread: %s", h->path);
+    free (buf);
+    return NULL;
+  }
+
+  *size_r = r;
+  return buf;
+}
+
+int
+do_internal_file_pwrite (int handle, const char *content, size_t size,
+                         int64_t offset)
+{
+  struct open_file *h;
+  ssize_t r;
+
+  if (offset < 0) {
+    reply_with_error ("offset is negative");
+    return -1;
+  }
+
+  h = get_handle (handle);
+  if (h == NULL)
+    return -1;
+
+  if (!h->write) {
+    reply_with_error_errno (EBADF, "%s: file handle is not open for writing",
+                            h->path);
+    return -1;
+  }
+
+  r = pwrite (h->fd, content, size, offset);
+  if (r == -1) {
+    reply_with_perror ("pwrite: %s", h->path);
+    return -1;
+  }
+
+  return r;
+}
+
+int
+do_internal_file_close (int handle)
+{
+  struct open_file *h;
+  int r = 0;
+
+  if (handle < 0 || (size_t) handle >= nr_handles ||
+      handles[handle].path == NULL) {
+    reply_with_error ("%d: invalid file handle", handle);
+    return -1;
+  }
+
+  h = &handles[handle];
+  if (close (h->fd) == -1) {
+    reply_with_perror ("close: %s", h->path);
+    r = -1;
+  }
+  free (h->path);
+  h->path = NULL;
+  h->fd = -1;
+
+  return r;
+}
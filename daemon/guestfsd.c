@@ -38,6 +38,7 @@
 #include <sys/param.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <fcntl.h>
 #include <signal.h>
 #include <netdb.h>
@@ -63,7 +64,6 @@
 
 #include "daemon.h"
 
-GUESTFSD_EXT_CMD(str_udevadm, udevadm);
 GUESTFSD_EXT_CMD(str_uuidgen, uuidgen);
 
 #ifndef MAX
@@ -476,6 +476,42 @@ xwrite (int sock, const void *v_buf, size_t len)
   return 0;
 }
 
+/* Like xwrite, but gathers the data from several buffers.  The iov
+ * array is modified as partial writes complete.
+ */
+int
+xwritev (int sock, struct iovec *iov, int iovcnt)
+{
+  ssize_t r;
+
+  for (;;) {
+    while (iovcnt > 0 && iov->iov_len == 0) {
+      iov++;
+      iovcnt--;
+    }
+    if (iovcnt == 0)
+      return 0;
+
+    r = writev (sock, iov, iovcnt);
+    if (r == -1) {
+      perror ("writev");
+      return -1;
+    }
+
+    while (r > 0) {
+      if ((size_t) r < iov->iov_len) {
+        iov->iov_base = (char *) iov->iov_base + r;
+        iov->iov_len -= r;
+        break;
+      }
+      r -= iov->iov_len;
+      iov->iov_len = 0;
+      iov++;
+      iovcnt--;
+    }
+  }
+}
+
 int
 xread (int sock, void *v_buf, size_t len)
 {
@@ -1203,32 +1239,6 @@ random_name (char *template)
   return 0;
 }
 
-/**
- * LVM and other commands aren't synchronous, especially when udev is
- * involved.  eg. You can create or remove some device, but the
- * C</dev> device node won't appear until some time later.  This means
- * that you get an error if you run one command followed by another.
- *
- * Use C<udevadm settle> after certain commands, but don't be too
- * fussed if it fails.
- */
-void
-udev_settle (void)
-{
-  char cmd[80];
-  int r;
-
-  snprintf (cmd, sizeof cmd, "%s%s settle",
-            str_udevadm, verbose ? " --debug" : "");
-  if (verbose)
-    printf ("%s\n", cmd);
-  r = system (cmd);
-  if (r == -1)
-    perror ("system");
-  else if (!WIFEXITED (r) || WEXITSTATUS (r) != 0)
-    fprintf (stderr, "warning: udevadm command failed\n");
-}
-
 char *
 get_random_uuid (void)
 {
@@ -21,10 +21,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <limits.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/stat.h>
+#ifdef HAVE_ENDIAN_H
+#include <endian.h>
+#endif
+#ifdef HAVE_SYS_ENDIAN_H
+#include <sys/endian.h>
+#endif
 
 #include "guestfs_protocol.h"
 #include "daemon.h"
@@ -413,6 +420,151 @@ do_hivex_node_set_value (int64_t nodeh,
   return 0;
 }
 
+/* Buffer used by do_internal_hivex_export.  The whole subtree is
+ * serialized before the reply is sent, so that errors can still be
+ * reported normally.
+ */
+struct export_buffer {
+  char *data;
+  size_t len;
+  size_t alloc;
+};
+
+static int
+export_append (struct export_buffer *b, const void *data, size_t len)
+{
+  if (b->len + len > b->alloc) {
+    const size_t alloc = MAX (b->alloc * 2, b->len + len);
+    char *p = realloc (b->data, alloc);
+    if (p == NULL) {
+      reply_with_perror ("realloc");
+      return -1;
+    }
+    b->data = p;
+    b->alloc = alloc;
+  }
+
+  memcpy (&b->data[b->len], data, len);
+  b->len += len;
+  return 0;
+}
+
+static int
+export_append_be32 (struct export_buffer *b, uint32_t v)
+{
+  v = htobe32 (v);
+  return export_append (b, &v, sizeof v);
+}
+
+static int
+export_append_string (struct export_buffer *b, const char *str, size_t len)
+{
+  if (export_append_be32 (b, len) == -1)
+    return -1;
+  return export_append (b, str, len);
+}
+
+/* Serialize a node, its values and (up to maxdepth levels of) its
+ * children.  maxdepth < 0 means there is no limit.
+ */
+static int
+export_node (struct export_buffer *b, hive_node_h node, int maxdepth)
+{
+  CLEANUP_FREE char *name = NULL;
+  CLEANUP_FREE hive_value_h *values = NULL;
+  CLEANUP_FREE hive_node_h *children = NULL;
+  size_t i, nr_values, nr_children;
+
+  name = hivex_node_name (h, node);
+  if (name == NULL) {
+    reply_with_perror ("hivex_node_name");
+    return -1;
+  }
+  if (export_append_string (b, name, strlen (name)) == -1)
+    return -1;
+
+  values = hivex_node_values (h, node);
+  if (values == NULL) {
+    reply_with_perror ("hivex_node_values: %s", name);
+    return -1;
+  }
+  for (nr_values = 0; values[nr_values] != 0; ++nr_values)
+    ;
+  if (export_append_be32 (b, nr_values) == -1)
+    return -1;
+
+  for (i = 0; i < nr_values; ++i) {
+    CLEANUP_FREE char *key = NULL, *value = NULL;
+    hive_type t;
+    size_t len;
+
+    key = hivex_value_key (h, values[i]);
+    if (key == NULL) {
+      reply_with_perror ("hivex_value_key: %s", name);
+      return -1;
+    }
+    value = hivex_value_value (h, values[i], &t, &len);
+    if (value == NULL) {
+      reply_with_perror ("hivex_value_value: %s\\%s", name, key);
+      return -1;
+    }
+    if (export_append_string (b, key, strlen (key)) == -1 ||
+        export_append_be32 (b, t) == -1 ||
+        export_append_string (b, value, len) == -1)
+      return -1;
+  }
+
+  if (maxdepth == 0)
+    return export_append_be32 (b, 0);
+
+  children = hivex_node_children (h, node);
+  if (children == NULL) {
+    reply_with_perror ("hivex_node_children: %s", name);
+    return -1;
+  }
+  for (nr_children = 0; children[nr_children] != 0; ++nr_children)
+    ;
+  if (export_append_be32 (b, nr_children) == -1)
+    return -1;
+
+  for (i = 0; i < nr_children; ++i) {
+    if (export_node (b, children[i], maxdepth > 0 ? maxdepth-1 : -1) == -1)
+      return -1;
+  }
+
+  return 0;
+}
+
+/* Has one FileOut parameter. */
+int
+do_internal_hivex_export (int64_t nodeh, int maxdepth)
+{
+  struct export_buffer b = { .data = NULL, .len = 0, .alloc = 0 };
+  CLEANUP_FREE char *data = NULL;
+  int r;
+
+  NEED_HANDLE (-1);
+
+  r = export_node (&b, nodeh, maxdepth);
+  data = b.data;
+  if (r == -1)
+    return -1;
+
+  /* Now we must send the reply message, before the file contents.
+   * After this there is no opportunity in the protocol to send any
+   * error message back.  Instead we can only cancel the transfer.
+   */
+  reply (NULL, NULL);
+
+  if (send_file_write (b.data, b.len) < 0)
+    return -1;
+
+  /* Normal end of file. */
+  if (send_file_end (0))
+    return -1;
+  return 0;
+}
+
 #else /* !HAVE_HIVEX */
 
 OPTGROUP_HIVEX_NOT_AVAILABLE
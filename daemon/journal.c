@@ -236,6 +236,171 @@ do_journal_get_realtime_usec (void)
   return (int64_t) usec;
 }
 
+/* Output buffer for do_journal_export.  Entries are packed into
+ * chunks of GUESTFS_MAX_CHUNK_SIZE, instead of sending a chunk for
+ * every field.
+ */
+struct export_buffer {
+  char *data;
+  size_t len;
+};
+
+static int
+export_write (struct export_buffer *b, const void *data, size_t len)
+{
+  if (b->len + len > GUESTFS_MAX_CHUNK_SIZE) {
+    if (b->len > 0 && send_file_write (b->data, b->len) < 0)
+      return -1;
+    b->len = 0;
+  }
+
+  /* Fields which are too large for the buffer are sent directly. */
+  if (len > GUESTFS_MAX_CHUNK_SIZE)
+    return send_file_write (data, len);
+
+  memcpy (&b->data[b->len], data, len);
+  b->len += len;
+  return 0;
+}
+
+static int
+export_write_be64 (struct export_buffer *b, uint64_t v)
+{
+  v = htobe64 (v);
+  return export_write (b, &v, sizeof v);
+}
+
+/* Is the "FIELD=data" field in the list of field names? */
+static int
+field_wanted (char *const *fields, const void *data, size_t len)
+{
+  size_t i, n;
+
+  for (i = 0; fields[i] != NULL; ++i) {
+    n = strlen (fields[i]);
+    if (n < len && memcmp (data, fields[i], n) == 0 &&
+        ((const char *) data)[n] == '=')
+      return 1;
+  }
+
+  return 0;
+}
+
+/* Has one FileOut parameter. */
+int
+do_journal_export (int64_t since, int64_t until,
+                   char *const *matches, char *const *fields)
+{
+  struct export_buffer b;
+  CLEANUP_FREE char *buffer = NULL;
+  size_t i, nr_fields;
+  const void *data;
+  size_t len;
+  uint64_t usec;
+  int r, ret = -1;
+
+  NEED_HANDLE (-1);
+
+  if (!(optargs_bitmask & GUESTFS_JOURNAL_EXPORT_SINCE_BITMASK))
+    since = -1;
+  if (!(optargs_bitmask & GUESTFS_JOURNAL_EXPORT_UNTIL_BITMASK))
+    until = -1;
+  if (!(optargs_bitmask & GUESTFS_JOURNAL_EXPORT_FIELDS_BITMASK))
+    fields = NULL;
+
+  buffer = malloc (GUESTFS_MAX_CHUNK_SIZE);
+  if (buffer == NULL) {
+    reply_with_perror ("malloc");
+    return -1;
+  }
+  b.data = buffer;
+  b.len = 0;
+
+  sd_journal_flush_matches (j);
+  if (optargs_bitmask & GUESTFS_JOURNAL_EXPORT_MATCHES_BITMASK) {
+    for (i = 0; matches[i] != NULL; ++i) {
+      if (strchr (matches[i], '=') == NULL) {
+        reply_with_error ("%s: match must have the form FIELD=value",
+                          matches[i]);
+        goto out;
+      }
+      r = sd_journal_add_match (j, matches[i], 0);
+      if (r < 0) {
+        reply_with_perror_errno (-r, "sd_journal_add_match: %s", matches[i]);
+        goto out;
+      }
+    }
+  }
+
+  if (since >= 0)
+    r = sd_journal_seek_realtime_usec (j, (uint64_t) since);
+  else
+    r = sd_journal_seek_head (j);
+  if (r < 0) {
+    reply_with_perror_errno (-r, "sd_journal_seek");
+    goto out;
+  }
+
+  /* Now we must send the reply message, before the file contents.
+   * After this there is no opportunity in the protocol to send any
+   * error message back.  Instead we can only cancel the transfer.
+   */
+  reply (NULL, NULL);
+
+  while ((r = sd_journal_next (j)) > 0) {
+    r = sd_journal_get_realtime_usec (j, &usec);
+    if (r < 0)
+      break;
+    if (until >= 0 && usec >= (uint64_t) until)
+      break;
+
+    /* Count the fields first, so the count can be written before
+     * the fields.
+     */
+    nr_fields = 0;
+    SD_JOURNAL_FOREACH_DATA (j, data, len) {
+      if (fields == NULL || field_wanted (fields, data, len))
+        nr_fields++;
+    }
+
+    if (export_write_be64 (&b, usec) < 0 ||
+        export_write_be64 (&b, nr_fields) < 0)
+      goto out;
+
+    sd_journal_restart_data (j);
+    while ((r = sd_journal_enumerate_data (j, &data, &len)) > 0) {
+      if (fields != NULL && !field_wanted (fields, data, len))
+        continue;
+      if (export_write_be64 (&b, len) < 0 ||
+          export_write (&b, data, len) < 0)
+        goto out;
+    }
+    if (r < 0)
+      break;
+  }
+
+  /* Failure while reading the journal. */
+  if (r < 0) {
+    send_file_end (1);          /* Cancel. */
+    errno = -r;
+    perror ("sd_journal");
+    goto out;
+  }
+
+  if (b.len > 0 && send_file_write (b.data, b.len) < 0)
+    goto out;
+
+  /* Normal end of file. */
+  if (send_file_end (0))
+    goto out;
+
+  ret = 0;
+
+ out:
+  sd_journal_flush_matches (j);
+  return ret;
+}
+
 #else /* !HAVE_SD_JOURNAL */
 
 OPTGROUP_JOURNAL_NOT_AVAILABLE
@@ -23,11 +23,15 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <error.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <mntent.h>
 
+#include "ignore-value.h"
+
 #include "daemon.h"
 #include "actions.h"
 
@@ -210,6 +214,160 @@ do_mount_options (const char *options, const mountable_t *mountable,
   return do_mount_vfs (options, NULL, mountable, mountpoint);
 }
 
+/* Maximum number of mount(8) processes run at the same time by
+ * internal_mount_ro_list, and maximum length of the error message
+ * returned for each device.
+ */
+#define MAX_PARALLEL_MOUNTS 16
+#define MAX_MOUNT_ERROR 4096
+
+struct mount_job {
+  pid_t pid;                    /* -1 if the job could not be started. */
+  int fd;                       /* Pipe carrying the error message. */
+  char *error;                  /* Error, if the job could not be started. */
+};
+
+/* Start a process which mounts 'device' read-only on 'mountpoint'
+ * (creating the mountpoint if it doesn't exist), and writes the error
+ * message from mount(8) to a pipe if that fails.
+ */
+static void
+start_mount_job (const char *device, const char *mountpoint,
+                 struct mount_job *job)
+{
+  CLEANUP_FREE char *mp = NULL;
+  int fd[2];
+
+  job->pid = -1;
+  job->fd = -1;
+  job->error = NULL;
+
+  mp = sysroot_path (mountpoint);
+  if (mp == NULL) {
+    job->error = strdup ("malloc");
+    return;
+  }
+  if (mkdir (mp, 0777) == -1 && errno != EEXIST) {
+    ignore_value (asprintf (&job->error, "mkdir: %m"));
+    return;
+  }
+
+  if (pipe2 (fd, O_CLOEXEC) == -1) {
+    ignore_value (asprintf (&job->error, "pipe2: %m"));
+    return;
+  }
+
+  job->pid = fork ();
+  if (job->pid == -1) {
+    ignore_value (asprintf (&job->error, "fork: %m"));
+    close (fd[0]);
+    close (fd[1]);
+    return;
+  }
+
+  if (job->pid == 0) {          /* Child. */
+    CLEANUP_FREE char *error = NULL;
+
+    close (fd[0]);
+    if (command (NULL, &error, str_mount, "-o", "ro", device, mp, NULL) == -1) {
+      /* Truncated so that it always fits in the pipe buffer. */
+      if (error)
+        ignore_value (xwrite (fd[1], error,
+                              MIN (strlen (error), MAX_MOUNT_ERROR - 1)));
+      _exit (EXIT_FAILURE);
+    }
+    _exit (EXIT_SUCCESS);
+  }
+
+  close (fd[1]);
+  job->fd = fd[0];
+}
+
+/* Wait for the job to finish.  Returns an empty string if the device
+ * was mounted, or the error message.  Returns NULL if out of memory.
+ */
+static char *
+finish_mount_job (const char *device, const char *mountpoint,
+                  struct mount_job *job)
+{
+  CLEANUP_FREE char *error = job->error;
+  char buf[MAX_MOUNT_ERROR];
+  size_t len = 0;
+  ssize_t r;
+  int status;
+  char *ret;
+
+  if (job->pid != -1) {
+    while (len < sizeof buf - 1 &&
+           (r = read (job->fd, buf + len, sizeof buf - 1 - len)) > 0)
+      len += r;
+    buf[len] = '\0';
+    close (job->fd);
+
+    if (waitpid (job->pid, &status, 0) == -1)
+      ignore_value (asprintf (&error, "waitpid: %m"));
+    else if (WIFEXITED (status) && WEXITSTATUS (status) == 0)
+      return strdup ("");
+    else
+      error = strdup (len > 0 ? buf : "mount failed");
+  }
+
+  if (asprintf (&ret, "%s on %s: %s",
+                device, mountpoint, error ? error : "malloc") == -1)
+    return NULL;
+  return ret;
+}
+
+/* Mount all of the devices read-only, each on its own mountpoint, by
+ * running several mount processes at the same time.  Returns a list
+ * with an error message (or an empty string) for each device.
+ */
+char **
+do_internal_mount_ro_list (char *const *devices, char *const *mountpoints)
+{
+  CLEANUP_FREE_STRINGSBUF DECLARE_STRINGSBUF (ret);
+  struct mount_job jobs[MAX_PARALLEL_MOUNTS];
+  size_t i, j, n, nr_jobs;
+  int r = 0;
+
+  n = count_strings (devices);
+  if (count_strings (mountpoints) != n) {
+    reply_with_error ("lists of devices and mountpoints have different lengths");
+    return NULL;
+  }
+  for (i = 0; i < n; ++i)
+    ABS_PATH (mountpoints[i], , return NULL);
+
+  for (i = 0; i < n; i += nr_jobs) {
+    nr_jobs = MIN (n - i, MAX_PARALLEL_MOUNTS);
+
+    for (j = 0; j < nr_jobs; ++j)
+      start_mount_job (devices[i+j], mountpoints[i+j], &jobs[j]);
+
+    /* Always wait for all the jobs, even after an error. */
+    for (j = 0; j < nr_jobs; ++j) {
+      char *error = finish_mount_job (devices[i+j], mountpoints[i+j], &jobs[j]);
+
+      if (error == NULL) {
+        if (r == 0)
+          reply_with_perror ("malloc");
+        r = -1;
+      }
+      else if (r == -1)
+        free (error);
+      else if (add_string_nodup (&ret, error) == -1)
+        r = -1;
+    }
+    if (r == -1)
+      return NULL;
+  }
+
+  if (end_stringsbuf (&ret) == -1)
+    return NULL;
+
+  return take_stringsbuf (&ret);
+}
+
 /* Takes optional arguments, consult optargs_bitmask. */
 int
 do_umount (const char *pathordevice,
@@ -372,6 +530,7 @@ do_umount_all (void)
   aug_finalize ();
   hivex_finalize ();
   journal_finalize ();
+  file_handles_finalize ();
 
   /* NB: Eventually we should aim to parse /proc/self/mountinfo, but
    * that requires custom parsing code.
@@ -89,6 +89,7 @@ do_part_init (const char *device, const char *parttype)
 
   r = commandf (NULL, &err, COMMAND_FLAG_FOLD_STDOUT_ON_STDERR,
                 str_parted, "-s", "--", device, "mklabel", parttype, NULL);
+  invalidate_parttable (device);
   if (r == -1) {
     reply_with_error ("parted: %s: %s", device, err);
     return -1;
@@ -143,6 +144,7 @@ do_part_add (const char *device, const char *prlogex,
   r = commandf (NULL, &err, COMMAND_FLAG_FOLD_STDOUT_ON_STDERR,
                 str_parted, "-s", "--",
                 device, "mkpart", prlogex, startstr, endstr, NULL);
+  invalidate_parttable (device);
   if (r == -1) {
     reply_with_error ("parted: %s: %s", device, err);
     return -1;
@@ -171,6 +173,7 @@ do_part_del (const char *device, int partnum)
 
   r = commandf (NULL, &err, COMMAND_FLAG_FOLD_STDOUT_ON_STDERR,
                 str_parted, "-s", "--", device, "rm", partnum_str, NULL);
+  invalidate_parttable (device);
   if (r == -1) {
     reply_with_error ("parted: %s: %s", device, err);
     return -1;
@@ -215,6 +218,7 @@ do_part_disk (const char *device, const char *parttype)
                 /* See comment about about the parted mkpart command. */
                 "mkpart", STREQ (parttype, "gpt") ? "p1" : "primary",
                 startstr, endstr, NULL);
+  invalidate_parttable (device);
   if (r == -1) {
     reply_with_error ("parted: %s: %s", device, err);
     return -1;
@@ -245,6 +249,7 @@ do_part_set_bootable (const char *device, int partnum, int bootable)
   r = commandf (NULL, &err, COMMAND_FLAG_FOLD_STDOUT_ON_STDERR,
                 str_parted, "-s", "--",
                 device, "set", partstr, "boot", bootable ? "on" : "off", NULL);
+  invalidate_parttable (device);
   if (r == -1) {
     reply_with_error ("parted: %s: %s", device, err);
     return -1;
@@ -274,6 +279,7 @@ do_part_set_name (const char *device, int partnum, const char *name)
 
   r = commandf (NULL, &err, COMMAND_FLAG_FOLD_STDOUT_ON_STDERR,
                 str_parted, "-s", "--", device, "name", partstr, name, NULL);
+  invalidate_parttable (device);
   if (r == -1) {
     reply_with_error ("parted: %s: %s", device, err);
     return -1;
@@ -346,6 +352,14 @@ print_partition_table (const char *device, bool add_m_option)
 char *
 do_part_get_parttype (const char *device)
 {
+  const struct parttable *t = read_parttable (device);
+  if (t) {
+    char *r = strdup (t->parttype);
+    if (r == NULL)
+      reply_with_perror ("strdup");
+    return r;
+  }
+
   CLEANUP_FREE char *out = print_partition_table (device, true);
   if (!out)
     return NULL;
@@ -382,9 +396,44 @@ do_part_get_parttype (const char *device)
   return r;
 }
 
+/* Return the partitions read by read_parttable. */
+static guestfs_int_partition_list *
+part_list_from_parttable (const struct parttable *t)
+{
+  guestfs_int_partition_list *r;
+  size_t i;
+
+  r = malloc (sizeof *r);
+  if (r == NULL) {
+    reply_with_perror ("malloc");
+    return NULL;
+  }
+  r->guestfs_int_partition_list_len = t->nr_entries;
+  r->guestfs_int_partition_list_val =
+    malloc (t->nr_entries * sizeof (guestfs_int_partition));
+  if (r->guestfs_int_partition_list_val == NULL) {
+    reply_with_perror ("malloc");
+    free (r);
+    return NULL;
+  }
+
+  for (i = 0; i < t->nr_entries; ++i) {
+    r->guestfs_int_partition_list_val[i].part_num = t->entries[i].num;
+    r->guestfs_int_partition_list_val[i].part_start = t->entries[i].start;
+    r->guestfs_int_partition_list_val[i].part_end = t->entries[i].end;
+    r->guestfs_int_partition_list_val[i].part_size = t->entries[i].size;
+  }
+
+  return r;
+}
+
 guestfs_int_partition_list *
 do_part_list (const char *device)
 {
+  const struct parttable *t = read_parttable (device);
+  if (t)
+    return part_list_from_parttable (t);
+
   CLEANUP_FREE char *out = print_partition_table (device, true);
   if (!out)
     return NULL;
@@ -446,6 +495,16 @@ do_part_get_bootable (const char *device, int partnum)
     return -1;
   }
 
+  /* parted's idea of the "boot" flag on GPT is complicated, so only
+   * MBR is handled natively.
+   */
+  const struct parttable *t = read_parttable (device);
+  if (t && STREQ (t->parttype, "msdos")) {
+    const struct parttable_entry *e = parttable_find (t, partnum);
+    if (e)
+      return e->bootable;
+  }
+
   CLEANUP_FREE char *out = print_partition_table (device, true);
   if (!out)
     return -1;
@@ -516,7 +575,8 @@ test_sfdisk_has_part_type (void)
   return tested;
 }
 
-/* Currently we use sfdisk for getting and setting the ID byte.  In
+/* Currently we use sfdisk for setting the ID byte, and for getting
+ * it when the partition table cannot be read by read_parttable.  In
  * future, extend parted to provide this functionality.  As a result
  * of using sfdisk, this won't work for non-MBR-style partitions, but
  * that limitation is noted in the documentation and we can extend it
@@ -530,6 +590,13 @@ do_part_get_mbr_id (const char *device, int partnum)
     return -1;
   }
 
+  const struct parttable *t = read_parttable (device);
+  if (t && STREQ (t->parttype, "msdos")) {
+    const struct parttable_entry *e = parttable_find (t, partnum);
+    if (e)
+      return e->mbr_id;
+  }
+
   const char *param = test_sfdisk_has_part_type () ? "--part-type" : "--print-id";
 
   char partnum_str[16];
@@ -582,6 +649,7 @@ do_part_set_mbr_id (const char *device, int partnum, int idbyte)
 
   r = command (NULL, &err, str_sfdisk,
                param, device, partnum_str, idbyte_str, NULL);
+  invalidate_parttable (device);
   if (r == -1) {
     reply_with_error ("sfdisk %s: %s", param, err);
     return -1;
@@ -615,6 +683,7 @@ do_part_set_gpt_type (const char *device, int partnum, const char *guid)
   CLEANUP_FREE char *err = NULL;
   int r = commandf (NULL, &err, COMMAND_FLAG_FOLD_STDOUT_ON_STDERR,
                     str_sgdisk, device, "-t", typecode, NULL);
+  invalidate_parttable (device);
 
   if (r == -1) {
     reply_with_error ("%s %s -t %s: %s", str_sgdisk, device, typecode, err);
@@ -641,6 +710,7 @@ do_part_set_gpt_guid (const char *device, int partnum, const char *guid)
   CLEANUP_FREE char *err = NULL;
   int r = commandf (NULL, &err, COMMAND_FLAG_FOLD_STDOUT_ON_STDERR,
                     str_sgdisk, device, "-u", typecode, NULL);
+  invalidate_parttable (device);
 
   if (r == -1) {
     reply_with_error ("%s %s -u %s: %s", str_sgdisk, device, typecode, err);
@@ -752,9 +822,30 @@ extract_uuid (const char *value)
   return ret;
 }
 
+/* Find a partition in a GPT read by read_parttable.  Returns NULL if
+ * the information has to be read using sgdisk instead.
+ */
+static const struct parttable_entry *
+find_gpt_partition (const char *device, int partnum)
+{
+  const struct parttable *t = read_parttable (device);
+  if (t == NULL || STRNEQ (t->parttype, "gpt"))
+    return NULL;
+
+  return parttable_find (t, partnum);
+}
+
 char *
 do_part_get_gpt_type (const char *device, int partnum)
 {
+  const struct parttable_entry *e = find_gpt_partition (device, partnum);
+  if (e) {
+    char *r = strdup (e->gpt_type);
+    if (r == NULL)
+      reply_with_perror ("strdup");
+    return r;
+  }
+
   return sgdisk_info_extract_field (device, partnum,
                                     "Partition GUID code", extract_uuid);
 }
@@ -762,6 +853,14 @@ do_part_get_gpt_type (const char *device, int partnum)
 char *
 do_part_get_gpt_guid (const char *device, int partnum)
 {
+  const struct parttable_entry *e = find_gpt_partition (device, partnum);
+  if (e) {
+    char *r = strdup (e->gpt_guid);
+    if (r == NULL)
+      reply_with_perror ("strdup");
+    return r;
+  }
+
   return sgdisk_info_extract_field (device, partnum,
                                     "Partition unique GUID", extract_uuid);
 }
@@ -826,9 +925,20 @@ do_part_get_name (const char *device, int partnum)
 char *
 do_part_get_mbr_part_type (const char *device, int partnum)
 {
-  CLEANUP_FREE char *parttype;
+  CLEANUP_FREE char *parttype = NULL;
   char *part_type;
 
+  const struct parttable *t = read_parttable (device);
+  if (t) {
+    const struct parttable_entry *e = parttable_find (t, partnum);
+    if (e) {
+      part_type = strdup (e->mbr_part_type);
+      if (part_type == NULL)
+        reply_with_perror ("strdup");
+      return part_type;
+    }
+  }
+
   parttype = do_part_get_parttype (device);
   if (parttype == NULL)
     return NULL;
@@ -935,6 +1045,14 @@ do_part_get_disk_guid (const char *device)
   const char *pattern = "Disk identifier (GUID):";
   size_t i;
 
+  const struct parttable *t = read_parttable (device);
+  if (t && STREQ (t->parttype, "gpt")) {
+    char *r = strdup (t->disk_guid);
+    if (r == NULL)
+      reply_with_perror ("strdup");
+    return r;
+  }
+
   CLEANUP_FREE char *err = NULL;
   int r = commandf (NULL, &err, COMMAND_FLAG_FOLD_STDOUT_ON_STDERR,
                     str_sgdisk, device, "-p", NULL);
@@ -980,6 +1098,7 @@ do_part_set_disk_guid (const char *device, const char *guid)
   CLEANUP_FREE char *err = NULL;
   int r = commandf (NULL, &err, COMMAND_FLAG_FOLD_STDOUT_ON_STDERR,
                     str_sgdisk, device, "-U", guid, NULL);
+  invalidate_parttable (device);
 
   if (r == -1) {
     reply_with_error ("%s %s -U %s: %s", str_sgdisk, device, guid, err);
@@ -995,6 +1114,7 @@ do_part_set_disk_guid_random (const char *device)
   CLEANUP_FREE char *err = NULL;
   int r = commandf (NULL, &err, COMMAND_FLAG_FOLD_STDOUT_ON_STDERR,
                     str_sgdisk, device, "-U", "R", NULL);
+  invalidate_parttable (device);
 
   if (r == -1) {
     reply_with_error ("%s %s -U R: %s", str_sgdisk, device, err);
@@ -1029,6 +1149,7 @@ do_part_expand_gpt(const char *device)
   /* Now we can do a real run. */
   r = commandf (NULL, &err, COMMAND_FLAG_FOLD_STDOUT_ON_STDERR,
                 str_sgdisk, "-e", device, NULL);
+  invalidate_parttable (device);
 
   if (r == -1) {
     reply_with_error ("%s -e %s: %s", str_sgdisk, device, err);
@@ -0,0 +1,732 @@
+/* libguestfs - the guestfsd daemon
+ * Copyright (C) 2016 Red Hat Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * Read MBR and GPT partition tables directly.
+ *
+ * Most of the C<part_*> calls in F<daemon/parted.c> have to run
+ * L<parted(8)>, L<sfdisk(8)> or L<sgdisk(8)> and parse their output.
+ * That is slow when the library queries every partition on every
+ * disk, as C<guestfs_list_filesystems> and inspection do.  For the
+ * common cases, MBR (including logical partitions) and GPT, the
+ * partition table is parsed here instead.
+ *
+ * Anything unusual (other partition table types, bad checksums,
+ * overlapping partitions, partitions beyond the end of the device, a
+ * filesystem on the whole device, ...) makes C<read_parttable> return
+ * C<NULL>, and the callers fall back to the external programs, so
+ * that they behave and fail exactly as before.
+ *
+ * Parsed tables are cached per device.  The calls which write
+ * partition tables drop the cached table (C<invalidate_parttable>).
+ * Since a device can also be overwritten in other ways (eg. by
+ * C<guestfs_dd> or C<guestfs_upload>), a cached table is only used
+ * after rereading the sectors it was parsed from (the MBR, the EBRs,
+ * or the GPT header) and checking that they have not changed.  The
+ * GPT header contains a checksum of the partition entries, so those
+ * don't need to be reread.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+
+#ifdef HAVE_LINUX_FS_H
+#include <linux/fs.h>
+#endif
+
+#include "guestfs_protocol.h"
+#include "daemon.h"
+#include "actions.h"
+
+/* Limits on what we are prepared to parse.  Tables beyond these are
+ * left to parted.
+ */
+#define MAX_LOGICAL_PARTITIONS 256
+#define MAX_GPT_ENTRIES_SIZE   (1024 * 1024)
+
+struct cached_parttable {
+  char *device;
+  dev_t rdev;
+  uint64_t size;                /* Size of the device in bytes. */
+  unsigned sector_size;
+  size_t nr_sectors;            /* Sectors the table was parsed from. */
+  uint64_t *lbas;
+  unsigned char *sectors;       /* nr_sectors * sector_size bytes. */
+  struct parttable table;
+};
+
+static struct cached_parttable **cache = NULL;
+static size_t nr_cache = 0;
+
+static void
+free_cached_parttable (struct cached_parttable *ct)
+{
+  if (ct) {
+    free (ct->device);
+    free (ct->lbas);
+    free (ct->sectors);
+    free (ct->table.entries);
+    free (ct);
+  }
+}
+
+static void
+remove_from_cache (size_t i)
+{
+  free_cached_parttable (cache[i]);
+  memmove (&cache[i], &cache[i+1], (nr_cache-i-1) * sizeof cache[0]);
+  nr_cache--;
+}
+
+/**
+ * Drop the cached partition table of C<device>.  This must be called
+ * by anything which writes a partition table.
+ */
+void
+invalidate_parttable (const char *device)
+{
+  size_t i;
+
+  for (i = 0; i < nr_cache; ++i) {
+    if (STREQ (cache[i]->device, device)) {
+      remove_from_cache (i);
+      return;
+    }
+  }
+}
+
+static uint16_t
+le16 (const unsigned char *p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+static uint32_t
+le32 (const unsigned char *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint64_t
+le64 (const unsigned char *p)
+{
+  return le32 (p) | ((uint64_t) le32 (p+4) << 32);
+}
+
+/* The CRC-32 used by GPT (the same as zlib's crc32). */
+static uint32_t
+gpt_crc32 (const unsigned char *buf, size_t len)
+{
+  static uint32_t table[256];
+  static int table_done = 0;
+  uint32_t crc = 0xffffffff;
+  size_t i;
+
+  if (!table_done) {
+    for (i = 0; i < 256; ++i) {
+      uint32_t c = i;
+      int k;
+
+      for (k = 0; k < 8; ++k)
+        c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+      table[i] = c;
+    }
+    table_done = 1;
+  }
+
+  for (i = 0; i < len; ++i)
+    crc = table[(crc ^ buf[i]) & 0xff] ^ (crc >> 8);
+
+  return crc ^ 0xffffffff;
+}
+
+/* Format a GUID the way sgdisk prints it. */
+static void
+format_guid (const unsigned char *guid, char *str)
+{
+  snprintf (str, 37,
+            "%08" PRIX32 "-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X",
+            le32 (guid), le16 (guid+4), le16 (guid+6),
+            guid[8], guid[9], guid[10], guid[11],
+            guid[12], guid[13], guid[14], guid[15]);
+}
+
+/* Why the table could not be parsed, for debugging. */
+static int
+unsupported (const char *device, const char *reason)
+{
+  if (verbose)
+    fprintf (stderr, "parttable: %s: %s, falling back to parted\n",
+             device, reason);
+  return -1;
+}
+
+/* Read a sector, and remember it so a cache hit can be validated. */
+static int
+read_sector (int fd, struct cached_parttable *ct, uint64_t lba,
+             unsigned char *buf)
+{
+  uint64_t *lbas;
+  unsigned char *sectors;
+  ssize_t r;
+
+  r = pread (fd, buf, ct->sector_size, lba * ct->sector_size);
+  if (r != (ssize_t) ct->sector_size) {
+    if (r == -1 && verbose)
+      perror (ct->device);
+    return unsupported (ct->device, "could not read sector");
+  }
+
+  lbas = realloc (ct->lbas, (ct->nr_sectors+1) * sizeof (uint64_t));
+  if (lbas == NULL)
+    return unsupported (ct->device, "out of memory");
+  ct->lbas = lbas;
+  sectors = realloc (ct->sectors, (ct->nr_sectors+1) * ct->sector_size);
+  if (sectors == NULL)
+    return unsupported (ct->device, "out of memory");
+  ct->sectors = sectors;
+
+  ct->lbas[ct->nr_sectors] = lba;
+  memcpy (&ct->sectors[ct->nr_sectors * ct->sector_size], buf,
+          ct->sector_size);
+  ct->nr_sectors++;
+  return 0;
+}
+
+/* Check that the sectors a cached table was parsed from are
+ * unchanged.
+ */
+static int
+sectors_unchanged (int fd, const struct cached_parttable *ct)
+{
+  CLEANUP_FREE unsigned char *buf = malloc (ct->sector_size);
+  size_t i;
+
+  if (buf == NULL)
+    return 0;
+
+  for (i = 0; i < ct->nr_sectors; ++i) {
+    if (pread (fd, buf, ct->sector_size, ct->lbas[i] * ct->sector_size)
+        != (ssize_t) ct->sector_size)
+      return 0;
+    if (memcmp (buf, &ct->sectors[i * ct->sector_size], ct->sector_size) != 0)
+      return 0;
+  }
+
+  return 1;
+}
+
+static struct parttable_entry *
+add_entry (struct cached_parttable *ct, int num,
+           uint64_t start_lba, uint64_t nr_sectors)
+{
+  struct parttable *t = &ct->table;
+  struct parttable_entry *entries, *e;
+
+  if (nr_sectors == 0 ||
+      start_lba + nr_sectors > ct->size / ct->sector_size) {
+    unsupported (ct->device, "partition beyond the end of the device");
+    return NULL;
+  }
+
+  entries = realloc (t->entries, (t->nr_entries+1) * sizeof *entries);
+  if (entries == NULL) {
+    unsupported (ct->device, "out of memory");
+    return NULL;
+  }
+  t->entries = entries;
+  e = &t->entries[t->nr_entries++];
+  memset (e, 0, sizeof *e);
+
+  /* Byte offsets, with an inclusive end, as printed by parted. */
+  e->num = num;
+  e->start = start_lba * ct->sector_size;
+  e->size = nr_sectors * ct->sector_size;
+  e->end = e->start + e->size - 1;
+  e->mbr_id = -1;
+  e->mbr_part_type = "primary";
+  return e;
+}
+
+static int
+is_extended (unsigned type)
+{
+  return type == 0x05 || type == 0x0f || type == 0x85;
+}
+
+/* Parse the chain of EBRs in the extended partition.  Logical
+ * partitions are numbered from 5, skipping empty entries, like
+ * parted and the kernel do.
+ */
+static int
+parse_ebrs (int fd, struct cached_parttable *ct,
+            uint64_t ext_start, uint64_t ext_sectors)
+{
+  CLEANUP_FREE unsigned char *buf = malloc (ct->sector_size);
+  uint64_t ebr = ext_start;
+  int num = 5;
+  size_t n;
+
+  if (buf == NULL)
+    return unsupported (ct->device, "out of memory");
+
+  for (n = 0; n < MAX_LOGICAL_PARTITIONS; ++n) {
+    const unsigned char *p = buf + 446;
+    struct parttable_entry *e;
+    uint64_t next;
+
+    if (read_sector (fd, ct, ebr, buf) == -1)
+      return -1;
+    if (le16 (buf + 510) != 0xaa55)
+      return unsupported (ct->device, "invalid EBR signature");
+    if (le32 (buf + 446 + 2*16 + 12) != 0 || le32 (buf + 446 + 3*16 + 12) != 0)
+      return unsupported (ct->device, "EBR has more than two entries");
+
+    /* The logical partition, relative to this EBR. */
+    if (p[4] != 0 && le32 (p+12) != 0) {
+      if (is_extended (p[4]))
+        return unsupported (ct->device, "nested extended partition");
+      if (le32 (p+8) == 0 ||
+          ebr + le32 (p+8) + le32 (p+12) > ext_start + ext_sectors)
+        return unsupported (ct->device,
+                            "logical partition outside extended partition");
+      e = add_entry (ct, num++, ebr + le32 (p+8), le32 (p+12));
+      if (e == NULL)
+        return -1;
+      e->mbr_id = p[4];
+      e->bootable = p[0] == 0x80;
+      e->mbr_part_type = "logical";
+    }
+
+    /* The next EBR, relative to the extended partition. */
+    p += 16;
+    if (p[4] == 0 || le32 (p+12) == 0)
+      return 0;
+    if (!is_extended (p[4]))
+      return unsupported (ct->device, "invalid link to next EBR");
+    next = ext_start + le32 (p+8);
+    /* Only follow chains which go forwards, so this terminates. */
+    if (next <= ebr || next >= ext_start + ext_sectors)
+      return unsupported (ct->device, "invalid link to next EBR");
+    ebr = next;
+  }
+
+  return unsupported (ct->device, "too many logical partitions");
+}
+
+/* Does the first sector look like a FAT or NTFS boot sector rather
+ * than an MBR?  parted reports these as "loop".
+ */
+static int
+is_boot_sector (const unsigned char *mbr)
+{
+  return (mbr[0] == 0xeb || mbr[0] == 0xe9) &&
+    (memcmp (mbr+54, "FAT", 3) == 0 || memcmp (mbr+82, "FAT", 3) == 0 ||
+     memcmp (mbr+3, "NTFS", 4) == 0 || memcmp (mbr+3, "EXFAT", 5) == 0);
+}
+
+static int
+parse_mbr (int fd, struct cached_parttable *ct, const unsigned char *mbr)
+{
+  uint64_t ext_start = 0, ext_sectors = 0;
+  size_t i;
+
+  ct->table.parttype = "msdos";
+
+  for (i = 0; i < 4; ++i) {
+    const unsigned char *p = mbr + 446 + i*16;
+    struct parttable_entry *e;
+
+    if (p[4] == 0 || le32 (p+12) == 0)
+      continue;
+    if (le32 (p+8) == 0)
+      return unsupported (ct->device, "partition overlaps the MBR");
+
+    e = add_entry (ct, i+1, le32 (p+8), le32 (p+12));
+    if (e == NULL)
+      return -1;
+    e->mbr_id = p[4];
+    e->bootable = p[0] == 0x80;
+
+    if (is_extended (p[4])) {
+      if (ext_sectors > 0)
+        return unsupported (ct->device, "more than one extended partition");
+      e->mbr_part_type = "extended";
+      ext_start = le32 (p+8);
+      ext_sectors = le32 (p+12);
+    }
+  }
+
+  if (ext_sectors > 0 && parse_ebrs (fd, ct, ext_start, ext_sectors) == -1)
+    return -1;
+
+  return 0;
+}
+
+static int
+parse_gpt (int fd, struct cached_parttable *ct)
+{
+  static const unsigned char zero_guid[16] = { 0 };
+  CLEANUP_FREE unsigned char *hdr = malloc (ct->sector_size);
+  CLEANUP_FREE unsigned char *entries = NULL;
+  uint32_t hdr_size, hdr_crc, nr_entries, entry_size;
+  uint64_t first_usable, last_usable, entries_lba;
+  size_t len, i;
+
+  if (hdr == NULL)
+    return unsupported (ct->device, "out of memory");
+
+  ct->table.parttype = "gpt";
+
+  if (read_sector (fd, ct, 1, hdr) == -1)
+    return -1;
+  if (memcmp (hdr, "EFI PART", 8) != 0)
+    return unsupported (ct->device, "no GPT header");
+  hdr_size = le32 (hdr+12);
+  if (hdr_size < 92 || hdr_size > ct->sector_size)
+    return unsupported (ct->device, "invalid GPT header size");
+  hdr_crc = le32 (hdr+16);
+  memset (hdr+16, 0, 4);
+  if (gpt_crc32 (hdr, hdr_size) != hdr_crc)
+    return unsupported (ct->device, "bad GPT header checksum");
+
+  first_usable = le64 (hdr+40);
+  last_usable = le64 (hdr+48);
+  entries_lba = le64 (hdr+72);
+  nr_entries = le32 (hdr+80);
+  entry_size = le32 (hdr+84);
+  if (le64 (hdr+24) != 1 || last_usable < first_usable ||
+      last_usable >= ct->size / ct->sector_size)
+    return unsupported (ct->device, "GPT header does not match the device");
+  if (entry_size < 128 || entry_size % 8 != 0 ||
+      (uint64_t) nr_entries * entry_size > MAX_GPT_ENTRIES_SIZE)
+    return unsupported (ct->device, "unexpected size of GPT entries");
+
+  format_guid (hdr+56, ct->table.disk_guid);
+
+  len = (size_t) nr_entries * entry_size;
+  entries = malloc (len);
+  if (entries == NULL)
+    return unsupported (ct->device, "out of memory");
+  if (pread (fd, entries, len, entries_lba * ct->sector_size) != (ssize_t) len)
+    return unsupported (ct->device, "could not read GPT entries");
+  if (gpt_crc32 (entries, len) != le32 (hdr+88))
+    return unsupported (ct->device, "bad GPT entries checksum");
+
+  for (i = 0; i < nr_entries; ++i) {
+    const unsigned char *p = entries + i*entry_size;
+    struct parttable_entry *e;
+    uint64_t first, last;
+
+    if (memcmp (p, zero_guid, 16) == 0)
+      continue;
+
+    first = le64 (p+32);
+    last = le64 (p+40);
+    if (first < first_usable || last > last_usable || last < first)
+      return unsupported (ct->device, "GPT partition outside usable area");
+
+    e = add_entry (ct, i+1, first, last - first + 1);
+    if (e == NULL)
+      return -1;
+    format_guid (p, e->gpt_type);
+    format_guid (p+16, e->gpt_guid);
+  }
+
+  return 0;
+}
+
+/* Reject tables with overlapping partitions, which parted refuses.
+ * Logical partitions are of course inside the extended partition.
+ */
+static int
+check_overlaps (struct cached_parttable *ct)
+{
+  const struct parttable *t = &ct->table;
+  size_t i, j;
+
+  for (i = 0; i < t->nr_entries; ++i) {
+    const struct parttable_entry *a = &t->entries[i];
+
+    for (j = i+1; j < t->nr_entries; ++j) {
+      const struct parttable_entry *b = &t->entries[j];
+
+      if (a->start > b->end || b->start > a->end)
+        continue;
+      if (STREQ (a->mbr_part_type, "extended") &&
+          STREQ (b->mbr_part_type, "logical"))
+        continue;
+      return unsupported (ct->device, "overlapping partitions");
+    }
+  }
+
+  return 0;
+}
+
+static struct cached_parttable *
+parse_parttable (const char *device, int fd, const struct stat *statbuf,
+                 uint64_t size, unsigned sector_size)
+{
+  struct cached_parttable *ct;
+  CLEANUP_FREE unsigned char *mbr = NULL;
+  size_t i;
+  int has_protective = 0, n_active = 0, r;
+
+  ct = calloc (1, sizeof *ct);
+  if (ct == NULL)
+    return NULL;
+  ct->device = strdup (device);
+  if (ct->device == NULL) {
+    free (ct);
+    return NULL;
+  }
+  ct->rdev = statbuf->st_rdev;
+  ct->size = size;
+  ct->sector_size = sector_size;
+
+  mbr = malloc (sector_size);
+  if (mbr == NULL || read_sector (fd, ct, 0, mbr) == -1)
+    goto unsupported;
+
+  if (le16 (mbr + 510) != 0xaa55) {
+    unsupported (device, "no MBR signature");
+    goto unsupported;
+  }
+
+  /* The same checks as parted, to tell an MBR from a boot sector. */
+  for (i = 0; i < 4; ++i) {
+    const unsigned char *p = mbr + 446 + i*16;
+
+    if (p[0] == 0x80)
+      n_active++;
+    else if (p[0] != 0) {
+      unsupported (device, "invalid boot indicator in MBR");
+      goto unsupported;
+    }
+    if (p[4] == 0xee)
+      has_protective = 1;
+  }
+  if (n_active == 0 && is_boot_sector (mbr)) {
+    unsupported (device, "filesystem on the whole device");
+    goto unsupported;
+  }
+
+  if (has_protective)
+    r = parse_gpt (fd, ct);
+  else
+    r = parse_mbr (fd, ct, mbr);
+  if (r == -1 || check_overlaps (ct) == -1)
+    goto unsupported;
+
+  return ct;
+
+ unsupported:
+  free_cached_parttable (ct);
+  return NULL;
+}
+
+/**
+ * Read the MBR or GPT partition table on C<device>.
+ *
+ * Returns C<NULL> if the partition table is not one which can be
+ * parsed here, in which case the caller should use parted, sfdisk or
+ * sgdisk instead.  This does not send an error reply.
+ *
+ * The returned table is owned by the cache and is only valid until
+ * the next call to C<read_parttable> or C<invalidate_parttable>.
+ */
+const struct parttable *
+read_parttable (const char *device)
+{
+  int fd;
+  struct stat statbuf;
+  uint64_t size;
+  unsigned sector_size = 512;
+  struct cached_parttable *ct;
+  struct cached_parttable **new_cache;
+  size_t i;
+
+  fd = open (device, O_RDONLY|O_CLOEXEC);
+  if (fd == -1) {
+    if (verbose)
+      perror (device);
+    return NULL;
+  }
+  if (fstat (fd, &statbuf) == -1) {
+    if (verbose)
+      perror (device);
+    close (fd);
+    return NULL;
+  }
+
+#ifdef BLKGETSIZE64
+  if (ioctl (fd, BLKGETSIZE64, &size) == -1)
+#endif
+    size = statbuf.st_size;
+#ifdef BLKSSZGET
+  {
+    int ss;
+    if (ioctl (fd, BLKSSZGET, &ss) == 0 && ss >= 512)
+      sector_size = ss;
+  }
+#endif
+
+  for (i = 0; i < nr_cache; ++i) {
+    if (STREQ (cache[i]->device, device)) {
+      ct = cache[i];
+      if (ct->rdev == statbuf.st_rdev && ct->size == size &&
+          ct->sector_size == sector_size && sectors_unchanged (fd, ct)) {
+        close (fd);
+        return &ct->table;
+      }
+      remove_from_cache (i);
+      break;
+    }
+  }
+
+  ct = parse_parttable (device, fd, &statbuf, size, sector_size);
+  close (fd);
+  if (ct == NULL)
+    return NULL;
+
+  new_cache = realloc (cache, (nr_cache+1) * sizeof cache[0]);
+  if (new_cache == NULL) {
+    free_cached_parttable (ct);
+    return NULL;
+  }
+  cache = new_cache;
+  cache[nr_cache++] = ct;
+
+  return &ct->table;
+}
+
+/**
+ * Find partition C<partnum> in the table, or C<NULL> if there is no
+ * such partition.
+ */
+const struct parttable_entry *
+parttable_find (const struct parttable *t, int partnum)
+{
+  size_t i;
+
+  for (i = 0; i < t->nr_entries; ++i) {
+    if (t->entries[i].num == partnum)
+      return &t->entries[i];
+  }
+
+  return NULL;
+}
+
+guestfs_int_internal_partition_list *
+do_internal_part_list_table (const char *device)
+{
+  guestfs_int_internal_partition_list *r;
+  const struct parttable *t;
+  guestfs_int_partition_list *parts = NULL;
+  size_t i, n;
+
+  t = read_parttable (device);
+  if (t)
+    n = t->nr_entries;
+  else {
+    /* Other partition table types are left to parted.  Only the
+     * partition numbers and offsets are available for them.
+     */
+    parts = do_part_list (device);
+    if (parts == NULL)
+      return NULL;
+    n = parts->guestfs_int_partition_list_len;
+  }
+
+  r = calloc (1, sizeof *r);
+  if (r == NULL) {
+    reply_with_perror ("calloc");
+    goto error;
+  }
+  r->guestfs_int_internal_partition_list_val =
+    calloc (n, sizeof (guestfs_int_internal_partition));
+  if (r->guestfs_int_internal_partition_list_val == NULL) {
+    reply_with_perror ("calloc");
+    goto error;
+  }
+  r->guestfs_int_internal_partition_list_len = n;
+
+  for (i = 0; i < n; ++i) {
+    guestfs_int_internal_partition *ip =
+      &r->guestfs_int_internal_partition_list_val[i];
+    const char *mbr_part_type = "primary", *gpt_type = "", *gpt_guid = "";
+
+    if (t) {
+      const struct parttable_entry *e = &t->entries[i];
+
+      ip->ip_num = e->num;
+      ip->ip_start = e->start;
+      ip->ip_end = e->end;
+      ip->ip_size = e->size;
+      ip->ip_mbr_id = e->mbr_id;
+      mbr_part_type = e->mbr_part_type;
+      gpt_type = e->gpt_type;
+      gpt_guid = e->gpt_guid;
+    }
+    else {
+      const guestfs_int_partition *p = &parts->guestfs_int_partition_list_val[i];
+
+      ip->ip_num = p->part_num;
+      ip->ip_start = p->part_start;
+      ip->ip_end = p->part_end;
+      ip->ip_size = p->part_size;
+      ip->ip_mbr_id = -1;
+    }
+
+    ip->ip_mbr_part_type = strdup (mbr_part_type);
+    ip->ip_gpt_type = strdup (gpt_type);
+    ip->ip_gpt_guid = strdup (gpt_guid);
+    if (ip->ip_mbr_part_type == NULL || ip->ip_gpt_type == NULL ||
+        ip->ip_gpt_guid == NULL) {
+      reply_with_perror ("strdup");
+      goto error;
+    }
+  }
+
+  if (parts) {
+    xdr_free ((xdrproc_t) xdr_guestfs_int_partition_list, (char *) parts);
+    free (parts);
+  }
+  return r;
+
+ error:
+  if (r) {
+    xdr_free ((xdrproc_t) xdr_guestfs_int_internal_partition_list, (char *) r);
+    free (r);
+  }
+  if (parts) {
+    xdr_free ((xdrproc_t) xdr_guestfs_int_partition_list, (char *) parts);
+    free (parts);
+  }
+  return NULL;
+}
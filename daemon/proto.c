@@ -42,6 +42,7 @@
 #include "daemon.h"
 #include "guestfs_protocol.h"
 #include "errnostring.h"
+#include "actions.h"
 
 /* The message currently being processed. */
 int proc_nr;
@@ -64,6 +65,12 @@ uint64_t progress_hint;
  */
 uint64_t optargs_bitmask;
 
+/* Size of FileIn/FileOut chunks agreed with the library.  This
+ * starts at the default and may be raised by
+ * internal_set_chunk_size, up to GUESTFS_MAX_CHUNK_SIZE.
+ */
+size_t chunk_size = GUESTFS_DEFAULT_CHUNK_SIZE;
+
 /* Time at which we received the current request. */
 static struct timeval start_t;
 
@@ -76,6 +83,38 @@ static size_t count_progress;
 /* The daemon communications socket. */
 static int sock;
 
+/* Most requests and replies are small, so messages up to this size
+ * are decoded and encoded in static buffers which are reused for
+ * every call.  Larger messages (up to GUESTFS_MESSAGE_MAX) use a
+ * buffer which is allocated for that message and freed afterwards,
+ * so that the daemon does not hold on to the memory.
+ */
+#define SMALL_MESSAGE_SIZE (64 * 1024)
+
+static char request_buf[SMALL_MESSAGE_SIZE];
+
+/* The reply buffers have room for the length word before the
+ * message, so the whole reply can be sent with a single write.
+ */
+static char reply_buf[4 + SMALL_MESSAGE_SIZE];
+static char error_buf[4 + GUESTFS_ERROR_LEN + 200];
+
+/* Encode the length word into the first 4 bytes of buf and send
+ * buf, which contains the length word followed by len bytes.
+ */
+static void
+send_message (char *buf, uint32_t len)
+{
+  XDR xdr;
+
+  xdrmem_create (&xdr, buf, 4, XDR_ENCODE);
+  xdr_u_int (&xdr, &len);
+  xdr_destroy (&xdr);
+
+  if (xwrite (sock, buf, 4 + (size_t) len) == -1)
+    error (EXIT_FAILURE, 0, "xwrite failed");
+}
+
 void
 main_loop (int _sock)
 {
@@ -110,10 +149,14 @@ main_loop (int _sock)
     if (len > GUESTFS_MESSAGE_MAX)
       error (EXIT_FAILURE, 0, "incoming message is too long (%u bytes)", len);
 
-    buf = malloc (len);
-    if (!buf) {
-      reply_with_perror ("malloc");
-      continue;
+    if (len <= sizeof request_buf)
+      buf = request_buf;
+    else {
+      buf = malloc (len);
+      if (!buf) {
+        reply_with_perror ("malloc");
+        continue;
+      }
     }
 
     if (xread (sock, buf, len) == -1)
@@ -210,7 +253,8 @@ main_loop (int _sock)
 
   cont:
     xdr_destroy (&xdr);
-    free (buf);
+    if (buf != request_buf)
+      free (buf);
   }
 }
 
@@ -260,11 +304,9 @@ static void
 send_error (int errnum, char *msg)
 {
   XDR xdr;
-  CLEANUP_FREE char *buf = NULL;
-  char lenbuf[4];
   struct guestfs_message_header hdr;
   struct guestfs_message_error err;
-  unsigned len;
+  uint32_t len;
 
   /* Print the full length error message. */
   fprintf (stderr, "guestfsd: error: %s\n", msg);
@@ -278,10 +320,7 @@ send_error (int errnum, char *msg)
   if (strlen (msg) > GUESTFS_ERROR_LEN)
     msg[GUESTFS_ERROR_LEN] = '\0';
 
-  buf = malloc (GUESTFS_ERROR_LEN + 200);
-  if (!buf)
-    error (EXIT_FAILURE, errno, "malloc");
-  xdrmem_create (&xdr, buf, GUESTFS_ERROR_LEN + 200, XDR_ENCODE);
+  xdrmem_create (&xdr, error_buf + 4, sizeof error_buf - 4, XDR_ENCODE);
 
   memset (&hdr, 0, sizeof hdr);
   hdr.prog = GUESTFS_PROGRAM;
@@ -307,29 +346,21 @@ send_error (int errnum, char *msg)
   len = xdr_getpos (&xdr);
   xdr_destroy (&xdr);
 
-  xdrmem_create (&xdr, lenbuf, 4, XDR_ENCODE);
-  xdr_u_int (&xdr, &len);
-  xdr_destroy (&xdr);
-
-  if (xwrite (sock, lenbuf, 4) == -1)
-    error (EXIT_FAILURE, 0, "xwrite failed");
-  if (xwrite (sock, buf, len) == -1)
-    error (EXIT_FAILURE, 0, "xwrite failed");
+  send_message (error_buf, len);
 }
 
-void
-reply (xdrproc_t xdrp, char *ret)
+/* Encode the reply into buf, which has room for the length word
+ * followed by size bytes.  Returns the length of the encoded
+ * message, or 0 if it did not fit.
+ */
+static uint32_t
+encode_reply (char *buf, size_t size, xdrproc_t xdrp, char *ret)
 {
   XDR xdr;
-  CLEANUP_FREE char *buf = NULL;
-  char lenbuf[4];
   struct guestfs_message_header hdr;
   uint32_t len;
 
-  buf = malloc (GUESTFS_MESSAGE_MAX);
-  if (!buf)
-    error (EXIT_FAILURE, errno, "malloc");
-  xdrmem_create (&xdr, buf, GUESTFS_MESSAGE_MAX, XDR_ENCODE);
+  xdrmem_create (&xdr, buf + 4, size, XDR_ENCODE);
 
   memset (&hdr, 0, sizeof hdr);
   hdr.prog = GUESTFS_PROGRAM;
@@ -342,35 +373,110 @@ reply (xdrproc_t xdrp, char *ret)
   if (!xdr_guestfs_message_header (&xdr, &hdr))
     error (EXIT_FAILURE, 0, "failed to encode reply header");
 
-  if (xdrp) {
+  if (xdrp && !(*xdrp) (&xdr, ret)) {
+    xdr_destroy (&xdr);
+    return 0;
+  }
+
+  len = xdr_getpos (&xdr);
+  xdr_destroy (&xdr);
+  return len;
+}
+
+void
+reply (xdrproc_t xdrp, char *ret)
+{
+  CLEANUP_FREE char *buf = NULL;
+  uint32_t len;
+
+  /* Try the small buffer first.  Encoding does not modify the reply
+   * struct, so if it does not fit we can encode it again into a
+   * buffer of the maximum message size.
+   */
+  len = encode_reply (reply_buf, sizeof reply_buf - 4, xdrp, ret);
+  if (len > 0) {
+    send_message (reply_buf, len);
+    return;
+  }
+
+  buf = malloc (4 + GUESTFS_MESSAGE_MAX);
+  if (!buf)
+    error (EXIT_FAILURE, errno, "malloc");
+  len = encode_reply (buf, GUESTFS_MESSAGE_MAX, xdrp, ret);
+  if (len == 0) {
     /* This can fail if the reply body is too large, for example
      * if it exceeds the maximum message size.  In that case
      * we want to return an error message instead. (RHBZ#509597).
      */
-    if (!(*xdrp) (&xdr, ret)) {
-      reply_with_error ("guestfsd: failed to encode reply body\n(maybe the reply exceeds the maximum message size in the protocol?)");
-      xdr_destroy (&xdr);
-      return;
-    }
+    reply_with_error ("guestfsd: failed to encode reply body\n(maybe the reply exceeds the maximum message size in the protocol?)");
+    return;
   }
 
-  len = xdr_getpos (&xdr);
-  xdr_destroy (&xdr);
+  send_message (buf, len);
+}
 
-  xdrmem_create (&xdr, lenbuf, 4, XDR_ENCODE);
-  xdr_u_int (&xdr, &len);
+/* State of a streamed reply, passed to stream_write. */
+struct stream_state {
+  int cancelled;
+};
+
+static int
+stream_write (void *handle, void *buf, int len)
+{
+  struct stream_state *state = handle;
+  int r;
+
+  r = send_file_write (buf, len);
+  if (r == -2)                  /* cancelled by library */
+    state->cancelled = 1;
+  if (r < 0)
+    return -1;
+  return len;
+}
+
+/* Send the reply of a function with a streamed reply.  The reply
+ * message has an OK status and no body.  Then the return value is
+ * encoded using an XDR record stream and sent as file chunks (as for
+ * FileOut parameters), so it is not limited by GUESTFS_MESSAGE_MAX.
+ */
+void
+reply_stream (xdrproc_t xdrp, char *ret)
+{
+  struct stream_state state = { .cancelled = 0 };
+  XDR xdr;
+  int ok;
+
+  reply (NULL, NULL);
+
+  /* The record stream buffers up to chunk_size bytes before calling
+   * stream_write, so each chunk is full size.  The cast is because
+   * the type of the callback differs between glibc and libtirpc.
+   */
+  xdrrec_create (&xdr, chunk_size, 0, (void *) &state,
+                 NULL, (int (*) ()) stream_write);
+  xdr.x_op = XDR_ENCODE;
+  ok = (*xdrp) (&xdr, ret) && xdrrec_endofrecord (&xdr, TRUE);
   xdr_destroy (&xdr);
 
-  if (xwrite (sock, lenbuf, 4) == -1)
-    error (EXIT_FAILURE, 0, "xwrite failed");
-  if (xwrite (sock, buf, (size_t) len) == -1)
-    error (EXIT_FAILURE, 0, "xwrite failed");
+  if (!ok) {
+    fprintf (stderr, "guestfsd: reply_stream: failed to encode reply body\n");
+    if (!state.cancelled)
+      send_file_end (1);
+    return;
+  }
+
+  send_file_end (0);
 }
 
 /* Receive file chunks, repeatedly calling 'cb'. */
 int
 receive_file (receive_cb cb, void *opaque)
 {
+  /* The buffer is kept between calls and only grows, so a large
+   * upload does not malloc and free once per chunk.
+   */
+  static char *buf = NULL;
+  static size_t buf_size = 0;
   guestfs_chunk chunk;
   char lenbuf[4];
   XDR xdr;
@@ -378,8 +484,6 @@ receive_file (receive_cb cb, void *opaque)
   uint32_t len;
 
   for (;;) {
-    CLEANUP_FREE char *buf = NULL;
-
     if (verbose)
       fprintf (stderr, "guestfsd: receive_file: reading length word\n");
 
@@ -397,22 +501,33 @@ receive_file (receive_cb cb, void *opaque)
     if (len > GUESTFS_MESSAGE_MAX)
       error (EXIT_FAILURE, 0, "incoming message is too long (%u bytes)", len);
 
-    buf = malloc (len);
-    if (!buf) {
-      perror ("malloc");
-      return -1;
+    if (len > buf_size) {
+      char *newbuf = realloc (buf, len);
+      if (!newbuf) {
+        perror ("realloc");
+        return -1;
+      }
+      buf = newbuf;
+      buf_size = len;
     }
 
     if (xread (sock, buf, len) == -1)
       exit (EXIT_FAILURE);
 
+    /* Decode the chunk header in place and pass the data to the
+     * callback straight from the buffer, instead of letting
+     * xdr_guestfs_chunk allocate and copy it.
+     */
     xdrmem_create (&xdr, buf, len, XDR_DECODE);
-    memset (&chunk, 0, sizeof chunk);
-    if (!xdr_guestfs_chunk (&xdr, &chunk)) {
+    if (!xdr_int (&xdr, &chunk.cancel) ||
+        !xdr_u_int (&xdr, &chunk.data.data_len) ||
+        chunk.data.data_len > GUESTFS_MAX_CHUNK_SIZE ||
+        chunk.data.data_len > len - 8) {
       xdr_destroy (&xdr);
       return -1;
     }
     xdr_destroy (&xdr);
+    chunk.data.data_val = buf + 8;
 
     if (verbose)
       fprintf (stderr,
@@ -431,14 +546,12 @@ receive_file (receive_cb cb, void *opaque)
       if (verbose)
         fprintf (stderr,
 		 "guestfsd: receive_file: received cancellation from library\n");
-      xdr_free ((xdrproc_t) xdr_guestfs_chunk, (char *) &chunk);
       return -2;
     }
     if (chunk.data.data_len == 0) {
       if (verbose)
         fprintf (stderr,
 		 "guestfsd: receive_file: end of file, leaving function\n");
-      xdr_free ((xdrproc_t) xdr_guestfs_chunk, (char *) &chunk);
       return 0;			/* end of file */
     }
 
@@ -448,7 +561,6 @@ receive_file (receive_cb cb, void *opaque)
     else
       r = 0;
 
-    xdr_free ((xdrproc_t) xdr_guestfs_chunk, (char *) &chunk);
     if (r == -1) {		/* write error */
       if (verbose)
         fprintf (stderr, "guestfsd: receive_file: write error\n");
@@ -481,35 +593,40 @@ cancel_receive (void)
 static int check_for_library_cancellation (void);
 static int send_chunk (const guestfs_chunk *);
 
-/* Also check if the library sends us a cancellation message. */
+/* Send buf as one or more chunks of at most chunk_size bytes.
+ * Also check if the library sends us a cancellation message.
+ */
 int
 send_file_write (const void *buf, size_t len)
 {
+  const char *p = buf;
   guestfs_chunk chunk;
   int cancel;
 
-  if (len > GUESTFS_MAX_CHUNK_SIZE) {
-    fprintf (stderr, "guestfsd: send_file_write: len (%zu) > GUESTFS_MAX_CHUNK_SIZE (%d)\n",
-             len, GUESTFS_MAX_CHUNK_SIZE);
-    return -1;
-  }
+  do {
+    const size_t n = MIN (len, chunk_size);
 
-  cancel = check_for_library_cancellation ();
+    cancel = check_for_library_cancellation ();
 
-  if (cancel) {
-    chunk.cancel = 1;
-    chunk.data.data_len = 0;
-    chunk.data.data_val = NULL;
-  } else {
-    chunk.cancel = 0;
-    chunk.data.data_len = len;
-    chunk.data.data_val = (char *) buf;
-  }
+    if (cancel) {
+      chunk.cancel = 1;
+      chunk.data.data_len = 0;
+      chunk.data.data_val = NULL;
+    } else {
+      chunk.cancel = 0;
+      chunk.data.data_len = n;
+      chunk.data.data_val = (char *) p;
+    }
 
-  if (send_chunk (&chunk) == -1)
-    return -1;
+    if (send_chunk (&chunk) == -1)
+      return -1;
+
+    if (cancel) return -2;
+
+    p += n;
+    len -= n;
+  } while (len > 0);
 
-  if (cancel) return -2;
   return 0;
 }
 
@@ -564,41 +681,65 @@ send_file_end (int cancel)
   return send_chunk (&chunk);
 }
 
+/* Send a chunk.  The header is encoded by hand and written together
+ * with the caller's data buffer using writev, so the data is not
+ * copied.  The result is the same as encoding the chunk with
+ * xdr_guestfs_chunk.
+ */
 static int
 send_chunk (const guestfs_chunk *chunk)
 {
-  const size_t buf_len = GUESTFS_MAX_CHUNK_SIZE + 48;
-  CLEANUP_FREE char *buf = NULL;
-  char lenbuf[4];
+  static const char padding[4] = { 0, 0, 0, 0 };
+  char hdr[12];
+  const size_t data_len = chunk->data.data_len;
+  const size_t padlen = (4 - (data_len & 3)) & 3;
+  struct iovec iov[3];
   XDR xdr;
   uint32_t len;
 
-  buf = malloc (buf_len);
-  if (buf == NULL) {
-    perror ("malloc");
+  if (data_len > GUESTFS_MAX_CHUNK_SIZE) {
+    fprintf (stderr, "guestfsd: send_chunk: chunk too large (%zu bytes)\n",
+             data_len);
     return -1;
   }
 
-  xdrmem_create (&xdr, buf, buf_len, XDR_ENCODE);
-  if (!xdr_guestfs_chunk (&xdr, (guestfs_chunk *) chunk)) {
+  len = 8 + data_len + padlen;
+  xdrmem_create (&xdr, hdr, sizeof hdr, XDR_ENCODE);
+  if (!xdr_u_int (&xdr, &len) ||
+      !xdr_int (&xdr, (int *) &chunk->cancel) ||
+      !xdr_u_int (&xdr, (u_int *) &chunk->data.data_len)) {
     fprintf (stderr, "guestfsd: send_chunk: failed to encode chunk\n");
     xdr_destroy (&xdr);
     return -1;
   }
-
-  len = xdr_getpos (&xdr);
   xdr_destroy (&xdr);
 
-  xdrmem_create (&xdr, lenbuf, 4, XDR_ENCODE);
-  xdr_u_int (&xdr, &len);
-  xdr_destroy (&xdr);
+  iov[0].iov_base = hdr;
+  iov[0].iov_len = sizeof hdr;
+  iov[1].iov_base = chunk->data.data_val;
+  iov[1].iov_len = data_len;
+  iov[2].iov_base = (char *) padding;
+  iov[2].iov_len = padlen;
 
-  const int err = (xwrite (sock, lenbuf, 4) == 0
-                   && xwrite (sock, buf, len) == 0 ? 0 : -1);
-  if (err)
+  if (xwritev (sock, iov, 3) == -1)
     error (EXIT_FAILURE, 0, "send_chunk: write failed");
 
-  return err;
+  return 0;
+}
+
+int
+do_internal_set_chunk_size (int size)
+{
+  if (size < GUESTFS_DEFAULT_CHUNK_SIZE)
+    size = GUESTFS_DEFAULT_CHUNK_SIZE;
+  else if (size > GUESTFS_MAX_CHUNK_SIZE)
+    size = GUESTFS_MAX_CHUNK_SIZE;
+
+  if (verbose)
+    fprintf (stderr, "guestfsd: using chunk size %d\n", size);
+
+  chunk_size = size;
+  return size;
 }
 
 /* Initial delay before sending notification messages, and
@@ -654,21 +795,16 @@ notify_progress_no_ratelimit (uint64_t position, uint64_t total,
   count_progress++;
   last_progress_t = *now_t;
 
-  /* Send the header word. */
+  /* The header word is sent in the same write as the message. */
   i = GUESTFS_PROGRESS_FLAG;
-  xdrmem_create (&xdr, buf, 4, XDR_ENCODE);
+  xdrmem_create (&xdr, buf, sizeof buf, XDR_ENCODE);
   xdr_u_int (&xdr, &i);
-  xdr_destroy (&xdr);
-
-  if (xwrite (sock, buf, 4) == -1)
-    error (EXIT_FAILURE, 0, "xwrite failed");
 
   message.proc = proc_nr;
   message.serial = serial;
   message.position = position;
   message.total = total;
 
-  xdrmem_create (&xdr, buf, sizeof buf, XDR_ENCODE);
   if (!xdr_guestfs_progress (&xdr, &message)) {
     fprintf (stderr, "guestfsd: xdr_guestfs_progress: failed to encode message\n");
     xdr_destroy (&xdr);
@@ -72,6 +72,8 @@ sfdisk (const char *device, int n, int cyls, int heads, int sectors,
   if (verbose)
     printf ("%s\n", buf);
 
+  invalidate_parttable (device);
+
   fp = popen (buf, "w");
   if (fp == NULL) {
     reply_with_perror ("failed to open pipe: %s", buf);
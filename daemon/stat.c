@@ -23,6 +23,7 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <fcntl.h>
 #include <unistd.h>
 
@@ -174,3 +175,141 @@ do_internal_lstatnslist (const char *path, char *const *names)
 
   return ret;
 }
+
+/* Maximum number of worker processes used by internal_stat_paths,
+ * and the minimum number of paths given to each worker.
+ */
+#define MAX_STAT_WORKERS     8
+#define PATHS_PER_STAT_WORKER 64
+
+/* Stat paths[start] to paths[end-1], storing the results in val.
+ * Must be called between CHROOT_IN and CHROOT_OUT.
+ */
+static void
+stat_paths_range (char *const *paths, size_t start, size_t end,
+                  guestfs_int_statns *val)
+{
+  size_t i;
+
+  for (i = start; i < end; ++i) {
+    struct stat statbuf;
+
+    if (lstat (paths[i], &statbuf) == -1)
+      val[i].st_ino = -1;
+    else
+      stat_to_statns (&val[i], &statbuf);
+  }
+}
+
+/* Start a worker process which stats a range of paths and sends the
+ * results back over a pipe.  Returns the pid, or -1 if the worker
+ * could not be started (the caller then does the work itself).
+ */
+static pid_t
+start_stat_worker (char *const *paths, size_t start, size_t end,
+                   guestfs_int_statns *val, int *fd_ret)
+{
+  int fd[2];
+  pid_t pid;
+
+  if (pipe2 (fd, O_CLOEXEC) == -1) {
+    perror ("pipe2");
+    return -1;
+  }
+
+  pid = fork ();
+  if (pid == -1) {
+    perror ("fork");
+    close (fd[0]);
+    close (fd[1]);
+    return -1;
+  }
+
+  if (pid == 0) {               /* Child. */
+    close (fd[0]);
+    CHROOT_IN;
+    stat_paths_range (paths, start, end, val);
+    CHROOT_OUT;
+    if (xwrite (fd[1], &val[start],
+                (end - start) * sizeof (guestfs_int_statns)) == -1)
+      _exit (EXIT_FAILURE);
+    _exit (EXIT_SUCCESS);
+  }
+
+  close (fd[1]);
+  *fd_ret = fd[0];
+  return pid;
+}
+
+guestfs_int_statns_list *
+do_internal_stat_paths (char *const *paths)
+{
+  guestfs_int_statns_list *ret;
+  guestfs_int_statns *val;
+  size_t i, nr_paths, nr_workers;
+  pid_t pids[MAX_STAT_WORKERS];
+  int fds[MAX_STAT_WORKERS];
+
+  NEED_ROOT (, return NULL);
+  for (i = 0; paths[i] != NULL; ++i)
+    ABS_PATH (paths[i], , return NULL);
+
+  nr_paths = count_strings (paths);
+
+  ret = malloc (sizeof *ret);
+  if (!ret) {
+    reply_with_perror ("malloc");
+    return NULL;
+  }
+  ret->guestfs_int_statns_list_len = nr_paths;
+  ret->guestfs_int_statns_list_val = val =
+    calloc (nr_paths, sizeof (guestfs_int_statns));
+  if (val == NULL) {
+    reply_with_perror ("calloc");
+    free (ret);
+    return NULL;
+  }
+
+  /* The library uses this to look up the same paths in many
+   * filesystems mounted at the same time.  Split large lists between
+   * several processes, so that the lookups (which are mostly waiting
+   * for I/O) in different filesystems happen in parallel.  The paths
+   * for each filesystem are next to each other in the list, so each
+   * process works on a contiguous range.
+   */
+  nr_workers = MIN (MAX_STAT_WORKERS, nr_paths / PATHS_PER_STAT_WORKER);
+  if (nr_workers <= 1) {
+    CHROOT_IN;
+    stat_paths_range (paths, 0, nr_paths, val);
+    CHROOT_OUT;
+    return ret;
+  }
+
+  for (i = 0; i < nr_workers; ++i)
+    pids[i] = start_stat_worker (paths,
+                                 i * nr_paths / nr_workers,
+                                 (i+1) * nr_paths / nr_workers,
+                                 val, &fds[i]);
+
+  for (i = 0; i < nr_workers; ++i) {
+    const size_t start = i * nr_paths / nr_workers;
+    const size_t end = (i+1) * nr_paths / nr_workers;
+    int r = -1;
+
+    if (pids[i] != -1) {
+      r = xread (fds[i], &val[start],
+                 (end - start) * sizeof (guestfs_int_statns));
+      close (fds[i]);
+      waitpid (pids[i], NULL, 0);
+    }
+
+    /* If the worker could not be started or failed, do its work here. */
+    if (r == -1) {
+      CHROOT_IN;
+      stat_paths_range (paths, start, end, val);
+      CHROOT_OUT;
+    }
+  }
+
+  return ret;
+}
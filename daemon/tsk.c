@@ -202,13 +202,13 @@ send_dirent_info (TSK_FS_FILE *fsfile, const char *path)
   file_metadata (fsfile->meta, &dirent);
 
   /* Serialize tsk_dirent struct. */
-  buf = malloc (GUESTFS_MAX_CHUNK_SIZE);
+  buf = malloc (GUESTFS_DEFAULT_CHUNK_SIZE);
   if (buf == NULL) {
     perror ("malloc");
     return -1;
   }
 
-  xdrmem_create (&xdr, buf, GUESTFS_MAX_CHUNK_SIZE, XDR_ENCODE);
+  xdrmem_create (&xdr, buf, GUESTFS_DEFAULT_CHUNK_SIZE, XDR_ENCODE);
 
   ret = xdr_guestfs_int_tsk_dirent (&xdr, &dirent);
   if (ret == 0) {
@@ -0,0 +1,426 @@
+/* libguestfs - the guestfsd daemon
+ * Copyright (C) 2016 Red Hat Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * Waiting for udev to finish processing device events.
+ *
+ * LVM and other commands aren't synchronous, especially when udev is
+ * involved.  eg. You can create or remove some device, but the
+ * C</dev> device node won't appear until some time later.  This means
+ * that you get an error if you run one command followed by another.
+ * So C<udev_settle> is called after such commands.
+ *
+ * Running C<udevadm settle> every time is slow, and usually there is
+ * nothing to wait for.  Instead the daemon listens to the kernel
+ * uevents and to the events which udev sends out after it has
+ * processed them, on a netlink socket.  Block device events which the
+ * kernel has sent but which udev has not finished with yet are
+ * pending, and we only have to wait if there are any.  If anything
+ * goes wrong (eg. the socket buffer overflows, or we wait too long),
+ * we fall back to C<udevadm settle>.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#ifdef HAVE_LINUX_NETLINK_H
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <linux/netlink.h>
+#endif
+
+#include "ignore-value.h"
+
+#include "daemon.h"
+
+GUESTFSD_EXT_CMD(str_udevadm, udevadm);
+
+/* How long to wait for pending events before giving up and running
+ * udevadm settle (milliseconds).
+ */
+#define SETTLE_TIMEOUT 10000
+
+/* Time spent in udev_settle, and number of calls (for debugging). */
+static uint64_t settle_total_ns = 0;
+static unsigned settle_calls = 0;
+static unsigned settle_forks = 0;
+
+static void udevadm_settle (void);
+
+static uint64_t
+now_ns (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+#ifdef HAVE_LINUX_NETLINK_H
+
+/* Netlink multicast groups, see libudev-monitor.c. */
+#define MONITOR_GROUP_KERNEL 1
+#define MONITOR_GROUP_UDEV   2
+
+/* Events sent by udev start with this header, see libudev-monitor.c. */
+#define UDEV_MONITOR_MAGIC 0xfeedcafe
+struct udev_monitor_netlink_header {
+  char prefix[8];               /* "libudev" */
+  unsigned int magic;           /* htonl (UDEV_MONITOR_MAGIC) */
+  unsigned int header_size;
+  unsigned int properties_off;
+  unsigned int properties_len;
+  /* Filter fields follow, which we don't need. */
+};
+
+static int uevent_fd = -2;      /* -2 = not opened yet, -1 = failed */
+
+/* Highest kernel sequence number seen so far. */
+static uint64_t last_kernel_seqnum = 0;
+
+/* Sequence numbers of the block device events which the kernel has
+ * sent, but which udev has not finished processing.
+ */
+static uint64_t *pending = NULL;
+static size_t nr_pending = 0, pending_alloc = 0;
+
+static void
+uevent_finalize (void) __attribute__((destructor));
+static void
+uevent_finalize (void)
+{
+  if (uevent_fd >= 0)
+    close (uevent_fd);
+  free (pending);
+}
+
+static int
+add_pending (uint64_t seqnum)
+{
+  if (nr_pending >= pending_alloc) {
+    const size_t n = pending_alloc == 0 ? 64 : pending_alloc * 2;
+    uint64_t *p = realloc (pending, n * sizeof (uint64_t));
+    if (p == NULL) {
+      perror ("realloc");
+      return -1;
+    }
+    pending = p;
+    pending_alloc = n;
+  }
+  pending[nr_pending++] = seqnum;
+  return 0;
+}
+
+static void
+remove_pending (uint64_t seqnum)
+{
+  size_t i;
+
+  for (i = 0; i < nr_pending; ++i) {
+    if (pending[i] == seqnum) {
+      pending[i] = pending[--nr_pending];
+      return;
+    }
+  }
+}
+
+/* Read the latest sequence number from the kernel. */
+static int
+get_kernel_seqnum (uint64_t *seqnum)
+{
+  char buf[32];
+  ssize_t r;
+  int fd;
+
+  fd = open ("/sys/kernel/uevent_seqnum", O_RDONLY|O_CLOEXEC);
+  if (fd == -1)
+    return -1;
+  r = read (fd, buf, sizeof buf - 1);
+  close (fd);
+  if (r <= 0)
+    return -1;
+  buf[r] = '\0';
+  if (sscanf (buf, "%" SCNu64, seqnum) != 1)
+    return -1;
+  return 0;
+}
+
+/* Find the SEQNUM and SUBSYSTEM properties in a list of \0-separated
+ * KEY=VALUE strings.
+ */
+static int
+parse_properties (const char *props, size_t len,
+                  uint64_t *seqnum, int *is_block)
+{
+  const char *end = props + len;
+  int have_seqnum = 0;
+
+  *is_block = 0;
+  while (props < end) {
+    const size_t n = strnlen (props, end - props);
+
+    if (n > 7 && STRPREFIX (props, "SEQNUM=")) {
+      if (sscanf (&props[7], "%" SCNu64, seqnum) == 1)
+        have_seqnum = 1;
+    }
+    else if (n == 15 && STRPREFIX (props, "SUBSYSTEM=block"))
+      *is_block = 1;
+    props += n + 1;
+  }
+
+  return have_seqnum ? 0 : -1;
+}
+
+/* Read and account for all the events which are waiting on the
+ * socket.  Returns -1 if we may have lost events.
+ */
+static int
+drain_events (void)
+{
+  char buf[8192];
+  struct sockaddr_nl addr;
+  struct iovec iov;
+  struct msghdr msg;
+  ssize_t r;
+  uint64_t seqnum;
+  int is_block;
+
+  for (;;) {
+    iov.iov_base = buf;
+    iov.iov_len = sizeof buf;
+    memset (&msg, 0, sizeof msg);
+    msg.msg_name = &addr;
+    msg.msg_namelen = sizeof addr;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    r = recvmsg (uevent_fd, &msg, MSG_DONTWAIT);
+    if (r == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return 0;
+      if (errno == EINTR)
+        continue;
+      if (errno != ENOBUFS)
+        perror ("recvmsg: uevent");
+      return -1;
+    }
+    if (r == 0 || (msg.msg_flags & MSG_TRUNC) ||
+        addr.nl_groups == 0)
+      continue;
+
+    if (addr.nl_groups == MONITOR_GROUP_KERNEL) {
+      /* Kernel event: "action@devpath\0KEY=VALUE\0...".  Only
+       * believe events which really come from the kernel.
+       */
+      const size_t n = strnlen (buf, r);
+
+      if (addr.nl_pid != 0 || n == (size_t) r || strchr (buf, '@') == NULL)
+        continue;
+      if (parse_properties (&buf[n+1], r - n - 1, &seqnum, &is_block) == -1)
+        continue;
+      if (seqnum > last_kernel_seqnum)
+        last_kernel_seqnum = seqnum;
+      if (is_block && add_pending (seqnum) == -1)
+        return -1;
+    }
+    else if (addr.nl_groups == MONITOR_GROUP_UDEV) {
+      /* udev has finished processing an event. */
+      const struct udev_monitor_netlink_header *h = (void *) buf;
+
+      if ((size_t) r < sizeof *h ||
+          memcmp (h->prefix, "libudev", 8) != 0 ||
+          ntohl (h->magic) != UDEV_MONITOR_MAGIC ||
+          h->properties_off > (size_t) r ||
+          h->properties_len > (size_t) r - h->properties_off)
+        continue;
+      if (parse_properties (&buf[h->properties_off], h->properties_len,
+                            &seqnum, &is_block) == -1)
+        continue;
+      remove_pending (seqnum);
+    }
+  }
+}
+
+/* Forget everything and run udevadm settle.  After this, all the
+ * events up to the kernel's current sequence number are done.
+ */
+static void
+resync (void)
+{
+  udevadm_settle ();
+
+  ignore_value (drain_events ());
+  nr_pending = 0;
+  if (get_kernel_seqnum (&last_kernel_seqnum) == -1) {
+    close (uevent_fd);
+    uevent_fd = -1;
+  }
+}
+
+/* Open the netlink socket, the first time we are called. */
+static void
+open_uevent_socket (void)
+{
+  struct sockaddr_nl addr;
+  const int bufsize = 16 * 1024 * 1024;
+  int fd;
+
+  fd = socket (PF_NETLINK, SOCK_DGRAM|SOCK_CLOEXEC|SOCK_NONBLOCK,
+               NETLINK_KOBJECT_UEVENT);
+  if (fd == -1) {
+    perror ("socket: NETLINK_KOBJECT_UEVENT");
+    uevent_fd = -1;
+    return;
+  }
+
+  /* Make it less likely that we drop events when a lot of devices
+   * are created at once.  This is only possible as root, but that
+   * is what we are.
+   */
+  if (setsockopt (fd, SOL_SOCKET, SO_RCVBUFFORCE,
+                  &bufsize, sizeof bufsize) == -1)
+    ignore_value (setsockopt (fd, SOL_SOCKET, SO_RCVBUF,
+                              &bufsize, sizeof bufsize));
+
+  memset (&addr, 0, sizeof addr);
+  addr.nl_family = AF_NETLINK;
+  addr.nl_groups = MONITOR_GROUP_KERNEL | MONITOR_GROUP_UDEV;
+  if (bind (fd, (struct sockaddr *) &addr, sizeof addr) == -1) {
+    perror ("bind: NETLINK_KOBJECT_UEVENT");
+    close (fd);
+    uevent_fd = -1;
+    return;
+  }
+
+  uevent_fd = fd;
+}
+
+/* Wait until there are no pending events.  Returns -1 if we have to
+ * fall back to udevadm settle.
+ */
+static int
+wait_for_pending (void)
+{
+  uint64_t kernel_seqnum, start = now_ns ();
+  struct pollfd pollfd;
+  int timeout, r;
+
+  if (get_kernel_seqnum (&kernel_seqnum) == -1)
+    return -1;
+
+  for (;;) {
+    if (drain_events () == -1)
+      return -1;
+
+    /* We have to have seen all the events that the kernel has sent,
+     * and udev has to have processed them.
+     */
+    if (last_kernel_seqnum >= kernel_seqnum && nr_pending == 0)
+      return 0;
+
+    timeout = SETTLE_TIMEOUT - (now_ns () - start) / 1000000;
+    if (timeout <= 0) {
+      if (verbose)
+        fprintf (stderr,
+                 "udev_settle: timed out with %zu pending events\n",
+                 nr_pending);
+      return -1;
+    }
+
+    pollfd.fd = uevent_fd;
+    pollfd.events = POLLIN;
+    pollfd.revents = 0;
+    r = poll (&pollfd, 1, timeout);
+    if (r == -1 && errno != EINTR) {
+      perror ("poll: uevent");
+      return -1;
+    }
+  }
+}
+
+#endif /* HAVE_LINUX_NETLINK_H */
+
+/**
+ * Wait until udev has processed all pending device events.
+ *
+ * Don't be too fussed if this fails.
+ */
+void
+udev_settle (void)
+{
+  const uint64_t start = now_ns ();
+  uint64_t t;
+
+  settle_calls++;
+
+#ifdef HAVE_LINUX_NETLINK_H
+  if (uevent_fd == -2) {
+    open_uevent_socket ();
+    if (uevent_fd >= 0)
+      resync ();
+    else
+      udevadm_settle ();
+  }
+  else if (uevent_fd >= 0) {
+    if (wait_for_pending () == -1)
+      resync ();
+  }
+  else
+#endif
+    udevadm_settle ();
+
+  t = now_ns () - start;
+  settle_total_ns += t;
+  if (verbose)
+    fprintf (stderr,
+             "udev_settle: %" PRIu64 ".%03" PRIu64 " ms "
+             "(total %" PRIu64 " ms in %u calls, %u udevadm settle)\n",
+             t / 1000000, t / 1000 % 1000,
+             settle_total_ns / 1000000, settle_calls, settle_forks);
+}
+
+static void
+udevadm_settle (void)
+{
+  char cmd[80];
+  int r;
+
+  settle_forks++;
+
+  snprintf (cmd, sizeof cmd, "%s%s settle",
+            str_udevadm, verbose ? " --debug" : "");
+  if (verbose)
+    printf ("%s\n", cmd);
+  r = system (cmd);
+  if (r == -1)
+    perror ("system");
+  else if (!WIFEXITED (r) || WEXITSTATUS (r) != 0)
+    fprintf (stderr, "warning: udevadm command failed\n");
+}
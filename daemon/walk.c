@@ -0,0 +1,397 @@
+/* libguestfs - the guestfsd daemon
+ * Copyright (C) 2016 Red Hat Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <rpc/xdr.h>
+#include <rpc/types.h>
+
+#if defined(HAVE_LLISTXATTR) && defined(HAVE_LGETXATTR)
+# define HAVE_WALK_XATTRS
+# ifdef HAVE_ATTR_XATTR_H
+#  include <attr/xattr.h>
+# else
+#  ifdef HAVE_SYS_XATTR_H
+#   include <sys/xattr.h>
+#  endif
+# endif
+#endif
+
+#include "guestfs_protocol.h"
+#include "daemon.h"
+#include "actions.h"
+
+/* Records are XDR-encoded into 'buf', which is sent to the library
+ * each time it holds at least chunk_size bytes.  The buffer is large
+ * enough for any single record.
+ *
+ * The functions below return 0 if OK, -1 if there was an error
+ * (and the caller must cancel the transfer), or -2 if sending
+ * failed or the library cancelled the transfer (in which case
+ * send_file_write has already dealt with it).
+ */
+struct walk_state {
+  char *buf;
+  size_t used;
+};
+
+static int walk_dir (struct walk_state *ws, const char *path, const char *name);
+static int send_entry (struct walk_state *ws, const char *path, const char *name, const struct stat *statbuf);
+static int send_record (struct walk_state *ws, guestfs_int_walk_entry *entry);
+static int flush_records (struct walk_state *ws);
+
+/* Has one FileOut parameter. */
+int
+do_internal_walk (const char *dir)
+{
+  struct walk_state ws = { .buf = NULL, .used = 0 };
+  CLEANUP_FREE char *path = NULL;
+  struct stat statbuf;
+  size_t len;
+  int r;
+
+  path = sysroot_path (dir);
+  if (path == NULL) {
+    reply_with_perror ("malloc");
+    return -1;
+  }
+  len = strlen (path);
+  while (len > 1 && path[len-1] == '/')
+    path[--len] = '\0';
+
+  if (lstat (path, &statbuf) == -1) {
+    reply_with_perror ("%s", dir);
+    return -1;
+  }
+  if (!S_ISDIR (statbuf.st_mode)) {
+    reply_with_error ("%s: not a directory", dir);
+    return -1;
+  }
+
+  ws.buf = malloc (GUESTFS_MAX_CHUNK_SIZE);
+  if (ws.buf == NULL) {
+    reply_with_perror ("malloc");
+    return -1;
+  }
+
+  /* Now we must send the reply message, before the records.  After
+   * this there is no opportunity in the protocol to send any error
+   * message back.  Instead we can only cancel the transfer.
+   */
+  reply (NULL, NULL);
+
+  r = send_entry (&ws, path, "", &statbuf);
+  if (r == 0)
+    r = walk_dir (&ws, path, "");
+  if (r == 0)
+    r = flush_records (&ws);
+  free (ws.buf);
+
+  if (r == -1) {
+    send_file_end (1);          /* Cancel. */
+    return -1;
+  }
+  if (r == -2)
+    return -1;
+
+  if (send_file_end (0))        /* Normal end of file. */
+    return -1;
+
+  return 0;
+}
+
+/* Read the names in a directory, sorted.  This cannot use the
+ * stringsbuf functions because they send an error reply on failure,
+ * and the reply has already been sent.
+ */
+static char **
+read_dir_names (const char *path, size_t *nr_names)
+{
+  DIR *dir;
+  struct dirent *d;
+  char **names = NULL, **new_names;
+  size_t nr = 0, alloc = 0;
+
+  dir = opendir (path);
+  if (dir == NULL) {
+    fprintf (stderr, "guestfsd: walk: opendir: %s: %m\n", path);
+    return NULL;
+  }
+
+  for (;;) {
+    errno = 0;
+    d = readdir (dir);
+    if (d == NULL) break;
+
+    /* Ignore . and .. */
+    if (STREQ (d->d_name, ".") || STREQ (d->d_name, ".."))
+      continue;
+
+    if (nr >= alloc) {
+      alloc += 64;
+      new_names = realloc (names, alloc * sizeof (char *));
+      if (new_names == NULL) {
+        perror ("realloc");
+        goto error;
+      }
+      names = new_names;
+    }
+    names[nr] = strdup (d->d_name);
+    if (names[nr] == NULL) {
+      perror ("strdup");
+      goto error;
+    }
+    nr++;
+  }
+
+  if (errno != 0) {
+    fprintf (stderr, "guestfsd: walk: readdir: %s: %m\n", path);
+    goto error;
+  }
+
+  if (closedir (dir) == -1) {
+    fprintf (stderr, "guestfsd: walk: closedir: %s: %m\n", path);
+    free_stringslen (names, nr);
+    return NULL;
+  }
+
+  if (nr > 0)
+    sort_strings (names, nr);
+  *nr_names = nr;
+  /* Never return NULL for an empty directory. */
+  return names ? names : calloc (1, sizeof (char *));
+
+ error:
+  closedir (dir);
+  free_stringslen (names, nr);
+  return NULL;
+}
+
+/* Send the contents of the directory 'path' (recursively).  'name'
+ * is the path relative to the top directory, or "" for the top
+ * directory itself.
+ */
+static int
+walk_dir (struct walk_state *ws, const char *path, const char *name)
+{
+  char **names;
+  size_t i, nr_names = 0;
+  int r = 0;
+
+  names = read_dir_names (path, &nr_names);
+  if (names == NULL)
+    return -1;
+
+  for (i = 0; i < nr_names; ++i) {
+    CLEANUP_FREE char *child_path = NULL;
+    CLEANUP_FREE char *child_name = NULL;
+    struct stat statbuf;
+
+    if (asprintf (&child_path, "%s/%s", path, names[i]) == -1 ||
+        asprintf (&child_name, "%s%s%s",
+                  name, name[0] ? "/" : "", names[i]) == -1) {
+      perror ("asprintf");
+      r = -1;
+      break;
+    }
+
+    if (lstat (child_path, &statbuf) == -1) {
+      /* The file may have been deleted since we read the directory. */
+      if (errno == ENOENT)
+        continue;
+      fprintf (stderr, "guestfsd: walk: lstat: %s: %m\n", child_path);
+      r = -1;
+      break;
+    }
+
+    r = send_entry (ws, child_path, child_name, &statbuf);
+    if (r == 0 && S_ISDIR (statbuf.st_mode))
+      r = walk_dir (ws, child_path, child_name);
+    if (r != 0)
+      break;
+  }
+
+  free_stringslen (names, nr_names);
+  return r;
+}
+
+/* Send the record for a single file, followed by one record for each
+ * of its extended attributes.
+ */
+static int
+send_entry (struct walk_state *ws, const char *path, const char *name,
+            const struct stat *statbuf)
+{
+  guestfs_int_walk_entry entry;
+  char link[PATH_MAX];
+  int r;
+
+  memset (&entry, 0, sizeof entry);
+  entry.we_name = (char *) name;
+  entry.we_dev = statbuf->st_dev;
+  entry.we_ino = statbuf->st_ino;
+  entry.we_mode = statbuf->st_mode;
+  entry.we_nlink = statbuf->st_nlink;
+  entry.we_uid = statbuf->st_uid;
+  entry.we_gid = statbuf->st_gid;
+  entry.we_rdev = statbuf->st_rdev;
+  entry.we_size = statbuf->st_size;
+#ifdef HAVE_STRUCT_STAT_ST_BLKSIZE
+  entry.we_blksize = statbuf->st_blksize;
+#else
+  entry.we_blksize = -1;
+#endif
+#ifdef HAVE_STRUCT_STAT_ST_BLOCKS
+  entry.we_blocks = statbuf->st_blocks;
+#else
+  entry.we_blocks = -1;
+#endif
+  entry.we_atime_sec = statbuf->st_atime;
+#ifdef HAVE_STRUCT_STAT_ST_ATIM_TV_NSEC
+  entry.we_atime_nsec = statbuf->st_atim.tv_nsec;
+#endif
+  entry.we_mtime_sec = statbuf->st_mtime;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+  entry.we_mtime_nsec = statbuf->st_mtim.tv_nsec;
+#endif
+  entry.we_ctime_sec = statbuf->st_ctime;
+#ifdef HAVE_STRUCT_STAT_ST_CTIM_TV_NSEC
+  entry.we_ctime_nsec = statbuf->st_ctim.tv_nsec;
+#endif
+
+  link[0] = '\0';
+  if (S_ISLNK (statbuf->st_mode)) {
+    ssize_t n = readlink (path, link, sizeof link - 1);
+    if (n >= 0)
+      link[n] = '\0';
+    else
+      link[0] = '\0';
+  }
+  entry.we_link = link;
+  entry.we_attrname = (char *) "";
+
+  r = send_record (ws, &entry);
+  if (r != 0)
+    return r;
+
+#ifdef HAVE_WALK_XATTRS
+  ssize_t len, vlen;
+  size_t i;
+  CLEANUP_FREE char *list = NULL;
+
+  len = llistxattr (path, NULL, 0);
+  if (len <= 0)                 /* No xattrs, or not supported. */
+    return 0;
+
+  list = malloc (len);
+  if (list == NULL) {
+    perror ("malloc");
+    return -1;
+  }
+  len = llistxattr (path, list, len);
+  if (len == -1) {
+    fprintf (stderr, "guestfsd: walk: llistxattr: %s: %m\n", path);
+    return 0;
+  }
+
+  memset (&entry, 0, sizeof entry);
+  entry.we_name = (char *) "";
+  entry.we_link = (char *) "";
+
+  for (i = 0; i < (size_t) len; i += strlen (&list[i]) + 1) {
+    CLEANUP_FREE char *val = NULL;
+
+    vlen = lgetxattr (path, &list[i], NULL, 0);
+    if (vlen == -1) {
+      fprintf (stderr, "guestfsd: walk: lgetxattr: %s: %s: %m\n",
+               path, &list[i]);
+      continue;
+    }
+    val = malloc (vlen > 0 ? vlen : 1);
+    if (val == NULL) {
+      perror ("malloc");
+      return -1;
+    }
+    vlen = lgetxattr (path, &list[i], val, vlen);
+    if (vlen == -1) {
+      fprintf (stderr, "guestfsd: walk: lgetxattr: %s: %s: %m\n",
+               path, &list[i]);
+      continue;
+    }
+
+    entry.we_attrname = &list[i];
+    entry.we_attrval.we_attrval_len = vlen;
+    entry.we_attrval.we_attrval_val = val;
+    r = send_record (ws, &entry);
+    if (r != 0)
+      return r;
+  }
+#endif
+
+  return 0;
+}
+
+static int
+send_record (struct walk_state *ws, guestfs_int_walk_entry *entry)
+{
+  XDR xdr;
+
+ again:
+  xdrmem_create (&xdr, ws->buf + ws->used,
+                 GUESTFS_MAX_CHUNK_SIZE - ws->used, XDR_ENCODE);
+  if (!xdr_guestfs_int_walk_entry (&xdr, entry)) {
+    xdr_destroy (&xdr);
+    if (ws->used == 0) {
+      fprintf (stderr, "guestfsd: walk: %s: record too large\n",
+               entry->we_name);
+      return -1;
+    }
+    /* Buffer full, send it and try again. */
+    if (flush_records (ws) != 0)
+      return -2;
+    goto again;
+  }
+  ws->used += xdr_getpos (&xdr);
+  xdr_destroy (&xdr);
+
+  if (ws->used >= chunk_size)
+    return flush_records (ws);
+
+  return 0;
+}
+
+static int
+flush_records (struct walk_state *ws)
+{
+  if (ws->used > 0) {
+    if (send_file_write (ws->buf, ws->used) < 0)
+      return -2;
+    ws->used = 0;
+  }
+
+  return 0;
+}
@@ -24,8 +24,14 @@
 #include <string.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <errno.h>
+#include <sys/ioctl.h>
 #include <sys/statvfs.h>
 
+#ifdef HAVE_LINUX_FS_H
+#include <linux/fs.h>
+#endif
+
 #include "ignore-value.h"
 
 #include "daemon.h"
@@ -36,6 +42,32 @@ GUESTFSD_EXT_CMD(str_wipefs, wipefs);
 
 static const char zero_buf[4096];
 
+/* Size of the (aligned) buffer used by the functions below which
+ * have to read a whole device.
+ */
+#define ZERO_BUFSIZE (1024 * 1024)
+
+/* Discard requests are split into pieces this large, so that progress
+ * can be reported.
+ */
+#define DISCARD_CHUNK (INT64_C(64) * 1024 * 1024)
+
+static void *
+alloc_zero_buffer (void)
+{
+  void *buf;
+
+  /* This buffer is also used with O_DIRECT, so it must be aligned.
+   * Note posix_memalign has this strange errno behaviour.
+   */
+  errno = posix_memalign (&buf, 4096, ZERO_BUFSIZE);
+  if (errno != 0) {
+    reply_with_perror ("posix_memalign");
+    return NULL;
+  }
+  return buf;
+}
+
 int
 do_zero (const char *device)
 {
@@ -134,53 +166,173 @@ do_wipefs (const char *device)
   return 0;
 }
 
+/* The ways in which a range of a device can be discarded, such that
+ * it is guaranteed to read back as zeroes.
+ */
+enum discard_method {
+  DISCARD_PUNCH_HOLE,           /* fallocate (PUNCH_HOLE), Linux >= 4.9 */
+  DISCARD_BLKDISCARD,           /* BLKDISCARD if BLKDISCARDZEROES */
+  NR_DISCARD_METHODS
+};
+
+static int
+discard_range (int fd, enum discard_method method,
+               uint64_t offset, uint64_t len)
+{
+  switch (method) {
+#ifdef FALLOC_FL_PUNCH_HOLE
+  case DISCARD_PUNCH_HOLE:
+    return fallocate (fd, FALLOC_FL_PUNCH_HOLE|FALLOC_FL_KEEP_SIZE,
+                      offset, len);
+#endif
+#if defined(BLKDISCARD) && defined(BLKDISCARDZEROES)
+  case DISCARD_BLKDISCARD: {
+    unsigned int arg;
+    uint64_t range[2] = { offset, len };
+
+    if (ioctl (fd, BLKDISCARDZEROES, &arg) == -1)
+      return -1;
+    if (arg == 0) {
+      errno = EOPNOTSUPP;
+      return -1;
+    }
+    return ioctl (fd, BLKDISCARD, range);
+  }
+#endif
+  default:
+    errno = EOPNOTSUPP;
+    return -1;
+  }
+}
+
+/* Try to zero the whole device by discarding it.  Returns 1 if the
+ * device was zeroed, 0 if it does not support a suitable kind of
+ * discard (and nothing was changed), or -1 on error.
+ */
+static int
+discard_device (int fd, const char *device, uint64_t size)
+{
+  enum discard_method method;
+  uint64_t pos, n;
+
+  if (size == 0)
+    return 1;
+
+  /* Find the first method which works on the first chunk. */
+  n = MIN (size, (uint64_t) DISCARD_CHUNK);
+  for (method = 0; method < NR_DISCARD_METHODS; ++method) {
+    if (discard_range (fd, method, 0, n) == 0)
+      break;
+  }
+  if (method == NR_DISCARD_METHODS)
+    return 0;
+
+  if (verbose)
+    fprintf (stderr, "guestfsd: zero_device: %s: using discard method %d\n",
+             device, (int) method);
+
+  for (pos = n; pos < size; pos += n) {
+    notify_progress (pos, size);
+    n = MIN (size - pos, (uint64_t) DISCARD_CHUNK);
+    if (discard_range (fd, method, pos, n) == -1) {
+      reply_with_perror ("discard: %s at offset %" PRIu64, device, pos);
+      return -1;
+    }
+  }
+  notify_progress (size, size);
+
+  return 1;
+}
+
+/* Zero a range which was found to contain non-zero data.  'buf'
+ * contains the data, and may be overwritten.
+ */
+static int
+zero_range (int fd, char *buf, uint64_t offset, size_t len)
+{
+  ssize_t r;
+
+#ifdef BLKZEROOUT
+  uint64_t range[2] = { offset, len };
+
+  /* This may be offloaded to the device (eg. WRITE SAME), and saves
+   * copying the zeroes.
+   */
+  if (ioctl (fd, BLKZEROOUT, range) == 0)
+    return 0;
+#endif
+
+  memset (buf, 0, len);
+  while (len > 0) {
+    r = pwrite (fd, buf, len, offset);
+    if (r == -1)
+      return -1;
+    buf += r;
+    offset += r;
+    len -= r;
+  }
+
+  return 0;
+}
+
 int
 do_zero_device (const char *device)
 {
-  const int64_t ssize = do_blockdev_getsize64 (device);
+  CLEANUP_FREE char *buf = NULL;
+  int64_t ssize;
+  uint64_t size, pos;
+  int fd, r;
+
+  ssize = do_blockdev_getsize64 (device);
   if (ssize == -1)
     return -1;
-  uint64_t size = (uint64_t) ssize;
+  size = (uint64_t) ssize;
+
+  buf = alloc_zero_buffer ();
+  if (buf == NULL)
+    return -1;
 
-  int fd = open (device, O_RDWR|O_CLOEXEC);
+  fd = open (device, O_RDWR|O_CLOEXEC);
   if (fd == -1) {
     reply_with_perror ("%s", device);
     return -1;
   }
 
-  char buf[sizeof zero_buf];
-
-  uint64_t pos = 0;
+  /* If the device can discard blocks so they read back as zeroes,
+   * this avoids reading the device at all.
+   */
+  r = discard_device (fd, device, size);
+  if (r == -1) {
+    close (fd);
+    return -1;
+  }
 
-  while (pos < size) {
-    uint64_t n64 = size - pos;
-    size_t n;
-    if (n64 > sizeof buf)
-      n = sizeof buf;
-    else
-      n = (size_t) n64; /* safe because of if condition */
+  for (pos = 0; r == 0 && pos < size; ) {
+    size_t n = MIN (size - pos, (uint64_t) ZERO_BUFSIZE);
+    ssize_t rn;
 
     /* Check if the block is already zero before overwriting it. */
-    ssize_t r;
-    r = pread (fd, buf, n, pos);
-    if (r == -1) {
+    rn = pread (fd, buf, n, pos);
+    if (rn == -1) {
       reply_with_perror ("pread: %s at offset %" PRIu64, device, pos);
       close (fd);
       return -1;
     }
+    if (rn == 0) {
+      reply_with_error ("pread: %s: unexpected end of device at offset %"
+                        PRIu64, device, pos);
+      close (fd);
+      return -1;
+    }
 
-    if (!is_zero (buf, sizeof buf)) {
-      r = pwrite (fd, zero_buf, n, pos);
-      if (r == -1) {
-        reply_with_perror ("pwrite: %s (with %" PRIu64 " bytes left to write)",
-                           device, size);
+    if (!is_zero (buf, rn)) {
+      if (zero_range (fd, buf, pos, rn) == -1) {
+        reply_with_perror ("pwrite: %s at offset %" PRIu64, device, pos);
         close (fd);
         return -1;
       }
-      pos += r;
     }
-    else
-      pos += n;
+    pos += rn;
 
     notify_progress (pos, size);
   }
@@ -193,18 +345,71 @@ do_zero_device (const char *device)
   return 0;
 }
 
+/* Check if everything that can be read from 'fd' is zero.  Holes
+ * (found using SEEK_DATA/SEEK_HOLE, if supported) are skipped.
+ * Returns 1 if zero, 0 if not, -1 on error.
+ */
+static int
+is_zero_fd (int fd, const char *name, char *buf)
+{
+  off_t pos = 0, end;
+  ssize_t r;
+  int use_seek_data = 1;
+
+  for (;;) {
+    end = -1;                   /* read to the end of file */
+
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+    if (use_seek_data) {
+      off_t data = lseek (fd, pos, SEEK_DATA);
+
+      if (data == -1 && errno == ENXIO) /* no more data */
+        return 1;
+      if (data >= pos)
+        end = lseek (fd, data, SEEK_HOLE);
+      if (data < pos || end <= data) {
+        /* Not supported (or ignored) by this file or device. */
+        use_seek_data = 0;
+        end = -1;
+      }
+      else
+        pos = data;
+    }
+#else
+    use_seek_data = 0;
+#endif
+
+    while (end == -1 || pos < end) {
+      size_t n = ZERO_BUFSIZE;
+
+      if (end >= 0 && (off_t) n > end - pos)
+        n = end - pos;
+      r = pread (fd, buf, n, pos);
+      if (r == -1) {
+        reply_with_perror ("read: %s", name);
+        return -1;
+      }
+      if (r == 0)               /* end of file */
+        return 1;
+      if (!is_zero (buf, r))
+        return 0;
+      pos += r;
+    }
+
+    if (!use_seek_data)
+      return 1;
+  }
+}
+
 int
 do_is_zero (const char *path)
 {
-  int fd;
+  int fd, r;
   CLEANUP_FREE char *buf = NULL;
-  ssize_t r;
 
-  buf = malloc (BUFSIZ);
-  if (buf == NULL) {
-    reply_with_perror ("malloc");
+  buf = alloc_zero_buffer ();
+  if (buf == NULL)
     return -1;
-  }
 
   CHROOT_IN;
   fd = open (path, O_RDONLY|O_CLOEXEC);
@@ -215,15 +420,8 @@ do_is_zero (const char *path)
     return -1;
   }
 
-  while ((r = read (fd, buf, BUFSIZ)) > 0) {
-    if (!is_zero (buf, r)) {
-      close (fd);
-      return 0;
-    }
-  }
-
+  r = is_zero_fd (fd, path, buf);
   if (r == -1) {
-    reply_with_perror ("read: %s", path);
     close (fd);
     return -1;
   }
@@ -233,37 +431,33 @@ do_is_zero (const char *path)
     return -1;
   }
 
-  return 1;
+  return r;
 }
 
 int
 do_is_zero_device (const char *device)
 {
-  int fd;
+  int fd, r;
   CLEANUP_FREE char *buf = NULL;
-  ssize_t r;
 
-  buf = malloc (BUFSIZ);
-  if (buf == NULL) {
-    reply_with_perror ("malloc");
+  buf = alloc_zero_buffer ();
+  if (buf == NULL)
     return -1;
-  }
 
-  fd = open (device, O_RDONLY|O_CLOEXEC);
+  /* Use large direct reads, so that checking a large device doesn't
+   * evict everything else from the page cache.  Not every device
+   * supports O_DIRECT.
+   */
+  fd = open (device, O_RDONLY|O_DIRECT|O_CLOEXEC);
+  if (fd == -1 && errno == EINVAL)
+    fd = open (device, O_RDONLY|O_CLOEXEC);
   if (fd == -1) {
     reply_with_perror ("open: %s", device);
     return -1;
   }
 
-  while ((r = read (fd, buf, BUFSIZ)) > 0) {
-    if (!is_zero (buf, r)) {
-      close (fd);
-      return 0;
-    }
-  }
-
+  r = is_zero_fd (fd, device, buf);
   if (r == -1) {
-    reply_with_perror ("read: %s", device);
     close (fd);
     return -1;
   }
@@ -273,7 +467,7 @@ do_is_zero_device (const char *device)
     return -1;
   }
 
-  return 1;
+  return r;
 }
 
 /* Current implementation is to create a file of all zeroes, then
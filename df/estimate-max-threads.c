@@ -20,16 +20,17 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
 #include <string.h>
-#include <error.h>
-#include <errno.h>
 #include <libintl.h>
 
 #include "guestfs.h"
 #include "guestfs-internal-frontend.h"
 #include "estimate-max-threads.h"
 
-static char *read_line_from (const char *cmd);
+static uint64_t get_available_memory (void);
+static uint64_t get_cgroup_available_memory (void);
 
 /* The actual overhead is likely much smaller than this, but err on
  * the safe side.
@@ -37,47 +38,163 @@ static char *read_line_from (const char *cmd);
 #define MBYTES_PER_THREAD 650
 
 /**
- * This function uses the output of C<free -m> to estimate how many
- * libguestfs appliances could be safely started in parallel.  Note
- * that it always returns E<ge> 1.
+ * This function estimates how many libguestfs appliances could be
+ * safely started in parallel, from the available memory reported in
+ * F</proc/meminfo> and any memory limit set on the cgroup of the
+ * current process.  Note that it always returns E<ge> 1.
  */
 size_t
 estimate_max_threads (void)
 {
-  CLEANUP_FREE char *mbytes_str = NULL;
-  size_t mbytes;
+  uint64_t bytes;
 
-  /* Choose the number of threads based on the amount of free memory. */
-  mbytes_str = read_line_from ("LANG=C free -m | "
-                               "grep '^Mem' | awk '{print $4+$6+$7}'");
-  if (mbytes_str == NULL)
-    return 1;
+  bytes = MIN (get_available_memory (), get_cgroup_available_memory ());
 
-  if (sscanf (mbytes_str, "%zu", &mbytes) != 1)
-    return 1;
+  return MAX (1, bytes / (MBYTES_PER_THREAD * UINT64_C(1024) * 1024));
+}
+
+/**
+ * Return the available memory in bytes, or C<0> if it could not be
+ * read.
+ *
+ * Kernels E<ge> 3.14 report C<MemAvailable>.  For older kernels, use
+ * free + buffers + cached memory instead.
+ */
+static uint64_t
+get_available_memory (void)
+{
+  CLEANUP_FCLOSE FILE *fp = NULL;
+  CLEANUP_FREE char *line = NULL;
+  size_t allocsize = 0;
+  uint64_t kb, available = 0, free_etc = 0;
+  int have_available = 0;
+
+  fp = fopen ("/proc/meminfo", "r");
+  if (fp == NULL)
+    return 0;
+
+  while (getline (&line, &allocsize, fp) != -1) {
+    if (sscanf (line, "MemAvailable: %" SCNu64, &kb) == 1) {
+      available = kb;
+      have_available = 1;
+    }
+    else if (sscanf (line, "MemFree: %" SCNu64, &kb) == 1 ||
+             sscanf (line, "Buffers: %" SCNu64, &kb) == 1 ||
+             sscanf (line, "Cached: %" SCNu64, &kb) == 1)
+      free_etc += kb;
+  }
 
-  return MAX (1, mbytes / MBYTES_PER_THREAD);
+  return (have_available ? available : free_etc) * 1024;
 }
 
 /**
- * Run external command and read the first line of output.
+ * Read a single number from a cgroup file.  Returns C<UINT64_MAX> if
+ * the file doesn't exist or contains C<max> (no limit).
  */
-static char *
-read_line_from (const char *cmd)
+static uint64_t
+read_cgroup_value (const char *dir, const char *file)
 {
-  FILE *pp;
-  char *ret = NULL;
+  CLEANUP_FREE char *path = NULL;
+  CLEANUP_FCLOSE FILE *fp = NULL;
+  uint64_t r;
+
+  if (asprintf (&path, "%s/%s", dir, file) == -1)
+    return UINT64_MAX;
+  fp = fopen (path, "r");
+  if (fp == NULL)
+    return UINT64_MAX;
+  if (fscanf (fp, "%" SCNu64, &r) != 1)
+    return UINT64_MAX;
+  return r;
+}
+
+/**
+ * Return the memory which may still be used by the cgroup of this
+ * process (the limit minus the current usage), or C<UINT64_MAX> if
+ * there is no limit.  The limits of the parent cgroups apply too, so
+ * those are checked as well.
+ *
+ * Both cgroup v1 (the C<memory> controller) and cgroup v2 (the
+ * unified hierarchy) are supported.
+ */
+static uint64_t
+get_cgroup_available_memory (void)
+{
+  CLEANUP_FCLOSE FILE *fp = NULL;
+  CLEANUP_FREE char *line = NULL;
   size_t allocsize = 0;
+  ssize_t len;
+  uint64_t ret = UINT64_MAX;
+
+  fp = fopen ("/proc/self/cgroup", "r");
+  if (fp == NULL)
+    return UINT64_MAX;
+
+  /* Each line is "hierarchy-ID:controller-list:cgroup-path".  The
+   * cgroup v2 hierarchy has ID 0 and an empty controller list.
+   */
+  while ((len = getline (&line, &allocsize, fp)) != -1) {
+    CLEANUP_FREE char *dir = NULL;
+    char *controllers, *cgpath, *p;
+    const char *root, *limit_file, *usage_file;
+
+    if (len > 0 && line[len-1] == '\n')
+      line[len-1] = '\0';
+
+    controllers = strchr (line, ':');
+    if (controllers == NULL)
+      continue;
+    controllers++;
+    cgpath = strchr (controllers, ':');
+    if (cgpath == NULL)
+      continue;
+    *cgpath++ = '\0';
+
+    if (STREQ (controllers, "")) {
+      root = "/sys/fs/cgroup";
+      limit_file = "memory.max";
+      usage_file = "memory.current";
+    }
+    else {
+      CLEANUP_FREE_STRING_LIST char **names =
+        guestfs_int_split_string (',', controllers);
+      size_t i;
+
+      if (names == NULL)
+        continue;
+      for (i = 0; names[i] != NULL; ++i)
+        if (STREQ (names[i], "memory"))
+          break;
+      if (names[i] == NULL)
+        continue;
+      root = "/sys/fs/cgroup/memory";
+      limit_file = "memory.limit_in_bytes";
+      usage_file = "memory.usage_in_bytes";
+    }
+
+    if (asprintf (&dir, "%s%s", root, cgpath) == -1)
+      continue;
 
-  pp = popen (cmd, "r");
-  if (pp == NULL)
-    error (EXIT_FAILURE, errno, "%s: external command failed", cmd);
+    /* Check this cgroup and all of its parents. */
+    for (;;) {
+      uint64_t limit, usage;
 
-  if (getline (&ret, &allocsize, pp) == -1)
-    error (EXIT_FAILURE, errno, "could not read line from external command");
+      limit = read_cgroup_value (dir, limit_file);
+      if (limit != UINT64_MAX) {
+        usage = read_cgroup_value (dir, usage_file);
+        if (usage == UINT64_MAX)
+          usage = 0;
+        ret = MIN (ret, limit > usage ? limit - usage : 0);
+      }
 
-  if (pclose (pp) == -1)
-    error (EXIT_FAILURE, errno, "pclose");
+      if (strlen (dir) <= strlen (root))
+        break;
+      p = strrchr (dir, '/');
+      if (p == NULL)
+        break;
+      *p = '\0';
+    }
+  }
 
   return ret;
 }
@@ -217,7 +217,12 @@ worker_thread (void *thread_data_vp)
       return &thread_data->r;
     }
 
-    /* Create a guestfs handle. */
+    /* Create a guestfs handle.  Each domain gets a fresh appliance.
+     * Keeping the appliance running and hot-plugging the next
+     * domain's disks instead would need guestfs_add_libvirt_dom to
+     * work after launch (adding labelled drives), which it does not
+     * do yet.
+     */
     g = guestfs_create ();
     if (g == NULL) {
       perror ("guestfs_create");
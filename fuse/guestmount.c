@@ -120,6 +120,7 @@ usage (int status)
               "  --keys-from-stdin    Read passphrases from stdin\n"
               "  --live               Connect to a live virtual machine\n"
               "  -m|--mount dev[:mnt[:opts[:fstype]] Mount dev on mnt (if omitted, /)\n"
+              "  --multithreaded      Process FUSE requests in several threads\n"
               "  --no-fork            Don't daemonize\n"
               "  -n|--no-sync         Don't autosync\n"
               "  -o|--option opt      Pass extra option to FUSE\n"
@@ -167,6 +168,7 @@ main (int argc, char *argv[])
     { "live", 0, 0, 0 },
     { "long-options", 0, 0, 0 },
     { "mount", 1, 0, 'm' },
+    { "multithreaded", 0, 0, 0 },
     { "no-fork", 0, 0, 0 },
     { "no-sync", 0, 0, 'n' },
     { "option", 1, 0, 'o' },
@@ -194,6 +196,7 @@ main (int argc, char *argv[])
   int debug_calls = 0;
   int dir_cache_timeout = -1;
   int do_fork = 1;
+  int multithreaded = 0;
   char *fuse_options = NULL;
   char *pid_file = NULL;
   int pipe_fd = -1;
@@ -240,6 +243,8 @@ main (int argc, char *argv[])
         pid_file = optarg;
       } else if (STREQ (long_options[option_index].name, "no-fork")) {
         do_fork = 0;
+      } else if (STREQ (long_options[option_index].name, "multithreaded")) {
+        multithreaded = 1;
       } else if (STREQ (long_options[option_index].name, "fd")) {
         if (sscanf (optarg, "%d", &pipe_fd) != 1 || pipe_fd < 0)
           error (EXIT_FAILURE, 0,
@@ -381,6 +386,10 @@ main (int argc, char *argv[])
     optargs.bitmask |= GUESTFS_MOUNT_LOCAL_DEBUGCALLS_BITMASK;
     optargs.debugcalls = 1;
   }
+  if (multithreaded) {
+    optargs.bitmask |= GUESTFS_MOUNT_LOCAL_MULTITHREADED_BITMASK;
+    optargs.multithreaded = 1;
+  }
   if (dir_cache_timeout > 0) {
     optargs.bitmask |= GUESTFS_MOUNT_LOCAL_CACHETIMEOUT_BITMASK;
     optargs.cachetimeout = dir_cache_timeout;
@@ -0,0 +1,269 @@
+/* Test FUSE in multithreaded mode.
+ * Copyright (C) 2016 Red Hat Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Several threads keep reading, stat-ing and listing a file through
+ * the mountpoint, while another thread overwrites it.  After each
+ * write has returned, the new content and size must be visible
+ * straight away, ie. none of the reads which raced with the write
+ * may have left the old data in the read-ahead buffer or in the
+ * directory caches.
+ *
+ * The filesystem is mounted with direct_io and without attribute
+ * caching in the kernel, so that all reads reach the caches in
+ * src/fuse.c.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <error.h>
+#include <pthread.h>
+
+#include <guestfs.h>
+#include "guestfs-internal-frontend.h"
+
+#include "ignore-value.h"
+
+#define SIZE INT64_C(256*1024*1024)
+
+#define NR_READERS 4
+#define NR_WRITES 200
+#define MAX_FILE_SIZE (64 * 1024 + NR_WRITES)
+
+/* NB: Must be a path that does not need quoting. */
+static char mountpoint[] = "/tmp/testfusemtXXXXXX";
+
+static int fd_r;                /* Shared by all the threads. */
+static volatile int stop;
+
+static int test_fuse_multithreaded (void);
+static void *reader_thread (void *arg);
+
+int
+main (int argc, char *argv[])
+{
+  const char *s;
+  guestfs_h *g;
+  int r, res;
+  pid_t pid;
+  struct sigaction sa;
+  char cmd[128];
+
+  s = getenv ("SKIP_TEST_FUSE_MULTITHREADED");
+  if (s && STRNEQ (s, "")) {
+    printf ("%s: test skipped because environment variable is set\n",
+            argv[0]);
+    exit (77);
+  }
+
+  if (access ("/dev/fuse", W_OK) == -1)
+    error (77, errno, "access: /dev/fuse");
+
+  g = guestfs_create ();
+  if (g == NULL)
+    error (EXIT_FAILURE, errno, "guestfs_create");
+
+  if (guestfs_add_drive_scratch (g, SIZE, -1) == -1)
+    exit (EXIT_FAILURE);
+
+  if (guestfs_launch (g) == -1)
+    exit (EXIT_FAILURE);
+
+  if (guestfs_part_disk (g, "/dev/sda", "mbr") == -1)
+    exit (EXIT_FAILURE);
+  if (guestfs_mkfs (g, "ext4", "/dev/sda1") == -1)
+    exit (EXIT_FAILURE);
+  if (guestfs_mount (g, "/dev/sda1", "/") == -1)
+    exit (EXIT_FAILURE);
+  if (guestfs_touch (g, "/file") == -1)
+    exit (EXIT_FAILURE);
+
+  if (mkdtemp (mountpoint) == NULL)
+    error (EXIT_FAILURE, errno, "mkdtemp");
+
+  if (guestfs_mount_local (g, mountpoint,
+                           GUESTFS_MOUNT_LOCAL_MULTITHREADED, 1,
+                           GUESTFS_MOUNT_LOCAL_OPTIONS,
+                           "direct_io,attr_timeout=0,entry_timeout=0",
+                           -1) == -1)
+    exit (EXIT_FAILURE);
+
+  pid = fork ();
+  if (pid == -1)
+    error (EXIT_FAILURE, errno, "fork");
+
+  if (pid == 0) {               /* Child. */
+    if (chdir (mountpoint) == -1) {
+      perror (mountpoint);
+      _exit (EXIT_FAILURE);
+    }
+
+    res = test_fuse_multithreaded ();
+    printf ("test_fuse_multithreaded() returned %d\n", res);
+    fflush (stdout);
+
+    ignore_value (chdir ("/"));
+
+    snprintf (cmd, sizeof cmd, "guestunmount %s", mountpoint);
+    r = system (cmd);
+    if (!WIFEXITED (r) || WEXITSTATUS (r) != EXIT_SUCCESS)
+      fprintf (stderr, "%s: warning: guestunmount command failed\n", argv[0]);
+
+    _exit (res == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+
+  /* Parent. */
+  memset (&sa, 0, sizeof sa);
+  sa.sa_handler = SIG_IGN;
+  sigaction (SIGINT, &sa, NULL);
+  sigaction (SIGTERM, &sa, NULL);
+
+  if (guestfs_mount_local_run (g) == -1)
+    exit (EXIT_FAILURE);
+
+  if (waitpid (pid, &r, 0) == -1)
+    error (EXIT_FAILURE, errno, "waitpid");
+
+  if (rmdir (mountpoint) == -1)
+    error (EXIT_FAILURE, errno, "rmdir: %s", mountpoint);
+
+  if (guestfs_shutdown (g) == -1)
+    exit (EXIT_FAILURE);
+
+  guestfs_close (g);
+
+  exit (!WIFEXITED (r) || WEXITSTATUS (r) != 0 ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+/* Run the test.  Mountpoint is current directory. */
+static int
+test_fuse_multithreaded (void)
+{
+  pthread_t readers[NR_READERS];
+  static char wbuf[MAX_FILE_SIZE], rbuf[MAX_FILE_SIZE + 1];
+  struct stat statbuf;
+  size_t i, j, size;
+  ssize_t n;
+  int fd_w, err, ret = -1;
+
+  fd_w = open ("file", O_WRONLY|O_CLOEXEC);
+  if (fd_w == -1) {
+    perror ("open: file");
+    return -1;
+  }
+  fd_r = open ("file", O_RDONLY|O_CLOEXEC);
+  if (fd_r == -1) {
+    perror ("open: file");
+    close (fd_w);
+    return -1;
+  }
+
+  for (i = 0; i < NR_READERS; ++i) {
+    err = pthread_create (&readers[i], NULL, reader_thread, NULL);
+    if (err != 0)
+      error (EXIT_FAILURE, err, "pthread_create");
+  }
+
+  for (i = 1; i <= NR_WRITES; ++i) {
+    /* The file grows by one byte each time, so the size shows whether
+     * stat saw the latest write too.
+     */
+    size = MAX_FILE_SIZE - NR_WRITES + i;
+    memset (wbuf, 'a' + i % 26, size);
+
+    n = pwrite (fd_w, wbuf, size, 0);
+    if (n != (ssize_t) size) {
+      perror ("pwrite: file");
+      goto out;
+    }
+
+    n = pread (fd_r, rbuf, sizeof rbuf, 0);
+    if (n == -1) {
+      perror ("pread: file");
+      goto out;
+    }
+    if (n != (ssize_t) size) {
+      fprintf (stderr, "write %zu: read %zd bytes, expected %zu\n",
+               i, n, size);
+      goto out;
+    }
+    for (j = 0; j < size; ++j) {
+      if (rbuf[j] != wbuf[j]) {
+        fprintf (stderr, "write %zu: read old data at offset %zu\n", i, j);
+        goto out;
+      }
+    }
+
+    if (stat ("file", &statbuf) == -1) {
+      perror ("stat: file");
+      goto out;
+    }
+    if (statbuf.st_size != (off_t) size) {
+      fprintf (stderr, "write %zu: stat returned size %jd, expected %zu\n",
+               i, (intmax_t) statbuf.st_size, size);
+      goto out;
+    }
+  }
+
+  ret = 0;
+
+ out:
+  stop = 1;
+  for (i = 0; i < NR_READERS; ++i)
+    ignore_value (pthread_join (readers[i], NULL));
+
+  close (fd_r);
+  close (fd_w);
+
+  return ret;
+}
+
+/* Keep filling the read-ahead buffer of fd_r and the directory
+ * caches until the writer has finished.
+ */
+static void *
+reader_thread (void *arg)
+{
+  char buf[4096];
+  struct stat statbuf;
+  DIR *dir;
+
+  while (!stop) {
+    ignore_value (pread (fd_r, buf, sizeof buf, 0));
+    ignore_value (stat ("file", &statbuf));
+
+    dir = opendir (".");
+    if (dir != NULL) {
+      while (readdir (dir) != NULL)
+        ;
+      closedir (dir);
+    }
+  }
+
+  return NULL;
+}
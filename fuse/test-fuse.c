@@ -250,6 +250,8 @@ test_fuse (void)
   int fd;
   struct timeval tv[2];
   struct timespec ts[2];
+#define NR_OTHER_FDS 100
+  int other_fds[NR_OTHER_FDS];
 #ifdef HAVE_ACL
   acl_t acl;
   char *acl_text;
@@ -653,6 +655,59 @@ test_fuse (void)
   }
   fclose (fp);
 
+  STAGE ("checking reads from an unlinked file");
+
+  fp = fopen ("unlinked.txt", "w");
+  if (fp == NULL) {
+    perror ("open: unlinked.txt");
+    return -1;
+  }
+  fputs ("unlinked", fp);
+  if (fclose (fp) == -1) {
+    perror ("fclose: unlinked.txt");
+    return -1;
+  }
+
+  fd = open ("unlinked.txt", O_RDONLY);
+  if (fd == -1) {
+    perror ("open: unlinked.txt");
+    return -1;
+  }
+  if (unlink ("unlinked.txt") == -1) {
+    perror ("unlink: unlinked.txt");
+    close (fd);
+    return -1;
+  }
+
+  /* Open lots of other files, so that the daemon would have to give
+   * up the file descriptor of unlinked.txt if it did not keep it open
+   * for as long as the file is open here.
+   */
+  for (u = 0; u < NR_OTHER_FDS; ++u) {
+    other_fds[u] = open ("world.txt", O_RDONLY);
+    if (other_fds[u] == -1) {
+      perror ("open: world.txt");
+      while (u > 0)
+        close (other_fds[--u]);
+      close (fd);
+      return -1;
+    }
+  }
+
+  r = pread (fd, buf, sizeof buf, 0);
+  for (u = 0; u < NR_OTHER_FDS; ++u)
+    close (other_fds[u]);
+  if (r == -1) {
+    perror ("pread: unlinked.txt");
+    close (fd);
+    return -1;
+  }
+  close (fd);
+  if (r != 8 || memcmp (buf, "unlinked", r) != 0) {
+    fprintf (stderr, "unexpected content read from unlinked file\n");
+    return -1;
+  }
+
 #ifdef HAVE_ACL
   if (acl_available) {
     STAGE ("checking POSIX ACL read operation");
@@ -30,7 +30,8 @@ let defaults = { name = "";
                  style = RErr, [], []; proc_nr = None;
                  tests = []; test_excuse = "";
                  shortdesc = ""; longdesc = "";
-                 protocol_limit_warning = false; fish_alias = [];
+                 protocol_limit_warning = false; stream_reply = false;
+                 fish_alias = [];
                  fish_output = None; visibility = VPublic;
                  deprecated_by = None; optional = None;
                  progress = false; camel_name = "";
@@ -2414,7 +2415,7 @@ This returns the number of virtual CPUs assigned to the appliance." };
 
   { defaults with
     name = "mount_local"; added = (1, 17, 22);
-    style = RErr, [String "localmountpoint"], [OBool "readonly"; OString "options"; OInt "cachetimeout"; OBool "debugcalls"];
+    style = RErr, [String "localmountpoint"], [OBool "readonly"; OString "options"; OInt "cachetimeout"; OBool "debugcalls"; OBool "multithreaded"];
     shortdesc = "mount on the local filesystem";
     longdesc = "\
 This call exports the libguestfs-accessible filesystem to
@@ -2433,7 +2434,16 @@ entries.  The default is 60 seconds.  See L<guestmount(1)>
 for further information.
 
 If C<debugcalls> is set to true, then additional debugging
-information is generated for every FUSE call.
+information is generated for every FUSE call.  For reads this
+includes whether the data came from the read-ahead buffer of the
+file, and the running count of read-ahead hits and misses.
+
+If C<multithreaded> is set to true, then C<guestfs_mount_local_run>
+uses the multithreaded FUSE main loop, so that requests which can be
+answered from the caches are not delayed by slow requests in other
+threads.  Lookups which miss the caches are sent to the appliance
+without waiting for the replies to lookups made by other threads,
+although the appliance still processes them one at a time.
 
 When C<guestfs_mount_local> returns, the filesystem is ready,
 but is not processing requests (access to it will block).  You
@@ -3480,6 +3490,44 @@ C<guestfs_get_identifier>." };
     longdesc = "\
 Get the handle identifier.  See C<guestfs_set_identifier>." };
 
+  { defaults with
+    name = "set_inspect_cache"; added = (1, 35, 20);
+    style = RErr, [Bool "inspectcache"], [];
+    fish_alias = ["inspect-cache"];
+    blocking = false;
+    shortdesc = "cache inspection results on disk";
+    longdesc = "\
+If C<inspectcache> is true, then the results of C<guestfs_inspect_os>
+are saved in the cache directory (see C<guestfs_set_cachedir>), and
+reused by later calls to C<guestfs_inspect_os> on the same disks,
+even from another handle or process.  This avoids mounting and
+examining every filesystem when the same unchanged disk images are
+inspected repeatedly.
+
+Cached results are only used if every disk is a local file with the
+same device, inode number, size and modification time as before, and
+the list of filesystems, their types and their UUIDs are unchanged.
+Disks accessed over the network are never cached.
+
+Note that changes to the backing file of a disk image (eg. a qcow2
+overlay) are only detected if they change the filesystem UUIDs.  Do
+not enable this if backing files may be modified in place.
+
+Only the results of C<guestfs_inspect_os> (and so all the
+C<guestfs_inspect_get_*> calls) are cached.  The default is false." };
+
+  { defaults with
+    name = "get_inspect_cache"; added = (1, 35, 20);
+    style = RBool "inspectcache", [], [];
+    blocking = false;
+    tests = [
+      InitNone, Always, TestResultFalse (
+        [["get_inspect_cache"]]), []
+    ];
+    shortdesc = "get the inspection cache flag";
+    longdesc = "\
+Return the inspection cache flag.  See C<guestfs_set_inspect_cache>." };
+
   { defaults with
     name = "available"; added = (1, 0, 80);
     style = RErr, [StringList "groups"], [];
@@ -3742,6 +3790,51 @@ Searches all the entries associated with the given inode.
 For each entry, a C<tsk_dirent> structure is returned.
 See C<filesystem_walk> for more information about C<tsk_dirent> structures." };
 
+  { defaults with
+    name = "walk"; added = (1, 35, 20);
+    style = RStructList ("entries", "walk_entry"), [Pathname "directory"], [];
+    cancellable = true;
+    tests = [
+      InitScratchFS, Always, TestResult (
+        [["mkdir_p"; "/walk/b/c"];
+         ["touch"; "/walk/a"];
+         ["touch"; "/walk/b/c/d"];
+         ["walk"; "/walk"]],
+        "ret->len == 5 && "^
+          "STREQ (ret->val[0].we_name, \"\") && "^
+          "STREQ (ret->val[1].we_name, \"a\") && "^
+          "STREQ (ret->val[2].we_name, \"b\") && "^
+          "STREQ (ret->val[3].we_name, \"b/c\") && "^
+          "STREQ (ret->val[4].we_name, \"b/c/d\")"), []
+    ];
+    shortdesc = "list all files and directories with their attributes";
+    longdesc = "\
+This walks the directory tree starting at F<directory>, and returns
+every file and directory in it along with its status and extended
+attributes.  Symbolic links are not followed.
+
+The whole tree is returned by a single call, so this is much faster
+than calling C<guestfs_ls>, C<guestfs_lstatnslist> and
+C<guestfs_lxattrlist> on each directory in turn.
+
+The first entry describes F<directory> itself, and has an empty
+C<we_name>.  The following entries are in depth-first order:
+each directory is followed by its contents, and the contents of
+each directory are sorted by name.  C<we_name> is the path of the
+entry relative to F<directory> (as in C<guestfs_find>).
+
+The C<we_dev> to C<we_ctime_nsec> fields are the same as the fields
+of the C<guestfs_statns> structure returned by C<guestfs_lstatns>.
+If the entry is a symbolic link, C<we_link> contains the target
+of the link, otherwise it is empty.
+
+Extended attributes are returned as additional entries: after each
+file or directory there are zero or more entries with a non-empty
+C<we_attrname>, one for each extended attribute of the file, with
+the value in C<we_attrval>.  In these entries the other fields are
+not used.  Entries describing files always have an empty
+C<we_attrname>." };
+
 ]
 
 (* daemon_functions are any functions which cause some action
@@ -5831,7 +5924,7 @@ The external L<cmp(1)> program is used for the comparison." };
     name = "strings"; added = (1, 0, 22);
     style = RStringList "stringsout", [Pathname "path"], [];
     proc_nr = Some 94;
-    protocol_limit_warning = true;
+    stream_reply = true;
     tests = [
       InitISOFS, Always, TestResult (
         [["strings"; "/known-5"]],
@@ -5856,7 +5949,7 @@ version of libguestfs, but see L<guestfs(3)/CVE-2014-8484>." };
     name = "strings_e"; added = (1, 0, 22);
     style = RStringList "stringsout", [String "encoding"; Pathname "path"], [];
     proc_nr = Some 95;
-    protocol_limit_warning = true;
+    stream_reply = true;
     tests = [
       InitISOFS, Always, TestResult (
         [["strings_e"; "b"; "/known-5"]],
@@ -6744,7 +6837,7 @@ This call returns the previous umask." };
     name = "readdir"; added = (1, 0, 55);
     style = RStructList ("entries", "dirent"), [Pathname "dir"], [];
     proc_nr = Some 138;
-    protocol_limit_warning = true;
+    stream_reply = true;
     shortdesc = "read directories entries";
     longdesc = "\
 This returns the list of directory entries in directory C<dir>.
@@ -6983,7 +7076,7 @@ for full details." };
     name = "grep"; added = (1, 0, 66);
     style = RStringList "lines", [String "regex"; Pathname "path"], [OBool "extended"; OBool "fixed"; OBool "insensitive"; OBool "compressed"];
     proc_nr = Some 151;
-    protocol_limit_warning = true; once_had_no_optargs = true;
+    stream_reply = true; once_had_no_optargs = true;
     tests = [
       InitISOFS, Always, TestResult (
         [["grep"; "abc"; "/test-grep.txt"; ""; ""; ""; ""]],
@@ -8307,7 +8400,32 @@ table.  This works on C<gpt> but not on C<mbr> partitions." };
     name = "part_list"; added = (1, 0, 78);
     style = RStructList ("partitions", "partition"), [Device "device"], [];
     proc_nr = Some 213;
-    tests = [] (* XXX Add a regression test for this. *);
+    tests = [
+      InitEmpty, Always, TestResult (
+        [["part_init"; "/dev/sda"; "mbr"];
+         ["part_add"; "/dev/sda"; "p"; "64"; "204799"];
+         ["part_add"; "/dev/sda"; "e"; "204800"; "614400"];
+         ["part_add"; "/dev/sda"; "l"; "204864"; "205988"];
+         ["part_list"; "/dev/sda"]],
+        "ret->len == 3 && "^
+          "ret->val[0].part_num == 1 && "^
+          "ret->val[0].part_start == 32768 && "^
+          "ret->val[0].part_end == 104857599 && "^
+          "ret->val[1].part_num == 2 && "^
+          "ret->val[2].part_num == 5 && "^
+          "ret->val[2].part_start == 104890368 && "^
+          "ret->val[2].part_size == 576000"), [];
+      InitEmpty, Always, TestResult (
+        [["part_init"; "/dev/sda"; "gpt"];
+         ["part_add"; "/dev/sda"; "p"; "64"; "204799"];
+         ["part_list"; "/dev/sda"];
+         ["part_add"; "/dev/sda"; "p"; "204800"; "409599"];
+         ["part_list"; "/dev/sda"]],
+        "ret->len == 2 && "^
+          "ret->val[1].part_num == 2 && "^
+          "ret->val[1].part_start == 104857600 && "^
+          "ret->val[1].part_size == 104857600"), []
+    ];
     shortdesc = "list partitions on a device";
     longdesc = "\
 This command parses the partition table on C<device> and
@@ -10754,6 +10872,7 @@ created subvolume will be added to." };
     style = RStructList ("subvolumes", "btrfssubvolume"), [Mountable_or_Path "fs"], [];
     proc_nr = Some 325;
     optional = Some "btrfs"; camel_name = "BTRFSSubvolumeList";
+    stream_reply = true;
     test_excuse = "tested in tests/btrfs";
     shortdesc = "list btrfs snapshots and subvolumes";
     longdesc = "\
@@ -13266,6 +13385,217 @@ is removed." };
     shortdesc = "search the entries associated to the given inode";
     longdesc = "Internal function for find_inode." };
 
+  { defaults with
+    name = "internal_set_chunk_size"; added = (1, 35, 20);
+    style = RInt "size", [Int "size"], [];
+    proc_nr = Some 471;
+    visibility = VInternal;
+    shortdesc = "negotiate the size of FileIn and FileOut chunks";
+    longdesc = "\
+This is called by the library after launch to ask the daemon
+to use chunks of up to C<size> bytes for FileIn and FileOut
+transfers.  The daemon clamps C<size> to the range it supports
+and returns the chunk size it will actually use, which the
+library then uses too.
+
+If the daemon does not support this call, both sides
+continue to use the default chunk size." };
+
+  { defaults with
+    name = "internal_walk"; added = (1, 35, 20);
+    style = RErr, [Pathname "directory"; FileOut "filename"], [];
+    proc_nr = Some 472;
+    visibility = VInternal;
+    shortdesc = "walk a directory tree";
+    longdesc = "Internal function for walk." };
+
+  { defaults with
+    name = "internal_file_open"; added = (1, 35, 20);
+    style = RInt "handle", [Pathname "path"; Bool "write"], [];
+    proc_nr = Some 473;
+    visibility = VInternal;
+    shortdesc = "open a file and return a handle";
+    longdesc = "\
+Open the file C<path> for reading (or for reading and writing if
+C<write> is true), and return a handle which can be passed to
+C<guestfs_internal_file_pread>, C<guestfs_internal_file_pwrite>
+and C<guestfs_internal_file_close>.
+
+The file stays open until the handle is closed, so the handle still
+refers to the same file if it is renamed or unlinked.  Only a limited
+number of handles can be open at the same time, after which this
+fails with C<EMFILE>.  This is used by C<guestfs_mount_local>." };
+
+  { defaults with
+    name = "internal_file_pread"; added = (1, 35, 20);
+    style = RBufferOut "content", [Int "handle"; Int "count"; Int64 "offset"], [];
+    proc_nr = Some 474;
+    visibility = VInternal;
+    shortdesc = "read part of a file by handle";
+    longdesc = "\
+This is the same as C<guestfs_pread>, but reads from a handle
+returned by C<guestfs_internal_file_open>." };
+
+  { defaults with
+    name = "internal_file_pwrite"; added = (1, 35, 20);
+    style = RInt "nbytes", [Int "handle"; BufferIn "content"; Int64 "offset"], [];
+    proc_nr = Some 475;
+    visibility = VInternal;
+    shortdesc = "write to part of a file by handle";
+    longdesc = "\
+This is the same as C<guestfs_pwrite>, but writes to a handle
+returned by C<guestfs_internal_file_open>." };
+
+  { defaults with
+    name = "internal_file_close"; added = (1, 35, 20);
+    style = RErr, [Int "handle"], [];
+    proc_nr = Some 476;
+    visibility = VInternal;
+    shortdesc = "close a file handle";
+    longdesc = "\
+Close a handle returned by C<guestfs_internal_file_open>." };
+
+  { defaults with
+    name = "journal_export"; added = (1, 35, 20);
+    style = RErr, [FileOut "filename"], [OInt64 "since"; OInt64 "until"; OStringList "matches"; OStringList "fields"];
+    proc_nr = Some 477;
+    optional = Some "journal";
+    test_excuse = "tests in tests/journal subdirectory";
+    shortdesc = "export journal entries to a local file";
+    longdesc = "\
+Export journal entries from the journal handle opened by
+C<guestfs_journal_open>, and write them to the local file
+C<filename>.  This is much faster than calling
+C<guestfs_journal_next> and C<guestfs_journal_get> for each
+entry, since all the entries are read in a single call.
+
+The optional C<since> and C<until> parameters are timestamps
+in microseconds since the epoch (see
+C<guestfs_journal_get_realtime_usec>).  Only entries with a
+timestamp E<ge> C<since> and E<lt> C<until> are exported.
+
+The optional C<matches> parameter is a list of C<FIELD=value>
+strings.  If given, only matching entries are exported.  As in
+L<journalctl(1)>, entries must match all the fields given, and if
+the same field is given several times then any of the values
+may match.
+
+The optional C<fields> parameter is a list of field names.  If
+given, only these fields of each entry are exported.
+
+The output file contains the entries one after another.  Each
+entry is a big-endian 64 bit timestamp (as above), a big-endian
+64 bit count of fields, and then each field as a big-endian 64 bit
+length followed by that many bytes of C<FIELD=data>.  Note that the
+data is not C<\\0>-terminated and may be binary.
+
+Fields may be truncated to the data threshold (see
+C<guestfs_journal_set_data_threshold>).
+
+This call moves the current position of the journal handle, and
+clears any matches." };
+
+  { defaults with
+    name = "internal_hivex_export"; added = (1, 35, 20);
+    style = RErr, [Int64 "nodeh"; Int "maxdepth"; FileOut "filename"], [];
+    proc_nr = Some 478;
+    visibility = VInternal;
+    optional = Some "hivex";
+    shortdesc = "export a registry subtree";
+    longdesc = "\
+Serialize the node C<nodeh> of the hive opened by
+C<guestfs_hivex_open>, with all its values, and its children
+down to C<maxdepth> levels (C<-1> means no limit), and write the
+result to C<filename>.  This is used by the library so that
+inspection can read a registry subtree in a single call." };
+
+  { defaults with
+    name = "internal_part_list_table"; added = (1, 35, 20);
+    style = RStructList ("partitions", "internal_partition"), [Device "device"], [];
+    proc_nr = Some 479;
+    visibility = VInternal;
+    shortdesc = "list partitions and their types";
+    longdesc = "\
+This returns the partitions on C<device>, like C<guestfs_part_list>,
+together with the MBR partition type byte (C<ip_mbr_id>, or C<-1>
+if C<device> does not have an MBR partition table), the MBR
+partition type (C<primary>, C<extended> or C<logical>), and the GPT
+partition type and unique GUIDs (empty strings if C<device> does not
+have a GPT).  This is used by the library to read a whole partition
+table in a single call." };
+
+  { defaults with
+    name = "internal_probe_devices"; added = (1, 35, 20);
+    style = RStructList ("probes", "internal_probe"), [DeviceList "devices"], [];
+    proc_nr = Some 480;
+    visibility = VInternal;
+    shortdesc = "probe devices for filesystems";
+    longdesc = "\
+Probe each of C<devices> using libblkid, and return a list (in the
+same order as C<devices>) of the filesystem type, label and UUID,
+the partition UUID and the size in bytes of each device.  Fields
+which cannot be determined are returned as empty strings (or C<-1>
+for the size): the call does not fail if a device cannot be probed.
+
+This is used by C<guestfs_list_filesystems> to probe all devices
+in a single call, instead of calling C<guestfs_vfs_type> for each
+one." };
+
+  { defaults with
+    name = "internal_stat_paths"; added = (1, 35, 20);
+    style = RStructList ("statbufs", "statns"), [StringList "paths"], [];
+    proc_nr = Some 481;
+    visibility = VInternal;
+    tests = [
+      InitISOFS, Always, TestResult (
+        [["internal_stat_paths"; "/empty /abssymlink /directory /nonexistent"]],
+        "ret->len == 4 && "^
+          "S_ISREG (ret->val[0].st_mode) && "^
+          "ret->val[0].st_size == 0 && "^
+          "S_ISLNK (ret->val[1].st_mode) && "^
+          "S_ISDIR (ret->val[2].st_mode) && "^
+          "ret->val[3].st_ino == -1"), []
+    ];
+    shortdesc = "get file information for a list of paths";
+    longdesc = "\
+For each of the absolute C<paths>, return the result of L<lstat(2)>
+on the path as a C<statns> entry.  If the call fails for a path,
+because it does not exist or for any other reason, the corresponding
+entry has C<st_ino> set to C<-1>.
+
+This is used by inspection to check for the existence and type of
+many files in a single call, instead of calling C<guestfs_is_file>
+and C<guestfs_is_dir> for each one." };
+
+  { defaults with
+    name = "internal_mount_ro_list"; added = (1, 35, 20);
+    style = RStringList "errors", [DeviceList "devices"; StringList "mountpoints"], [];
+    proc_nr = Some 482;
+    visibility = VInternal;
+    tests = [
+      InitEmpty, Always, TestResult (
+        [["part_init"; "/dev/sda"; "mbr"];
+         ["part_add"; "/dev/sda"; "p"; "64"; "204799"];
+         ["part_add"; "/dev/sda"; "p"; "204800"; "409599"];
+         ["mkfs"; "ext2"; "/dev/sda1"; ""; "NOARG"; ""; ""; "NOARG"];
+         ["internal_mount_ro_list"; "/dev/sda1 /dev/sda2"; "/mp1 /mp2"]],
+        "ret[0] != NULL && STREQ (ret[0], \"\") && "^
+          "ret[1] != NULL && STRNEQ (ret[1], \"\") && "^
+          "ret[2] == NULL"), []
+    ];
+    shortdesc = "mount several devices read-only at the same time";
+    longdesc = "\
+Mount each of C<devices> read-only on the corresponding entry of
+C<mountpoints>.  The mountpoints are created if they don't exist,
+as with C<guestfs_mkmountpoint>.  Several devices are mounted in
+parallel.
+
+This returns a list with one entry for each device: an empty string
+if the device was mounted, or else the error message.
+
+This is used by inspection to mount all the filesystems it examines
+at once." };
+
 ]
 
 (* Non-API meta-commands available only in guestfish.
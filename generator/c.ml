@@ -1781,7 +1781,8 @@ and generate_client_actions actions () =
 
   (* Client-side stubs for each function. *)
   let generate_daemon_stub { name = name; c_name = c_name;
-                             style = ret, args, optargs as style } =
+                             style = ret, args, optargs as style;
+                             stream_reply = stream_reply } =
     let errcode =
       match errcode_of_ret ret with
       | `CannotReturnError -> assert false
@@ -1978,7 +1979,7 @@ and generate_client_actions actions () =
     if has_ret then pr "  memset (&ret, 0, sizeof ret);\n";
     pr "\n";
     pr "  r = guestfs_int_recv (g, \"%s\", &hdr, &err,\n        " name;
-    if not has_ret then
+    if not has_ret || stream_reply then
       pr "NULL, NULL"
     else
       pr "(xdrproc_t) xdr_guestfs_%s_ret, (char *) &ret" name;
@@ -2016,6 +2017,17 @@ and generate_client_actions actions () =
     pr "  }\n";
     pr "\n";
 
+    (* The return value of a streamed reply follows the reply. *)
+    if stream_reply then (
+      pr "  if (guestfs_int_recv_stream (g, \"%s\",\n" name;
+      pr "        (xdrproc_t) xdr_guestfs_%s_ret, (char *) &ret) == -1) {\n"
+        name;
+      trace_return_error ~indent:4 name style errcode;
+      pr "    return %s;\n" (string_of_errcode errcode);
+      pr "  }\n";
+      pr "\n"
+    );
+
     (* Expecting to receive further files (FileOut)? *)
     List.iter (
       function
@@ -239,6 +239,29 @@ let () =
     | { blocking = true } -> ()
   ) (actions |> daemon_functions);
 
+  (* Check stream_reply is only used where it makes sense. *)
+  List.iter (
+    function
+    | { name = name; stream_reply = true; proc_nr = None } ->
+      failwithf "%s: stream_reply can only be used on daemon functions" name
+    | { name = name; stream_reply = true;
+        style = ret, args, _; protocol_limit_warning = plw } ->
+      (match ret with
+       | RStringList _ | RHashtable _ | RStructList _ -> ()
+       | _ ->
+         failwithf "%s: stream_reply can only be used on functions returning lists"
+           name
+      );
+      if List.exists (function FileIn _ | FileOut _ -> true | _ -> false) args
+      then
+        failwithf "%s: stream_reply cannot be used with FileIn or FileOut parameters"
+          name;
+      if plw then
+        failwithf "%s: stream_reply functions are not subject to the protocol limit, remove protocol_limit_warning"
+          name
+    | { stream_reply = false } -> ()
+  ) actions;
+
   (* Check wrapper flag is set on all daemon functions. *)
   List.iter (
     function
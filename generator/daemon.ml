@@ -223,7 +223,8 @@ let generate_daemon_stubs actions () =
 ";
 
   List.iter (
-    fun { name = name; style = ret, args, optargs; optional = optional } ->
+    fun { name = name; style = ret, args, optargs; optional = optional;
+          stream_reply = stream_reply } ->
       (* Generate server-side stubs. *)
       pr "void\n";
       pr "%s_stub (XDR *xdr_in)\n" name;
@@ -451,50 +452,51 @@ let generate_daemon_stubs actions () =
       if no_reply then
         pr "  /* do_%s has already sent a reply */\n" name
       else (
+        let reply = if stream_reply then "reply_stream" else "reply" in
         match ret with
         | RErr -> pr "  reply (NULL, NULL);\n"
         | RInt n | RInt64 n | RBool n ->
             pr "  struct guestfs_%s_ret ret;\n" name;
             pr "  ret.%s = r;\n" n;
-            pr "  reply ((xdrproc_t) &xdr_guestfs_%s_ret, (char *) &ret);\n"
-              name
+            pr "  %s ((xdrproc_t) &xdr_guestfs_%s_ret, (char *) &ret);\n"
+              reply name
         | RConstString _ | RConstOptString _ ->
             failwithf "RConstString|RConstOptString cannot be used by daemon functions"
         | RString n ->
             pr "  struct guestfs_%s_ret ret;\n" name;
             pr "  ret.%s = r;\n" n;
-            pr "  reply ((xdrproc_t) &xdr_guestfs_%s_ret, (char *) &ret);\n"
-              name;
+            pr "  %s ((xdrproc_t) &xdr_guestfs_%s_ret, (char *) &ret);\n"
+              reply name;
             pr "  free (r);\n"
         | RStringList n | RHashtable n ->
             pr "  struct guestfs_%s_ret ret;\n" name;
             pr "  ret.%s.%s_len = count_strings (r);\n" n n;
             pr "  ret.%s.%s_val = r;\n" n n;
-            pr "  reply ((xdrproc_t) &xdr_guestfs_%s_ret, (char *) &ret);\n"
-              name;
+            pr "  %s ((xdrproc_t) &xdr_guestfs_%s_ret, (char *) &ret);\n"
+              reply name;
             pr "  free_strings (r);\n"
         | RStruct (n, _) ->
             pr "  struct guestfs_%s_ret ret;\n" name;
             pr "  ret.%s = *r;\n" n;
             pr "  free (r);\n";
-            pr "  reply ((xdrproc_t) xdr_guestfs_%s_ret, (char *) &ret);\n"
-              name;
+            pr "  %s ((xdrproc_t) xdr_guestfs_%s_ret, (char *) &ret);\n"
+              reply name;
             pr "  xdr_free ((xdrproc_t) xdr_guestfs_%s_ret, (char *) &ret);\n"
               name
         | RStructList (n, _) ->
             pr "  struct guestfs_%s_ret ret;\n" name;
             pr "  ret.%s = *r;\n" n;
             pr "  free (r);\n";
-            pr "  reply ((xdrproc_t) xdr_guestfs_%s_ret, (char *) &ret);\n"
-              name;
+            pr "  %s ((xdrproc_t) xdr_guestfs_%s_ret, (char *) &ret);\n"
+              reply name;
             pr "  xdr_free ((xdrproc_t) xdr_guestfs_%s_ret, (char *) &ret);\n"
               name
         | RBufferOut n ->
             pr "  struct guestfs_%s_ret ret;\n" name;
             pr "  ret.%s.%s_val = r;\n" n n;
             pr "  ret.%s.%s_len = size;\n" n n;
-            pr "  reply ((xdrproc_t) &xdr_guestfs_%s_ret, (char *) &ret);\n"
-              name;
+            pr "  %s ((xdrproc_t) &xdr_guestfs_%s_ret, (char *) &ret);\n"
+              reply name;
             pr "  free (r);\n"
       );
 
@@ -445,6 +445,38 @@ let structs = [
     s_camel_name = "InternalMountable";
   };
 
+  (* Partition table entry, see guestfs_internal_part_list_table. *)
+  { defaults with
+    s_name = "internal_partition";
+    s_internal = true;
+    s_cols = [
+    "ip_num", FInt32;
+    "ip_start", FBytes;
+    "ip_end", FBytes;
+    "ip_size", FBytes;
+    "ip_mbr_id", FInt32;
+    "ip_mbr_part_type", FString;
+    "ip_gpt_type", FString;
+    "ip_gpt_guid", FString;
+    ];
+    s_camel_name = "InternalPartition";
+  };
+
+  (* Filesystem probe, see guestfs_internal_probe_devices. *)
+  { defaults with
+    s_name = "internal_probe";
+    s_internal = true;
+    s_cols = [
+    "ipr_device", FString;
+    "ipr_type", FString;
+    "ipr_label", FString;
+    "ipr_uuid", FString;
+    "ipr_partuuid", FString;
+    "ipr_size", FInt64;
+    ];
+    s_camel_name = "InternalProbe";
+  };
+
   (* The Sleuth Kit directory entry information. *)
   { defaults with
     s_name = "tsk_dirent";
@@ -468,6 +500,33 @@ let structs = [
     ];
     s_camel_name = "TSKDirent" };
 
+  (* Entry returned by the walk call. *)
+  { defaults with
+    s_name = "walk_entry";
+    s_cols = [
+    "we_name", FString;
+    "we_dev", FInt64;
+    "we_ino", FInt64;
+    "we_mode", FInt64;
+    "we_nlink", FInt64;
+    "we_uid", FInt64;
+    "we_gid", FInt64;
+    "we_rdev", FInt64;
+    "we_size", FInt64;
+    "we_blksize", FInt64;
+    "we_blocks", FInt64;
+    "we_atime_sec", FInt64;
+    "we_atime_nsec", FInt64;
+    "we_mtime_sec", FInt64;
+    "we_mtime_nsec", FInt64;
+    "we_ctime_sec", FInt64;
+    "we_ctime_nsec", FInt64;
+    "we_link", FString;
+    "we_attrname", FString;
+    "we_attrval", FBuffer;
+    ];
+    s_camel_name = "WalkEntry" };
+
 ] (* end of structs *)
 
 let lookup_struct name =
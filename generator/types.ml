@@ -355,6 +355,10 @@ type action = {
 
   (* Lots of flags ... *)
   protocol_limit_warning : bool;  (* warn about protocol size limits *)
+  stream_reply : bool;            (* daemon function sends its return value
+                                     as a stream of chunks after the reply,
+                                     so it is not limited by the maximum
+                                     message size *)
   fish_alias : string list;       (* alias(es) for this cmd in guestfish *)
   fish_output : fish_output_t option; (* how to display output in guestfish *)
   visibility: visibility;         (* The visbility of function *)
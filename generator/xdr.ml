@@ -197,6 +197,11 @@ let generate_xdr () =
    * reasons (it limits what we can do in the API), but it (a) makes
    * the protocol a lot simpler, and (b) provides a bound on the size
    * of the daemon which operates in limited memory space.
+   *
+   * Functions marked stream_reply avoid the limit for their return
+   * value: the reply message has no body, and the return value is
+   * sent afterwards as an XDR record stream in guestfs_chunk
+   * messages, in the same way as a FileOut parameter.
    *)
   pr "const GUESTFS_MESSAGE_MAX = %d;\n" (4 * 1024 * 1024);
   pr "\n";
@@ -204,7 +209,7 @@ let generate_xdr () =
   (* Message header, etc. *)
   pr "\
 const GUESTFS_PROGRAM = 0x2000F5F5;
-const GUESTFS_PROTOCOL_VERSION = 4;
+const GUESTFS_PROTOCOL_VERSION = 5;
 
 /* These constants must be larger than any possible message length. */
 const GUESTFS_LAUNCH_FLAG = 0xf5f55ff5;
@@ -244,7 +249,12 @@ struct guestfs_message_header {
   guestfs_message_status status;
 };
 
-const GUESTFS_MAX_CHUNK_SIZE = 8192;
+/* Chunks are GUESTFS_DEFAULT_CHUNK_SIZE bytes unless a larger size
+ * has been negotiated after launch (see internal_set_chunk_size).
+ * GUESTFS_MAX_CHUNK_SIZE is the largest chunk either side accepts.
+ */
+const GUESTFS_DEFAULT_CHUNK_SIZE = 8192;
+const GUESTFS_MAX_CHUNK_SIZE = 1048576;
 
 struct guestfs_chunk {
   int cancel;			     /* if non-zero, transfer is cancelled */
@@ -119,6 +119,14 @@ PKG_CHECK_MODULES([SD_JOURNAL], [libsystemd],[
     ])
 ])
 
+dnl libblkid library (optional)
+PKG_CHECK_MODULES([BLKID], [blkid],[
+    AC_SUBST([BLKID_CFLAGS])
+    AC_SUBST([BLKID_LIBS])
+    AC_DEFINE([HAVE_BLKID],[1],[libblkid found at compile time.])
+],
+    [AC_MSG_WARN([libblkid not found, filesystems will be probed using the blkid program])])
+
 dnl libtsk sleuthkit library (optional)
 AC_CHECK_LIB([tsk],[tsk_version_print],[
     AC_CHECK_HEADER([tsk/libtsk.h],[
@@ -42,6 +42,7 @@ AC_CHECK_HEADERS([\
     sys/endian.h \
     errno.h \
     linux/fs.h \
+    linux/netlink.h \
     linux/raid/md_u.h \
     printf.h \
     sys/inotify.h \
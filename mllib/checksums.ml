@@ -45,13 +45,13 @@ let of_string csum_type csum_value =
   | "sha512" -> SHA512 csum_value
   | _ -> invalid_arg csum_type
 
+let prog_of_csum = function
+  | SHA1 _ -> "sha1sum"
+  | SHA256 _ -> "sha256sum"
+  | SHA512 _ -> "sha512sum"
+
 let verify_checksum csum filename =
-  let prog, csum_ref =
-    match csum with
-    | SHA1 c -> "sha1sum", c
-    | SHA256 c -> "sha256sum", c
-    | SHA512 c -> "sha512sum", c
-  in
+  let prog = prog_of_csum csum and csum_ref = string_of_csum csum in
 
   let cmd = sprintf "%s %s" prog (Filename.quote filename) in
   let lines = external_command cmd in
@@ -63,5 +63,93 @@ let verify_checksum csum filename =
     if csum_ref <> csum_actual then
       raise (Mismatched_checksum (csum, csum_actual))
 
+let start_verify_checksums checksums filename =
+  (* Run one checksum program for each checksum, reading from a pipe.
+   * All the pipes are close-on-exec, so that each program only
+   * inherits its own stdin and stdout.
+   *)
+  let progs =
+    List.map (
+      fun csum ->
+        let prog = prog_of_csum csum in
+        let in_rd, in_wr = Unix.pipe () in
+        let out_rd, out_wr = Unix.pipe () in
+        List.iter Unix.set_close_on_exec [in_rd; in_wr; out_rd; out_wr];
+        let pid =
+          Unix.create_process prog [| prog |] in_rd out_wr Unix.stderr in
+        Unix.close in_rd;
+        Unix.close out_wr;
+        (csum, prog, pid, in_wr, out_rd)
+    ) checksums in
+
+  (* Fork a subprocess which reads the file once and copies the data
+   * to all the checksum programs.
+   *)
+  let pid = Unix.fork () in
+  if pid = 0 then (
+    (* Child. *)
+    (try
+       List.iter (fun (_, _, _, _, out_rd) -> Unix.close out_rd) progs;
+       let fd = Unix.openfile filename [Unix.O_RDONLY] 0 in
+       let bufsize = 1024 * 1024 in
+       let buf = Bytes.create bufsize in
+       let rec write_all fd pos len =
+         if len > 0 then (
+           let n = Unix.write fd buf pos len in
+           write_all fd (pos+n) (len-n)
+         )
+       in
+       let rec loop () =
+         let n = Unix.read fd buf 0 bufsize in
+         if n > 0 then (
+           List.iter (fun (_, _, _, in_wr, _) -> write_all in_wr 0 n) progs;
+           loop ()
+         )
+       in
+       loop ();
+       Unix.close fd
+     with exn ->
+       eprintf "%s: %s: %s\n%!" prog filename (Printexc.to_string exn);
+       Exit._exit 1
+    );
+    Exit._exit 0
+  );
+
+  (* Parent. *)
+  List.iter (fun (_, _, _, in_wr, _) -> Unix.close in_wr) progs;
+
+  (* The returned function waits for the checksums, and checks them. *)
+  fun () ->
+    let results =
+      List.map (
+        fun (csum, prog, pid, _, out_rd) ->
+          let chan = Unix.in_channel_of_descr out_rd in
+          let line = try Some (input_line chan) with End_of_file -> None in
+          close_in chan;
+          let _, status = Unix.waitpid [] pid in
+          (csum, prog, line, status)
+      ) progs in
+
+    (match snd (Unix.waitpid [] pid) with
+    | Unix.WEXITED 0 -> ()
+    | _ -> error (f_"could not read %s, see earlier error messages") filename
+    );
+
+    List.iter (
+      fun (csum, prog, line, status) ->
+        if status <> Unix.WEXITED 0 then
+          error (f_"%s failed, see earlier error messages") prog;
+        match line with
+        | None ->
+          error (f_"%s did not return any output") prog
+        | Some line ->
+          let csum_actual = fst (String.split " " line) in
+          if string_of_csum csum <> csum_actual then
+            raise (Mismatched_checksum (csum, csum_actual))
+    ) results
+
 let verify_checksums checksums filename =
-  List.iter (fun c -> verify_checksum c filename) checksums
+  match checksums with
+  | [] -> ()
+  | [csum] -> verify_checksum csum filename
+  | checksums -> start_verify_checksums checksums filename ()
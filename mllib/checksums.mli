@@ -33,7 +33,18 @@ val verify_checksum : csum_t -> string -> unit
 (** Verify the checksum of the file. *)
 
 val verify_checksums : csum_t list -> string -> unit
-(** Verify all the checksums of the file. *)
+(** Verify all the checksums of the file.  The file is only read
+    once, however many checksums there are. *)
+
+val start_verify_checksums : csum_t list -> string -> (unit -> unit)
+(** [start_verify_checksums checksums filename] starts verifying all
+    the checksums of the file in the background, reading the file
+    only once.  This lets the caller do something else with the file
+    (such as uncompressing it) at the same time.
+
+    It returns a function which waits until the checksums have been
+    computed, and raises [Mismatched_checksum] if any of them does
+    not match.  The function must be called exactly once. *)
 
 val string_of_csum_t : csum_t -> string
 (** Return a string representation of the checksum type. *)
@@ -33,6 +33,7 @@
 #include <sys/stat.h>
 #include <sys/socket.h>  /* accept4 */
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <assert.h>
 #include <libintl.h>
 
@@ -241,23 +242,42 @@ can_read_data (guestfs_h *g, struct connection *connv)
 }
 
 static ssize_t
-write_data (guestfs_h *g, struct connection *connv,
-            const void *bufv, size_t len)
+write_datav (guestfs_h *g, struct connection *connv,
+             const struct iovec *iov_in, int iovcnt)
 {
-  const char *buf = bufv;
   struct connection_socket *conn = (struct connection_socket *) connv;
-  const size_t original_len = len;
+  struct iovec iov_copy[CONN_MAX_IOV];
+  struct iovec *iov = iov_copy;
+  size_t original_len = 0;
+  int i;
 
   if (conn->daemon_sock == -1) {
     error (g, _("write_data: socket not connected"));
     return -1;
   }
 
-  while (len > 0) {
+  /* We have to adjust the vector as partial writes complete, so work
+   * on a copy of it.
+   */
+  assert (iovcnt >= 0 && iovcnt <= CONN_MAX_IOV);
+  for (i = 0; i < iovcnt; ++i) {
+    iov_copy[i] = iov_in[i];
+    original_len += iov_in[i].iov_len;
+  }
+
+  for (;;) {
     struct pollfd fds[2];
     nfds_t nfds = 1;
     int r;
 
+    /* Skip any elements which have been completely written. */
+    while (iovcnt > 0 && iov->iov_len == 0) {
+      iov++;
+      iovcnt--;
+    }
+    if (iovcnt == 0)
+      break;
+
     fds[0].fd = conn->daemon_sock;
     fds[0].events = POLLOUT;
     fds[0].revents = 0;
@@ -286,7 +306,7 @@ write_data (guestfs_h *g, struct connection *connv,
 
     /* Can write data on daemon socket? */
     if ((fds[0].revents & POLLOUT) != 0) {
-      ssize_t n = write (conn->daemon_sock, buf, len);
+      ssize_t n = writev (conn->daemon_sock, iov, iovcnt);
       if (n == -1) {
         if (errno == EINTR || errno == EAGAIN)
           continue;
@@ -296,14 +316,36 @@ write_data (guestfs_h *g, struct connection *connv,
         return -1;
       }
 
-      buf += n;
-      len -= n;
+      while (n > 0) {
+        if ((size_t) n >= iov->iov_len) {
+          n -= iov->iov_len;
+          iov->iov_len = 0;
+          iov++;
+          iovcnt--;
+        }
+        else {
+          iov->iov_base = (char *) iov->iov_base + n;
+          iov->iov_len -= n;
+          n = 0;
+        }
+      }
     }
   }
 
   return original_len;
 }
 
+static ssize_t
+write_data (guestfs_h *g, struct connection *connv,
+            const void *buf, size_t len)
+{
+  struct iovec iov;
+
+  iov.iov_base = (void *) buf;
+  iov.iov_len = len;
+  return write_datav (g, connv, &iov, 1);
+}
+
 /**
  * This is called if C<conn-E<gt>console_sock> becomes ready to read
  * while we are doing one of the connection operations above.  It
@@ -416,6 +458,7 @@ static struct connection_ops ops = {
   .accept_connection = accept_connection,
   .read_data = read_data,
   .write_data = write_data,
+  .write_datav = write_datav,
   .can_read_data = can_read_data,
 };
 
@@ -20,7 +20,16 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include <sys/wait.h>
 #include <libintl.h>
 
@@ -31,8 +40,403 @@
 #include "guestfs.h"
 #include "guestfs-internal.h"
 
+/**
+ * Read a Berkeley DB hash database, as used by the RPM database.
+ *
+ * The file is memory-mapped and the hash pages are walked directly,
+ * which avoids running C<db_dump> and converting all the data to and
+ * from hex.  Only the features used by RPM are supported: hash
+ * databases (not btree), with items stored on the hash page, on
+ * overflow pages or as on-page duplicates.  If the file is some
+ * other kind of database and C<db_dump> is available, then we fall
+ * back to running C<db_dump>.
+ *
+ * The on-disk format is described in F<dbinc/db_page.h> in the
+ * Berkeley DB sources.  All integers are stored in the byte order of
+ * the machine which created the database, which we detect from the
+ * magic number in the metadata page.
+ */
+
+#define DB_HASHMAGIC 0x061561
+
+/* Page types. */
+#define P_HASH_UNSORTED 2
+#define P_OVERFLOW      7
+#define P_HASHMETA      8
+#define P_HASH          13
+
+/* Item types on hash pages. */
+#define H_KEYDATA   1
+#define H_DUPLICATE 2
+#define H_OFFPAGE   3
+#define H_OFFDUP    4
+
+/* Size of the page header, and the extra space used by the checksum
+ * (PG_CHKSUM: 2 unused bytes and a 4 byte checksum) if the database
+ * has checksums enabled.  Encrypted databases store a larger HMAC
+ * and IV instead, but those are not supported.
+ */
+#define SIZEOF_PAGE      26
+#define SIZEOF_PG_CHKSUM 6
+#define DBMETA_CHKSUM    0x01
+
+struct db_file {
+  const char *filename;
+  const unsigned char *map;
+  size_t size;
+  bool swap;                    /* Database is in the other byte order. */
+  uint32_t pagesize;
+  uint32_t npages;
+  uint32_t overhead;            /* Offset of the first byte after header. */
+};
+
+static int read_db_hash (guestfs_h *g, struct db_file *db, void *opaque, guestfs_int_db_dump_callback callback);
+#if defined(DB_DUMP)
+static int run_db_dump (guestfs_h *g, const char *dumpfile, void *opaque, guestfs_int_db_dump_callback callback);
+#endif
+
+static inline uint16_t
+get16 (const struct db_file *db, const unsigned char *p)
+{
+  uint16_t v;
+
+  memcpy (&v, p, sizeof v);
+  return db->swap ? __builtin_bswap16 (v) : v;
+}
+
+static inline uint32_t
+get32 (const struct db_file *db, const unsigned char *p)
+{
+  uint32_t v;
+
+  memcpy (&v, p, sizeof v);
+  return db->swap ? __builtin_bswap32 (v) : v;
+}
+
+/* Return a pointer to page C<pgno>, or C<NULL> if the page is
+ * outside the file.
+ */
+static const unsigned char *
+get_page (const struct db_file *db, uint32_t pgno)
+{
+  if (pgno >= db->npages)
+    return NULL;
+  return db->map + (size_t) pgno * db->pagesize;
+}
+
+/* Parse the metadata page.  Returns 0 if this is a hash database
+ * that we can read, or -1 if not (without setting an error).
+ */
+static int
+parse_meta_page (guestfs_h *g, struct db_file *db)
+{
+  uint32_t magic, version, last_pgno;
+  uint8_t encrypt_alg, type, metaflags;
+
+  if (db->size < 512)
+    return -1;
+
+  memcpy (&magic, &db->map[12], sizeof magic);
+  if (magic == DB_HASHMAGIC)
+    db->swap = false;
+  else if (__builtin_bswap32 (magic) == DB_HASHMAGIC)
+    db->swap = true;
+  else {
+    debug (g, "%s: not a Berkeley DB hash database (magic 0x%" PRIx32 ")",
+           db->filename, magic);
+    return -1;
+  }
+
+  version = get32 (db, &db->map[16]);
+  db->pagesize = get32 (db, &db->map[20]);
+  encrypt_alg = db->map[24];
+  type = db->map[25];
+  metaflags = db->map[26];
+  last_pgno = get32 (db, &db->map[32]);
+
+  if (version < 7 || version > 10 || type != P_HASHMETA ||
+      encrypt_alg != 0) {
+    debug (g, "%s: unsupported hash database (version %" PRIu32 ", "
+           "type %d, encrypt_alg %d)",
+           db->filename, version, type, encrypt_alg);
+    return -1;
+  }
+  if (db->pagesize < 512 || db->pagesize > 65536 ||
+      (db->pagesize & (db->pagesize - 1)) != 0) {
+    debug (g, "%s: invalid page size %" PRIu32, db->filename, db->pagesize);
+    return -1;
+  }
+
+  db->overhead = SIZEOF_PAGE;
+  if (metaflags & DBMETA_CHKSUM)
+    db->overhead += SIZEOF_PG_CHKSUM;
+
+  /* Pages after the end of the file were allocated but never
+   * written, so they contain no data.
+   */
+  db->npages = db->size / db->pagesize;
+  if ((uint64_t) last_pgno + 1 < db->npages)
+    db->npages = last_pgno + 1;
+
+  return 0;
+}
+
+/**
+ * This helper function is specialized to just reading hash format
+ * databases.  It's just enough to support the RPM database format.
+ *
+ * The callback is called once for each (key, value) pair in the
+ * database, in no particular order.
+ */
+int
+guestfs_int_read_db_dump (guestfs_h *g,
+			  const char *dumpfile, void *opaque,
+			  guestfs_int_db_dump_callback callback)
+{
+  struct db_file db = { .filename = dumpfile };
+  struct stat statbuf;
+  void *map;
+  int fd, r;
+
+  fd = open (dumpfile, O_RDONLY|O_CLOEXEC);
+  if (fd == -1) {
+    perrorf (g, "open: %s", dumpfile);
+    return -1;
+  }
+  if (fstat (fd, &statbuf) == -1) {
+    perrorf (g, "fstat: %s", dumpfile);
+    close (fd);
+    return -1;
+  }
+  db.size = statbuf.st_size;
+  if (db.size == 0) {
+    close (fd);
+    goto unsupported;
+  }
+
+  map = mmap (NULL, db.size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (map == MAP_FAILED) {
+    perrorf (g, "mmap: %s", dumpfile);
+    return -1;
+  }
+  db.map = map;
+
+  if (parse_meta_page (g, &db) == -1) {
+    munmap (map, db.size);
+    goto unsupported;
+  }
+
+  madvise (map, db.size, MADV_SEQUENTIAL);
+  r = read_db_hash (g, &db, opaque, callback);
+  munmap (map, db.size);
+  return r;
+
+ unsupported:
+#if defined(DB_DUMP)
+  return run_db_dump (g, dumpfile, opaque, callback);
+#else
+  error (g, _("%s: not a Berkeley DB hash database"), dumpfile);
+  return -1;
+#endif
+}
+
+/* Read an item stored on a chain of overflow pages.  Returns a
+ * newly allocated buffer, or C<NULL> on error.
+ */
+static unsigned char *
+read_overflow (guestfs_h *g, const struct db_file *db,
+               uint32_t pgno, uint32_t tlen)
+{
+  unsigned char *buf;
+  const unsigned char *page;
+  uint32_t n = 0, len, npages = 0;
+
+  buf = safe_malloc (g, tlen > 0 ? tlen : 1);
+
+  while (n < tlen) {
+    page = get_page (db, pgno);
+    if (page == NULL || page[25] != P_OVERFLOW || ++npages > db->npages)
+      goto corrupt;
+
+    /* On overflow pages, hf_offset is the length of data on the page. */
+    len = get16 (db, &page[22]);
+    if (len > db->pagesize - db->overhead || len > tlen - n)
+      goto corrupt;
+    memcpy (&buf[n], &page[db->overhead], len);
+    n += len;
+
+    pgno = get32 (db, &page[16]);
+    if (len == 0)
+      goto corrupt;
+  }
+
+  return buf;
+
+ corrupt:
+  free (buf);
+  error (g, _("%s: corrupt overflow page chain at page %" PRIu32),
+         db->filename, pgno);
+  return NULL;
+}
+
+/* An item (key or value) on a hash page. */
+struct item {
+  uint8_t type;
+  const unsigned char *data;
+  size_t len;
+  unsigned char *alloc;         /* Non-NULL if data must be freed. */
+};
+
+/* Get item C<indx> from a hash page.  Items are stored backwards
+ * from the end of the page, so the length of an item is the distance
+ * to the start of the previous item.
+ */
+static int
+get_item (guestfs_h *g, const struct db_file *db,
+          const unsigned char *page, uint32_t pgno, uint16_t nent,
+          uint16_t indx, struct item *item)
+{
+  const unsigned char *inp = &page[db->overhead];
+  uint32_t off, end;
+  const unsigned char *p;
+
+  item->alloc = NULL;
+
+  off = get16 (db, &inp[2*indx]);
+  end = indx == 0 ? db->pagesize : get16 (db, &inp[2*(indx-1)]);
+  if (off < db->overhead + 2 * (uint32_t) nent || off >= end ||
+      end > db->pagesize)
+    goto corrupt;
+
+  p = &page[off];
+  item->type = p[0];
+  switch (item->type) {
+  case H_KEYDATA:
+  case H_DUPLICATE:
+    item->data = &p[1];
+    item->len = end - off - 1;
+    return 0;
+
+  case H_OFFPAGE:
+    /* type, 3 unused bytes, page number, total length */
+    if (end - off < 12)
+      goto corrupt;
+    item->len = get32 (db, &p[8]);
+    item->alloc = read_overflow (g, db, get32 (db, &p[4]), item->len);
+    if (item->alloc == NULL)
+      return -1;
+    item->data = item->alloc;
+    return 0;
+
+  case H_OFFDUP:
+    error (g, _("%s: off-page duplicates are not supported"), db->filename);
+    return -1;
+
+  default:
+    goto corrupt;
+  }
+
+ corrupt:
+  error (g, _("%s: corrupt item %d on hash page %" PRIu32),
+         db->filename, (int) indx, pgno);
+  return -1;
+}
+
+/* Call the callback for each (key, value) pair on one hash page. */
+static int
+read_hash_page (guestfs_h *g, const struct db_file *db,
+                const unsigned char *page, uint32_t pgno,
+                void *opaque, guestfs_int_db_dump_callback callback)
+{
+  uint16_t nent, i;
+  struct item key, value;
+  const unsigned char *p, *end;
+  uint16_t len;
+  int r = -1;
+
+  nent = get16 (db, &page[20]);
+  if ((nent & 1) != 0 ||
+      db->overhead + 2 * (uint32_t) nent > db->pagesize) {
+    error (g, _("%s: corrupt hash page %" PRIu32), db->filename, pgno);
+    return -1;
+  }
+
+  for (i = 0; i < nent; i += 2) {
+    if (get_item (g, db, page, pgno, nent, i, &key) == -1)
+      return -1;
+    if (key.type != H_KEYDATA && key.type != H_OFFPAGE) {
+      error (g, _("%s: unexpected key type %d on hash page %" PRIu32),
+             db->filename, key.type, pgno);
+      free (key.alloc);
+      return -1;
+    }
+    if (get_item (g, db, page, pgno, nent, i+1, &value) == -1) {
+      free (key.alloc);
+      return -1;
+    }
+
+    if (value.type != H_DUPLICATE)
+      r = callback (g, key.data, key.len, value.data, value.len, opaque);
+    else {
+      /* Each duplicate is stored as length, data, length. */
+      p = value.data;
+      end = value.data + value.len;
+      r = 0;
+      while (r == 0 && p < end) {
+        if (end - p < 4 ||
+            (len = get16 (db, p), (size_t) (end - p) < (size_t) len + 4)) {
+          error (g, _("%s: corrupt duplicate item on hash page %" PRIu32),
+                 db->filename, pgno);
+          r = -1;
+          break;
+        }
+        r = callback (g, key.data, key.len, &p[2], len, opaque);
+        p += len + 4;
+      }
+    }
+
+    free (key.alloc);
+    free (value.alloc);
+    if (r == -1)
+      return -1;
+  }
+
+  return 0;
+}
+
+/* Walk all the pages in the file in order, reading the hash pages.
+ * This is faster than following the bucket chains and gives the same
+ * set of (key, value) pairs, since each hash page belongs to exactly
+ * one bucket.  Pages which are free or unused are not hash pages and
+ * are skipped.
+ */
+static int
+read_db_hash (guestfs_h *g, struct db_file *db,
+              void *opaque, guestfs_int_db_dump_callback callback)
+{
+  const unsigned char *page;
+  uint32_t pgno;
+
+  for (pgno = 1; pgno < db->npages; ++pgno) {
+    page = get_page (db, pgno);
+    if (page[25] != P_HASH && page[25] != P_HASH_UNSORTED)
+      continue;
+    if (get32 (db, &page[8]) != pgno)
+      continue;
+    if (read_hash_page (g, db, page, pgno, opaque, callback) == -1)
+      return -1;
+  }
+
+  return 0;
+}
+
 #if defined(DB_DUMP)
 
+/* If the file is not a hash database which we can read directly,
+ * run the db_dump program and parse its output.
+ */
+
 static void read_db_dump_line (guestfs_h *g, void *datav, const char *line, size_t len);
 static unsigned char *convert_hex_to_binary (guestfs_h *g, const char *hex, size_t hexlen, size_t *binlen_rtn);
 
@@ -47,14 +451,9 @@ struct cb_data {
   size_t keylen;
 };
 
-/* This helper function is specialized to just reading the hash-format
- * output from db_dump/db4_dump.  It's just enough to support the RPM
- * database format.
- */
-int
-guestfs_int_read_db_dump (guestfs_h *g,
-			  const char *dumpfile, void *opaque,
-			  guestfs_int_db_dump_callback callback)
+static int
+run_db_dump (guestfs_h *g, const char *dumpfile, void *opaque,
+             guestfs_int_db_dump_callback callback)
 {
   struct cb_data data;
   CLEANUP_CMD_CLOSE struct command *cmd = guestfs_int_new_command (g);
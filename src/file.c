@@ -32,6 +32,7 @@
 #include "guestfs.h"
 #include "guestfs-internal.h"
 #include "guestfs-internal-actions.h"
+#include "guestfs_protocol.h"
 
 static int
 compare (const void *vp1, const void *vp2)
@@ -372,46 +373,91 @@ guestfs_impl_write_append (guestfs_h *g, const char *path,
   return write_or_append (g, path, content, size, 1);
 }
 
+/* The lstatnslist, lxattrlist and readlinklist calls below split
+ * the list of names into batches, so that neither the request nor
+ * the reply can exceed the maximum message size.  All the batches are
+ * sent to the daemon before any reply is read (see
+ * guestfs_int_pipeline_send), so a batch does not have to wait for
+ * the reply to the previous one.  The daemon still processes the
+ * batches one at a time.
+ */
+static size_t
+count_batches (char *const *names, size_t max)
+{
+  size_t len = guestfs_int_count_strings (names);
+
+  return (len + max - 1) / max;
+}
+
 #define LSTATNSLIST_MAX 1000
 
 struct guestfs_statns_list *
 guestfs_impl_lstatnslist (guestfs_h *g, const char *dir, char * const*names)
 {
-  size_t len = guestfs_int_count_strings (names);
-  size_t old_len;
+  const size_t nr_batches = count_batches (names, LSTATNSLIST_MAX);
+  size_t i, old_len;
+  CLEANUP_FREE int *serials = NULL;
   struct guestfs_statns_list *ret;
 
   ret = safe_malloc (g, sizeof *ret);
   ret->len = 0;
   ret->val = NULL;
 
-  while (len > 0) {
-    CLEANUP_FREE_STATNS_LIST struct guestfs_statns_list *stats = NULL;
+  if (nr_batches == 0)
+    return ret;
+
+  if (guestfs_int_check_appliance_up (g, "lstatnslist") == -1)
+    goto err;
+
+  serials = safe_malloc (g, nr_batches * sizeof (int));
+  for (i = 0; i < nr_batches; ++i) {
+    struct guestfs_internal_lstatnslist_args args;
 
     /* Note we don't need to free up the strings because take_strings
      * does not do a deep copy.
      */
     CLEANUP_FREE char **first = take_strings (g, names, LSTATNSLIST_MAX, &names);
 
-    len = len <= LSTATNSLIST_MAX ? 0 : len - LSTATNSLIST_MAX;
-
-    stats = guestfs_internal_lstatnslist (g, dir, first);
-
-    if (stats == NULL) {
-      guestfs_free_statns_list (ret);
-      return NULL;
-    }
+    args.path = (char *) dir;
+    args.names.names_val = first;
+    args.names.names_len = guestfs_int_count_strings (first);
+    serials[i] =
+      guestfs_int_pipeline_send (g, GUESTFS_PROC_INTERNAL_LSTATNSLIST, 0,
+                                 (xdrproc_t) xdr_guestfs_internal_lstatnslist_args,
+                                 (char *) &args);
+    if (serials[i] == -1)
+      goto err_drain;
+  }
+
+  for (i = 0; i < nr_batches; ++i) {
+    struct guestfs_internal_lstatnslist_ret r;
+    guestfs_int_statns_list *stats = &r.statbufs;
+
+    memset (&r, 0, sizeof r);
+    if (guestfs_int_pipeline_recv (g, "internal_lstatnslist",
+                                   GUESTFS_PROC_INTERNAL_LSTATNSLIST,
+                                   serials[i],
+                                   (xdrproc_t) xdr_guestfs_internal_lstatnslist_ret,
+                                   (char *) &r) == -1)
+      goto err_drain;
 
     /* Append stats to ret. */
     old_len = ret->len;
-    ret->len += stats->len;
+    ret->len += stats->guestfs_int_statns_list_len;
     ret->val = safe_realloc (g, ret->val,
                              ret->len * sizeof (struct guestfs_statns));
-    memcpy (&ret->val[old_len], stats->val,
-            stats->len * sizeof (struct guestfs_statns));
+    memcpy (&ret->val[old_len], stats->guestfs_int_statns_list_val,
+            stats->guestfs_int_statns_list_len * sizeof (struct guestfs_statns));
+    free (stats->guestfs_int_statns_list_val);
   }
 
   return ret;
+
+ err_drain:
+  guestfs_int_pipeline_drain (g);
+ err:
+  guestfs_free_statns_list (ret);
+  return NULL;
 }
 
 #define LXATTRLIST_MAX 1000
@@ -419,47 +465,73 @@ guestfs_impl_lstatnslist (guestfs_h *g, const char *dir, char * const*names)
 struct guestfs_xattr_list *
 guestfs_impl_lxattrlist (guestfs_h *g, const char *dir, char *const *names)
 {
-  size_t len = guestfs_int_count_strings (names);
+  const size_t nr_batches = count_batches (names, LXATTRLIST_MAX);
   size_t i, old_len;
+  CLEANUP_FREE int *serials = NULL;
   struct guestfs_xattr_list *ret;
 
   ret = safe_malloc (g, sizeof *ret);
   ret->len = 0;
   ret->val = NULL;
 
-  while (len > 0) {
-    CLEANUP_FREE_XATTR_LIST struct guestfs_xattr_list *xattrs = NULL;
+  if (nr_batches == 0)
+    return ret;
+
+  if (guestfs_int_check_appliance_up (g, "lxattrlist") == -1)
+    goto err;
+
+  serials = safe_malloc (g, nr_batches * sizeof (int));
+  for (i = 0; i < nr_batches; ++i) {
+    struct guestfs_internal_lxattrlist_args args;
 
     /* Note we don't need to free up the strings because take_strings
      * does not do a deep copy.
      */
     CLEANUP_FREE char **first = take_strings (g, names, LXATTRLIST_MAX, &names);
-    len = len <= LXATTRLIST_MAX ? 0 : len - LXATTRLIST_MAX;
 
-    xattrs = guestfs_internal_lxattrlist (g, dir, first);
-
-    if (xattrs == NULL) {
-      guestfs_free_xattr_list (ret);
-      return NULL;
-    }
-
-    /* Append xattrs to ret. */
+    args.path = (char *) dir;
+    args.names.names_val = first;
+    args.names.names_len = guestfs_int_count_strings (first);
+    serials[i] =
+      guestfs_int_pipeline_send (g, GUESTFS_PROC_INTERNAL_LXATTRLIST, 0,
+                                 (xdrproc_t) xdr_guestfs_internal_lxattrlist_args,
+                                 (char *) &args);
+    if (serials[i] == -1)
+      goto err_drain;
+  }
+
+  for (i = 0; i < nr_batches; ++i) {
+    struct guestfs_internal_lxattrlist_ret r;
+    guestfs_int_xattr_list *xattrs = &r.xattrs;
+
+    memset (&r, 0, sizeof r);
+    if (guestfs_int_pipeline_recv (g, "internal_lxattrlist",
+                                   GUESTFS_PROC_INTERNAL_LXATTRLIST,
+                                   serials[i],
+                                   (xdrproc_t) xdr_guestfs_internal_lxattrlist_ret,
+                                   (char *) &r) == -1)
+      goto err_drain;
+
+    /* Append xattrs to ret.  The XDR and public structs have the
+     * same layout, so we can take ownership of the attribute names
+     * and values without copying them.
+     */
     old_len = ret->len;
-    ret->len += xattrs->len;
+    ret->len += xattrs->guestfs_int_xattr_list_len;
     ret->val = safe_realloc (g, ret->val,
                              ret->len * sizeof (struct guestfs_xattr));
-    for (i = 0; i < xattrs->len; ++i, ++old_len) {
-      /* We have to make a deep copy of the attribute name and value.
-       */
-      ret->val[old_len].attrname = safe_strdup (g, xattrs->val[i].attrname);
-      ret->val[old_len].attrval = safe_malloc (g, xattrs->val[i].attrval_len);
-      ret->val[old_len].attrval_len = xattrs->val[i].attrval_len;
-      memcpy (ret->val[old_len].attrval, xattrs->val[i].attrval,
-              xattrs->val[i].attrval_len);
-    }
+    memcpy (&ret->val[old_len], xattrs->guestfs_int_xattr_list_val,
+            xattrs->guestfs_int_xattr_list_len * sizeof (struct guestfs_xattr));
+    free (xattrs->guestfs_int_xattr_list_val);
   }
 
   return ret;
+
+ err_drain:
+  guestfs_int_pipeline_drain (g);
+ err:
+  guestfs_free_xattr_list (ret);
+  return NULL;
 }
 
 #define READLINK_MAX 1000
@@ -467,32 +539,55 @@ guestfs_impl_lxattrlist (guestfs_h *g, const char *dir, char *const *names)
 char **
 guestfs_impl_readlinklist (guestfs_h *g, const char *dir, char *const *names)
 {
-  size_t len = guestfs_int_count_strings (names);
-  size_t old_len, ret_len = 0;
+  const size_t nr_batches = count_batches (names, READLINK_MAX);
+  size_t i, old_len, ret_len = 0;
+  CLEANUP_FREE int *serials = NULL;
   char **ret = NULL;
 
-  while (len > 0) {
-    /* Note we don't need to free up the strings because the 'links'
-     * strings are copied to ret, and 'take_strings' does not do a
-     * deep copy.
+  if (nr_batches > 0) {
+    if (guestfs_int_check_appliance_up (g, "readlinklist") == -1)
+      return NULL;
+
+    serials = safe_malloc (g, nr_batches * sizeof (int));
+  }
+
+  for (i = 0; i < nr_batches; ++i) {
+    struct guestfs_internal_readlinklist_args args;
+
+    /* Note we don't need to free up the strings because take_strings
+     * does not do a deep copy.
      */
-    CLEANUP_FREE char **links = NULL;
     CLEANUP_FREE char **first = take_strings (g, names, READLINK_MAX, &names);
-    len = len <= READLINK_MAX ? 0 : len - READLINK_MAX;
 
-    links = guestfs_internal_readlinklist (g, dir, first);
+    args.path = (char *) dir;
+    args.names.names_val = first;
+    args.names.names_len = guestfs_int_count_strings (first);
+    serials[i] =
+      guestfs_int_pipeline_send (g, GUESTFS_PROC_INTERNAL_READLINKLIST, 0,
+                                 (xdrproc_t) xdr_guestfs_internal_readlinklist_args,
+                                 (char *) &args);
+    if (serials[i] == -1)
+      goto err;
+  }
 
-    if (links == NULL) {
-      if (ret)
-        guestfs_int_free_string_list (ret);
-      return NULL;
-    }
+  for (i = 0; i < nr_batches; ++i) {
+    struct guestfs_internal_readlinklist_ret r;
 
-    /* Append links to ret. */
+    memset (&r, 0, sizeof r);
+    if (guestfs_int_pipeline_recv (g, "internal_readlinklist",
+                                   GUESTFS_PROC_INTERNAL_READLINKLIST,
+                                   serials[i],
+                                   (xdrproc_t) xdr_guestfs_internal_readlinklist_ret,
+                                   (char *) &r) == -1)
+      goto err;
+
+    /* Append links to ret.  The strings are not copied. */
     old_len = ret_len;
-    ret_len += guestfs_int_count_strings (links);
+    ret_len += r.links.links_len;
     ret = safe_realloc (g, ret, ret_len * sizeof (char *));
-    memcpy (&ret[old_len], links, (ret_len-old_len) * sizeof (char *));
+    memcpy (&ret[old_len], r.links.links_val,
+            r.links.links_len * sizeof (char *));
+    free (r.links.links_val);
   }
 
   /* NULL-terminate the list. */
@@ -500,6 +595,13 @@ guestfs_impl_readlinklist (guestfs_h *g, const char *dir, char *const *names)
   ret[ret_len] = NULL;
 
   return ret;
+
+ err:
+  guestfs_int_pipeline_drain (g);
+  for (i = 0; i < ret_len; ++i)
+    free (ret[i]);
+  free (ret);
+  return NULL;
 }
 
 char **
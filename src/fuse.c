@@ -20,6 +20,8 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
 #include <unistd.h>
 #include <errno.h>
 #include <sys/types.h>
@@ -41,13 +43,16 @@
 #endif
 
 #include "cloexec.h"
+#include "ignore-value.h"
 #include "glthread/lock.h"
+#include "glthread/thread.h"
 #include "hash.h"
 #include "hash-pjw.h"
 
 #include "guestfs.h"
 #include "guestfs-internal.h"
 #include "guestfs-internal-actions.h"
+#include "guestfs_protocol.h"
 
 #if HAVE_FUSE
 
@@ -59,9 +64,9 @@ static void dir_cache_invalidate (guestfs_h *, const char *path);
 static int lsc_insert (guestfs_h *, const char *path, const char *name, time_t now, struct stat const *statbuf);
 static int xac_insert (guestfs_h *, const char *path, const char *name, time_t now, struct guestfs_xattr_list *xattrs);
 static int rlc_insert (guestfs_h *, const char *path, const char *name, time_t now, char *link);
-static const struct stat *lsc_lookup (guestfs_h *, const char *pathname);
-static const struct guestfs_xattr_list *xac_lookup (guestfs_h *, const char *pathname);
-static const char *rlc_lookup (guestfs_h *, const char *pathname);
+static int lsc_lookup (guestfs_h *, const char *pathname, struct stat *statbuf);
+static struct guestfs_xattr_list *xac_lookup (guestfs_h *, const char *pathname);
+static char *rlc_lookup (guestfs_h *, const char *pathname);
 
 /* This lock protects access to g->localmountpoint. */
 gl_lock_define_initialized (static, mount_local_lock);
@@ -87,6 +92,196 @@ gl_lock_define_initialized (static, mount_local_lock);
     return -ret_errno;							\
   } while (0)
 
+/* Locking.
+ *
+ * If the multithreaded flag is set, FUSE calls the functions below
+ * from several threads at the same time.  The handle is not
+ * thread-safe, and it has only one connection to the daemon, so:
+ *
+ * g->ml_handle_lock is held around every libguestfs call on the
+ * handle, including RETURN_ERRNO which reads the errno of the failed
+ * call.  Use ACQUIRE_HANDLE_LOCK_FOR_CURRENT_SCOPE for this.
+ *
+ * The exception is pipelined_call, used for the lookups made when
+ * getattr, readlink, getxattr and listxattr miss the caches.  It
+ * sends the request, then releases the lock until it is its turn to
+ * read the reply, so that concurrent misses are queued in the
+ * daemon together instead of each costing a full round trip.  Each
+ * pipelined request gets a ticket (g->ml_next_send), and the replies
+ * are read in ticket order (g->ml_next_recv).  Other calls wait until
+ * no pipelined request is outstanding, and g->ml_pipeline_cond is
+ * broadcast whenever that may have changed.
+ *
+ * g->ml_cache_lock protects the directory caches and the read-ahead
+ * counters in the handle.  It is only held while the caches are
+ * being updated or copied, never during a call to the daemon, so
+ * requests which can be answered from the caches don't have to wait
+ * for requests which are being processed by the daemon.
+ *
+ * Functions which change the filesystem call dir_cache_invalidate
+ * after the daemon call, with the handle lock still held.  Otherwise
+ * a concurrent request could read the old data from the daemon
+ * between the invalidation and the change, and cache it again.
+ *
+ * Each open file has a lock protecting its read-ahead buffer.
+ *
+ * The locks must be acquired in the order: file, handle, cache.
+ */
+static void
+unlock_handle (guestfs_h **gp)
+{
+  gl_lock_unlock ((*gp)->ml_handle_lock);
+}
+
+/* Take the handle lock for an ordinary (not pipelined) call. */
+static void
+lock_handle (guestfs_h *g)
+{
+  gl_lock_lock (g->ml_handle_lock);
+  while (g->ml_next_send != g->ml_next_recv)
+    gl_cond_wait (g->ml_pipeline_cond, g->ml_handle_lock);
+}
+
+#define ACQUIRE_HANDLE_LOCK_FOR_CURRENT_SCOPE()                         \
+  __attribute__((cleanup(unlock_handle))) guestfs_h *_handle_locked = g; \
+  lock_handle (_handle_locked)
+
+/* Make a simple call to the daemon, pipelined with the calls made by
+ * other threads at the same time (see above).  This must be called
+ * without the handle lock held.  Returns 0, or -errno on error.
+ */
+static int
+pipelined_call (guestfs_h *g, const char *fn, int proc_nr,
+                xdrproc_t xdr_args, char *args,
+                xdrproc_t xdr_ret, char *ret)
+{
+  uint64_t ticket;
+  size_t waiting;
+  int serial, r = 0;
+
+  /* Let the thread which is next to read a reply know that we are
+   * about to send a request, so that it waits for us.
+   */
+  gl_lock_lock (g->ml_cache_lock);
+  g->ml_waiting_senders++;
+  gl_lock_unlock (g->ml_cache_lock);
+
+  gl_lock_lock (g->ml_handle_lock);
+
+  gl_lock_lock (g->ml_cache_lock);
+  g->ml_waiting_senders--;
+  gl_lock_unlock (g->ml_cache_lock);
+
+  if (guestfs_int_check_appliance_up (g, fn) == -1)
+    serial = -1;
+  else
+    serial = guestfs_int_pipeline_send (g, proc_nr, 0, xdr_args, args);
+  gl_cond_broadcast (g->ml_pipeline_cond);
+  if (serial == -1) {
+    r = -1;
+    goto out;
+  }
+
+  /* Wait until all earlier replies have been read, and until threads
+   * which are about to send a request have done so.
+   */
+  ticket = g->ml_next_send++;
+  for (;;) {
+    gl_lock_lock (g->ml_cache_lock);
+    waiting = g->ml_waiting_senders;
+    gl_lock_unlock (g->ml_cache_lock);
+    if (g->ml_next_recv == ticket && waiting == 0)
+      break;
+    gl_cond_wait (g->ml_pipeline_cond, g->ml_handle_lock);
+  }
+
+  r = guestfs_int_pipeline_recv (g, fn, proc_nr, serial, xdr_ret, ret);
+  g->ml_next_recv++;
+  gl_cond_broadcast (g->ml_pipeline_cond);
+
+ out:
+  if (r == -1) {
+    /* 0 doesn't mean "no error", see RETURN_ERRNO. */
+    r = -guestfs_last_errno (g);
+    if (r == 0)
+      r = -EINVAL;
+  }
+  gl_lock_unlock (g->ml_handle_lock);
+  return r;
+}
+
+/* lgetxattrs for getxattr and listxattr cache misses.  Returns the
+ * list, or NULL and sets *err to -errno.
+ */
+static struct guestfs_xattr_list *
+pipelined_lgetxattrs (guestfs_h *g, const char *path, int *err)
+{
+  struct guestfs_lgetxattrs_args args;
+  struct guestfs_lgetxattrs_ret ret;
+
+  args.path = (char *) path;
+  memset (&ret, 0, sizeof ret);
+  *err = pipelined_call (g, "lgetxattrs", GUESTFS_PROC_LGETXATTRS,
+                         (xdrproc_t) xdr_guestfs_lgetxattrs_args,
+                         (char *) &args,
+                         (xdrproc_t) xdr_guestfs_lgetxattrs_ret,
+                         (char *) &ret);
+  if (*err < 0)
+    return NULL;
+
+  /* The XDR list has the same layout as struct guestfs_xattr_list,
+   * as in the generated actions.
+   */
+  return safe_memdup (g, &ret.xattrs, sizeof ret.xattrs);
+}
+
+/* Read-ahead.
+ *
+ * Each open file has a buffer holding the data of the last read from
+ * the daemon.  While reads are sequential, each read from the daemon
+ * doubles the window (up to READAHEAD_MAX), so that copying a large
+ * file out of the mountpoint needs one RPC for several FUSE reads.
+ * Random reads only read the requested data.  The total size of all
+ * buffers is limited to READAHEAD_TOTAL.
+ *
+ * Once a sequential reader has consumed half of the buffer, a thread
+ * is started to read the next window into a second buffer (ra_buf),
+ * so that the next RPC overlaps with the reader processing the data
+ * it already has.  The thread only takes the handle and cache locks,
+ * so it can be joined with the file lock held.
+ *
+ * Any change made through the mountpoint increments
+ * g->ml_data_generation, which discards the buffers of all files.
+ */
+#define READAHEAD_MIN     (128 * 1024)
+#define READAHEAD_MAX     (2 * 1024 * 1024) /* See mount_local_read. */
+#define READAHEAD_TOTAL   (64 * 1024 * 1024)
+
+/* Stored in fi->fh for each open file. */
+struct ml_file {
+  int handle;                   /* Daemon handle (internal_file_open). */
+  char *buf;                    /* Read-ahead buffer. */
+  off_t buf_offset;             /* File offset of buf. */
+  size_t buf_len;               /* Bytes of data in buf. */
+  int buf_eof;                  /* Buffer goes up to the end of file. */
+  uint64_t generation;          /* g->ml_data_generation when read. */
+  off_t next_offset;            /* Offset after the previous read. */
+  size_t window;                /* Current read-ahead window. */
+  gl_lock_define (, lock);      /* Protects the fields above. */
+
+  /* Background read of the next window.  While ra_running is set,
+   * the ra_* fields below belong to ra_thread.
+   */
+  guestfs_h *g;
+  int ra_running;
+  gl_thread_t ra_thread;
+  char *ra_buf;
+  off_t ra_offset;
+  size_t ra_len;
+  size_t ra_count;              /* Bytes requested. */
+  uint64_t ra_generation;       /* g->ml_data_generation when started. */
+};
+
 static struct guestfs_xattr_list *
 copy_xattr_list (guestfs_h *g, const struct guestfs_xattr *first, size_t num)
 {
@@ -128,6 +323,8 @@ mount_local_readdir (const char *path, void *buf, fuse_fill_dir_t filler,
   DECL_G ();
   DEBUG_CALL ("%s, %p, %ld", path, buf, (long) offset);
 
+  ACQUIRE_HANDLE_LOCK_FOR_CURRENT_SCOPE ();
+
   time (&now);
 
   dir_cache_remove_all_expired (g, now);
@@ -256,20 +453,23 @@ mount_local_readdir (const char *path, void *buf, fuse_fill_dir_t filler,
 static int
 mount_local_getattr (const char *path, struct stat *statbuf)
 {
-  const struct stat *buf;
-  CLEANUP_FREE_STAT struct guestfs_statns *r = NULL;
+  struct guestfs_lstatns_args args;
+  struct guestfs_lstatns_ret ret;
+  const guestfs_int_statns *r = &ret.statbuf;
+  int err;
   DECL_G ();
   DEBUG_CALL ("%s, %p", path, statbuf);
 
-  buf = lsc_lookup (g, path);
-  if (buf) {
-    memcpy (statbuf, buf, sizeof *statbuf);
+  if (lsc_lookup (g, path, statbuf))
     return 0;
-  }
 
-  r = guestfs_lstatns (g, path);
-  if (r == NULL)
-    RETURN_ERRNO;
+  args.path = (char *) path;
+  memset (&ret, 0, sizeof ret);
+  err = pipelined_call (g, "lstatns", GUESTFS_PROC_LSTATNS,
+                        (xdrproc_t) xdr_guestfs_lstatns_args, (char *) &args,
+                        (xdrproc_t) xdr_guestfs_lstatns_ret, (char *) &ret);
+  if (err < 0)
+    return err;
 
   memset (statbuf, 0, sizeof *statbuf);
   statbuf->st_dev = r->st_dev;
@@ -366,18 +566,27 @@ mount_local_access (const char *path, int mask)
 static int
 mount_local_readlink (const char *path, char *buf, size_t size)
 {
-  const char *r;
-  int free_it = 0;
+  CLEANUP_FREE char *r = NULL;
   size_t len;
   DECL_G ();
   DEBUG_CALL ("%s, %p, %zu", path, buf, size);
 
   r = rlc_lookup (g, path);
   if (!r) {
-    r = guestfs_readlink (g, path);
-    if (r == NULL)
-      RETURN_ERRNO;
-    free_it = 1;
+    struct guestfs_readlink_args args;
+    struct guestfs_readlink_ret ret;
+    int err;
+
+    args.path = (char *) path;
+    memset (&ret, 0, sizeof ret);
+    err = pipelined_call (g, "readlink", GUESTFS_PROC_READLINK,
+                          (xdrproc_t) xdr_guestfs_readlink_args,
+                          (char *) &args,
+                          (xdrproc_t) xdr_guestfs_readlink_ret,
+                          (char *) &ret);
+    if (err < 0)
+      return err;
+    r = ret.link;
   }
 
   /* Note this is different from the real readlink(2) syscall.  FUSE wants
@@ -390,11 +599,6 @@ mount_local_readlink (const char *path, char *buf, size_t size)
   memcpy (buf, r, len);
   buf[len] = '\0';
 
-  if (free_it) {
-    char *tmp = (char *) r;
-    free (tmp);
-  }
-
   return 0;
 }
 
@@ -407,9 +611,10 @@ mount_local_mknod (const char *path, mode_t mode, dev_t rdev)
 
   if (g->ml_read_only) return -EROFS;
 
-  dir_cache_invalidate (g, path);
+  ACQUIRE_HANDLE_LOCK_FOR_CURRENT_SCOPE ();
 
   r = guestfs_mknod (g, mode, major (rdev), minor (rdev), path);
+  dir_cache_invalidate (g, path);
   if (r == -1)
     RETURN_ERRNO;
 
@@ -425,9 +630,10 @@ mount_local_mkdir (const char *path, mode_t mode)
 
   if (g->ml_read_only) return -EROFS;
 
-  dir_cache_invalidate (g, path);
+  ACQUIRE_HANDLE_LOCK_FOR_CURRENT_SCOPE ();
 
   r = guestfs_mkdir_mode (g, path, mode);
+  dir_cache_invalidate (g, path);
   if (r == -1)
     RETURN_ERRNO;
 
@@ -443,9 +649,10 @@ mount_local_unlink (const char *path)
 
   if (g->ml_read_only) return -EROFS;
 
-  dir_cache_invalidate (g, path);
+  ACQUIRE_HANDLE_LOCK_FOR_CURRENT_SCOPE ();
 
   r = guestfs_rm (g, path);
+  dir_cache_invalidate (g, path);
   if (r == -1)
     RETURN_ERRNO;
 
@@ -461,9 +668,10 @@ mount_local_rmdir (const char *path)
 
   if (g->ml_read_only) return -EROFS;
 
-  dir_cache_invalidate (g, path);
+  ACQUIRE_HANDLE_LOCK_FOR_CURRENT_SCOPE ();
 
   r = guestfs_rmdir (g, path);
+  dir_cache_invalidate (g, path);
   if (r == -1)
     RETURN_ERRNO;
 
@@ -479,9 +687,10 @@ mount_local_symlink (const char *from, const char *to)
 
   if (g->ml_read_only) return -EROFS;
 
-  dir_cache_invalidate (g, to);
+  ACQUIRE_HANDLE_LOCK_FOR_CURRENT_SCOPE ();
 
   r = guestfs_ln_s (g, from, to);
+  dir_cache_invalidate (g, to);
   if (r == -1)
     RETURN_ERRNO;
 
@@ -497,10 +706,11 @@ mount_local_rename (const char *from, const char *to)
 
   if (g->ml_read_only) return -EROFS;
 
-  dir_cache_invalidate (g, from);
-  dir_cache_invalidate (g, to);
+  ACQUIRE_HANDLE_LOCK_FOR_CURRENT_SCOPE ();
 
   r = guestfs_rename (g, from, to);
+  dir_cache_invalidate (g, from);
+  dir_cache_invalidate (g, to);
   if (r == -1)
     RETURN_ERRNO;
 
@@ -516,10 +726,11 @@ mount_local_link (const char *from, const char *to)
 
   if (g->ml_read_only) return -EROFS;
 
-  dir_cache_invalidate (g, from);
-  dir_cache_invalidate (g, to);
+  ACQUIRE_HANDLE_LOCK_FOR_CURRENT_SCOPE ();
 
   r = guestfs_ln (g, from, to);
+  dir_cache_invalidate (g, from);
+  dir_cache_invalidate (g, to);
   if (r == -1)
     RETURN_ERRNO;
 
@@ -535,9 +746,10 @@ mount_local_chmod (const char *path, mode_t mode)
 
   if (g->ml_read_only) return -EROFS;
 
-  dir_cache_invalidate (g, path);
+  ACQUIRE_HANDLE_LOCK_FOR_CURRENT_SCOPE ();
 
   r = guestfs_chmod (g, mode, path);
+  dir_cache_invalidate (g, path);
   if (r == -1)
     RETURN_ERRNO;
 
@@ -553,9 +765,10 @@ mount_local_chown (const char *path, uid_t uid, gid_t gid)
 
   if (g->ml_read_only) return -EROFS;
 
-  dir_cache_invalidate (g, path);
+  ACQUIRE_HANDLE_LOCK_FOR_CURRENT_SCOPE ();
 
   r = guestfs_lchown (g, uid, gid, path);
+  dir_cache_invalidate (g, path);
   if (r == -1)
     RETURN_ERRNO;
 
@@ -571,9 +784,10 @@ mount_local_truncate (const char *path, off_t size)
 
   if (g->ml_read_only) return -EROFS;
 
-  dir_cache_invalidate (g, path);
+  ACQUIRE_HANDLE_LOCK_FOR_CURRENT_SCOPE ();
 
   r = guestfs_truncate_size (g, path, size);
+  dir_cache_invalidate (g, path);
   if (r == -1)
     RETURN_ERRNO;
 
@@ -592,7 +806,7 @@ mount_local_utimens (const char *path, const struct timespec ts[2])
 
   if (g->ml_read_only) return -EROFS;
 
-  dir_cache_invalidate (g, path);
+  ACQUIRE_HANDLE_LOCK_FOR_CURRENT_SCOPE ();
 
   atsecs = ts[0].tv_sec;
   atnsecs = ts[0].tv_nsec;
@@ -617,34 +831,243 @@ mount_local_utimens (const char *path, const struct timespec ts[2])
 #endif
 
   r = guestfs_utimens (g, path, atsecs, atnsecs, mtsecs, mtnsecs);
+  dir_cache_invalidate (g, path);
   if (r == -1)
     RETURN_ERRNO;
 
   return 0;
 }
 
-/* All this function needs to do is to check that the requested open
- * flags are valid.  See the notes in <fuse/fuse.h>.
+/* Check that the requested open flags are valid (see the notes in
+ * <fuse/fuse.h>), then open the file in the daemon.  The daemon
+ * handle is stored in fi->fh, so that reads and writes don't have to
+ * look up and open the file each time.
  */
 static int
 mount_local_open (const char *path, struct fuse_file_info *fi)
 {
   const int flags = fi->flags & O_ACCMODE;
+  struct ml_file *file;
+  int r;
   DECL_G ();
   DEBUG_CALL ("%s, 0%o", path, (unsigned) fi->flags);
 
   if (g->ml_read_only && flags != O_RDONLY)
     return -EROFS;
 
+  ACQUIRE_HANDLE_LOCK_FOR_CURRENT_SCOPE ();
+
+  r = guestfs_internal_file_open (g, path, flags != O_RDONLY);
+  if (r == -1)
+    RETURN_ERRNO;
+
+  file = calloc (1, sizeof *file);
+  if (file == NULL) {
+    ignore_value (guestfs_internal_file_close (g, r));
+    return -ENOMEM;
+  }
+  file->handle = r;
+  file->g = g;
+  gl_lock_init (file->lock);
+
+  gl_lock_lock (g->ml_cache_lock);
+  file->generation = g->ml_data_generation;
+  gl_lock_unlock (g->ml_cache_lock);
+
+  fi->fh = (uintptr_t) file;
   return 0;
 }
 
+/* Read data from the daemon into the read-ahead buffer of the file.
+ * This is called with the file lock held.  It returns 0 or -errno.
+ */
 static int
-mount_local_read (const char *path, char *buf, size_t size, off_t offset,
-                  struct fuse_file_info *fi)
+fill_buffer (guestfs_h *g, struct ml_file *file, size_t size, off_t offset)
 {
+  const int sequential = offset == file->next_offset;
+  size_t count;
+  size_t rsize;
   char *r;
+
+  /* Grow the window while reads are sequential.  A random read
+   * resets it, and only the requested data is read.
+   */
+  if (sequential)
+    file->window =
+      file->window == 0 ? READAHEAD_MIN : MIN (file->window * 2, READAHEAD_MAX);
+  else
+    file->window = 0;
+
+  count = MAX (size, file->window);
+  gl_lock_lock (g->ml_cache_lock);
+  if (count > size &&
+      g->ml_readahead_bytes - file->buf_len + count > READAHEAD_TOTAL)
+    count = size;
+  gl_lock_unlock (g->ml_cache_lock);
+
+  {
+    ACQUIRE_HANDLE_LOCK_FOR_CURRENT_SCOPE ();
+
+    r = guestfs_internal_file_pread (g, file->handle, count, offset, &rsize);
+    if (r == NULL)
+      RETURN_ERRNO;
+  }
+
+  if (rsize > count)
+    rsize = count;
+
+  gl_lock_lock (g->ml_cache_lock);
+  g->ml_readahead_bytes -= file->buf_len;
+  g->ml_readahead_bytes += rsize;
+  gl_lock_unlock (g->ml_cache_lock);
+
+  free (file->buf);
+  file->buf = r;
+  file->buf_offset = offset;
+  file->buf_len = rsize;
+  file->buf_eof = rsize < count;
+
+  return 0;
+}
+
+/* The background read started by start_readahead. */
+static void *
+readahead_thread (void *filev)
+{
+  struct ml_file *file = filev;
+  guestfs_h *g = file->g;
   size_t rsize;
+  char *r;
+
+  {
+    ACQUIRE_HANDLE_LOCK_FOR_CURRENT_SCOPE ();
+
+    /* Nobody is waiting for this data yet, so don't report errors.
+     * The read is repeated in the foreground if this fails.
+     */
+    guestfs_push_error_handler (g, NULL, NULL);
+    r = guestfs_internal_file_pread (g, file->handle, file->ra_count,
+                                     file->ra_offset, &rsize);
+    guestfs_pop_error_handler (g);
+  }
+  if (r == NULL)
+    return NULL;
+
+  if (rsize > file->ra_count)
+    rsize = file->ra_count;
+
+  gl_lock_lock (g->ml_cache_lock);
+  g->ml_readahead_bytes += rsize;
+  gl_lock_unlock (g->ml_cache_lock);
+
+  file->ra_buf = r;
+  file->ra_len = rsize;
+  return NULL;
+}
+
+/* Wait for the background read, if any.  This is called with the
+ * file lock held.
+ */
+static void
+finish_readahead (struct ml_file *file)
+{
+  if (file->ra_running) {
+    ignore_value (glthread_join (file->ra_thread, NULL));
+    file->ra_running = 0;
+  }
+}
+
+/* Discard the result of the background read.  This is called with
+ * the file lock held, and the background read finished.
+ */
+static void
+discard_readahead (guestfs_h *g, struct ml_file *file)
+{
+  if (file->ra_buf) {
+    gl_lock_lock (g->ml_cache_lock);
+    g->ml_readahead_bytes -= file->ra_len;
+    gl_lock_unlock (g->ml_cache_lock);
+    free (file->ra_buf);
+    file->ra_buf = NULL;
+    file->ra_len = 0;
+  }
+}
+
+/* If the reader is sequential and has consumed half of the buffer,
+ * start reading the next window in the background.  This is called
+ * with the file lock held.
+ */
+static void
+start_readahead (guestfs_h *g, struct ml_file *file)
+{
+  const off_t end = file->buf_offset + file->buf_len;
+  size_t count;
+  int ok;
+
+  if (file->window == 0 || file->buf_eof || file->ra_running ||
+      file->ra_buf != NULL ||
+      file->next_offset - file->buf_offset < (off_t) file->buf_len / 2)
+    return;
+
+  count = MIN (file->window * 2, READAHEAD_MAX);
+  gl_lock_lock (g->ml_cache_lock);
+  ok = g->ml_readahead_bytes + count <= READAHEAD_TOTAL;
+  file->ra_generation = g->ml_data_generation;
+  gl_lock_unlock (g->ml_cache_lock);
+  if (!ok)
+    return;
+
+  file->window = count;
+  file->ra_offset = end;
+  file->ra_count = count;
+  if (glthread_create (&file->ra_thread, readahead_thread, file) == 0)
+    file->ra_running = 1;
+}
+
+/* Replace the buffer with the result of the background read if that
+ * is still valid and contains the data at 'offset'.  This is called
+ * with the file lock held.  Returns true if the buffer was replaced.
+ */
+static int
+use_readahead (guestfs_h *g, struct ml_file *file, size_t size, off_t offset)
+{
+  int eof, ok;
+
+  finish_readahead (file);
+  if (file->ra_buf == NULL)
+    return 0;
+  eof = file->ra_len < file->ra_count;
+
+  gl_lock_lock (g->ml_cache_lock);
+  ok = file->ra_generation == g->ml_data_generation &&
+    offset >= file->ra_offset &&
+    (offset + size <= file->ra_offset + file->ra_len ||
+     (eof && offset <= file->ra_offset + file->ra_len));
+  if (ok) {
+    g->ml_readahead_bytes -= file->buf_len;
+    free (file->buf);
+    file->buf = file->ra_buf;
+    file->buf_offset = file->ra_offset;
+    file->buf_len = file->ra_len;
+    file->buf_eof = eof;
+    file->ra_buf = NULL;
+    file->ra_len = 0;
+  }
+  gl_lock_unlock (g->ml_cache_lock);
+
+  if (!ok)
+    discard_readahead (g, file);
+  return ok;
+}
+
+static int
+mount_local_read (const char *path, char *buf, size_t size, off_t offset,
+                  struct fuse_file_info *fi)
+{
+  struct ml_file *file = (struct ml_file *) (uintptr_t) fi->fh;
+  size_t n;
+  int hit, r;
+  uint64_t hits, misses;
   const size_t limit = 2 * 1024 * 1024;
   DECL_G ();
   DEBUG_CALL ("%s, %p, %zu, %ld", path, buf, size, (long) offset);
@@ -656,26 +1079,69 @@ mount_local_read (const char *path, char *buf, size_t size, off_t offset,
   if (size > limit)
     size = limit;
 
-  r = guestfs_pread (g, path, size, offset, &rsize);
-  if (r == NULL)
-    RETURN_ERRNO;
+  gl_lock_lock (file->lock);
 
-  /* This should never happen, but at least it stops us overflowing
-   * the output buffer if it does happen.
+  /* Discard the buffer if anything was changed through the
+   * mountpoint since it was read.
    */
-  if (rsize > size)
-    rsize = size;
+  gl_lock_lock (g->ml_cache_lock);
+  if (file->generation != g->ml_data_generation) {
+    g->ml_readahead_bytes -= file->buf_len;
+    free (file->buf);
+    file->buf = NULL;
+    file->buf_len = 0;
+    file->generation = g->ml_data_generation;
+  }
+
+  /* The request can be served from the buffer if all of it is in the
+   * buffer, or if the buffer goes up to the end of the file.
+   */
+  hit = file->buf != NULL &&
+    offset >= file->buf_offset &&
+    (offset + size <= file->buf_offset + file->buf_len ||
+     (file->buf_eof && offset <= file->buf_offset + file->buf_len));
+  gl_lock_unlock (g->ml_cache_lock);
+
+  if (!hit && (file->ra_running || file->ra_buf != NULL))
+    hit = use_readahead (g, file, size, offset);
+
+  gl_lock_lock (g->ml_cache_lock);
+  if (hit)
+    g->ml_readahead_hits++;
+  else
+    g->ml_readahead_misses++;
+  hits = g->ml_readahead_hits;
+  misses = g->ml_readahead_misses;
+  gl_lock_unlock (g->ml_cache_lock);
+
+  if (g->ml_debug_calls)
+    debug (g, "%s: %s: read-ahead %s (%" PRIu64 " hits, %" PRIu64 " misses)",
+           g->localmountpoint, __func__, hit ? "hit" : "miss", hits, misses);
+
+  if (!hit) {
+    r = fill_buffer (g, file, size, offset);
+    if (r < 0) {
+      gl_lock_unlock (file->lock);
+      return r;
+    }
+  }
+
+  n = MIN (size, file->buf_offset + file->buf_len - offset);
+  memcpy (buf, file->buf + (offset - file->buf_offset), n);
+  file->next_offset = offset + n;
 
-  memcpy (buf, r, rsize);
-  free (r);
+  start_readahead (g, file);
 
-  return rsize;
+  gl_lock_unlock (file->lock);
+
+  return n;
 }
 
 static int
 mount_local_write (const char *path, const char *buf, size_t size,
                    off_t offset, struct fuse_file_info *fi)
 {
+  struct ml_file *file = (struct ml_file *) (uintptr_t) fi->fh;
   const size_t limit = 2 * 1024 * 1024;
   int r;
   DECL_G ();
@@ -683,13 +1149,14 @@ mount_local_write (const char *path, const char *buf, size_t size,
 
   if (g->ml_read_only) return -EROFS;
 
-  dir_cache_invalidate (g, path);
+  ACQUIRE_HANDLE_LOCK_FOR_CURRENT_SCOPE ();
 
   /* See mount_local_read. */
   if (size > limit)
     size = limit;
 
-  r = guestfs_pwrite (g, path, buf, size, offset);
+  r = guestfs_internal_file_pwrite (g, file->handle, buf, size, offset);
+  dir_cache_invalidate (g, path);
   if (r == -1)
     RETURN_ERRNO;
 
@@ -703,6 +1170,8 @@ mount_local_statfs (const char *path, struct statvfs *stbuf)
   DECL_G ();
   DEBUG_CALL ("%s, %p", path, stbuf);
 
+  ACQUIRE_HANDLE_LOCK_FOR_CURRENT_SCOPE ();
+
   r = guestfs_statvfs (g, path);
   if (r == NULL)
     RETURN_ERRNO;
@@ -725,12 +1194,28 @@ mount_local_statfs (const char *path, struct statvfs *stbuf)
 static int
 mount_local_release (const char *path, struct fuse_file_info *fi)
 {
+  struct ml_file *file = (struct ml_file *) (uintptr_t) fi->fh;
   DECL_G ();
   DEBUG_CALL ("%s", path);
 
-  /* Just a stub. This method is optional and can safely be left
-   * unimplemented.
-   */
+  finish_readahead (file);
+  discard_readahead (g, file);
+
+  /* FUSE ignores the return value of release. */
+  {
+    ACQUIRE_HANDLE_LOCK_FOR_CURRENT_SCOPE ();
+
+    ignore_value (guestfs_internal_file_close (g, file->handle));
+  }
+
+  gl_lock_lock (g->ml_cache_lock);
+  g->ml_readahead_bytes -= file->buf_len;
+  gl_lock_unlock (g->ml_cache_lock);
+
+  gl_lock_destroy (file->lock);
+  free (file->buf);
+  free (file);
+
   return 0;
 }
 
@@ -743,6 +1228,8 @@ mount_local_fsync (const char *path, int isdatasync,
   DECL_G ();
   DEBUG_CALL ("%s, %d", path, isdatasync);
 
+  ACQUIRE_HANDLE_LOCK_FOR_CURRENT_SCOPE ();
+
   r = guestfs_sync (g);
   if (r == -1)
     RETURN_ERRNO;
@@ -760,10 +1247,11 @@ mount_local_setxattr (const char *path, const char *name, const char *value,
 
   if (g->ml_read_only) return -EROFS;
 
-  dir_cache_invalidate (g, path);
+  ACQUIRE_HANDLE_LOCK_FOR_CURRENT_SCOPE ();
 
   /* XXX Underlying guestfs(3) API doesn't understand the flags. */
   r = guestfs_lsetxattr (g, name, value, size, path);
+  dir_cache_invalidate (g, path);
   if (r == -1)
     RETURN_ERRNO;
 
@@ -778,8 +1266,7 @@ static int
 mount_local_getxattr (const char *path, const char *name, char *value,
                       size_t size)
 {
-  const struct guestfs_xattr_list *xattrs;
-  int free_attrs = 0;
+  struct guestfs_xattr_list *xattrs;
   ssize_t r;
   size_t i, sz;
   DECL_G ();
@@ -787,10 +1274,11 @@ mount_local_getxattr (const char *path, const char *name, char *value,
 
   xattrs = xac_lookup (g, path);
   if (xattrs == NULL) {
-    xattrs = guestfs_lgetxattrs (g, path);
+    int err;
+
+    xattrs = pipelined_lgetxattrs (g, path, &err);
     if (xattrs == NULL)
-      RETURN_ERRNO;
-    free_attrs = 1;
+      return err;
   }
 
   /* Find the matching attribute (index in 'i'). */
@@ -826,8 +1314,7 @@ mount_local_getxattr (const char *path, const char *name, char *value,
   memcpy (value, xattrs->val[i].attrval, sz);
 
  out:
-  if (free_attrs)
-    guestfs_free_xattr_list ((struct guestfs_xattr_list *) xattrs);
+  guestfs_free_xattr_list (xattrs);
 
   return r;
 }
@@ -836,8 +1323,7 @@ mount_local_getxattr (const char *path, const char *name, char *value,
 static int
 mount_local_listxattr (const char *path, char *list, size_t size)
 {
-  const struct guestfs_xattr_list *xattrs;
-  int free_attrs = 0;
+  struct guestfs_xattr_list *xattrs;
   size_t space = 0;
   size_t len;
   size_t i;
@@ -847,10 +1333,11 @@ mount_local_listxattr (const char *path, char *list, size_t size)
 
   xattrs = xac_lookup (g, path);
   if (xattrs == NULL) {
-    xattrs = guestfs_lgetxattrs (g, path);
+    int err;
+
+    xattrs = pipelined_lgetxattrs (g, path, &err);
     if (xattrs == NULL)
-      RETURN_ERRNO;
-    free_attrs = 1;
+      return err;
   }
 
   /* Calculate how much space is required to hold the result. */
@@ -886,8 +1373,7 @@ mount_local_listxattr (const char *path, char *list, size_t size)
   }
 
  out:
-  if (free_attrs)
-    guestfs_free_xattr_list ((struct guestfs_xattr_list *) xattrs);
+  guestfs_free_xattr_list (xattrs);
 
   return r;
 }
@@ -901,9 +1387,10 @@ mount_local_removexattr(const char *path, const char *name)
 
   if (g->ml_read_only) return -EROFS;
 
-  dir_cache_invalidate (g, path);
+  ACQUIRE_HANDLE_LOCK_FOR_CURRENT_SCOPE ();
 
   r = guestfs_lremovexattr (g, name, path);
+  dir_cache_invalidate (g, path);
   if (r == -1)
     RETURN_ERRNO;
 
@@ -983,6 +1470,14 @@ guestfs_impl_mount_local (guestfs_h *g, const char *localmountpoint,
     g->ml_debug_calls = optargs->debugcalls;
   else
     g->ml_debug_calls = 0;
+  if (optargs->bitmask & GUESTFS_MOUNT_LOCAL_MULTITHREADED_BITMASK)
+    g->ml_multithreaded = optargs->multithreaded;
+  else
+    g->ml_multithreaded = 0;
+
+  g->ml_data_generation = 0;
+  g->ml_readahead_hits = g->ml_readahead_misses = 0;
+  g->ml_readahead_bytes = 0;
 
   /* Initialize the directory caches in the handle. */
   if (init_dir_caches (g) == -1)
@@ -1072,14 +1567,20 @@ guestfs_impl_mount_local_run (guestfs_h *g)
     return -1;
   }
 
-  debug (g, "%s: entering fuse_loop", __func__);
+  debug (g, "%s: entering %s", __func__,
+         g->ml_multithreaded ? "fuse_loop_mt" : "fuse_loop");
 
   /* Enter the main loop. */
-  r = fuse_loop (g->fuse);
+  if (g->ml_multithreaded)
+    r = fuse_loop_mt (g->fuse);
+  else
+    r = fuse_loop (g->fuse);
   if (r != 0)
     perrorf (g, _("fuse_loop: %s"), g->localmountpoint);
 
   debug (g, "%s: leaving fuse_loop", __func__);
+  debug (g, "%s: read-ahead: %" PRIu64 " hits, %" PRIu64 " misses",
+         __func__, g->ml_readahead_hits, g->ml_readahead_misses);
 
   guestfs_int_free_fuse (g);
   gl_lock_lock (mount_local_lock);
@@ -1306,9 +1807,11 @@ gen_remove_all_expired (Hash_table *ht, Hash_data_freer freer, time_t now)
 static void
 dir_cache_remove_all_expired (guestfs_h *g, time_t now)
 {
+  gl_lock_lock (g->ml_cache_lock);
   gen_remove_all_expired (g->lsc_ht, lsc_free, now);
   gen_remove_all_expired (g->xac_ht, xac_free, now);
   gen_remove_all_expired (g->rlc_ht, rlc_free, now);
+  gl_lock_unlock (g->ml_cache_lock);
 }
 
 static int
@@ -1317,10 +1820,15 @@ gen_replace (guestfs_h *g, Hash_table *ht,
 {
   struct entry_common *old_entry;
 
+  gl_lock_lock (g->ml_cache_lock);
+
   old_entry = hash_delete (ht, new_entry);
   freer (old_entry);
 
   old_entry = hash_insert (ht, new_entry);
+
+  gl_lock_unlock (g->ml_cache_lock);
+
   if (old_entry == NULL) {
     perrorf (g, "hash_insert");
     freer (new_entry);
@@ -1430,52 +1938,67 @@ rlc_insert (guestfs_h *g,
   return gen_replace (g, g->rlc_ht, (struct entry_common *) entry, rlc_free);
 }
 
-static const struct stat *
-lsc_lookup (guestfs_h *g, const char *pathname)
+/* The lookup functions return a copy of the cache entry, since the
+ * entry could be freed by another thread as soon as the cache lock is
+ * released.
+ */
+static int
+lsc_lookup (guestfs_h *g, const char *pathname, struct stat *statbuf)
 {
   const struct entry_common key = { .pathname = (char *) pathname };
   struct lsc_entry *entry;
   time_t now;
+  int r = 0;
 
   time (&now);
 
+  gl_lock_lock (g->ml_cache_lock);
   entry = hash_lookup (g->lsc_ht, &key);
-  if (entry && entry->c.timeout >= now)
-    return &entry->statbuf;
-  else
-    return NULL;
+  if (entry && entry->c.timeout >= now) {
+    memcpy (statbuf, &entry->statbuf, sizeof *statbuf);
+    r = 1;
+  }
+  gl_lock_unlock (g->ml_cache_lock);
+
+  return r;
 }
 
-static const struct guestfs_xattr_list *
+static struct guestfs_xattr_list *
 xac_lookup (guestfs_h *g, const char *pathname)
 {
   const struct entry_common key = { .pathname = (char *) pathname };
   struct xac_entry *entry;
+  struct guestfs_xattr_list *r = NULL;
   time_t now;
 
   time (&now);
 
+  gl_lock_lock (g->ml_cache_lock);
   entry = hash_lookup (g->xac_ht, &key);
   if (entry && entry->c.timeout >= now)
-    return entry->xattrs;
-  else
-    return NULL;
+    r = copy_xattr_list (g, entry->xattrs->val, entry->xattrs->len);
+  gl_lock_unlock (g->ml_cache_lock);
+
+  return r;
 }
 
-static const char *
+static char *
 rlc_lookup (guestfs_h *g, const char *pathname)
 {
   const struct entry_common key = { .pathname = (char *) pathname };
   struct rlc_entry *entry;
+  char *r = NULL;
   time_t now;
 
   time (&now);
 
+  gl_lock_lock (g->ml_cache_lock);
   entry = hash_lookup (g->rlc_ht, &key);
   if (entry && entry->c.timeout >= now)
-    return entry->link;
-  else
-    return NULL;
+    r = strdup (entry->link);
+  gl_lock_unlock (g->ml_cache_lock);
+
+  return r;
 }
 
 static void
@@ -1492,9 +2015,16 @@ gen_remove (Hash_table *ht, const char *pathname, Hash_data_freer freer)
 static void
 dir_cache_invalidate (guestfs_h *g, const char *path)
 {
+  /* This is called for every change made through the mountpoint, so
+   * also use it to discard the read-ahead buffers of all files.
+   */
+  gl_lock_lock (g->ml_cache_lock);
+  g->ml_data_generation++;
+
   gen_remove (g->lsc_ht, path, lsc_free);
   gen_remove (g->xac_ht, path, xac_free);
   gen_remove (g->rlc_ht, path, rlc_free);
+  gl_lock_unlock (g->ml_cache_lock);
 }
 
 #else /* !HAVE_FUSE */
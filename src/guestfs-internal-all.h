@@ -112,4 +112,8 @@ typedef enum {
   MOUNTABLE_PATH        /* An already mounted path: device = path */
 } mountable_type_t;
 
+/* is-zero.c */
+extern int guestfs_int_is_zero (const void *buffer, size_t size);
+extern int guestfs_int_is_zero_portable (const void *buffer, size_t size);
+
 #endif /* GUESTFS_INTERNAL_ALL_H_ */
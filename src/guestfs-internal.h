@@ -28,6 +28,7 @@
 #define GUESTFS_INTERNAL_H_
 
 #include <stdbool.h>
+#include <sys/uio.h>
 
 #include <rpc/types.h>  /* Needed on libc's different than glibc. */
 #include <rpc/xdr.h>
@@ -54,6 +55,8 @@
 #endif
 
 #include "hash.h"
+#include "glthread/lock.h"
+#include "glthread/cond.h"
 
 #include "guestfs-internal-frontend.h"
 
@@ -115,6 +118,15 @@
  */
 #define APPLIANCE_TIMEOUT (20*60) /* 20 mins */
 
+/* Limits on pipelined requests (see guestfs_int_pipeline_send).
+ * The byte limit is kept well below the size of the socket and
+ * virtio-serial buffers, so that writing a pipelined request can
+ * never block waiting for the daemon, which could itself be blocked
+ * writing a reply that we are not yet reading.
+ */
+#define PIPELINE_MAX_REQUESTS 64
+#define PIPELINE_MAX_BYTES (64 * 1024)
+
 /* Some limits on what the inspection code will read, for safety. */
 
 /* Small text configuration files.
@@ -344,6 +356,8 @@ struct connection {
    */
 };
 
+#define CONN_MAX_IOV 4
+
 struct connection_ops {
   /* Close everything and free the connection struct and any internal data. */
   void (*free_connection) (guestfs_h *g, struct connection *);
@@ -369,6 +383,12 @@ struct connection_ops {
   ssize_t (*read_data) (guestfs_h *g, struct connection *, void *buf, size_t len);
   ssize_t (*write_data) (guestfs_h *g, struct connection *, const void *buf, size_t len);
 
+  /* Like write_data, but gathers the data from up to CONN_MAX_IOV
+   * separate buffers, so the caller does not need to copy them into
+   * one buffer first.
+   */
+  ssize_t (*write_datav) (guestfs_h *g, struct connection *, const struct iovec *iov, int iovcnt);
+
   /* Test if data is available to read on the daemon socket, without blocking.
    * Returns: 1 = yes, 0 = no, -1 = error
    */
@@ -394,6 +414,25 @@ struct cached_feature {
   int result;
 };
 
+/**
+ * Cache of disk image information.
+ *
+ * Used to cache the results of C<guestfs_disk_format> etc (see
+ * F<src/info.c>).  The image is identified by its device and inode,
+ * and the size and mtime are checked so that modified images are
+ * probed again.
+ */
+struct cached_disk_info {
+  uint64_t dev;
+  uint64_t ino;
+  int64_t size;
+  int64_t mtime_sec;
+  int64_t mtime_nsec;
+  char *format;
+  int64_t virtual_size;
+  int has_backing_file;
+};
+
 /**
  * The libguestfs handle.
  */
@@ -410,6 +449,7 @@ struct guestfs_h {
   bool enable_network;          /* Enable the network. */
   bool selinux;                 /* selinux enabled? */
   bool pgroup;                  /* Create process group for children? */
+  bool inspect_cache;           /* Cache inspection results on disk? */
   bool close_on_exit;           /* Is this handle on the atexit list? */
 
   int smp;                      /* If > 1, -smp flag passed to hv. */
@@ -489,6 +529,11 @@ struct guestfs_h {
   struct inspect_fs *fses;
   size_t nr_fses;
 
+  /* Paths prefetched while inspect_os checks a mounted filesystem,
+   * see prefetch_paths in inspect-fs.c.  NULL if not in use.
+   */
+  const struct guestfs_statns *prefetched;
+
   /* Private data area. */
   struct hash_table *pda;
   struct pda_entry *pda_next;
@@ -513,6 +558,17 @@ struct guestfs_h {
   struct connection *conn;              /* Connection to appliance. */
   int msg_next_serial;
 
+  /* Pipelined requests, see guestfs_int_pipeline_send. */
+  size_t pipeline_outstanding;   /* Requests sent, reply not yet read. */
+  size_t pipeline_bytes;         /* Total size of outstanding requests. */
+  size_t pipeline_sizes[PIPELINE_MAX_REQUESTS]; /* Size of each request. */
+  struct pipeline_reply *pipeline_replies; /* Replies read, not collected. */
+
+  /* Size of FileIn/FileOut chunks negotiated with the daemon after
+   * launch, or 0 if not negotiated (use GUESTFS_DEFAULT_CHUNK_SIZE).
+   */
+  size_t chunk_size;
+
 #if HAVE_FUSE
   /**** Used by the mount-local APIs. ****/
   const char *localmountpoint;
@@ -521,6 +577,15 @@ struct guestfs_h {
   Hash_table *lsc_ht, *xac_ht, *rlc_ht; /* Directory cache. */
   int ml_read_only;                     /* If mounted read-only. */
   int ml_debug_calls;        /* Extra debug info on each FUSE call. */
+  int ml_multithreaded;                 /* Use the multithreaded loop. */
+  gl_lock_define (, ml_handle_lock);    /* Serializes calls on the handle. */
+  gl_lock_define (, ml_cache_lock);     /* Protects the caches. */
+  gl_cond_define (, ml_pipeline_cond);  /* Pipelined calls, see fuse.c. */
+  uint64_t ml_next_send, ml_next_recv;
+  size_t ml_waiting_senders;
+  uint64_t ml_data_generation;          /* Incremented on every change. */
+  size_t ml_readahead_bytes;            /* Total size of read-ahead buffers. */
+  uint64_t ml_readahead_hits, ml_readahead_misses;
 #endif
 
 #ifdef HAVE_LIBVIRT_BACKEND
@@ -537,6 +602,10 @@ struct guestfs_h {
   /* Cached features. */
   struct cached_feature *features;
   size_t nr_features;
+
+  /* Cached disk image information. */
+  struct cached_disk_info *disk_info;
+  size_t nr_disk_info;
 };
 
 /**
@@ -795,7 +864,14 @@ extern int guestfs_int_recv (guestfs_h *g, const char *fn, struct guestfs_messag
 extern int guestfs_int_recv_discard (guestfs_h *g, const char *fn);
 extern int guestfs_int_send_file (guestfs_h *g, const char *filename);
 extern int guestfs_int_recv_file (guestfs_h *g, const char *filename);
+extern int guestfs_int_recv_stream (guestfs_h *g, const char *fn, xdrproc_t xdrp, char *ret);
 extern int guestfs_int_recv_from_daemon (guestfs_h *g, uint32_t *size_rtn, void **buf_rtn);
+extern size_t guestfs_int_chunk_size (guestfs_h *g);
+extern void guestfs_int_negotiate_chunk_size (guestfs_h *g);
+extern int guestfs_int_pipeline_send (guestfs_h *g, int proc_nr, uint64_t optargs_bitmask, xdrproc_t xdrp, char *args);
+extern int guestfs_int_pipeline_recv (guestfs_h *g, const char *fn, int proc_nr, int serial, xdrproc_t xdrp, char *ret);
+extern void guestfs_int_pipeline_drain (guestfs_h *g);
+extern void guestfs_int_free_pipeline (guestfs_h *g);
 extern void guestfs_int_progress_message_callback (guestfs_h *g, const struct guestfs_progress *message);
 extern void guestfs_int_log_message_callback (guestfs_h *g, const char *buf, size_t len);
 
@@ -829,6 +905,9 @@ extern void guestfs_int_add_dummy_appliance_drive (guestfs_h *g);
 extern void guestfs_int_free_drives (guestfs_h *g);
 extern const char *guestfs_int_drive_protocol_to_string (enum drive_protocol protocol);
 
+/* info.c */
+extern void guestfs_int_free_disk_info_cache (guestfs_h *g);
+
 /* appliance.c */
 extern int guestfs_int_build_appliance (guestfs_h *g, char **kernel, char **initrd, char **appliance);
 
@@ -855,11 +934,17 @@ extern char *guestfs_int_download_to_tmp (guestfs_h *g, struct inspect_fs *fs, c
 extern struct inspect_fs *guestfs_int_search_for_root (guestfs_h *g, const char *root);
 extern int guestfs_int_is_partition (guestfs_h *g, const char *partition);
 
+/* inspect-cache.c */
+extern char *guestfs_int_inspect_cache_key (guestfs_h *g, char *const *fses);
+extern int guestfs_int_inspect_cache_load (guestfs_h *g, const char *key);
+extern void guestfs_int_inspect_cache_save (guestfs_h *g, const char *key);
+
 /* inspect-fs.c */
 extern int guestfs_int_is_file_nocase (guestfs_h *g, const char *);
 extern int guestfs_int_is_dir_nocase (guestfs_h *g, const char *);
-extern int guestfs_int_check_for_filesystem_on (guestfs_h *g,
-                                              const char *mountable);
+extern int guestfs_int_inspect_is_file (guestfs_h *g, const char *path, int followsymlinks);
+extern int guestfs_int_inspect_is_dir (guestfs_h *g, const char *path, int followsymlinks);
+extern int guestfs_int_check_for_filesystems (guestfs_h *g, char *const *fses);
 extern int guestfs_int_parse_unsigned_int (guestfs_h *g, const char *str);
 extern int guestfs_int_parse_unsigned_int_ignore_trailing (guestfs_h *g, const char *str);
 extern int guestfs_int_parse_major_minor (guestfs_h *g, struct inspect_fs *fs);
@@ -884,6 +969,35 @@ extern int guestfs_int_check_coreos_usr (guestfs_h *g, struct inspect_fs *fs);
 extern char *guestfs_int_case_sensitive_path_silently (guestfs_h *g, const char *);
 extern char * guestfs_int_get_windows_systemroot (guestfs_h *g);
 extern int guestfs_int_check_windows_root (guestfs_h *g, struct inspect_fs *fs, char *windows_systemroot);
+extern char *guestfs_int_utf16le_to_utf8 (const char *input, size_t len);
+
+/* inspect-registry.c */
+struct hive_value {
+  char *key;
+  int64_t type;                 /* hive_type, eg. 1 = REG_SZ. */
+  char *value;                  /* \0-terminated for convenience. */
+  size_t len;                   /* Length, not including the \0. */
+};
+
+struct hive_node {
+  char *name;
+  size_t nr_values;
+  struct hive_value *values;
+  size_t nr_children;
+  struct hive_node *children;
+};
+
+extern struct hive_node *guestfs_int_hivex_export (guestfs_h *g, int64_t nodeh, int maxdepth);
+extern void guestfs_int_free_hive_node (struct hive_node *node);
+extern const struct hive_node *guestfs_int_hive_node_get_child (const struct hive_node *node, const char *name);
+extern const struct hive_value *guestfs_int_hive_node_get_value (const struct hive_node *node, const char *key);
+extern char *guestfs_int_hive_value_utf8 (guestfs_h *g, const struct hive_value *value);
+#ifdef HAVE_ATTRIBUTE_CLEANUP
+#define CLEANUP_FREE_HIVE_NODE __attribute__((cleanup(guestfs_int_cleanup_free_hive_node)))
+#else
+#define CLEANUP_FREE_HIVE_NODE
+#endif
+extern void guestfs_int_cleanup_free_hive_node (struct hive_node **);
 
 /* inspect-fs-cd.c */
 extern int guestfs_int_check_installer_root (guestfs_h *g, struct inspect_fs *fs);
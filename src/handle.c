@@ -106,6 +106,12 @@ guestfs_create_flags (unsigned flags, ...)
   /* Default is uniprocessor appliance. */
   g->smp = 1;
 
+#if HAVE_FUSE
+  gl_lock_init (g->ml_handle_lock);
+  gl_lock_init (g->ml_cache_lock);
+  gl_cond_init (g->ml_pipeline_cond);
+#endif
+
   g->path = strdup (GUESTFS_DEFAULT_PATH);
   if (!g->path) goto error;
 
@@ -367,10 +373,14 @@ guestfs_close (guestfs_h *g)
 
 #if HAVE_FUSE
   guestfs_int_free_fuse (g);
+  gl_lock_destroy (g->ml_handle_lock);
+  gl_lock_destroy (g->ml_cache_lock);
+  gl_cond_destroy (g->ml_pipeline_cond);
 #endif
 
   guestfs_int_free_inspect_info (g);
   guestfs_int_free_drives (g);
+  guestfs_int_free_disk_info_cache (g);
 
   for (hp = g->hv_params; hp; hp = hp_next) {
     free (hp->hv_param);
@@ -454,6 +464,8 @@ shutdown_backend (guestfs_h *g, int check_for_errors)
     g->conn = NULL;
   }
 
+  guestfs_int_free_pipeline (g);
+  g->chunk_size = 0;
   guestfs_int_free_drives (g);
 
   for (i = 0; i < g->nr_features; ++i)
@@ -907,6 +919,19 @@ guestfs_impl_get_pgroup (guestfs_h *g)
   return g->pgroup;
 }
 
+int
+guestfs_impl_set_inspect_cache (guestfs_h *g, int v)
+{
+  g->inspect_cache = !!v;
+  return 0;
+}
+
+int
+guestfs_impl_get_inspect_cache (guestfs_h *g)
+{
+  return g->inspect_cache;
+}
+
 int
 guestfs_impl_set_smp (guestfs_h *g, int v)
 {
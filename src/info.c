@@ -16,13 +16,26 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+/**
+ * Information about disk images: format, virtual size and whether
+ * the image has a backing file.
+ *
+ * The headers of the common formats (raw, qcow2, vmdk, vdi and vhdx)
+ * are parsed directly.  For anything else we run
+ * S<C<qemu-img info --output json>> and parse its output.  The
+ * results are cached in the handle, since tools such as virt-v2v and
+ * virt-resize ask about the same images many times.
+ */
+
 #include <config.h>
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <inttypes.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <errno.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
@@ -30,6 +43,22 @@
 #include <string.h>
 #include <libintl.h>
 
+#ifdef HAVE_ENDIAN_H
+#include <endian.h>
+#endif
+#ifdef HAVE_SYS_ENDIAN_H
+#include <sys/endian.h>
+#endif
+
+#if defined __APPLE__ && defined __MACH__
+#include <libkern/OSByteOrder.h>
+#define be32toh(x) OSSwapBigToHostInt32(x)
+#define be64toh(x) OSSwapBigToHostInt64(x)
+#define le16toh(x) OSSwapLittleToHostInt16(x)
+#define le32toh(x) OSSwapLittleToHostInt32(x)
+#define le64toh(x) OSSwapLittleToHostInt64(x)
+#endif
+
 #ifdef HAVE_SYS_TIME_H
 #include <sys/time.h>
 #endif
@@ -40,6 +69,8 @@
 
 #include <yajl/yajl_tree.h>
 
+#include "stat-time.h"
+
 #include "guestfs.h"
 #include "guestfs-internal.h"
 #include "guestfs-internal-actions.h"
@@ -57,137 +88,509 @@ cleanup_yajl_tree_free (void *ptr)
 #define CLEANUP_YAJL_TREE_FREE
 #endif
 
-static yajl_val get_json_output (guestfs_h *g, const char *filename);
+/* Information about a disk image.  If the image was probed using
+ * qemu-img, format is NULL or virtual_size is -1 if qemu-img did not
+ * print them.
+ */
+struct disk_info {
+  char *format;
+  int64_t virtual_size;
+  int has_backing_file;
+};
+
+static int get_disk_info (guestfs_h *g, const char *filename, struct disk_info *info);
+static int probe_header (guestfs_h *g, int fd, const char *filename, const struct stat *statbuf, struct disk_info *info);
+static int qemu_img_info (guestfs_h *g, const char *filename, int fd, struct disk_info *info);
 static void set_child_rlimits (struct command *);
 
 char *
 guestfs_impl_disk_format (guestfs_h *g, const char *filename)
 {
-  size_t i, len;
-  CLEANUP_YAJL_TREE_FREE yajl_val tree = get_json_output (g, filename);
+  struct disk_info info;
 
-  if (tree == NULL)
+  if (get_disk_info (g, filename, &info) == -1)
     return NULL;
 
-  if (! YAJL_IS_OBJECT (tree))
-    goto bad_type;
-
-  len = YAJL_GET_OBJECT(tree)->len;
-  for (i = 0; i < len; ++i) {
-    if (STREQ (YAJL_GET_OBJECT(tree)->keys[i], "format")) {
-      const char *str;
-      yajl_val node = YAJL_GET_OBJECT(tree)->values[i];
-      if (YAJL_IS_NULL (node))
-        goto bad_type;
-      str = YAJL_GET_STRING (node);
-      if (str == NULL)
-        goto bad_type;
-      return safe_strdup (g, str); /* caller frees */
-    }
+  if (info.format == NULL) {
+    error (g, _("qemu-img info: JSON output did not contain 'format' key"));
+    return NULL;
   }
 
- bad_type:
-  error (g, _("qemu-img info: JSON output did not contain 'format' key"));
-  return NULL;
+  return info.format; /* caller frees */
 }
 
 int64_t
 guestfs_impl_disk_virtual_size (guestfs_h *g, const char *filename)
 {
-  size_t i, len;
-  CLEANUP_YAJL_TREE_FREE yajl_val tree = get_json_output (g, filename);
+  struct disk_info info;
 
-  if (tree == NULL)
+  if (get_disk_info (g, filename, &info) == -1)
     return -1;
+  free (info.format);
 
-  if (! YAJL_IS_OBJECT (tree))
-    goto bad_type;
-
-  len = YAJL_GET_OBJECT(tree)->len;
-  for (i = 0; i < len; ++i) {
-    if (STREQ (YAJL_GET_OBJECT(tree)->keys[i], "virtual-size")) {
-      yajl_val node = YAJL_GET_OBJECT(tree)->values[i];
-      if (YAJL_IS_NULL (node))
-        goto bad_type;
-      if (! YAJL_IS_NUMBER (node))
-        goto bad_type;
-      if (! YAJL_IS_INTEGER (node)) {
-        error (g, _("qemu-img info: 'virtual-size' is not representable as a 64 bit integer"));
-        return -1;
-      }
-      return YAJL_GET_INTEGER (node);
-    }
+  if (info.virtual_size == -1) {
+    error (g, _("qemu-img info: JSON output did not contain 'virtual-size' key"));
+    return -1;
   }
 
- bad_type:
-  error (g, _("qemu-img info: JSON output did not contain 'virtual-size' key"));
-  return -1;
+  return info.virtual_size;
 }
 
 int
 guestfs_impl_disk_has_backing_file (guestfs_h *g, const char *filename)
 {
-  size_t i, len;
-  CLEANUP_YAJL_TREE_FREE yajl_val tree = get_json_output (g, filename);
+  struct disk_info info;
 
-  if (tree == NULL)
+  if (get_disk_info (g, filename, &info) == -1)
     return -1;
+  free (info.format);
 
-  if (! YAJL_IS_OBJECT (tree))
-    goto bad_type;
+  return info.has_backing_file;
+}
 
-  len = YAJL_GET_OBJECT(tree)->len;
-  for (i = 0; i < len; ++i) {
-    if (STREQ (YAJL_GET_OBJECT(tree)->keys[i], "backing-filename")) {
-      yajl_val node = YAJL_GET_OBJECT(tree)->values[i];
-      /* Work on the assumption that if this field is null, it means
-       * no backing file, rather than being an error.
-       */
-      if (YAJL_IS_NULL (node))
-        return 0;
+/* Maximum number of images remembered in the handle. */
+#define MAX_CACHED_DISK_INFO 256
+
+/* Look for the image in the cache.  Images are identified by their
+ * inode, and the size and mtime are compared so that an image which
+ * has been modified is probed again.
+ */
+static int
+cache_lookup (guestfs_h *g, const struct stat *statbuf, struct disk_info *info)
+{
+  const struct timespec mtime = get_stat_mtime (statbuf);
+  size_t i;
+
+  for (i = 0; i < g->nr_disk_info; ++i) {
+    const struct cached_disk_info *c = &g->disk_info[i];
+
+    if (c->dev == (uint64_t) statbuf->st_dev &&
+        c->ino == (uint64_t) statbuf->st_ino &&
+        c->size == statbuf->st_size &&
+        c->mtime_sec == mtime.tv_sec &&
+        c->mtime_nsec == mtime.tv_nsec) {
+      info->format = c->format ? safe_strdup (g, c->format) : NULL;
+      info->virtual_size = c->virtual_size;
+      info->has_backing_file = c->has_backing_file;
       return 1;
     }
   }
 
-  return 0; /* no backing-filename key means no backing file */
+  return 0;
+}
 
- bad_type:
-  error (g, _("qemu-img info: JSON output was not an object"));
-  return -1;
+static void
+cache_add (guestfs_h *g, const struct stat *statbuf,
+           const struct disk_info *info)
+{
+  const struct timespec mtime = get_stat_mtime (statbuf);
+  struct cached_disk_info *c;
+  size_t i;
+
+  /* Replace any stale entry for the same image. */
+  for (i = 0; i < g->nr_disk_info; ++i) {
+    if (g->disk_info[i].dev == (uint64_t) statbuf->st_dev &&
+        g->disk_info[i].ino == (uint64_t) statbuf->st_ino)
+      break;
+  }
+
+  if (i == g->nr_disk_info) {
+    if (g->nr_disk_info >= MAX_CACHED_DISK_INFO) {
+      /* Throw away the oldest entry. */
+      free (g->disk_info[0].format);
+      memmove (&g->disk_info[0], &g->disk_info[1],
+               (g->nr_disk_info-1) * sizeof (struct cached_disk_info));
+      g->nr_disk_info--;
+      i = g->nr_disk_info;
+    }
+    g->disk_info =
+      safe_realloc (g, g->disk_info,
+                    (g->nr_disk_info+1) * sizeof (struct cached_disk_info));
+    g->nr_disk_info++;
+  }
+  else
+    free (g->disk_info[i].format);
+
+  c = &g->disk_info[i];
+  c->dev = statbuf->st_dev;
+  c->ino = statbuf->st_ino;
+  c->size = statbuf->st_size;
+  c->mtime_sec = mtime.tv_sec;
+  c->mtime_nsec = mtime.tv_nsec;
+  c->format = info->format ? safe_strdup (g, info->format) : NULL;
+  c->virtual_size = info->virtual_size;
+  c->has_backing_file = info->has_backing_file;
 }
 
-/* Run 'qemu-img info --output json filename', and parse the output
- * as JSON, returning a JSON tree and handling errors.
+/**
+ * Free the cache of disk image information (called when the handle
+ * is closed).
  */
-static void parse_json (guestfs_h *g, void *treevp, const char *input, size_t len);
-#define PARSE_JSON_NO_OUTPUT ((void *) -1)
+void
+guestfs_int_free_disk_info_cache (guestfs_h *g)
+{
+  size_t i;
 
-static yajl_val
-get_json_output (guestfs_h *g, const char *filename)
+  for (i = 0; i < g->nr_disk_info; ++i)
+    free (g->disk_info[i].format);
+  free (g->disk_info);
+  g->disk_info = NULL;
+  g->nr_disk_info = 0;
+}
+
+/* Get the information about a disk image, from the cache, by parsing
+ * the header, or by running qemu-img.  The caller must free
+ * info->format.
+ */
+static int
+get_disk_info (guestfs_h *g, const char *filename, struct disk_info *info)
 {
-  CLEANUP_CMD_CLOSE struct command *cmd = guestfs_int_new_command (g);
   int fd, r;
-  char fdpath[64];
-  yajl_val tree = NULL;
   struct stat statbuf;
 
   fd = open (filename, O_RDONLY /* NB: !O_CLOEXEC */);
   if (fd == -1) {
     perrorf (g, "disk info: %s", filename);
-    return NULL;
+    return -1;
   }
 
   if (fstat (fd, &statbuf) == -1) {
     perrorf (g, "disk info: fstat: %s", filename);
     close (fd);
-    return NULL;
+    return -1;
   }
   if (S_ISDIR (statbuf.st_mode)) {
     error (g, "disk info: %s is a directory", filename);
     close (fd);
-    return NULL;
+    return -1;
+  }
+
+  /* Only regular files are cached, since writing to a block device
+   * doesn't change its mtime.
+   */
+  if (S_ISREG (statbuf.st_mode) && cache_lookup (g, &statbuf, info)) {
+    close (fd);
+    return 0;
+  }
+
+  info->format = NULL;
+  info->virtual_size = -1;
+  info->has_backing_file = 0;
+
+  r = probe_header (g, fd, filename, &statbuf, info);
+  if (r == 0)                   /* Unknown format. */
+    r = qemu_img_info (g, filename, fd, info);
+  close (fd);
+  if (r == -1) {
+    free (info->format);
+    return -1;
+  }
+
+  debug (g, "disk info: %s: format %s, virtual size %" PRIi64 "%s",
+         filename, info->format ? info->format : "(none)",
+         info->virtual_size,
+         info->has_backing_file ? ", has backing file" : "");
+
+  if (S_ISREG (statbuf.st_mode))
+    cache_add (g, &statbuf, info);
+
+  return 0;
+}
+
+/* Read up to len bytes at offset.  Short reads (at the end of the
+ * file) are padded with zeroes.
+ */
+static int
+read_at (guestfs_h *g, int fd, const char *filename,
+         void *buf, size_t len, off_t offset)
+{
+  char *p = buf;
+  ssize_t r;
+
+  memset (buf, 0, len);
+  while (len > 0) {
+    r = pread (fd, p, len, offset);
+    if (r == -1) {
+      if (errno == EINTR)
+        continue;
+      perrorf (g, "disk info: pread: %s", filename);
+      return -1;
+    }
+    if (r == 0)
+      break;
+    p += r;
+    len -= r;
+    offset += r;
+  }
+
+  return 0;
+}
+
+static inline uint16_t
+get_le16 (const char *p)
+{
+  uint16_t v;
+  memcpy (&v, p, sizeof v);
+  return le16toh (v);
+}
+
+static inline uint32_t
+get_le32 (const char *p)
+{
+  uint32_t v;
+  memcpy (&v, p, sizeof v);
+  return le32toh (v);
+}
+
+static inline uint64_t
+get_le64 (const char *p)
+{
+  uint64_t v;
+  memcpy (&v, p, sizeof v);
+  return le64toh (v);
+}
+
+static inline uint32_t
+get_be32 (const char *p)
+{
+  uint32_t v;
+  memcpy (&v, p, sizeof v);
+  return be32toh (v);
+}
+
+static inline uint64_t
+get_be64 (const char *p)
+{
+  uint64_t v;
+  memcpy (&v, p, sizeof v);
+  return be64toh (v);
+}
+
+/* qcow2 (versions 2 and 3). */
+static int
+probe_qcow2 (guestfs_h *g, const char *header, struct disk_info *info)
+{
+  const uint32_t version = get_be32 (&header[4]);
+
+  if (version != 2 && version != 3)
+    return 0;
+
+  info->format = safe_strdup (g, "qcow2");
+  info->virtual_size = get_be64 (&header[24]);
+  info->has_backing_file = get_be64 (&header[8]) != 0;
+  return 1;
+}
+
+/* VMDK monolithic sparse or stream-optimized extents, with an embedded
+ * descriptor.  Other variants (such as separate descriptor files)
+ * can describe several extents, so they are left to qemu-img.
+ */
+static int
+probe_vmdk (guestfs_h *g, int fd, const char *filename,
+            const char *header, struct disk_info *info)
+{
+  const uint64_t capacity = get_le64 (&header[12]);
+  const uint64_t desc_offset = get_le64 (&header[28]);
+  const uint64_t desc_size = get_le64 (&header[36]);
+  CLEANUP_FREE char *desc = NULL;
+
+  if (desc_offset == 0 || desc_size == 0 || desc_size > 2048)
+    return 0;
+
+  desc = safe_malloc (g, desc_size * 512 + 1);
+  if (read_at (g, fd, filename, desc, desc_size * 512, desc_offset * 512) == -1)
+    return -1;
+  desc[desc_size * 512] = '\0';
+
+  if (strstr (desc, "createType=\"monolithicSparse\"") == NULL &&
+      strstr (desc, "createType=\"streamOptimized\"") == NULL)
+    return 0;
+
+  info->format = safe_strdup (g, "vmdk");
+  info->virtual_size = capacity * 512;
+  info->has_backing_file = strstr (desc, "parentFileNameHint") != NULL;
+  return 1;
+}
+
+/* VDI version 1.1, dynamic or static images.  qemu doesn't support
+ * any other kind.
+ */
+static int
+probe_vdi (guestfs_h *g, const char *header, struct disk_info *info)
+{
+  const uint32_t version = get_le32 (&header[68]);
+  const uint32_t image_type = get_le32 (&header[76]);
+
+  if (version != 0x00010001 || (image_type != 1 && image_type != 2))
+    return 0;
+
+  info->format = safe_strdup (g, "vdi");
+  info->virtual_size = get_le64 (&header[368]);
+  info->has_backing_file = 0;
+  return 1;
+}
+
+/* VHDX.  The virtual size is stored in the metadata region, which is
+ * found using the region table.  GUIDs are stored in the usual
+ * Microsoft mixed-endian format.
+ */
+static const char vhdx_metadata_region_guid[16] =
+  "\x06\xa2\x7c\x8b\x90\x47\x9a\x4b\xb8\xfe\x57\x5f\x05\x0f\x88\x6e";
+static const char vhdx_virtual_disk_size_guid[16] =
+  "\x24\x42\xa5\x2f\x1b\xcd\x76\x48\xb2\x11\x5d\xbe\xd8\x3b\xf4\xb8";
+static const char vhdx_parent_locator_guid[16] =
+  "\x2d\x5f\xd3\xa8\x0b\xb3\x4d\x45\xab\xf7\xd3\xd8\x48\x34\xab\x0c";
+
+#define VHDX_TABLE_SIZE (64 * 1024)
+
+static int
+probe_vhdx (guestfs_h *g, int fd, const char *filename,
+            struct disk_info *info)
+{
+  static const off_t region_table_offsets[] = { 192 * 1024, 256 * 1024 };
+  CLEANUP_FREE char *buf = safe_malloc (g, VHDX_TABLE_SIZE);
+  uint64_t metadata_offset = 0;
+  int64_t virtual_size = -1;
+  int has_parent = 0;
+  uint32_t i, j, n;
+  char size[8];
+
+  /* Find the metadata region. */
+  for (i = 0; metadata_offset == 0 && i < 2; ++i) {
+    if (read_at (g, fd, filename, buf, VHDX_TABLE_SIZE,
+                 region_table_offsets[i]) == -1)
+      return -1;
+    if (memcmp (buf, "regi", 4) != 0)
+      continue;
+    n = get_le32 (&buf[8]);
+    for (j = 0; j < n && 16 + (j+1) * 32 <= VHDX_TABLE_SIZE; ++j) {
+      const char *entry = &buf[16 + j * 32];
+      if (memcmp (entry, vhdx_metadata_region_guid, 16) == 0) {
+        metadata_offset = get_le64 (&entry[16]);
+        break;
+      }
+    }
+  }
+  if (metadata_offset == 0)
+    return 0;
+
+  /* Find the virtual disk size and parent locator items. */
+  if (read_at (g, fd, filename, buf, VHDX_TABLE_SIZE, metadata_offset) == -1)
+    return -1;
+  if (memcmp (buf, "metadata", 8) != 0)
+    return 0;
+  n = get_le16 (&buf[10]);
+  for (j = 0; j < n && 32 + (j+1) * 32 <= VHDX_TABLE_SIZE; ++j) {
+    const char *entry = &buf[32 + j * 32];
+    if (memcmp (entry, vhdx_virtual_disk_size_guid, 16) == 0) {
+      if (read_at (g, fd, filename, size, sizeof size,
+                   metadata_offset + get_le32 (&entry[16])) == -1)
+        return -1;
+      virtual_size = get_le64 (size);
+    }
+    else if (memcmp (entry, vhdx_parent_locator_guid, 16) == 0)
+      has_parent = 1;
+  }
+  if (virtual_size == -1)
+    return 0;
+
+  info->format = safe_strdup (g, "vhdx");
+  info->virtual_size = virtual_size;
+  info->has_backing_file = has_parent;
+  return 1;
+}
+
+/* Signatures of other formats that qemu knows about but which we
+ * don't parse.  These are checked so that we don't mistake them for
+ * raw images.
+ */
+static const struct {
+  const char *magic;
+  size_t len;
+} other_formats[] = {
+  { "COWD", 4 },                /* vmdk (ESX) */
+  { "# Disk DescriptorFile", 21 }, /* vmdk descriptor */
+  { "QED\0", 4 },
+  { "conectix", 8 },            /* vpc */
+  { "Bochs Virtual HD Image", 22 },
+  { "WithoutFreeSpace", 16 },   /* parallels */
+  { "WithouFreSpacExt", 16 },   /* parallels */
+  { "LUKS\xba\xbe", 6 },
+  { "#!/bin/sh\n#V2.0 Format", 22 }, /* cloop */
+};
+
+/* Probe the image header.  Returns 1 if the format was recognized
+ * and info was filled in, 0 if the format is unknown (use qemu-img),
+ * or -1 on error.
+ */
+static int
+probe_header (guestfs_h *g, int fd, const char *filename,
+              const struct stat *statbuf, struct disk_info *info)
+{
+  char header[512];
+  int64_t size;
+  size_t i, len;
+  int r;
+
+  if (read_at (g, fd, filename, header, sizeof header, 0) == -1)
+    return -1;
+
+  if (memcmp (header, "QFI\xfb", 4) == 0)
+    r = probe_qcow2 (g, header, info);
+  else if (memcmp (header, "KDMV", 4) == 0)
+    r = probe_vmdk (g, fd, filename, header, info);
+  else if (get_le32 (&header[64]) == 0xbeda107f)
+    r = probe_vdi (g, header, info);
+  else if (memcmp (header, "vhdxfile", 8) == 0)
+    r = probe_vhdx (g, fd, filename, info);
+  else
+    r = -2;
+  if (r != -2)
+    return r;
+
+  for (i = 0; i < sizeof other_formats / sizeof other_formats[0]; ++i) {
+    if (memcmp (header, other_formats[i].magic, other_formats[i].len) == 0)
+      return 0;
   }
 
+  /* qemu probes dmg images by the filename extension. */
+  len = strlen (filename);
+  if (len >= 4 && STRCASEEQ (&filename[len-4], ".dmg"))
+    return 0;
+
+  /* Anything else is a raw image, as for qemu-img. */
+  if (S_ISREG (statbuf->st_mode))
+    size = statbuf->st_size;
+  else {
+    size = lseek (fd, 0, SEEK_END);
+    if (size == -1) {
+      perrorf (g, "disk info: lseek: %s", filename);
+      return -1;
+    }
+  }
+
+  info->format = safe_strdup (g, "raw");
+  info->virtual_size = size;
+  info->has_backing_file = 0;
+  return 1;
+}
+
+/* Run 'qemu-img info --output json filename', and parse the output
+ * as JSON, handling errors.
+ */
+static void parse_json (guestfs_h *g, void *treevp, const char *input, size_t len);
+#define PARSE_JSON_NO_OUTPUT ((void *) -1)
+
+static int
+qemu_img_info (guestfs_h *g, const char *filename, int fd,
+               struct disk_info *info)
+{
+  CLEANUP_CMD_CLOSE struct command *cmd = guestfs_int_new_command (g);
+  CLEANUP_YAJL_TREE_FREE yajl_val tree = NULL;
+  int r;
+  char fdpath[64];
+  size_t i, len;
+
   snprintf (fdpath, sizeof fdpath, "/dev/fd/%d", fd);
   guestfs_int_cmd_clear_close_files (cmd);
 
@@ -200,24 +603,55 @@ get_json_output (guestfs_h *g, const char *filename)
                                        CMD_STDOUT_FLAG_WHOLE_BUFFER);
   set_child_rlimits (cmd);
   r = guestfs_int_cmd_run (cmd);
-  close (fd);
   if (r == -1)
-    return NULL;
+    return -1;
   if (!WIFEXITED (r) || WEXITSTATUS (r) != 0) {
     guestfs_int_external_command_failed (g, r, "qemu-img info", filename);
-    return NULL;
+    return -1;
   }
 
   if (tree == NULL)
-    return NULL;        /* parse_json callback already set an error */
+    return -1;          /* parse_json callback already set an error */
 
   if (tree == PARSE_JSON_NO_OUTPUT) {
     /* If this ever happened, it would indicate a bug in 'qemu-img info'. */
+    tree = NULL;
     error (g, _("qemu-img info command produced no output, but didn't return an error status code"));
-    return NULL;
+    return -1;
+  }
+
+  if (! YAJL_IS_OBJECT (tree)) {
+    error (g, _("qemu-img info: JSON output was not an object"));
+    return -1;
+  }
+
+  len = YAJL_GET_OBJECT(tree)->len;
+  for (i = 0; i < len; ++i) {
+    const char *key = YAJL_GET_OBJECT(tree)->keys[i];
+    yajl_val node = YAJL_GET_OBJECT(tree)->values[i];
+
+    if (STREQ (key, "format")) {
+      const char *str = YAJL_GET_STRING (node);
+      if (str != NULL)
+        info->format = safe_strdup (g, str);
+    }
+    else if (STREQ (key, "virtual-size")) {
+      if (YAJL_IS_INTEGER (node))
+        info->virtual_size = YAJL_GET_INTEGER (node);
+      else if (YAJL_IS_NUMBER (node)) {
+        error (g, _("qemu-img info: 'virtual-size' is not representable as a 64 bit integer"));
+        return -1;
+      }
+    }
+    else if (STREQ (key, "backing-filename")) {
+      /* Work on the assumption that if this field is null, it means
+       * no backing file, rather than being an error.
+       */
+      info->has_backing_file = ! YAJL_IS_NULL (node);
+    }
   }
 
-  return tree;          /* caller must call yajl_tree_free (tree) */
+  return 0;
 }
 
 /* Parse the JSON document printed by qemu-img info --output json. */
@@ -44,9 +44,7 @@
 #include "guestfs-internal.h"
 #include "guestfs-internal-actions.h"
 
-#ifdef DB_DUMP
 static struct guestfs_application2_list *list_applications_rpm (guestfs_h *g, struct inspect_fs *fs);
-#endif
 static struct guestfs_application2_list *list_applications_deb (guestfs_h *g, struct inspect_fs *fs);
 static struct guestfs_application2_list *list_applications_pacman (guestfs_h *g, struct inspect_fs *fs);
 static struct guestfs_application2_list *list_applications_apk (guestfs_h *g, struct inspect_fs *fs);
@@ -121,11 +119,9 @@ guestfs_impl_inspect_list_applications2 (guestfs_h *g, const char *root)
     case OS_TYPE_HURD:
       switch (fs->package_format) {
       case OS_PACKAGE_FORMAT_RPM:
-#ifdef DB_DUMP
         ret = list_applications_rpm (g, fs);
         if (ret == NULL)
           return NULL;
-#endif
         break;
 
       case OS_PACKAGE_FORMAT_DEB:
@@ -185,8 +181,6 @@ guestfs_impl_inspect_list_applications2 (guestfs_h *g, const char *root)
   return ret;
 }
 
-#ifdef DB_DUMP
-
 /* This data comes from the Name database, and contains the application
  * names and the first 4 bytes of each link field.
  */
@@ -425,8 +419,6 @@ list_applications_rpm (guestfs_h *g, struct inspect_fs *fs)
   return NULL;
 }
 
-#endif /* defined DB_DUMP */
-
 static struct guestfs_application2_list *
 list_applications_deb (guestfs_h *g, struct inspect_fs *fs)
 {
@@ -823,7 +815,7 @@ list_applications_windows_from_path (guestfs_h *g,
                                      struct guestfs_application2_list *apps,
                                      const char **path, size_t path_len)
 {
-  CLEANUP_FREE_HIVEX_NODE_LIST struct guestfs_hivex_node_list *children = NULL;
+  CLEANUP_FREE_HIVE_NODE struct hive_node *uninstall = NULL;
   int64_t node;
   size_t i;
 
@@ -835,48 +827,45 @@ list_applications_windows_from_path (guestfs_h *g,
   if (node == 0)
     return;
 
-  children = guestfs_hivex_node_children (g, node);
-  if (children == NULL)
+  /* Fetch the children and their values in a single call. */
+  uninstall = guestfs_int_hivex_export (g, node, 1);
+  if (uninstall == NULL)
     return;
 
   /* Consider any child node that has a DisplayName key.
    * See also:
    * http://nsis.sourceforge.net/Add_uninstall_information_to_Add/Remove_Programs#Optional_values
    */
-  for (i = 0; i < children->len; ++i) {
-    const int64_t child = children->val[i].hivex_node_h;
-    int64_t value;
-    CLEANUP_FREE char *name = NULL, *display_name = NULL, *version = NULL,
+  for (i = 0; i < uninstall->nr_children; ++i) {
+    const struct hive_node *child = &uninstall->children[i];
+    const struct hive_value *value;
+    CLEANUP_FREE char *display_name = NULL, *version = NULL,
       *install_path = NULL, *publisher = NULL, *url = NULL, *comments = NULL;
 
     /* Use the node name as a proxy for the package name in Linux.  The
      * display name is not language-independent, so it cannot be used.
      */
-    name = guestfs_hivex_node_name (g, child);
-    if (name == NULL)
-      continue;
-
-    value = guestfs_hivex_node_get_value (g, child, "DisplayName");
+    value = guestfs_int_hive_node_get_value (child, "DisplayName");
     if (value) {
-      display_name = guestfs_hivex_value_utf8 (g, value);
+      display_name = guestfs_int_hive_value_utf8 (g, value);
       if (display_name) {
-        value = guestfs_hivex_node_get_value (g, child, "DisplayVersion");
+        value = guestfs_int_hive_node_get_value (child, "DisplayVersion");
         if (value)
-          version = guestfs_hivex_value_utf8 (g, value);
-        value = guestfs_hivex_node_get_value (g, child, "InstallLocation");
+          version = guestfs_int_hive_value_utf8 (g, value);
+        value = guestfs_int_hive_node_get_value (child, "InstallLocation");
         if (value)
-          install_path = guestfs_hivex_value_utf8 (g, value);
-        value = guestfs_hivex_node_get_value (g, child, "Publisher");
+          install_path = guestfs_int_hive_value_utf8 (g, value);
+        value = guestfs_int_hive_node_get_value (child, "Publisher");
         if (value)
-          publisher = guestfs_hivex_value_utf8 (g, value);
-        value = guestfs_hivex_node_get_value (g, child, "URLInfoAbout");
+          publisher = guestfs_int_hive_value_utf8 (g, value);
+        value = guestfs_int_hive_node_get_value (child, "URLInfoAbout");
         if (value)
-          url = guestfs_hivex_value_utf8 (g, value);
-        value = guestfs_hivex_node_get_value (g, child, "Comments");
+          url = guestfs_int_hive_value_utf8 (g, value);
+        value = guestfs_int_hive_node_get_value (child, "Comments");
         if (value)
-          comments = guestfs_hivex_value_utf8 (g, value);
+          comments = guestfs_int_hive_value_utf8 (g, value);
 
-        add_application (g, apps, name, display_name, 0,
+        add_application (g, apps, child->name, display_name, 0,
                          version ? : "",
                          "", "",
                          install_path ? : "",
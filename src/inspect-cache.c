@@ -0,0 +1,451 @@
+/* libguestfs
+ * Copyright (C) 2016 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * Persistent cache of inspection results.
+ *
+ * If enabled with L<guestfs(3)/guestfs_set_inspect_cache>, the
+ * results of C<guestfs_inspect_os> (ie. the list of C<struct
+ * inspect_fs> in the handle) are saved in the cache directory, and
+ * loaded again on subsequent calls if the disks have not changed.
+ *
+ * The cache key is a string made from:
+ *
+ * =over 4
+ *
+ * =item *
+ *
+ * the identity (device, inode, size and mtime) of each local drive,
+ *
+ * =item *
+ *
+ * the list of filesystems and their types, and
+ *
+ * =item *
+ *
+ * the UUID of each filesystem.
+ *
+ * =back
+ *
+ * The complete key is stored in the cache file and compared when
+ * loading, so hash collisions in the file name only cause a cache
+ * miss.
+ *
+ * Drives which are not local files (eg. NBD or iSCSI) have no
+ * identity that can be checked cheaply, so if any drive is not a
+ * local file, the cache is not used.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <libintl.h>
+
+#include "hash-pjw.h"
+
+#include "guestfs.h"
+#include "guestfs-internal.h"
+#include "guestfs-internal-actions.h"
+
+/* This is saved in the cache files, so if we change the format or
+ * the contents of struct inspect_fs in future, we should increment
+ * this to discard any data cached by previous versions of libguestfs.
+ */
+#define MEMO_GENERATION 1
+
+/* Does the filesystem type 'vfs_type' (from guestfs_list_filesystems)
+ * have a UUID worth putting in the cache key?
+ */
+static int
+has_uuid (const char *vfs_type)
+{
+  return STRNEQ (vfs_type, "unknown") && STRNEQ (vfs_type, "swap");
+}
+
+/**
+ * Compute the cache key for the current drives and the list of
+ * filesystems C<fses> (as returned by C<guestfs_list_filesystems>).
+ *
+ * Returns C<NULL> if the inspection results cannot be cached.  This
+ * is not an error and no error is set in the handle.
+ */
+char *
+guestfs_int_inspect_cache_key (guestfs_h *g, char *const *fses)
+{
+  char *key = NULL;
+  size_t keylen = 0;
+  FILE *fp;
+  struct drive *drv;
+  size_t i, j;
+  int ok = 1;
+  CLEANUP_FREE_STRINGSBUF DECLARE_STRINGSBUF (devices);
+  CLEANUP_FREE_INTERNAL_PROBE_LIST struct guestfs_internal_probe_list *probes =
+    NULL;
+
+  fp = open_memstream (&key, &keylen);
+  if (fp == NULL) {
+    debug (g, "inspect cache: open_memstream: %m");
+    return NULL;
+  }
+
+  ITER_DRIVES (g, i, drv) {
+    struct stat statbuf;
+
+    /* The dummy appliance drive has an empty name. */
+    if (drv->src.protocol == drive_protocol_file &&
+        STREQ (drv->src.u.path, ""))
+      continue;
+
+    if (drv->src.protocol != drive_protocol_file ||
+        stat (drv->src.u.path, &statbuf) == -1) {
+      ok = 0;
+      break;
+    }
+
+    fprintf (fp, "drive %zu %s %s %d %" PRIu64 " %" PRIu64 " %" PRIu64
+             " %" PRIi64 ".%09ld\n",
+             i, drv->src.u.path,
+             drv->src.format ? drv->src.format : "-",
+             drv->readonly,
+             (uint64_t) statbuf.st_dev, (uint64_t) statbuf.st_ino,
+             (uint64_t) statbuf.st_size,
+             (int64_t) statbuf.st_mtim.tv_sec, statbuf.st_mtim.tv_nsec);
+  }
+
+  /* The UUID of a filesystem changes if the filesystem is recreated,
+   * even if the disk image is modified in place by something that
+   * preserves the mtime.  The UUIDs of all the devices are probed in
+   * a single call; btrfs subvolumes are not devices, so they are
+   * looked up separately.
+   */
+  for (i = 0; ok && fses[i] != NULL; i += 2) {
+    if (has_uuid (fses[i+1]) && STRPREFIX (fses[i], "/dev/"))
+      guestfs_int_add_string (g, &devices, fses[i]);
+  }
+  guestfs_int_end_stringsbuf (g, &devices);
+
+  if (ok) {
+    guestfs_push_error_handler (g, NULL, NULL);
+    probes = guestfs_internal_probe_devices (g, devices.argv);
+    guestfs_pop_error_handler (g);
+    if (probes == NULL || probes->len != devices.size - 1)
+      ok = 0;
+  }
+
+  for (i = 0, j = 0; ok && fses[i] != NULL; i += 2) {
+    CLEANUP_FREE char *subvol_uuid = NULL;
+    const char *uuid = NULL;
+
+    if (has_uuid (fses[i+1])) {
+      if (STRPREFIX (fses[i], "/dev/"))
+        uuid = probes->val[j++].ipr_uuid;
+      else {
+        guestfs_push_error_handler (g, NULL, NULL);
+        uuid = subvol_uuid = guestfs_vfs_uuid (g, fses[i]);
+        guestfs_pop_error_handler (g);
+      }
+    }
+
+    fprintf (fp, "fs %s %s %s\n", fses[i], fses[i+1], uuid ? uuid : "-");
+  }
+
+  if (fclose (fp) == -1 || !ok) {
+    free (key);
+    return NULL;
+  }
+
+  return key;
+}
+
+static char *
+cache_filename (guestfs_h *g, const char *key)
+{
+  CLEANUP_FREE char *cachedir = NULL;
+
+  cachedir = guestfs_int_lazy_make_supermin_appliance_dir (g);
+  if (cachedir == NULL)
+    return NULL;
+
+  return safe_asprintf (g, "%s/inspect.%08zx",
+                        cachedir, hash_pjw (key, SIZE_MAX));
+}
+
+/* Strings are written as "<length>:<string>\n", or "-\n" for NULL,
+ * so they may contain any character.
+ */
+static void
+write_string (FILE *fp, const char *str)
+{
+  if (str == NULL)
+    fprintf (fp, "-\n");
+  else
+    fprintf (fp, "%zu:%s\n", strlen (str), str);
+}
+
+static void
+write_int (FILE *fp, int i)
+{
+  fprintf (fp, "%d\n", i);
+}
+
+static int
+read_string (FILE *fp, char **ret)
+{
+  size_t len;
+  char *str;
+  int c;
+
+  c = getc (fp);
+  if (c == '-') {
+    *ret = NULL;
+    return getc (fp) == '\n' ? 0 : -1;
+  }
+  ungetc (c, fp);
+
+  if (fscanf (fp, "%zu:", &len) != 1)
+    return -1;
+  str = malloc (len + 1);
+  if (str == NULL)
+    return -1;
+  if (fread (str, 1, len, fp) != len || getc (fp) != '\n') {
+    free (str);
+    return -1;
+  }
+  str[len] = '\0';
+  *ret = str;
+  return 0;
+}
+
+static int
+read_int (FILE *fp, int *ret)
+{
+  if (fscanf (fp, "%d", ret) != 1 || getc (fp) != '\n')
+    return -1;
+  return 0;
+}
+
+static int
+read_fs (FILE *fp, struct inspect_fs *fs)
+{
+  int i, n;
+
+  if (read_int (fp, &i) == -1) return -1;
+  fs->role = i;
+  if (read_string (fp, &fs->mountable) == -1) return -1;
+  if (read_int (fp, &i) == -1) return -1;
+  fs->type = i;
+  if (read_int (fp, &i) == -1) return -1;
+  fs->distro = i;
+  if (read_int (fp, &i) == -1) return -1;
+  fs->package_format = i;
+  if (read_int (fp, &i) == -1) return -1;
+  fs->package_management = i;
+  if (read_string (fp, &fs->product_name) == -1) return -1;
+  if (read_string (fp, &fs->product_variant) == -1) return -1;
+  if (read_int (fp, &fs->version.v_major) == -1) return -1;
+  if (read_int (fp, &fs->version.v_minor) == -1) return -1;
+  if (read_int (fp, &fs->version.v_micro) == -1) return -1;
+  if (read_string (fp, &fs->arch) == -1) return -1;
+  if (read_string (fp, &fs->hostname) == -1) return -1;
+  if (read_string (fp, &fs->windows_systemroot) == -1) return -1;
+  if (read_string (fp, &fs->windows_current_control_set) == -1) return -1;
+
+  if (read_int (fp, &n) == -1) return -1;
+  if (n >= 0) {
+    fs->drive_mappings = calloc (n + 1, sizeof (char *));
+    if (fs->drive_mappings == NULL) return -1;
+    for (i = 0; i < n; ++i) {
+      if (read_string (fp, &fs->drive_mappings[i]) == -1 ||
+          fs->drive_mappings[i] == NULL)
+        return -1;
+    }
+  }
+
+  if (read_int (fp, &i) == -1) return -1;
+  fs->format = i;
+  if (read_int (fp, &fs->is_live_disk) == -1) return -1;
+  if (read_int (fp, &fs->is_netinst_disk) == -1) return -1;
+  if (read_int (fp, &fs->is_multipart_disk) == -1) return -1;
+
+  if (read_int (fp, &n) == -1 || n < 0) return -1;
+  if (n > 0) {
+    fs->fstab = calloc (n, sizeof (struct inspect_fstab_entry));
+    if (fs->fstab == NULL) return -1;
+    for (i = 0; i < n; ++i) {
+      fs->nr_fstab++;
+      if (read_string (fp, &fs->fstab[i].mountable) == -1 ||
+          read_string (fp, &fs->fstab[i].mountpoint) == -1)
+        return -1;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * Try to load cached inspection results for C<key> into the handle.
+ *
+ * Returns C<0> if the results were loaded, or C<-1> if there were
+ * no usable results in the cache.  This is not an error and no error
+ * is set in the handle.
+ */
+int
+guestfs_int_inspect_cache_load (guestfs_h *g, const char *key)
+{
+  CLEANUP_FREE char *filename = NULL, *cached_key = NULL;
+  CLEANUP_FCLOSE FILE *fp = NULL;
+  int generation, n, i;
+
+  guestfs_push_error_handler (g, NULL, NULL);
+  filename = cache_filename (g, key);
+  guestfs_pop_error_handler (g);
+  if (filename == NULL)
+    return -1;
+
+  fp = fopen (filename, "r");
+  if (fp == NULL)
+    return -1;
+
+  if (read_int (fp, &generation) == -1 || generation != MEMO_GENERATION ||
+      read_string (fp, &cached_key) == -1 || cached_key == NULL ||
+      STRNEQ (cached_key, key) ||
+      read_int (fp, &n) == -1 || n < 0) {
+    debug (g, "inspect cache: %s: stale or unreadable", filename);
+    return -1;
+  }
+
+  guestfs_int_free_inspect_info (g);
+  g->fses = safe_calloc (g, n > 0 ? n : 1, sizeof (struct inspect_fs));
+  for (i = 0; i < n; ++i) {
+    g->nr_fses++;
+    if (read_fs (fp, &g->fses[i]) == -1) {
+      debug (g, "inspect cache: %s: corrupt", filename);
+      guestfs_int_free_inspect_info (g);
+      return -1;
+    }
+  }
+
+  debug (g, "inspect cache: loaded results from %s", filename);
+  return 0;
+}
+
+static void
+write_fs (FILE *fp, const struct inspect_fs *fs)
+{
+  size_t i;
+
+  write_int (fp, fs->role);
+  write_string (fp, fs->mountable);
+  write_int (fp, fs->type);
+  write_int (fp, fs->distro);
+  write_int (fp, fs->package_format);
+  write_int (fp, fs->package_management);
+  write_string (fp, fs->product_name);
+  write_string (fp, fs->product_variant);
+  write_int (fp, fs->version.v_major);
+  write_int (fp, fs->version.v_minor);
+  write_int (fp, fs->version.v_micro);
+  write_string (fp, fs->arch);
+  write_string (fp, fs->hostname);
+  write_string (fp, fs->windows_systemroot);
+  write_string (fp, fs->windows_current_control_set);
+
+  if (fs->drive_mappings == NULL)
+    write_int (fp, -1);
+  else {
+    write_int (fp, guestfs_int_count_strings (fs->drive_mappings));
+    for (i = 0; fs->drive_mappings[i] != NULL; ++i)
+      write_string (fp, fs->drive_mappings[i]);
+  }
+
+  write_int (fp, fs->format);
+  write_int (fp, fs->is_live_disk);
+  write_int (fp, fs->is_netinst_disk);
+  write_int (fp, fs->is_multipart_disk);
+
+  write_int (fp, fs->nr_fstab);
+  for (i = 0; i < fs->nr_fstab; ++i) {
+    write_string (fp, fs->fstab[i].mountable);
+    write_string (fp, fs->fstab[i].mountpoint);
+  }
+}
+
+/**
+ * Save the inspection results in the handle to the cache, under
+ * C<key>.  Failure to save is not an error.
+ *
+ * The results are written to a temporary file which is renamed, so
+ * that other handles using the same cache directory never see a
+ * partially written file.
+ */
+void
+guestfs_int_inspect_cache_save (guestfs_h *g, const char *key)
+{
+  CLEANUP_FREE char *filename = NULL, *tmpfile = NULL;
+  FILE *fp;
+  int fd, r;
+  size_t i;
+
+  guestfs_push_error_handler (g, NULL, NULL);
+  filename = cache_filename (g, key);
+  guestfs_pop_error_handler (g);
+  if (filename == NULL)
+    return;
+
+  tmpfile = safe_asprintf (g, "%s.XXXXXX", filename);
+  fd = mkstemp (tmpfile);
+  if (fd == -1) {
+    debug (g, "inspect cache: mkstemp: %s: %m", tmpfile);
+    return;
+  }
+  fp = fdopen (fd, "w");
+  if (fp == NULL) {
+    debug (g, "inspect cache: fdopen: %s: %m", tmpfile);
+    close (fd);
+    unlink (tmpfile);
+    return;
+  }
+
+  write_int (fp, MEMO_GENERATION);
+  write_string (fp, key);
+  write_int (fp, g->nr_fses);
+  for (i = 0; i < g->nr_fses; ++i)
+    write_fs (fp, &g->fses[i]);
+
+  r = ferror (fp);
+  if (fclose (fp) == EOF || r) {
+    debug (g, "inspect cache: write: %s: %m", tmpfile);
+    unlink (tmpfile);
+    return;
+  }
+
+  if (rename (tmpfile, filename) == -1) {
+    debug (g, "inspect cache: rename: %s: %m", filename);
+    unlink (tmpfile);
+    return;
+  }
+
+  debug (g, "inspect cache: saved results to %s", filename);
+}
@@ -57,7 +57,7 @@ check_debian_installer_root (guestfs_h *g, struct inspect_fs *fs)
 
   (void) guestfs_int_parse_major_minor (g, fs);
 
-  if (guestfs_is_file (g, "/.disk/cd_type") > 0) {
+  if (guestfs_int_inspect_is_file (g, "/.disk/cd_type", 0) > 0) {
     CLEANUP_FREE char *cd_type =
       guestfs_int_first_line_of_file (g, "/.disk/cd_type");
     if (!cd_type)
@@ -443,26 +443,26 @@ guestfs_int_check_installer_root (guestfs_h *g, struct inspect_fs *fs)
    * Fedora live CDs which contain the same, but larger file).  We
    * need to unpack this and look inside to tell the difference.
    */
-  if (guestfs_is_file (g, "/casper/filesystem.squashfs") > 0 ||
-      guestfs_is_file (g, "/live/filesystem.squashfs") > 0 ||
-      guestfs_is_file (g, "/mfsroot.gz") > 0)
+  if (guestfs_int_inspect_is_file (g, "/casper/filesystem.squashfs", 0) > 0 ||
+      guestfs_int_inspect_is_file (g, "/live/filesystem.squashfs", 0) > 0 ||
+      guestfs_int_inspect_is_file (g, "/mfsroot.gz", 0) > 0)
     fs->is_live_disk = 1;
 
   /* Debian/Ubuntu. */
-  if (guestfs_is_file (g, "/.disk/info") > 0) {
+  if (guestfs_int_inspect_is_file (g, "/.disk/info", 0) > 0) {
     if (check_debian_installer_root (g, fs) == -1)
       return -1;
   }
 
   /* Fedora CDs and DVD (not netinst). */
-  else if (guestfs_is_file (g, "/.treeinfo") > 0) {
+  else if (guestfs_int_inspect_is_file (g, "/.treeinfo", 0) > 0) {
     if (check_fedora_installer_root (g, fs) == -1)
       return -1;
   }
 
   /* FreeDOS install CD. */
-  else if (guestfs_is_file (g, "/freedos/freedos.ico") > 0 &&
-           guestfs_is_file (g, "/setup.bat") > 0) {
+  else if (guestfs_int_inspect_is_file (g, "/freedos/freedos.ico", 0) > 0 &&
+           guestfs_int_inspect_is_file (g, "/setup.bat", 0) > 0) {
     fs->type = OS_TYPE_DOS;
     fs->distro = OS_DISTRO_FREEDOS;
     fs->arch = safe_strdup (g, "i386");
@@ -471,25 +471,25 @@ guestfs_int_check_installer_root (guestfs_h *g, struct inspect_fs *fs)
   /* Linux with /isolinux/isolinux.cfg (note that non-Linux can use
    * ISOLINUX too, eg. FreeDOS).
    */
-  else if (guestfs_is_file (g, "/isolinux/isolinux.cfg") > 0) {
+  else if (guestfs_int_inspect_is_file (g, "/isolinux/isolinux.cfg", 0) > 0) {
     if (check_isolinux_installer_root (g, fs) == -1)
       return -1;
   }
 
   /* FreeBSD with /boot/loader.rc. */
-  else if (guestfs_is_file (g, "/boot/loader.rc") > 0) {
+  else if (guestfs_int_inspect_is_file (g, "/boot/loader.rc", 0) > 0) {
     fs->type = OS_TYPE_FREEBSD;
   }
 
   /* Windows 2003 64 bit */
-  else if (guestfs_is_file (g, "/amd64/txtsetup.sif") > 0) {
+  else if (guestfs_int_inspect_is_file (g, "/amd64/txtsetup.sif", 0) > 0) {
     fs->arch = safe_strdup (g, "x86_64");
     if (check_w2k3_installer_root (g, fs, "/amd64/txtsetup.sif") == -1)
       return -1;
   }
 
   /* Windows 2003 32 bit */
-  else if (guestfs_is_file (g, "/i386/txtsetup.sif") > 0) {
+  else if (guestfs_int_inspect_is_file (g, "/i386/txtsetup.sif", 0) > 0) {
     fs->arch = safe_strdup (g, "i386");
     if (check_w2k3_installer_root (g, fs, "/i386/txtsetup.sif") == -1)
       return -1;
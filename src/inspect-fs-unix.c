@@ -459,8 +459,7 @@ guestfs_int_check_linux_root (guestfs_h *g, struct inspect_fs *fs)
 
   fs->type = OS_TYPE_LINUX;
 
-  if (guestfs_is_file_opts (g, "/etc/os-release",
-                            GUESTFS_IS_FILE_OPTS_FOLLOWSYMLINKS, 1, -1) > 0) {
+  if (guestfs_int_inspect_is_file (g, "/etc/os-release", 1) > 0) {
     r = parse_os_release (g, fs, "/etc/os-release");
     if (r == -1)        /* error */
       return -1;
@@ -468,8 +467,7 @@ guestfs_int_check_linux_root (guestfs_h *g, struct inspect_fs *fs)
       goto skip_release_checks;
   }
 
-  if (guestfs_is_file_opts (g, "/etc/lsb-release",
-                            GUESTFS_IS_FILE_OPTS_FOLLOWSYMLINKS, 1, -1) > 0) {
+  if (guestfs_int_inspect_is_file (g, "/etc/lsb-release", 1) > 0) {
     r = parse_lsb_release (g, fs, "/etc/lsb-release");
     if (r == -1)        /* error */
       return -1;
@@ -480,8 +478,7 @@ guestfs_int_check_linux_root (guestfs_h *g, struct inspect_fs *fs)
   /* RHEL-based distros include a "/etc/redhat-release" file, hence their
    * checks need to be performed before the Red-Hat one.
    */
-  if (guestfs_is_file_opts (g, "/etc/oracle-release",
-                            GUESTFS_IS_FILE_OPTS_FOLLOWSYMLINKS, 1, -1) > 0) {
+  if (guestfs_int_inspect_is_file (g, "/etc/oracle-release", 1) > 0) {
 
     fs->distro = OS_DISTRO_ORACLE_LINUX;
 
@@ -508,8 +505,7 @@ guestfs_int_check_linux_root (guestfs_h *g, struct inspect_fs *fs)
       fs->version.v_minor = 0;
     }
   }
-  else if (guestfs_is_file_opts (g, "/etc/centos-release",
-                                 GUESTFS_IS_FILE_OPTS_FOLLOWSYMLINKS, 1, -1) > 0) {
+  else if (guestfs_int_inspect_is_file (g, "/etc/centos-release", 1) > 0) {
     fs->distro = OS_DISTRO_CENTOS;
 
     if (parse_release_file (g, fs, "/etc/centos-release") == -1)
@@ -536,8 +532,7 @@ guestfs_int_check_linux_root (guestfs_h *g, struct inspect_fs *fs)
       fs->version.v_minor = 0;
     }
   }
-  else if (guestfs_is_file_opts (g, "/etc/altlinux-release",
-                                 GUESTFS_IS_FILE_OPTS_FOLLOWSYMLINKS, 1, -1) > 0) {
+  else if (guestfs_int_inspect_is_file (g, "/etc/altlinux-release", 1) > 0) {
     fs->distro = OS_DISTRO_ALTLINUX;
 
     if (parse_release_file (g, fs, "/etc/altlinux-release") == -1)
@@ -547,8 +542,7 @@ guestfs_int_check_linux_root (guestfs_h *g, struct inspect_fs *fs)
                                          re_altlinux) == -1)
       return -1;
   }
-  else if (guestfs_is_file_opts (g, "/etc/redhat-release",
-                                 GUESTFS_IS_FILE_OPTS_FOLLOWSYMLINKS, 1, -1) > 0) {
+  else if (guestfs_int_inspect_is_file (g, "/etc/redhat-release", 1) > 0) {
     fs->distro = OS_DISTRO_REDHAT_BASED; /* Something generic Red Hat-like. */
 
     if (parse_release_file (g, fs, "/etc/redhat-release") == -1)
@@ -628,8 +622,7 @@ guestfs_int_check_linux_root (guestfs_h *g, struct inspect_fs *fs)
       fs->version.v_minor = 0;
     }
   }
-  else if (guestfs_is_file_opts (g, "/etc/debian_version",
-                                 GUESTFS_IS_FILE_OPTS_FOLLOWSYMLINKS, 1, -1) > 0) {
+  else if (guestfs_int_inspect_is_file (g, "/etc/debian_version", 1) > 0) {
     fs->distro = OS_DISTRO_DEBIAN;
 
     if (parse_release_file (g, fs, "/etc/debian_version") == -1)
@@ -638,8 +631,7 @@ guestfs_int_check_linux_root (guestfs_h *g, struct inspect_fs *fs)
     if (guestfs_int_parse_major_minor (g, fs) == -1)
       return -1;
   }
-  else if (guestfs_is_file_opts (g, "/etc/pardus-release",
-                                 GUESTFS_IS_FILE_OPTS_FOLLOWSYMLINKS, 1, -1) > 0) {
+  else if (guestfs_int_inspect_is_file (g, "/etc/pardus-release", 1) > 0) {
     fs->distro = OS_DISTRO_PARDUS;
 
     if (parse_release_file (g, fs, "/etc/pardus-release") == -1)
@@ -648,16 +640,14 @@ guestfs_int_check_linux_root (guestfs_h *g, struct inspect_fs *fs)
     if (guestfs_int_parse_major_minor (g, fs) == -1)
       return -1;
   }
-  else if (guestfs_is_file_opts (g, "/etc/arch-release",
-                                 GUESTFS_IS_FILE_OPTS_FOLLOWSYMLINKS, 1, -1) > 0) {
+  else if (guestfs_int_inspect_is_file (g, "/etc/arch-release", 1) > 0) {
     fs->distro = OS_DISTRO_ARCHLINUX;
 
     /* /etc/arch-release file is empty and I can't see a way to
      * determine the actual release or product string.
      */
   }
-  else if (guestfs_is_file_opts (g, "/etc/gentoo-release",
-                                 GUESTFS_IS_FILE_OPTS_FOLLOWSYMLINKS, 1, -1) > 0) {
+  else if (guestfs_int_inspect_is_file (g, "/etc/gentoo-release", 1) > 0) {
     fs->distro = OS_DISTRO_GENTOO;
 
     if (parse_release_file (g, fs, "/etc/gentoo-release") == -1)
@@ -666,8 +656,7 @@ guestfs_int_check_linux_root (guestfs_h *g, struct inspect_fs *fs)
     if (guestfs_int_parse_major_minor (g, fs) == -1)
       return -1;
   }
-  else if (guestfs_is_file_opts (g, "/etc/meego-release",
-                                 GUESTFS_IS_FILE_OPTS_FOLLOWSYMLINKS, 1, -1) > 0) {
+  else if (guestfs_int_inspect_is_file (g, "/etc/meego-release", 1) > 0) {
     fs->distro = OS_DISTRO_MEEGO;
 
     if (parse_release_file (g, fs, "/etc/meego-release") == -1)
@@ -676,8 +665,7 @@ guestfs_int_check_linux_root (guestfs_h *g, struct inspect_fs *fs)
     if (guestfs_int_parse_major_minor (g, fs) == -1)
       return -1;
   }
-  else if (guestfs_is_file_opts (g, "/etc/slackware-version",
-                                 GUESTFS_IS_FILE_OPTS_FOLLOWSYMLINKS, 1, -1) > 0) {
+  else if (guestfs_int_inspect_is_file (g, "/etc/slackware-version", 1) > 0) {
     fs->distro = OS_DISTRO_SLACKWARE;
 
     if (parse_release_file (g, fs, "/etc/slackware-version") == -1)
@@ -686,8 +674,7 @@ guestfs_int_check_linux_root (guestfs_h *g, struct inspect_fs *fs)
     if (guestfs_int_parse_major_minor (g, fs) == -1)
       return -1;
   }
-  else if (guestfs_is_file_opts (g, "/etc/ttylinux-target",
-                                 GUESTFS_IS_FILE_OPTS_FOLLOWSYMLINKS, 1, -1) > 0) {
+  else if (guestfs_int_inspect_is_file (g, "/etc/ttylinux-target", 1) > 0) {
     fs->distro = OS_DISTRO_TTYLINUX;
 
     if (parse_release_file (g, fs, "/etc/ttylinux-target") == -1)
@@ -696,8 +683,7 @@ guestfs_int_check_linux_root (guestfs_h *g, struct inspect_fs *fs)
     if (guestfs_int_parse_major_minor (g, fs) == -1)
       return -1;
   }
-  else if (guestfs_is_file_opts (g, "/etc/SuSE-release",
-                                 GUESTFS_IS_FILE_OPTS_FOLLOWSYMLINKS, 1, -1) > 0) {
+  else if (guestfs_int_inspect_is_file (g, "/etc/SuSE-release", 1) > 0) {
     fs->distro = OS_DISTRO_SUSE_BASED;
 
     if (parse_suse_release (g, fs, "/etc/SuSE-release") == -1)
@@ -706,8 +692,7 @@ guestfs_int_check_linux_root (guestfs_h *g, struct inspect_fs *fs)
   }
   /* CirrOS versions providing a own version file.
    */
-  else if (guestfs_is_file_opts (g, "/etc/cirros/version",
-                                 GUESTFS_IS_FILE_OPTS_FOLLOWSYMLINKS, 1, -1) > 0) {
+  else if (guestfs_int_inspect_is_file (g, "/etc/cirros/version", 1) > 0) {
     fs->distro = OS_DISTRO_CIRROS;
 
     if (parse_release_file (g, fs, "/etc/cirros/version") == -1)
@@ -719,10 +704,8 @@ guestfs_int_check_linux_root (guestfs_h *g, struct inspect_fs *fs)
   /* Buildroot (http://buildroot.net) is an embedded Linux distro
    * toolkit.  It is used by specific distros such as Cirros.
    */
-  else if (guestfs_is_file_opts (g, "/etc/br-version",
-                                 GUESTFS_IS_FILE_OPTS_FOLLOWSYMLINKS, 1, -1) > 0) {
-    if (guestfs_is_file_opts (g, "/usr/share/cirros/logo",
-                              GUESTFS_IS_FILE_OPTS_FOLLOWSYMLINKS, 1, -1) > 0)
+  else if (guestfs_int_inspect_is_file (g, "/etc/br-version", 1) > 0) {
+    if (guestfs_int_inspect_is_file (g, "/usr/share/cirros/logo", 1) > 0)
       fs->distro = OS_DISTRO_CIRROS;
     else
       fs->distro = OS_DISTRO_BUILDROOT;
@@ -734,8 +717,7 @@ guestfs_int_check_linux_root (guestfs_h *g, struct inspect_fs *fs)
     if (guestfs_int_parse_major_minor (g, fs) == -1)
       return -1;
   }
-  else if (guestfs_is_file_opts (g, "/etc/alpine-release",
-                                 GUESTFS_IS_FILE_OPTS_FOLLOWSYMLINKS, 1, -1) > 0) {
+  else if (guestfs_int_inspect_is_file (g, "/etc/alpine-release", 1) > 0) {
     fs->distro = OS_DISTRO_ALPINE_LINUX;
 
     if (parse_release_file (g, fs, "/etc/alpine-release") == -1)
@@ -744,8 +726,7 @@ guestfs_int_check_linux_root (guestfs_h *g, struct inspect_fs *fs)
     if (guestfs_int_parse_major_minor (g, fs) == -1)
       return -1;
   }
-  else if (guestfs_is_file_opts (g, "/etc/frugalware-release",
-                                 GUESTFS_IS_FILE_OPTS_FOLLOWSYMLINKS, 1, -1) > 0) {
+  else if (guestfs_int_inspect_is_file (g, "/etc/frugalware-release", 1) > 0) {
     fs->distro = OS_DISTRO_FRUGALWARE;
 
     if (parse_release_file (g, fs, "/etc/frugalware-release") == -1)
@@ -755,8 +736,7 @@ guestfs_int_check_linux_root (guestfs_h *g, struct inspect_fs *fs)
                                          re_frugalware) == -1)
       return -1;
   }
-  else if (guestfs_is_file_opts (g, "/etc/pld-release",
-                                 GUESTFS_IS_FILE_OPTS_FOLLOWSYMLINKS, 1, -1) > 0) {
+  else if (guestfs_int_inspect_is_file (g, "/etc/pld-release", 1) > 0) {
     fs->distro = OS_DISTRO_PLD_LINUX;
 
     if (parse_release_file (g, fs, "/etc/pld-release") == -1)
@@ -797,8 +777,7 @@ guestfs_int_check_linux_usr (guestfs_h *g, struct inspect_fs *fs)
   fs->type = OS_TYPE_LINUX;
   fs->role = OS_ROLE_USR;
 
-  if (guestfs_is_file_opts (g, "/lib/os-release",
-                            GUESTFS_IS_FILE_OPTS_FOLLOWSYMLINKS, 1, -1) > 0) {
+  if (guestfs_int_inspect_is_file (g, "/lib/os-release", 1) > 0) {
     r = parse_os_release (g, fs, "/lib/os-release");
     if (r == -1)        /* error */
       return -1;
@@ -826,8 +805,7 @@ guestfs_int_check_freebsd_root (guestfs_h *g, struct inspect_fs *fs)
    * we'll use that anyway.
    */
 
-  if (guestfs_is_file_opts (g, "/etc/motd",
-                            GUESTFS_IS_FILE_OPTS_FOLLOWSYMLINKS, 1, -1) > 0) {
+  if (guestfs_int_inspect_is_file (g, "/etc/motd", 1) > 0) {
     if (parse_release_file (g, fs, "/etc/motd") == -1)
       return -1;
 
@@ -855,8 +833,7 @@ int
 guestfs_int_check_netbsd_root (guestfs_h *g, struct inspect_fs *fs)
 {
 
-  if (guestfs_is_file_opts (g, "/etc/release",
-                            GUESTFS_IS_FILE_OPTS_FOLLOWSYMLINKS, 1, -1) > 0) {
+  if (guestfs_int_inspect_is_file (g, "/etc/release", 1) > 0) {
     int result;
     if (parse_release_file (g, fs, "/etc/release") == -1)
       return -1;
@@ -892,8 +869,7 @@ guestfs_int_check_netbsd_root (guestfs_h *g, struct inspect_fs *fs)
 int
 guestfs_int_check_openbsd_root (guestfs_h *g, struct inspect_fs *fs)
 {
-  if (guestfs_is_file_opts (g, "/etc/motd",
-                            GUESTFS_IS_FILE_OPTS_FOLLOWSYMLINKS, 1, -1) > 0) {
+  if (guestfs_int_inspect_is_file (g, "/etc/motd", 1) > 0) {
     CLEANUP_FREE char *major = NULL, *minor = NULL;
 
     /* The first line of this file gets automatically updated at boot. */
@@ -945,8 +921,7 @@ guestfs_int_check_hurd_root (guestfs_h *g, struct inspect_fs *fs)
 {
   fs->type = OS_TYPE_HURD;
 
-  if (guestfs_is_file_opts (g, "/etc/debian_version",
-                            GUESTFS_IS_FILE_OPTS_FOLLOWSYMLINKS, 1, -1) > 0) {
+  if (guestfs_int_inspect_is_file (g, "/etc/debian_version", 1) > 0) {
     fs->distro = OS_DISTRO_DEBIAN;
 
     if (parse_release_file (g, fs, "/etc/debian_version") == -1)
@@ -963,7 +938,7 @@ guestfs_int_check_hurd_root (guestfs_h *g, struct inspect_fs *fs)
   /* Determine the architecture. */
   check_architecture (g, fs);
 
-  if (guestfs_is_file (g, "/etc/fstab") > 0) {
+  if (guestfs_int_inspect_is_file (g, "/etc/fstab", 0) > 0) {
     const char *configfiles[] = { "/etc/fstab", NULL };
     if (inspect_with_augeas (g, fs, configfiles, check_fstab) == -1)
       return -1;
@@ -982,8 +957,7 @@ guestfs_int_check_minix_root (guestfs_h *g, struct inspect_fs *fs)
 {
   fs->type = OS_TYPE_MINIX;
 
-  if (guestfs_is_file_opts (g, "/etc/version",
-                            GUESTFS_IS_FILE_OPTS_FOLLOWSYMLINKS, 1, -1) > 0) {
+  if (guestfs_int_inspect_is_file (g, "/etc/version", 1) > 0) {
     if (parse_release_file (g, fs, "/etc/version") == -1)
       return -1;
 
@@ -1043,8 +1017,7 @@ guestfs_int_check_coreos_usr (guestfs_h *g, struct inspect_fs *fs)
   fs->distro = OS_DISTRO_COREOS;
   fs->role = OS_ROLE_USR;
 
-  if (guestfs_is_file_opts (g, "/lib/os-release",
-                            GUESTFS_IS_FILE_OPTS_FOLLOWSYMLINKS, 1, -1) > 0) {
+  if (guestfs_int_inspect_is_file (g, "/lib/os-release", 1) > 0) {
     r = parse_os_release (g, fs, "/lib/os-release");
     if (r == -1)        /* error */
       return -1;
@@ -1052,8 +1025,7 @@ guestfs_int_check_coreos_usr (guestfs_h *g, struct inspect_fs *fs)
       goto skip_release_checks;
   }
 
-  if (guestfs_is_file_opts (g, "/share/coreos/lsb-release",
-                            GUESTFS_IS_FILE_OPTS_FOLLOWSYMLINKS, 1, -1) > 0) {
+  if (guestfs_int_inspect_is_file (g, "/share/coreos/lsb-release", 1) > 0) {
     r = parse_lsb_release (g, fs, "/share/coreos/lsb-release");
     if (r == -1)        /* error */
       return -1;
@@ -1085,8 +1057,7 @@ check_architecture (guestfs_h *g, struct inspect_fs *fs)
      * relative ones (which can be resolved within the same partition),
      * then we can check the architecture of their target.
      */
-    if (guestfs_is_file_opts (g, binaries[i],
-                              GUESTFS_IS_FILE_OPTS_FOLLOWSYMLINKS, 1, -1) > 0) {
+    if (guestfs_int_inspect_is_file (g, binaries[i], 1) > 0) {
       CLEANUP_FREE char *resolved = NULL;
 
       /* Ignore errors from realpath and file_architecture calls. */
@@ -1126,7 +1097,7 @@ check_hostname_unix (guestfs_h *g, struct inspect_fs *fs)
      * It's best to just look for each of these files in turn, rather
      * than try anything clever based on distro.
      */
-    if (guestfs_is_file (g, "/etc/HOSTNAME")) {
+    if (guestfs_int_inspect_is_file (g, "/etc/HOSTNAME", 0)) {
       fs->hostname = guestfs_int_first_line_of_file (g, "/etc/HOSTNAME");
       if (fs->hostname == NULL)
         return -1;
@@ -1136,7 +1107,7 @@ check_hostname_unix (guestfs_h *g, struct inspect_fs *fs)
       }
     }
 
-    if (!fs->hostname && guestfs_is_file (g, "/etc/hostname")) {
+    if (!fs->hostname && guestfs_int_inspect_is_file (g, "/etc/hostname", 0)) {
       fs->hostname = guestfs_int_first_line_of_file (g, "/etc/hostname");
       if (fs->hostname == NULL)
         return -1;
@@ -1146,7 +1117,8 @@ check_hostname_unix (guestfs_h *g, struct inspect_fs *fs)
       }
     }
 
-    if (!fs->hostname && guestfs_is_file (g, "/etc/sysconfig/network")) {
+    if (!fs->hostname &&
+        guestfs_int_inspect_is_file (g, "/etc/sysconfig/network", 0)) {
       const char *configfiles[] = { "/etc/sysconfig/network", NULL };
       if (inspect_with_augeas (g, fs, configfiles,
                                check_hostname_redhat) == -1)
@@ -1159,14 +1131,14 @@ check_hostname_unix (guestfs_h *g, struct inspect_fs *fs)
     /* /etc/rc.conf contains the hostname, but there is no Augeas lens
      * for this file.
      */
-    if (guestfs_is_file (g, "/etc/rc.conf")) {
+    if (guestfs_int_inspect_is_file (g, "/etc/rc.conf", 0)) {
       if (check_hostname_freebsd (g, fs) == -1)
         return -1;
     }
     break;
 
   case OS_TYPE_OPENBSD:
-    if (guestfs_is_file (g, "/etc/myname")) {
+    if (guestfs_int_inspect_is_file (g, "/etc/myname", 0)) {
       fs->hostname = guestfs_int_first_line_of_file (g, "/etc/myname");
       if (fs->hostname == NULL)
         return -1;
@@ -1178,7 +1150,7 @@ check_hostname_unix (guestfs_h *g, struct inspect_fs *fs)
     break;
 
   case OS_TYPE_MINIX:
-    if (guestfs_is_file (g, "/etc/hostname.file")) {
+    if (guestfs_int_inspect_is_file (g, "/etc/hostname.file", 0)) {
       fs->hostname = guestfs_int_first_line_of_file (g, "/etc/hostname.file");
       if (fs->hostname == NULL)
         return -1;
@@ -2021,8 +1993,7 @@ inspect_with_augeas (guestfs_h *g, struct inspect_fs *fs,
 
   /* Security: Refuse to do this if a config file is too large. */
   for (i = 0; configfiles[i] != NULL; ++i) {
-    if (guestfs_is_file_opts (g, configfiles[i],
-                              GUESTFS_IS_FILE_OPTS_FOLLOWSYMLINKS, 1, -1) == 0)
+    if (guestfs_int_inspect_is_file (g, configfiles[i], 1) == 0)
       continue;
 
     size = guestfs_filesize (g, configfiles[i]);
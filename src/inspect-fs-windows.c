@@ -279,7 +279,7 @@ check_windows_software_registry (guestfs_h *g, struct inspect_fs *fs)
   const char *hivepath[] =
     { "Microsoft", "Windows NT", "CurrentVersion" };
   size_t i;
-  CLEANUP_FREE_HIVEX_VALUE_LIST struct guestfs_hivex_value_list *values = NULL;
+  CLEANUP_FREE_HIVE_NODE struct hive_node *currentversion = NULL;
   bool ignore_currentversion = false;
 
   if (guestfs_hivex_open (g, software_path,
@@ -298,57 +298,46 @@ check_windows_software_registry (guestfs_h *g, struct inspect_fs *fs)
     goto out;
   }
 
-  values = guestfs_hivex_node_values (g, node);
+  /* Read all the values in a single call. */
+  currentversion = guestfs_int_hivex_export (g, node, 0);
+  if (currentversion == NULL)
+    goto out;
 
-  for (i = 0; i < values->len; ++i) {
-    const int64_t value = values->val[i].hivex_value_h;
-    CLEANUP_FREE char *key = guestfs_hivex_value_key (g, value);
-    if (key == NULL)
-      goto out;
+  for (i = 0; i < currentversion->nr_values; ++i) {
+    const struct hive_value *value = &currentversion->values[i];
+    const char *key = value->key;
 
     if (STRCASEEQ (key, "ProductName")) {
-      fs->product_name = guestfs_hivex_value_utf8 (g, value);
+      fs->product_name = guestfs_int_hive_value_utf8 (g, value);
       if (!fs->product_name)
         goto out;
     }
     else if (STRCASEEQ (key, "CurrentMajorVersionNumber")) {
-      size_t vsize;
-      const int64_t vtype = guestfs_hivex_value_type (g, value);
-      CLEANUP_FREE char *vbuf = guestfs_hivex_value_value (g, value, &vsize);
-
-      if (vbuf == NULL)
-        goto out;
-      if (vtype != 4 || vsize != 4) {
+      if (value->type != 4 || value->len != 4) {
         error (g, "hivex: expected CurrentVersion\\%s to be a DWORD field",
                "CurrentMajorVersionNumber");
         goto out;
       }
 
-      fs->version.v_major = le32toh (*(int32_t *)vbuf);
+      fs->version.v_major = le32toh (*(int32_t *)value->value);
 
       /* Ignore CurrentVersion if we see it after this key. */
       ignore_currentversion = true;
     }
     else if (STRCASEEQ (key, "CurrentMinorVersionNumber")) {
-      size_t vsize;
-      const int64_t vtype = guestfs_hivex_value_type (g, value);
-      CLEANUP_FREE char *vbuf = guestfs_hivex_value_value (g, value, &vsize);
-
-      if (vbuf == NULL)
-        goto out;
-      if (vtype != 4 || vsize != 4) {
+      if (value->type != 4 || value->len != 4) {
         error (g, "hivex: expected CurrentVersion\\%s to be a DWORD field",
                "CurrentMinorVersionNumber");
         goto out;
       }
 
-      fs->version.v_minor = le32toh (*(int32_t *)vbuf);
+      fs->version.v_minor = le32toh (*(int32_t *)value->value);
 
       /* Ignore CurrentVersion if we see it after this key. */
       ignore_currentversion = true;
     }
     else if (!ignore_currentversion && STRCASEEQ (key, "CurrentVersion")) {
-      CLEANUP_FREE char *version = guestfs_hivex_value_utf8 (g, value);
+      CLEANUP_FREE char *version = guestfs_int_hive_value_utf8 (g, value);
       if (!version)
         goto out;
       if (guestfs_int_version_from_x_y_re (g, &fs->version, version,
@@ -356,7 +345,7 @@ check_windows_software_registry (guestfs_h *g, struct inspect_fs *fs)
         goto out;
     }
     else if (STRCASEEQ (key, "InstallationType")) {
-      fs->product_variant = guestfs_hivex_value_utf8 (g, value);
+      fs->product_variant = guestfs_int_hive_value_utf8 (g, value);
       if (!fs->product_variant)
         goto out;
     }
@@ -395,8 +384,8 @@ check_windows_system_registry (guestfs_h *g, struct inspect_fs *fs)
 
   int ret = -1;
   int64_t root, node, value;
-  CLEANUP_FREE_HIVEX_VALUE_LIST struct guestfs_hivex_value_list *values = NULL;
-  CLEANUP_FREE_HIVEX_VALUE_LIST struct guestfs_hivex_value_list *values2 = NULL;
+  CLEANUP_FREE_HIVE_NODE struct hive_node *mounted_devices = NULL;
+  CLEANUP_FREE_HIVE_NODE struct hive_node *parameters = NULL;
   int32_t dword;
   size_t i, count;
   CLEANUP_FREE void *buf = NULL;
@@ -452,17 +441,16 @@ check_windows_system_registry (guestfs_h *g, struct inspect_fs *fs)
     /* Not found: skip getting drive letter mappings (RHBZ#803664). */
     goto skip_drive_letter_mappings;
 
-  values = guestfs_hivex_node_values (g, node);
+  mounted_devices = guestfs_int_hivex_export (g, node, 0);
+  if (mounted_devices == NULL)
+    goto out;
 
   /* Count how many DOS drive letter mappings there are.  This doesn't
    * ignore removable devices, so it overestimates, but that doesn't
    * matter because it just means we'll allocate a few bytes extra.
    */
-  for (i = count = 0; i < values->len; ++i) {
-    CLEANUP_FREE char *key =
-      guestfs_hivex_value_key (g, values->val[i].hivex_value_h);
-    if (key == NULL)
-      goto out;
+  for (i = count = 0; i < mounted_devices->nr_values; ++i) {
+    const char *key = mounted_devices->values[i].key;
     if (STRCASEEQLEN (key, "\\DosDevices\\", 12) &&
         c_isalpha (key[12]) && key[13] == ':')
       count++;
@@ -470,24 +458,18 @@ check_windows_system_registry (guestfs_h *g, struct inspect_fs *fs)
 
   fs->drive_mappings = safe_calloc (g, 2*count + 1, sizeof (char *));
 
-  for (i = count = 0; i < values->len; ++i) {
-    const int64_t v = values->val[i].hivex_value_h;
-    CLEANUP_FREE char *key = guestfs_hivex_value_key (g, v);
-    if (key == NULL)
-      goto out;
+  for (i = count = 0; i < mounted_devices->nr_values; ++i) {
+    const struct hive_value *v = &mounted_devices->values[i];
+    const char *key = v->key;
     if (STRCASEEQLEN (key, "\\DosDevices\\", 12) &&
         c_isalpha (key[12]) && key[13] == ':') {
       /* Get the binary value.  Is it a fixed disk? */
-      CLEANUP_FREE char *blob = NULL;
+      const char *blob = v->value;
       char *device;
-      int64_t type;
       bool is_gpt;
-      size_t len;
 
-      type = guestfs_hivex_value_type (g, v);
-      blob = guestfs_hivex_value_value (g, v, &len);
-      is_gpt = memcmp (blob, gpt_prefix, 8) == 0;
-      if (blob != NULL && type == 3 && (len == 12 || is_gpt)) {
+      is_gpt = v->len >= 8 && memcmp (blob, gpt_prefix, 8) == 0;
+      if (v->type == 3 && (v->len == 12 || is_gpt)) {
         /* Try to map the blob to a known disk and partition. */
         if (is_gpt)
           device = map_registry_disk_blob_gpt (g, blob);
@@ -520,18 +502,16 @@ check_windows_system_registry (guestfs_h *g, struct inspect_fs *fs)
     goto out;
   }
 
-  values2 = guestfs_hivex_node_values (g, node);
-  if (values2 == NULL)
+  parameters = guestfs_int_hivex_export (g, node, 0);
+  if (parameters == NULL)
     goto out;
 
-  for (i = 0; i < values2->len; ++i) {
-    const int64_t v = values2->val[i].hivex_value_h;
-    CLEANUP_FREE char *key = guestfs_hivex_value_key (g, v);
-    if (key == NULL)
-      goto out;
+  for (i = 0; i < parameters->nr_values; ++i) {
+    const struct hive_value *v = &parameters->values[i];
+    const char *key = v->key;
 
     if (STRCASEEQ (key, "Hostname")) {
-      fs->hostname = guestfs_hivex_value_utf8 (g, v);
+      fs->hostname = guestfs_int_hive_value_utf8 (g, v);
       if (!fs->hostname)
         goto out;
     }
@@ -706,8 +686,6 @@ guestfs_int_case_sensitive_path_silently (guestfs_h *g, const char *path)
  * the appliance because it uses iconv_open which doesn't work because
  * we delete all the i18n databases.
  */
-static char *utf16_to_utf8 (/* const */ char *input, size_t len);
-
 char *
 guestfs_impl_hivex_value_utf8 (guestfs_h *g, int64_t valueh)
 {
@@ -718,7 +696,7 @@ guestfs_impl_hivex_value_utf8 (guestfs_h *g, int64_t valueh)
   if (buf == NULL)
     return NULL;
 
-  ret = utf16_to_utf8 (buf, buflen);
+  ret = guestfs_int_utf16le_to_utf8 (buf, buflen);
   if (ret == NULL) {
     perrorf (g, "hivex: conversion of registry value to UTF8 failed");
     return NULL;
@@ -727,8 +705,11 @@ guestfs_impl_hivex_value_utf8 (guestfs_h *g, int64_t valueh)
   return ret;
 }
 
-static char *
-utf16_to_utf8 (/* const */ char *input, size_t len)
+/* Convert a UTF16LE string to UTF8.  Returns NULL and sets errno on
+ * failure.
+ */
+char *
+guestfs_int_utf16le_to_utf8 (const char *input, size_t len)
 {
   iconv_t ic = iconv_open ("UTF-8", "UTF-16LE");
   if (ic == (iconv_t) -1)
@@ -749,7 +730,7 @@ utf16_to_utf8 (/* const */ char *input, size_t len)
     errno = err;
     return NULL;
   }
-  char *inp = input;
+  char *inp = (char *) input;
   char *outp = out;
 
   const size_t r =
@@ -23,6 +23,7 @@
 #include <unistd.h>
 #include <string.h>
 #include <libintl.h>
+#include <sys/stat.h>
 
 #ifdef HAVE_ENDIAN_H
 #include <endian.h>
@@ -42,30 +43,200 @@ static int check_filesystem (guestfs_h *g, const char *mountable,
 static void extend_fses (guestfs_h *g);
 static int get_partition_context (guestfs_h *g, const char *partition, int *partnum_ret, int *nr_partitions_ret);
 static int is_symlink_to (guestfs_h *g, const char *file, const char *wanted_target);
+static int check_for_filesystem_on (guestfs_h *g, const char *mountable, const char *vfs_type, const struct guestfs_statns *prefetched, int others_mounted);
+static struct guestfs_statns_list *prefetch_paths (guestfs_h *g, char *const *prefixes);
+static const struct guestfs_statns *find_prefetched (guestfs_h *g, const char *path, size_t len);
+static const struct guestfs_statns *lookup_prefetched (guestfs_h *g, const char *path, int followsymlinks);
+
+/* Paths which the heuristics below, in inspect-fs-unix.c and in
+ * inspect-fs-cd.c check for.  They are all looked up in a single call
+ * to the daemon when a filesystem has been mounted, see
+ * prefetch_paths.  Paths which are not in this list still work, but
+ * cost a round trip each.
+ *
+ * The parent directories of every path must be in the list too, so
+ * that lookup_prefetched can check that none of them is a symlink.
+ */
+static const char *const inspect_paths[] = {
+  /* parent directories */
+  "/grub", "/grub2", "/hurd", "/service", "/etc/coreos", "/isolinux",
+  "/EFI", "/images", "/i386", "/amd64", "/freedos", "/boot",
+  "/etc/cirros", "/usr/share", "/usr/share/cirros", "/lib",
+  "/etc/sysconfig", "/usr/bin", "/casper", "/live",
+  /* check_filesystem */
+  "/etc", "/bin", "/share", "/root", "/home", "/usr", "/local",
+  "/log", "/run", "/spool", "/share/coreos",
+  "/grub/menu.lst", "/grub/grub.conf", "/grub2/grub.cfg",
+  "/etc/freebsd-update.conf", "/etc/fstab", "/etc/hosts",
+  "/netbsd", "/etc/release", "/bsd", "/etc/motd",
+  "/hurd/console", "/hurd/hello", "/hurd/null",
+  "/service/vm", "/etc/version", "/etc/coreos/update.conf",
+  "/isolinux/isolinux.cfg", "/EFI/BOOT", "/images/install.img",
+  "/.disk", "/.discinfo", "/i386/txtsetup.sif", "/amd64/txtsetup.sif",
+  "/freedos/freedos.ico", "/boot/loader.rc",
+  /* inspect-fs-unix.c */
+  "/etc/os-release", "/etc/lsb-release", "/etc/oracle-release",
+  "/etc/centos-release", "/etc/altlinux-release", "/etc/redhat-release",
+  "/etc/debian_version", "/etc/pardus-release", "/etc/arch-release",
+  "/etc/gentoo-release", "/etc/meego-release", "/etc/slackware-version",
+  "/etc/ttylinux-target", "/etc/SuSE-release", "/etc/cirros/version",
+  "/etc/br-version", "/usr/share/cirros/logo", "/etc/alpine-release",
+  "/etc/frugalware-release", "/etc/pld-release",
+  "/lib/os-release", "/share/coreos/lsb-release", "/etc/mdadm.conf",
+  "/bin/bash", "/bin/ls", "/bin/echo", "/bin/rm", "/bin/sh",
+  "/etc/HOSTNAME", "/etc/hostname", "/etc/sysconfig/network",
+  "/etc/rc.conf", "/etc/myname", "/etc/hostname.file",
+  "/usr/bin/dnf",
+  /* inspect-fs-cd.c */
+  "/.disk/cd_type", "/.disk/info", "/.treeinfo", "/setup.bat",
+  "/casper/filesystem.squashfs", "/live/filesystem.squashfs",
+  "/mfsroot.gz",
+  NULL
+};
+#define NR_INSPECT_PATHS (sizeof inspect_paths / sizeof inspect_paths[0] - 1)
+
+/* Can this filesystem be mounted in advance by
+ * guestfs_int_check_for_filesystems?  It must be on a device, and of
+ * a type for which mounting the same device a second time reuses the
+ * superblock.  This excludes NTFS, because ntfs-3g refuses to mount a
+ * device which is already mounted.
+ */
+static int
+can_mount_in_advance (const char *mountable, const char *vfs_type)
+{
+  return STRPREFIX (mountable, "/dev/") &&
+    (STREQ (vfs_type, "ext2") ||
+     STREQ (vfs_type, "ext3") ||
+     STREQ (vfs_type, "ext4") ||
+     STREQ (vfs_type, "xfs") ||
+     STREQ (vfs_type, "btrfs") ||
+     STREQ (vfs_type, "vfat") ||
+     STREQ (vfs_type, "iso9660"));
+}
 
-/* Find out if 'device' contains a filesystem.  If it does, add
- * another entry in g->fses.
+/**
+ * Check all the filesystems in C<fses> (the list of mountables and
+ * their types returned by C<guestfs_list_filesystems>), adding an
+ * entry to C<g-E<gt>fses> for each filesystem found.
+ *
+ * Instead of mounting each filesystem on F</> in turn, the filesystems
+ * on devices are first all mounted read-only at the same time, each
+ * under its own mountpoint, by a single call which runs the mounts in
+ * parallel in the daemon.  The paths which the heuristics check for
+ * are then looked up in all of them with a single call.  After that
+ * each filesystem is mounted on F</> to run the rest of the checks,
+ * which is cheap because the kernel reuses the superblock of the
+ * mount which already exists.
+ *
+ * Other filesystems (see C<can_mount_in_advance>) are still checked
+ * one at a time.
  */
 int
-guestfs_int_check_for_filesystem_on (guestfs_h *g, const char *mountable)
+guestfs_int_check_for_filesystems (guestfs_h *g, char *const *fses)
+{
+  CLEANUP_FREE_STRINGSBUF DECLARE_STRINGSBUF (devices);
+  CLEANUP_FREE_STRINGSBUF DECLARE_STRINGSBUF (mountpoints);
+  CLEANUP_FREE_STRINGSBUF DECLARE_STRINGSBUF (mounted);
+  CLEANUP_FREE_STRING_LIST char **errors = NULL;
+  CLEANUP_FREE_STATNS_LIST struct guestfs_statns_list *stats = NULL;
+  CLEANUP_FREE ssize_t *slot = NULL;
+  size_t i, nr_fses;
+  int r = 0;
+
+  nr_fses = guestfs_int_count_strings (fses) / 2;
+
+  /* slot[i] is the index of fses[2*i] in 'devices' if it is mounted
+   * in advance, then its index in 'mounted' (and the prefetched
+   * results) if that worked, else -1.
+   */
+  slot = safe_malloc (g, nr_fses * sizeof (ssize_t));
+  for (i = 0; i < nr_fses; ++i) {
+    const char *mountable = fses[2*i], *vfs_type = fses[2*i+1];
+
+    slot[i] = -1;
+    if (can_mount_in_advance (mountable, vfs_type)) {
+      slot[i] = devices.size;
+      guestfs_int_add_string (g, &devices, mountable);
+      guestfs_int_add_sprintf (g, &mountpoints, "/inspect%zu", devices.size);
+    }
+  }
+
+  /* Not worth it for a single filesystem. */
+  if (devices.size >= 2) {
+    guestfs_int_end_stringsbuf (g, &devices);
+    guestfs_int_end_stringsbuf (g, &mountpoints);
+    /* If this fails, check the filesystems one at a time. */
+    guestfs_push_error_handler (g, NULL, NULL);
+    errors = guestfs_internal_mount_ro_list (g, devices.argv, mountpoints.argv);
+    guestfs_pop_error_handler (g);
+  }
+
+  for (i = 0; i < nr_fses; ++i) {
+    if (slot[i] == -1)
+      continue;
+    if (errors == NULL || STRNEQ (errors[slot[i]], "")) {
+      if (errors)
+        debug (g, "check_for_filesystems: %s", errors[slot[i]]);
+      slot[i] = -1;
+      continue;
+    }
+    guestfs_int_add_string (g, &mounted, mountpoints.argv[slot[i]]);
+    slot[i] = mounted.size - 1;
+  }
+
+  if (mounted.size > 0) {
+    guestfs_int_end_stringsbuf (g, &mounted);
+    stats = prefetch_paths (g, mounted.argv);
+  }
+
+  for (i = 0; i < nr_fses; ++i) {
+    const struct guestfs_statns *prefetched = NULL;
+
+    if (stats && slot[i] >= 0)
+      prefetched = &stats->val[slot[i] * NR_INSPECT_PATHS];
+    if (check_for_filesystem_on (g, fses[2*i], fses[2*i+1], prefetched,
+                                 mounted.size > 0) == -1) {
+      r = -1;
+      break;
+    }
+  }
+
+  /* Unmount the filesystems and remove the mountpoints. */
+  if (devices.size >= 2) {
+    if (guestfs_umount_all (g) == -1)
+      r = -1;
+    guestfs_push_error_handler (g, NULL, NULL);
+    for (i = 0; mountpoints.argv[i] != NULL; ++i)
+      guestfs_rmmountpoint (g, mountpoints.argv[i]);
+    guestfs_pop_error_handler (g);
+  }
+
+  return r;
+}
+
+/* Find out if 'device' contains a filesystem.  If it does, add
+ * another entry in g->fses.  'vfs_type' is the type returned for it
+ * by guestfs_list_filesystems (which may be "unknown").
+ *
+ * 'prefetched' are the results of prefetch_paths for this filesystem
+ * if they are already known, else NULL.  'others_mounted' is true if
+ * other filesystems are mounted under their own mountpoints.
+ */
+static int
+check_for_filesystem_on (guestfs_h *g, const char *mountable,
+                         const char *vfs_type,
+                         const struct guestfs_statns *prefetched,
+                         int others_mounted)
 {
-  CLEANUP_FREE char *vfs_type = NULL;
   int is_swap, r;
   struct inspect_fs *fs;
   CLEANUP_FREE_INTERNAL_MOUNTABLE struct guestfs_internal_mountable *m = NULL;
+  CLEANUP_FREE_STATNS_LIST struct guestfs_statns_list *stats = NULL;
   int whole_device = 0;
 
-  /* Get vfs-type in order to check if it's a Linux(?) swap device.
-   * If there's an error we should ignore it, so to do that we have to
-   * temporarily replace the error handler with a null one.
-   */
-  guestfs_push_error_handler (g, NULL, NULL);
-  vfs_type = guestfs_vfs_type (g, mountable);
-  guestfs_pop_error_handler (g);
-
-  is_swap = vfs_type && STREQ (vfs_type, "swap");
-  debug (g, "check_for_filesystem_on: %s (%s)",
-         mountable, vfs_type ? vfs_type : "failed to get vfs type");
+  /* Check if it's a Linux(?) swap device. */
+  is_swap = STREQ (vfs_type, "swap");
+  debug (g, "check_for_filesystem_on: %s (%s)", mountable, vfs_type);
 
   if (is_swap) {
     extend_fses (g);
@@ -104,7 +275,7 @@ guestfs_int_check_for_filesystem_on (guestfs_h *g, const char *mountable)
 
   /* Try mounting the device.  As above, ignore errors. */
   guestfs_push_error_handler (g, NULL, NULL);
-  if (vfs_type && STREQ (vfs_type, "ufs")) { /* Hack for the *BSDs. */
+  if (STREQ (vfs_type, "ufs")) { /* Hack for the *BSDs. */
     /* FreeBSD fs is a variant of ufs called ufs2 ... */
     r = guestfs_mount_vfs (g, "ro,ufstype=ufs2", "ufs", mountable, "/");
     if (r == -1)
@@ -118,10 +289,25 @@ guestfs_int_check_for_filesystem_on (guestfs_h *g, const char *mountable)
     return 0;
 
   /* Do the rest of the checks. */
+  if (prefetched == NULL) {
+    char *root[] = { (char *) "", NULL };
+
+    stats = prefetch_paths (g, root);
+    if (stats)
+      prefetched = stats->val;
+  }
+  g->prefetched = prefetched;
   r = check_filesystem (g, mountable, m, whole_device);
+  g->prefetched = NULL;
 
-  /* Unmount the filesystem. */
-  if (guestfs_umount_all (g) == -1)
+  /* Unmount the filesystem.  If other filesystems are mounted, they
+   * are hidden under this one, so guestfs_umount_all would fail.
+   */
+  if (others_mounted) {
+    if (guestfs_umount (g, "/") == -1)
+      return -1;
+  }
+  else if (guestfs_umount_all (g) == -1)
     return -1;
 
   return r;
@@ -150,20 +336,20 @@ check_filesystem (guestfs_h *g, const char *mountable,
   fs->mountable = safe_strdup (g, mountable);
 
   /* Optimize some of the tests by avoiding multiple tests of the same thing. */
-  const int is_dir_etc = guestfs_is_dir (g, "/etc") > 0;
-  const int is_dir_bin = guestfs_is_dir (g, "/bin") > 0;
-  const int is_dir_share = guestfs_is_dir (g, "/share") > 0;
+  const int is_dir_etc = guestfs_int_inspect_is_dir (g, "/etc", 0) > 0;
+  const int is_dir_bin = guestfs_int_inspect_is_dir (g, "/bin", 0) > 0;
+  const int is_dir_share = guestfs_int_inspect_is_dir (g, "/share", 0) > 0;
 
   /* Grub /boot? */
-  if (guestfs_is_file (g, "/grub/menu.lst") > 0 ||
-      guestfs_is_file (g, "/grub/grub.conf") > 0 ||
-      guestfs_is_file (g, "/grub2/grub.cfg") > 0)
+  if (guestfs_int_inspect_is_file (g, "/grub/menu.lst", 0) > 0 ||
+      guestfs_int_inspect_is_file (g, "/grub/grub.conf", 0) > 0 ||
+      guestfs_int_inspect_is_file (g, "/grub2/grub.cfg", 0) > 0)
     ;
   /* FreeBSD root? */
   else if (is_dir_etc &&
            is_dir_bin &&
-           guestfs_is_file (g, "/etc/freebsd-update.conf") > 0 &&
-           guestfs_is_file (g, "/etc/fstab") > 0) {
+           guestfs_int_inspect_is_file (g, "/etc/freebsd-update.conf", 0) > 0 &&
+           guestfs_int_inspect_is_file (g, "/etc/fstab", 0) > 0) {
     fs->role = OS_ROLE_ROOT;
     fs->format = OS_FORMAT_INSTALLED;
     if (guestfs_int_check_freebsd_root (g, fs) == -1)
@@ -172,9 +358,9 @@ check_filesystem (guestfs_h *g, const char *mountable,
   /* NetBSD root? */
   else if (is_dir_etc &&
            is_dir_bin &&
-           guestfs_is_file (g, "/netbsd") > 0 &&
-           guestfs_is_file (g, "/etc/fstab") > 0 &&
-           guestfs_is_file (g, "/etc/release") > 0) {
+           guestfs_int_inspect_is_file (g, "/netbsd", 0) > 0 &&
+           guestfs_int_inspect_is_file (g, "/etc/fstab", 0) > 0 &&
+           guestfs_int_inspect_is_file (g, "/etc/release", 0) > 0) {
     fs->role = OS_ROLE_ROOT;
     fs->format = OS_FORMAT_INSTALLED;
     if (guestfs_int_check_netbsd_root (g, fs) == -1)
@@ -183,18 +369,18 @@ check_filesystem (guestfs_h *g, const char *mountable,
   /* OpenBSD root? */
   else if (is_dir_etc &&
            is_dir_bin &&
-           guestfs_is_file (g, "/bsd") > 0 &&
-           guestfs_is_file (g, "/etc/fstab") > 0 &&
-           guestfs_is_file (g, "/etc/motd") > 0) {
+           guestfs_int_inspect_is_file (g, "/bsd", 0) > 0 &&
+           guestfs_int_inspect_is_file (g, "/etc/fstab", 0) > 0 &&
+           guestfs_int_inspect_is_file (g, "/etc/motd", 0) > 0) {
     fs->role = OS_ROLE_ROOT;
     fs->format = OS_FORMAT_INSTALLED;
     if (guestfs_int_check_openbsd_root (g, fs) == -1)
       return -1;
   }
   /* Hurd root? */
-  else if (guestfs_is_file (g, "/hurd/console") > 0 &&
-           guestfs_is_file (g, "/hurd/hello") > 0 &&
-           guestfs_is_file (g, "/hurd/null") > 0) {
+  else if (guestfs_int_inspect_is_file (g, "/hurd/console", 0) > 0 &&
+           guestfs_int_inspect_is_file (g, "/hurd/hello", 0) > 0 &&
+           guestfs_int_inspect_is_file (g, "/hurd/null", 0) > 0) {
     fs->role = OS_ROLE_ROOT;
     fs->format = OS_FORMAT_INSTALLED; /* XXX could be more specific */
     if (guestfs_int_check_hurd_root (g, fs) == -1)
@@ -203,9 +389,9 @@ check_filesystem (guestfs_h *g, const char *mountable,
   /* Minix root? */
   else if (is_dir_etc &&
            is_dir_bin &&
-           guestfs_is_file (g, "/service/vm") > 0 &&
-           guestfs_is_file (g, "/etc/fstab") > 0 &&
-           guestfs_is_file (g, "/etc/version") > 0) {
+           guestfs_int_inspect_is_file (g, "/service/vm", 0) > 0 &&
+           guestfs_int_inspect_is_file (g, "/etc/fstab", 0) > 0 &&
+           guestfs_int_inspect_is_file (g, "/etc/version", 0) > 0) {
     fs->role = OS_ROLE_ROOT;
     fs->format = OS_FORMAT_INSTALLED;
     if (guestfs_int_check_minix_root (g, fs) == -1)
@@ -215,8 +401,8 @@ check_filesystem (guestfs_h *g, const char *mountable,
   else if (is_dir_etc &&
            (is_dir_bin ||
             is_symlink_to (g, "/bin", "usr/bin") > 0) &&
-           (guestfs_is_file (g, "/etc/fstab") > 0 ||
-            guestfs_is_file (g, "/etc/hosts") > 0)) {
+           (guestfs_int_inspect_is_file (g, "/etc/fstab", 0) > 0 ||
+            guestfs_int_inspect_is_file (g, "/etc/hosts", 0) > 0)) {
     fs->role = OS_ROLE_ROOT;
     fs->format = OS_FORMAT_INSTALLED;
     if (guestfs_int_check_linux_root (g, fs) == -1)
@@ -224,10 +410,10 @@ check_filesystem (guestfs_h *g, const char *mountable,
   }
   /* CoreOS root? */
   else if (is_dir_etc &&
-           guestfs_is_dir (g, "/root") > 0 &&
-           guestfs_is_dir (g, "/home") > 0 &&
-           guestfs_is_dir (g, "/usr") > 0 &&
-           guestfs_is_file (g, "/etc/coreos/update.conf") > 0) {
+           guestfs_int_inspect_is_dir (g, "/root", 0) > 0 &&
+           guestfs_int_inspect_is_dir (g, "/home", 0) > 0 &&
+           guestfs_int_inspect_is_dir (g, "/usr", 0) > 0 &&
+           guestfs_int_inspect_is_file (g, "/etc/coreos/update.conf", 0) > 0) {
     fs->role = OS_ROLE_ROOT;
     fs->format = OS_FORMAT_INSTALLED;
     if (guestfs_int_check_coreos_root (g, fs) == -1)
@@ -237,30 +423,30 @@ check_filesystem (guestfs_h *g, const char *mountable,
   else if (is_dir_etc &&
            is_dir_bin &&
            is_dir_share &&
-           guestfs_is_dir (g, "/local") == 0 &&
-           guestfs_is_file (g, "/etc/fstab") == 0)
+           guestfs_int_inspect_is_dir (g, "/local", 0) == 0 &&
+           guestfs_int_inspect_is_file (g, "/etc/fstab", 0) == 0)
     ;
   /* Linux /usr? */
   else if (is_dir_etc &&
            is_dir_bin &&
            is_dir_share &&
-           guestfs_is_dir (g, "/local") > 0 &&
-           guestfs_is_file (g, "/etc/fstab") == 0) {
+           guestfs_int_inspect_is_dir (g, "/local", 0) > 0 &&
+           guestfs_int_inspect_is_file (g, "/etc/fstab", 0) == 0) {
     if (guestfs_int_check_linux_usr (g, fs) == -1)
       return -1;
   }
   /* CoreOS /usr? */
   else if (is_dir_bin &&
            is_dir_share &&
-           guestfs_is_dir (g, "/local") > 0 &&
-           guestfs_is_dir (g, "/share/coreos") > 0) {
+           guestfs_int_inspect_is_dir (g, "/local", 0) > 0 &&
+           guestfs_int_inspect_is_dir (g, "/share/coreos", 0) > 0) {
     if (guestfs_int_check_coreos_usr (g, fs) == -1)
       return -1;
   }
   /* Linux /var? */
-  else if (guestfs_is_dir (g, "/log") > 0 &&
-           guestfs_is_dir (g, "/run") > 0 &&
-           guestfs_is_dir (g, "/spool") > 0)
+  else if (guestfs_int_inspect_is_dir (g, "/log", 0) > 0 &&
+           guestfs_int_inspect_is_dir (g, "/run", 0) > 0 &&
+           guestfs_int_inspect_is_dir (g, "/spool", 0) > 0)
     ;
   /* Windows root? */
   else if ((windows_systemroot = guestfs_int_get_windows_systemroot (g)) != NULL)
@@ -299,15 +485,15 @@ check_filesystem (guestfs_h *g, const char *mountable,
    * first partition (eg. bootable USB key).
    */
   else if ((whole_device || (partnum == 1 && nr_partitions == 1)) &&
-           (guestfs_is_file (g, "/isolinux/isolinux.cfg") > 0 ||
-            guestfs_is_dir (g, "/EFI/BOOT") > 0 ||
-            guestfs_is_file (g, "/images/install.img") > 0 ||
-            guestfs_is_dir (g, "/.disk") > 0 ||
-            guestfs_is_file (g, "/.discinfo") > 0 ||
-            guestfs_is_file (g, "/i386/txtsetup.sif") > 0 ||
-            guestfs_is_file (g, "/amd64/txtsetup.sif") > 0 ||
-            guestfs_is_file (g, "/freedos/freedos.ico") > 0 ||
-            guestfs_is_file (g, "/boot/loader.rc") > 0)) {
+           (guestfs_int_inspect_is_file (g, "/isolinux/isolinux.cfg", 0) > 0 ||
+            guestfs_int_inspect_is_dir (g, "/EFI/BOOT", 0) > 0 ||
+            guestfs_int_inspect_is_file (g, "/images/install.img", 0) > 0 ||
+            guestfs_int_inspect_is_dir (g, "/.disk", 0) > 0 ||
+            guestfs_int_inspect_is_file (g, "/.discinfo", 0) > 0 ||
+            guestfs_int_inspect_is_file (g, "/i386/txtsetup.sif", 0) > 0 ||
+            guestfs_int_inspect_is_file (g, "/amd64/txtsetup.sif", 0) > 0 ||
+            guestfs_int_inspect_is_file (g, "/freedos/freedos.ico", 0) > 0 ||
+            guestfs_int_inspect_is_file (g, "/boot/loader.rc", 0) > 0)) {
     fs->role = OS_ROLE_ROOT;
     fs->format = OS_FORMAT_INSTALLER;
     if (guestfs_int_check_installer_root (g, fs) == -1)
@@ -371,8 +557,14 @@ static int
 is_symlink_to (guestfs_h *g, const char *file, const char *wanted_target)
 {
   CLEANUP_FREE char *target = NULL;
+  const struct guestfs_statns *st;
 
-  if (guestfs_is_symlink (g, file) == 0)
+  st = lookup_prefetched (g, file, 0);
+  if (st != NULL) {
+    if (st->st_ino == -1 || !S_ISLNK (st->st_mode))
+      return 0;
+  }
+  else if (guestfs_is_symlink (g, file) == 0)
     return 0;
 
   target = guestfs_readlink (g, file);
@@ -383,6 +575,139 @@ is_symlink_to (guestfs_h *g, const char *file, const char *wanted_target)
   return STREQ (target, wanted_target);
 }
 
+/**
+ * Look up all of C<inspect_paths>, prefixed with each of C<prefixes>
+ * in turn, using a single call to the daemon.  The returned list has
+ * the C<lstat> results for C<NR_INSPECT_PATHS> paths for each prefix.  While a filesystem
+ * is checked, C<g-E<gt>prefetched> points to its entries, which are
+ * used by C<guestfs_int_inspect_is_file> and
+ * C<guestfs_int_inspect_is_dir>.
+ *
+ * Errors are ignored and C<NULL> is returned: the checks then just
+ * fall back to calling C<guestfs_is_file> etc. for each path.
+ */
+static struct guestfs_statns_list *
+prefetch_paths (guestfs_h *g, char *const *prefixes)
+{
+  CLEANUP_FREE_STRINGSBUF DECLARE_STRINGSBUF (paths);
+  struct guestfs_statns_list *stats;
+  size_t i, j;
+
+  for (i = 0; prefixes[i] != NULL; ++i) {
+    for (j = 0; j < NR_INSPECT_PATHS; ++j)
+      guestfs_int_add_sprintf (g, &paths, "%s%s",
+                               prefixes[i], inspect_paths[j]);
+  }
+  guestfs_int_end_stringsbuf (g, &paths);
+
+  guestfs_push_error_handler (g, NULL, NULL);
+  stats = guestfs_internal_stat_paths (g, paths.argv);
+  guestfs_pop_error_handler (g);
+  if (stats == NULL)
+    return NULL;
+
+  if (stats->len != paths.size - 1) {
+    debug (g, "guestfs_internal_stat_paths returned %u entries, ignored",
+           stats->len);
+    guestfs_free_statns_list (stats);
+    return NULL;
+  }
+
+  return stats;
+}
+
+/* Return the prefetched entry for the first 'len' characters
+ * of 'path', or NULL if that was not prefetched.
+ */
+static const struct guestfs_statns *
+find_prefetched (guestfs_h *g, const char *path, size_t len)
+{
+  size_t i;
+
+  for (i = 0; i < NR_INSPECT_PATHS; ++i) {
+    if (STREQLEN (inspect_paths[i], path, len) &&
+        inspect_paths[i][len] == '\0')
+      return &g->prefetched[i];
+  }
+
+  return NULL;
+}
+
+/* Return the prefetched lstat result for 'path', or NULL if 'path'
+ * was not prefetched.  If the path does not exist, st_ino is -1 in
+ * the returned entry.
+ *
+ * The paths were looked up under /inspectN (or under / before the
+ * guest's other filesystems are mounted), where the daemon resolves
+ * an absolute symlink such as /bin -> /usr/bin against the appliance
+ * and not against the guest.  So NULL is also returned, and the
+ * caller makes the live call instead, if any parent directory of
+ * 'path' is a symlink, or if 'path' itself is a symlink and
+ * 'followsymlinks' is set.  In every other case the stat result
+ * would be the same as the lstat one.
+ */
+static const struct guestfs_statns *
+lookup_prefetched (guestfs_h *g, const char *path, int followsymlinks)
+{
+  const struct guestfs_statns *st;
+  const char *p;
+
+  if (g->prefetched == NULL)
+    return NULL;
+
+  for (p = strchr (path + 1, '/'); p != NULL; p = strchr (p + 1, '/')) {
+    st = find_prefetched (g, path, p - path);
+    if (st == NULL || (st->st_ino != -1 && S_ISLNK (st->st_mode)))
+      return NULL;
+  }
+
+  st = find_prefetched (g, path, strlen (path));
+  if (st == NULL ||
+      (followsymlinks && st->st_ino != -1 && S_ISLNK (st->st_mode)))
+    return NULL;
+
+  return st;
+}
+
+/**
+ * Equivalent to C<guestfs_is_file_opts>, but uses the results of
+ * C<prefetch_paths> when C<path> is one of the paths checked by
+ * inspection.
+ */
+int
+guestfs_int_inspect_is_file (guestfs_h *g, const char *path,
+                             int followsymlinks)
+{
+  const struct guestfs_statns *st;
+
+  st = lookup_prefetched (g, path, followsymlinks);
+  if (st == NULL)
+    return guestfs_is_file_opts (g, path,
+                                 GUESTFS_IS_FILE_OPTS_FOLLOWSYMLINKS,
+                                 followsymlinks, -1);
+
+  return st->st_ino != -1 && S_ISREG (st->st_mode);
+}
+
+/**
+ * Equivalent to C<guestfs_is_dir_opts>, see
+ * C<guestfs_int_inspect_is_file>.
+ */
+int
+guestfs_int_inspect_is_dir (guestfs_h *g, const char *path,
+                            int followsymlinks)
+{
+  const struct guestfs_statns *st;
+
+  st = lookup_prefetched (g, path, followsymlinks);
+  if (st == NULL)
+    return guestfs_is_dir_opts (g, path,
+                                GUESTFS_IS_DIR_OPTS_FOLLOWSYMLINKS,
+                                followsymlinks, -1);
+
+  return st->st_ino != -1 && S_ISDIR (st->st_mode);
+}
+
 int
 guestfs_int_is_file_nocase (guestfs_h *g, const char *path)
 {
@@ -522,8 +847,7 @@ guestfs_int_check_package_management (guestfs_h *g, struct inspect_fs *fs)
   case OS_DISTRO_FEDORA:
     /* If Fedora >= 22 and dnf is installed, say "dnf". */
     if (guestfs_int_version_ge (&fs->version, 22, 0, 0) &&
-        guestfs_is_file_opts (g, "/usr/bin/dnf",
-                              GUESTFS_IS_FILE_OPTS_FOLLOWSYMLINKS, 1, -1) > 0)
+        guestfs_int_inspect_is_file (g, "/usr/bin/dnf", 1) > 0)
       fs->package_management = OS_PACKAGE_MANAGEMENT_DNF;
     else if (guestfs_int_version_ge (&fs->version, 1, 0, 0))
       fs->package_management = OS_PACKAGE_MANAGEMENT_YUM;
@@ -0,0 +1,275 @@
+/* libguestfs
+ * Copyright (C) 2016 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * Local copies of Windows Registry subtrees.
+ *
+ * Inspection reads a lot of keys and values from the registry.  Using
+ * the C<guestfs_hivex_*> calls for this costs several round trips to
+ * the daemon for every value.  Instead, a whole subtree is exported
+ * by the daemon in a single call (C<guestfs_internal_hivex_export>),
+ * parsed into a tree of C<struct hive_node>, and then searched
+ * locally.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_ENDIAN_H
+#include <endian.h>
+#endif
+#ifdef HAVE_SYS_ENDIAN_H
+#include <sys/endian.h>
+#endif
+
+#if defined __APPLE__ && defined __MACH__
+#include <libkern/OSByteOrder.h>
+#define be32toh(x) OSSwapBigToHostInt32(x)
+#endif
+
+#include "full-read.h"
+
+#include "guestfs.h"
+#include "guestfs-internal.h"
+#include "guestfs-internal-actions.h"
+
+/* Parser state.  The format is private to the daemon and the
+ * library, see export_node in F<daemon/hivex.c>.
+ */
+struct parser {
+  const char *p;                /* Current position. */
+  const char *end;              /* End of the data. */
+};
+
+static int
+parse_be32 (struct parser *ps, uint32_t *v)
+{
+  if (ps->end - ps->p < 4)
+    return -1;
+  memcpy (v, ps->p, 4);
+  *v = be32toh (*v);
+  ps->p += 4;
+  return 0;
+}
+
+/* Parse a length-prefixed string.  It is copied and \0-terminated,
+ * since values are usually used as strings.
+ */
+static int
+parse_string (guestfs_h *g, struct parser *ps, char **str, size_t *len_r)
+{
+  uint32_t len;
+
+  if (parse_be32 (ps, &len) == -1 || (size_t) (ps->end - ps->p) < len)
+    return -1;
+  *str = safe_malloc (g, len + 1);
+  memcpy (*str, ps->p, len);
+  (*str)[len] = '\0';
+  ps->p += len;
+  if (len_r)
+    *len_r = len;
+  return 0;
+}
+
+static int
+parse_node (guestfs_h *g, struct parser *ps, struct hive_node *node)
+{
+  uint32_t n, type;
+  size_t i;
+
+  if (parse_string (g, ps, &node->name, NULL) == -1)
+    return -1;
+
+  if (parse_be32 (ps, &n) == -1 || n > (size_t) (ps->end - ps->p))
+    return -1;
+  node->values = safe_calloc (g, n, sizeof (struct hive_value));
+  for (i = 0; i < n; ++i) {
+    struct hive_value *value = &node->values[i];
+
+    if (parse_string (g, ps, &value->key, NULL) == -1)
+      return -1;
+    node->nr_values++;
+    if (parse_be32 (ps, &type) == -1 ||
+        parse_string (g, ps, &value->value, &value->len) == -1)
+      return -1;
+    value->type = type;
+  }
+
+  if (parse_be32 (ps, &n) == -1 || n > (size_t) (ps->end - ps->p))
+    return -1;
+  node->children = safe_calloc (g, n, sizeof (struct hive_node));
+  for (i = 0; i < n; ++i) {
+    node->nr_children++;
+    if (parse_node (g, ps, &node->children[i]) == -1)
+      return -1;
+  }
+
+  return 0;
+}
+
+static void
+free_node_contents (struct hive_node *node)
+{
+  size_t i;
+
+  free (node->name);
+  for (i = 0; i < node->nr_values; ++i) {
+    free (node->values[i].key);
+    free (node->values[i].value);
+  }
+  free (node->values);
+  for (i = 0; i < node->nr_children; ++i)
+    free_node_contents (&node->children[i]);
+  free (node->children);
+}
+
+void
+guestfs_int_free_hive_node (struct hive_node *node)
+{
+  if (node) {
+    free_node_contents (node);
+    free (node);
+  }
+}
+
+void
+guestfs_int_cleanup_free_hive_node (struct hive_node **ptr)
+{
+  guestfs_int_free_hive_node (*ptr);
+}
+
+/**
+ * Export the registry node C<nodeh> (in the hive which is currently
+ * open) with its values and its children down to C<maxdepth> levels
+ * (C<-1> for no limit).
+ *
+ * Returns the local copy, which must be freed with
+ * C<guestfs_int_free_hive_node>, or C<NULL> on error.
+ */
+struct hive_node *
+guestfs_int_hivex_export (guestfs_h *g, int64_t nodeh, int maxdepth)
+{
+  CLEANUP_UNLINK_FREE char *tmpfile = NULL;
+  CLEANUP_FREE char *buf = NULL;
+  struct stat statbuf;
+  struct parser ps;
+  struct hive_node *node;
+  size_t size;
+  int fd;
+
+  tmpfile = guestfs_int_make_temp_path (g, "hivex");
+  if (tmpfile == NULL)
+    return NULL;
+
+  if (guestfs_internal_hivex_export (g, nodeh, maxdepth, tmpfile) == -1)
+    return NULL;
+
+  fd = open (tmpfile, O_RDONLY|O_CLOEXEC);
+  if (fd == -1) {
+    perrorf (g, "open: %s", tmpfile);
+    return NULL;
+  }
+  if (fstat (fd, &statbuf) == -1) {
+    perrorf (g, "stat: %s", tmpfile);
+    close (fd);
+    return NULL;
+  }
+  size = statbuf.st_size;
+  buf = safe_malloc (g, size);
+  if (full_read (fd, buf, size) != size) {
+    perrorf (g, "full-read: %s: %zu bytes", tmpfile, size);
+    close (fd);
+    return NULL;
+  }
+  close (fd);
+
+  ps.p = buf;
+  ps.end = buf + size;
+  node = safe_calloc (g, 1, sizeof *node);
+  if (parse_node (g, &ps, node) == -1 || ps.p != ps.end) {
+    error (g, "invalid data from guestfs_internal_hivex_export: "
+           "size=%zu, offset=%zu", size, (size_t) (ps.p - buf));
+    guestfs_int_free_hive_node (node);
+    return NULL;
+  }
+
+  return node;
+}
+
+/**
+ * Find the child of C<node> called C<name>.  As in the registry, the
+ * name is not case sensitive.  Returns C<NULL> if there is no such
+ * child (or if the child was not exported).
+ */
+const struct hive_node *
+guestfs_int_hive_node_get_child (const struct hive_node *node,
+                                 const char *name)
+{
+  size_t i;
+
+  for (i = 0; i < node->nr_children; ++i) {
+    if (STRCASEEQ (node->children[i].name, name))
+      return &node->children[i];
+  }
+
+  return NULL;
+}
+
+/**
+ * Find the value of C<node> called C<key> (not case sensitive).
+ * Returns C<NULL> if there is no such value.
+ */
+const struct hive_value *
+guestfs_int_hive_node_get_value (const struct hive_node *node,
+                                 const char *key)
+{
+  size_t i;
+
+  for (i = 0; i < node->nr_values; ++i) {
+    if (STRCASEEQ (node->values[i].key, key))
+      return &node->values[i];
+  }
+
+  return NULL;
+}
+
+/**
+ * Convert a value, assumed to be a UTF-16LE string, to UTF-8.  This
+ * is the local equivalent of C<guestfs_hivex_value_utf8>.
+ */
+char *
+guestfs_int_hive_value_utf8 (guestfs_h *g, const struct hive_value *value)
+{
+  char *ret;
+
+  ret = guestfs_int_utf16le_to_utf8 (value->value, value->len);
+  if (ret == NULL) {
+    perrorf (g, "hivex: conversion of registry value to UTF8 failed");
+    return NULL;
+  }
+
+  return ret;
+}
@@ -57,7 +57,8 @@ char **
 guestfs_impl_inspect_os (guestfs_h *g)
 {
   CLEANUP_FREE_STRING_LIST char **fses = NULL;
-  char **fs, **ret;
+  CLEANUP_FREE char *cache_key = NULL;
+  char **ret;
 
   /* Remove any information previously stored in the handle. */
   guestfs_int_free_inspect_info (g);
@@ -65,18 +66,23 @@ guestfs_impl_inspect_os (guestfs_h *g)
   if (guestfs_umount_all (g) == -1)
     return NULL;
 
-  /* Iterate over all detected filesystems.  Inspect each one in turn
-   * and add that information to the handle.
+  /* Iterate over all detected filesystems.  Inspect each one and add
+   * that information to the handle.
    */
 
   fses = guestfs_list_filesystems (g);
   if (fses == NULL) return NULL;
 
-  for (fs = fses; *fs; fs += 2) {
-    if (guestfs_int_check_for_filesystem_on (g, *fs)) {
-      guestfs_int_free_inspect_info (g);
-      return NULL;
-    }
+  /* If the same disks were inspected before, use the saved results. */
+  if (g->inspect_cache) {
+    cache_key = guestfs_int_inspect_cache_key (g, fses);
+    if (cache_key && guestfs_int_inspect_cache_load (g, cache_key) == 0)
+      goto get_roots;
+  }
+
+  if (guestfs_int_check_for_filesystems (g, fses) == -1) {
+    guestfs_int_free_inspect_info (g);
+    return NULL;
   }
 
   /* The OS inspection information for CoreOS are gathered by inspecting
@@ -102,6 +108,10 @@ guestfs_impl_inspect_os (guestfs_h *g)
    * filesystems which are root devices and return that to the user.
    * Fall through to guestfs_inspect_get_roots to do that.
    */
+  if (cache_key)
+    guestfs_int_inspect_cache_save (g, cache_key);
+
+ get_roots:
   ret = guestfs_inspect_get_roots (g);
   if (ret == NULL)
     guestfs_int_free_inspect_info (g);
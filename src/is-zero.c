@@ -0,0 +1,178 @@
+/* libguestfs
+ * Copyright (C) 2016 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * Fast detection of all-zero buffers.
+ *
+ * This is used when zeroing devices and when writing sparse output,
+ * where large buffers have to be checked and the check is on the hot
+ * path.  This file is linked into the daemon, the library and the
+ * tools, so it must not use any library or daemon functions.
+ *
+ * On x86-64 there are SSE2 and AVX2 implementations, and the AVX2
+ * one is selected at runtime if the CPU supports it.  On other
+ * architectures a portable word-at-a-time loop is used.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "guestfs-internal-all.h"
+
+#if defined(__x86_64__) && defined(__GNUC__) && \
+  (defined(__clang__) || GUESTFS_GCC_VERSION >= 40900) /* gcc >= 4.9 */
+#define HAVE_IS_ZERO_X86_64
+#include <immintrin.h>
+#endif
+
+/* Words may alias the caller's buffer of any type. */
+typedef unsigned long __attribute__((__may_alias__)) word_t;
+
+/* Check the unaligned head and tail of the buffer byte by byte. */
+static inline int
+is_zero_bytes (const unsigned char *p, size_t size)
+{
+  size_t i;
+
+  for (i = 0; i < size; ++i) {
+    if (p[i] != 0)
+      return 0;
+  }
+
+  return 1;
+}
+
+/* Portable version.  After aligning the pointer, four words are
+ * ORed together per iteration so that there is only one branch
+ * per 32 bytes (on 64 bit).
+ */
+static int
+is_zero_words (const unsigned char *p, size_t size)
+{
+  const word_t *w;
+  size_t head, n;
+
+  head = (- (uintptr_t) p) & (sizeof (word_t) - 1);
+  if (head > size)
+    head = size;
+  if (!is_zero_bytes (p, head))
+    return 0;
+  p += head;
+  size -= head;
+
+  w = (const word_t *) p;
+  n = size / sizeof (word_t);
+  for (; n >= 4; n -= 4, w += 4) {
+    if ((w[0] | w[1] | w[2] | w[3]) != 0)
+      return 0;
+  }
+  for (; n > 0; --n, ++w) {
+    if (*w != 0)
+      return 0;
+  }
+
+  return is_zero_bytes ((const unsigned char *) w,
+                        size & (sizeof (word_t) - 1));
+}
+
+#ifdef HAVE_IS_ZERO_X86_64
+
+/* SSE2 is always available on x86-64. */
+static int
+is_zero_sse2 (const unsigned char *p, size_t size)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+
+  for (; size >= 64; size -= 64, p += 64) {
+    __m128i v;
+
+    v = _mm_or_si128 (_mm_loadu_si128 ((const __m128i *) p),
+                      _mm_loadu_si128 ((const __m128i *) (p+16)));
+    v = _mm_or_si128 (v, _mm_loadu_si128 ((const __m128i *) (p+32)));
+    v = _mm_or_si128 (v, _mm_loadu_si128 ((const __m128i *) (p+48)));
+    if (_mm_movemask_epi8 (_mm_cmpeq_epi8 (v, zero)) != 0xffff)
+      return 0;
+  }
+
+  return is_zero_words (p, size);
+}
+
+static int __attribute__((target("avx2")))
+is_zero_avx2 (const unsigned char *p, size_t size)
+{
+  for (; size >= 128; size -= 128, p += 128) {
+    __m256i v;
+
+    v = _mm256_or_si256 (_mm256_loadu_si256 ((const __m256i *) p),
+                         _mm256_loadu_si256 ((const __m256i *) (p+32)));
+    v = _mm256_or_si256 (v, _mm256_loadu_si256 ((const __m256i *) (p+64)));
+    v = _mm256_or_si256 (v, _mm256_loadu_si256 ((const __m256i *) (p+96)));
+    if (!_mm256_testz_si256 (v, v))
+      return 0;
+  }
+
+  return is_zero_sse2 (p, size);
+}
+
+#endif /* HAVE_IS_ZERO_X86_64 */
+
+/* Buffers smaller than this are not worth dispatching. */
+#define SMALL_BUFFER 64
+
+/**
+ * Return true iff the buffer is all zero bytes.
+ */
+int
+guestfs_int_is_zero (const void *buffer, size_t size)
+{
+  const unsigned char *p = buffer;
+
+  if (size < SMALL_BUFFER)
+    return is_zero_bytes (p, size);
+
+  /* Most non-zero buffers have non-zero data near the start, so
+   * check the first bytes before starting the vectorized loop.
+   */
+  if (!is_zero_bytes (p, 16))
+    return 0;
+
+#ifdef HAVE_IS_ZERO_X86_64
+  /* This is just a test of a variable initialized by libgcc, so it
+   * is cheap enough to do on every call, and safe from threads.
+   */
+  if (__builtin_cpu_supports ("avx2"))
+    return is_zero_avx2 (p, size);
+  return is_zero_sse2 (p, size);
+#else
+  return is_zero_words (p, size);
+#endif
+}
+
+/**
+ * Like L</guestfs_int_is_zero>, but always uses the portable
+ * implementation.  This is only for testing and benchmarking.
+ */
+int
+guestfs_int_is_zero_portable (const void *buffer, size_t size)
+{
+  return is_zero_words (buffer, size);
+}
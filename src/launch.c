@@ -98,6 +98,9 @@ guestfs_impl_launch (guestfs_h *g)
   if (g->backend_ops->launch (g, g->backend_data, g->backend_arg) == -1)
     return -1;
 
+  /* Agree on the FileIn/FileOut chunk size with the daemon. */
+  guestfs_int_negotiate_chunk_size (g);
+
   return 0;
 }
 
@@ -20,6 +20,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <inttypes.h>
 #include <string.h>
 
 #include "guestfs.h"
@@ -28,20 +29,32 @@
 
 /* List filesystems.
  *
- * The current implementation just uses guestfs_vfs_type and doesn't
- * try mounting anything, but we reserve the right in future to try
- * mounting filesystems.
+ * The current implementation just probes the devices with
+ * guestfs_internal_probe_devices and doesn't try mounting anything,
+ * but we reserve the right in future to try mounting filesystems.
  */
 
+/* The partition table of the last device looked at by
+ * is_mbr_partition_type_42.  guestfs_list_partitions returns the
+ * partitions of each device together, so this is enough to fetch
+ * each partition table only once.
+ */
+struct last_parttable {
+  char *device;
+  struct guestfs_internal_partition_list *partitions;
+};
+
 static void remove_from_list (char **list, const char *item);
-static int check_with_vfs_type (guestfs_h *g, const char *dev, struct stringsbuf *sb);
-static int is_mbr_partition_type_42 (guestfs_h *g, const char *partition);
+static void add_strings (guestfs_h *g, struct stringsbuf *sb, char *const *list);
+static int check_with_vfs_type (guestfs_h *g, const char *dev, const char *vfs_type, struct stringsbuf *sb);
+static int is_mbr_partition_type_42 (guestfs_h *g, const char *partition, struct last_parttable *last);
 
 char **
 guestfs_impl_list_filesystems (guestfs_h *g)
 {
   size_t i;
   DECLARE_STRINGSBUF (ret);
+  CLEANUP_FREE_STRINGSBUF DECLARE_STRINGSBUF (candidates);
 
   const char *lvm2[] = { "lvm2", NULL };
   const int has_lvm2 = guestfs_feature_available (g, (char **) lvm2);
@@ -54,9 +67,12 @@ guestfs_impl_list_filesystems (guestfs_h *g)
   CLEANUP_FREE_STRING_LIST char **lvs = NULL;
   CLEANUP_FREE_STRING_LIST char **ldmvols = NULL;
   CLEANUP_FREE_STRING_LIST char **ldmparts = NULL;
+  CLEANUP_FREE_INTERNAL_PROBE_LIST struct guestfs_internal_probe_list *probes =
+    NULL;
+  struct last_parttable last = { .device = NULL, .partitions = NULL };
 
   /* Look to see if any devices directly contain filesystems
-   * (RHBZ#590167).  However vfs-type will fail to tell us anything
+   * (RHBZ#590167).  However probing will fail to tell us anything
    * useful about devices which just contain partitions, so we also
    * get the list of partitions and exclude the corresponding devices
    * by using part-to-dev.
@@ -74,51 +90,53 @@ guestfs_impl_list_filesystems (guestfs_h *g)
       remove_from_list (devices, dev);
   }
 
-  /* Use vfs-type to check for filesystems on devices. */
-  for (i = 0; devices[i] != NULL; ++i)
-    if (check_with_vfs_type (g, devices[i], &ret) == -1)
-      goto error;
+  /* Collect everything which might contain a filesystem: devices,
+   * partitions, md devices, LVs and Windows dynamic disks.
+   */
+  add_strings (g, &candidates, devices);
 
-  /* Use vfs-type to check for filesystems on partitions. */
   for (i = 0; partitions[i] != NULL; ++i) {
-    if (has_ldm == 0 || ! is_mbr_partition_type_42 (g, partitions[i])) {
-      if (check_with_vfs_type (g, partitions[i], &ret) == -1)
-        goto error;
-    }
+    if (has_ldm == 0 ||
+        ! is_mbr_partition_type_42 (g, partitions[i], &last))
+      guestfs_int_add_string (g, &candidates, partitions[i]);
   }
+  free (last.device);
+  guestfs_free_internal_partition_list (last.partitions);
 
-  /* Use vfs-type to check for filesystems on md devices. */
-  for (i = 0; mds[i] != NULL; ++i)
-    if (check_with_vfs_type (g, mds[i], &ret) == -1)
-      goto error;
+  add_strings (g, &candidates, mds);
 
   if (has_lvm2 > 0) {
-    /* Use vfs-type to check for filesystems on LVs. */
     lvs = guestfs_lvs (g);
     if (lvs == NULL) goto error;
-
-    for (i = 0; lvs[i] != NULL; ++i)
-      if (check_with_vfs_type (g, lvs[i], &ret) == -1)
-        goto error;
+    add_strings (g, &candidates, lvs);
   }
 
   if (has_ldm > 0) {
-    /* Use vfs-type to check for filesystems on Windows dynamic disks. */
     ldmvols = guestfs_list_ldm_volumes (g);
     if (ldmvols == NULL) goto error;
-
-    for (i = 0; ldmvols[i] != NULL; ++i)
-      if (check_with_vfs_type (g, ldmvols[i], &ret) == -1)
-        goto error;
+    add_strings (g, &candidates, ldmvols);
 
     ldmparts = guestfs_list_ldm_partitions (g);
     if (ldmparts == NULL) goto error;
+    add_strings (g, &candidates, ldmparts);
+  }
 
-    for (i = 0; ldmparts[i] != NULL; ++i)
-      if (check_with_vfs_type (g, ldmparts[i], &ret) == -1)
-        goto error;
+  guestfs_int_end_stringsbuf (g, &candidates);
+
+  /* Probe all of them in a single call, and check the results. */
+  probes = guestfs_internal_probe_devices (g, candidates.argv);
+  if (probes == NULL) goto error;
+  if (probes->len != candidates.size - 1) {
+    error (g, "internal_probe_devices: expected %zu results, got %" PRIu32,
+           candidates.size - 1, probes->len);
+    goto error;
   }
 
+  for (i = 0; i < probes->len; ++i)
+    if (check_with_vfs_type (g, candidates.argv[i], probes->val[i].ipr_type,
+                             &ret) == -1)
+      goto error;
+
   /* Finish off the list and return it. */
   guestfs_int_end_stringsbuf (g, &ret);
   return ret.argv;
@@ -128,6 +146,16 @@ guestfs_impl_list_filesystems (guestfs_h *g)
   return NULL;
 }
 
+/* Add all the strings in 'list' to 'sb'. */
+static void
+add_strings (guestfs_h *g, struct stringsbuf *sb, char *const *list)
+{
+  size_t i;
+
+  for (i = 0; list[i] != NULL; ++i)
+    guestfs_int_add_string (g, sb, list[i]);
+}
+
 /* If 'item' occurs in 'list', remove and free it. */
 static void
 remove_from_list (char **list, const char *item)
@@ -144,23 +172,17 @@ remove_from_list (char **list, const char *item)
     }
 }
 
-/* Use vfs-type to look for a filesystem of some sort on 'dev'.
+/* 'vfs_type' is the type of filesystem found on 'dev' by probing it.
  * Apart from some types which we ignore, add the result to the
  * 'ret' string list.
  */
 static int
-check_with_vfs_type (guestfs_h *g, const char *device, struct stringsbuf *sb)
+check_with_vfs_type (guestfs_h *g, const char *device, const char *vfs_type,
+                     struct stringsbuf *sb)
 {
   const char *v;
-  CLEANUP_FREE char *vfs_type = NULL;
-
-  guestfs_push_error_handler (g, NULL, NULL);
-  vfs_type = guestfs_vfs_type (g, device);
-  guestfs_pop_error_handler (g);
 
-  if (!vfs_type)
-    v = "unknown";
-  else if (STREQ (vfs_type, ""))
+  if (STREQ (vfs_type, ""))
     v = "unknown";
   else if (STREQ (vfs_type, "btrfs")) {
     CLEANUP_FREE_BTRFSSUBVOLUME_LIST struct guestfs_btrfssubvolume_list *vols =
@@ -217,11 +239,13 @@ check_with_vfs_type (guestfs_h *g, const char *device, struct stringsbuf *sb)
  * compiled with ldm support, we'll get the filesystems on these later.
  */
 static int
-is_mbr_partition_type_42 (guestfs_h *g, const char *partition)
+is_mbr_partition_type_42 (guestfs_h *g, const char *partition,
+                          struct last_parttable *last)
 {
   CLEANUP_FREE char *device = NULL;
   int partnum;
-  int mbr_id;
+  int mbr_id = -2;              /* -2 means not found in the table. */
+  size_t i;
   int ret = 0;
 
   guestfs_push_error_handler (g, NULL, NULL);
@@ -234,7 +258,30 @@ is_mbr_partition_type_42 (guestfs_h *g, const char *partition)
   if (device == NULL)
     goto out;
 
-  mbr_id = guestfs_part_get_mbr_id (g, device, partnum);
+  if (last->device == NULL || STRNEQ (last->device, device)) {
+    free (last->device);
+    guestfs_free_internal_partition_list (last->partitions);
+    last->device = safe_strdup (g, device);
+    last->partitions = guestfs_internal_part_list_table (g, device);
+  }
+  if (last->partitions != NULL) {
+    for (i = 0; i < last->partitions->len; ++i) {
+      const struct guestfs_internal_partition *ip = &last->partitions->val[i];
+
+      if (ip->ip_num == partnum) {
+        /* The daemon returns -1 both for GPT partitions and when it
+         * could not parse the partition table itself, in which case
+         * ask parted below.
+         */
+        if (ip->ip_mbr_id != -1 || STRNEQ (ip->ip_gpt_type, ""))
+          mbr_id = ip->ip_mbr_id;
+        break;
+      }
+    }
+  }
+
+  if (mbr_id == -2)
+    mbr_id = guestfs_part_get_mbr_id (g, device, partnum);
 
   ret = mbr_id == 0x42;
 
@@ -20,7 +20,7 @@
  * This is the code used to send and receive RPC messages and (for
  * certain types of message) to perform file transfers.  This code is
  * driven from the generated actions (F<src/actions-*.c>).  There
- * are five different cases to consider:
+ * are six different cases to consider:
  *
  * =over 4
  *
@@ -60,12 +60,34 @@
  *
  * =item 5.
  *
+ * An RPC with a streamed reply (eg. L<guestfs(3)/guestfs_readdir>).
+ * The reply message has no body, and the return value follows in
+ * file chunks, which avoids the limit on the size of a message.  The
+ * sequence of calls is:
+ *
+ *   guestfs_int_send
+ *   guestfs_int_recv
+ *   guestfs_int_recv_stream
+ *
+ * =item 6.
+ *
  * Both C<FileIn> and C<FileOut> parameters.  There are no calls like
  * this in the current API, but they would be implemented as a
  * combination of cases 3 and 4.
  *
  * =back
  *
+ * In addition, library code (but not the generated actions) may
+ * pipeline several simple RPCs (case 2 above) without waiting for
+ * each reply in turn.  The sequence of calls is:
+ *
+ *   guestfs_int_pipeline_send  (possibly multiple times)
+ *   guestfs_int_pipeline_recv  (once per request, in the same order)
+ *
+ * The daemon still processes requests one at a time and replies in
+ * order, but because the requests are already queued on the channel
+ * this saves one round trip per call.
+ *
  * All read/write/etc operations are performed using the current
  * connection module (C<g-E<gt>conn>).  During operations the
  * connection module transparently handles log messages that appear on
@@ -82,6 +104,7 @@
 #include <errno.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <assert.h>
 #include <libintl.h>
 
@@ -94,10 +117,23 @@
 #include "guestfs.h"
 #include "guestfs-internal.h"
 #include "guestfs_protocol.h"
+#include "errnostring.h"
 
 /* Size of guestfs_progress message on the wire. */
 #define PROGRESS_MESSAGE_SIZE 24
 
+/**
+ * A reply to a pipelined request which has been read from the daemon
+ * but not yet collected by C<guestfs_int_pipeline_recv>.
+ */
+struct pipeline_reply {
+  struct pipeline_reply *next;
+  uint32_t size;                /* Size of message. */
+  void *buf;                    /* The raw (XDR-encoded) message. */
+};
+
+static int pipeline_read_reply (guestfs_h *g);
+
 /**
  * This is called if we detect EOF, ie. qemu died.
  */
@@ -111,6 +147,7 @@ child_cleanup (guestfs_h *g)
     g->conn->ops->free_connection (g, g->conn);
     g->conn = NULL;
   }
+  guestfs_int_free_pipeline (g);
   memset (&g->launch_t, 0, sizeof g->launch_t);
   guestfs_int_free_drives (g);
   g->state = CONFIG;
@@ -243,23 +280,23 @@ check_daemon_socket (guestfs_h *g)
   return -2;
 }
 
-int
-guestfs_int_send (guestfs_h *g, int proc_nr,
-		  uint64_t progress_hint, uint64_t optargs_bitmask,
-		  xdrproc_t xdrp, char *args)
+/**
+ * Encode a request message, including the leading length word, into
+ * a newly allocated buffer.  The size of the buffer is returned in
+ * C<*size_r>.
+ *
+ * Returns C<NULL> on error.
+ */
+static char *
+encode_request (guestfs_h *g, int proc_nr, int serial,
+                uint64_t progress_hint, uint64_t optargs_bitmask,
+                xdrproc_t xdrp, char *args, size_t *size_r)
 {
   struct guestfs_message_header hdr;
   XDR xdr;
   uint32_t len;
-  const int serial = g->msg_next_serial++;
-  ssize_t r;
   CLEANUP_FREE char *msg_out = NULL;
-  size_t msg_out_size;
-
-  if (!g->conn) {
-    guestfs_int_unexpected_close_error (g);
-    return -1;
-  }
+  char *ret;
 
   /* We have to allocate this message buffer on the heap because
    * it is quite large (although will be mostly unused).  We
@@ -282,7 +319,7 @@ guestfs_int_send (guestfs_h *g, int proc_nr,
 
   if (!xdr_guestfs_message_header (&xdr, &hdr)) {
     error (g, _("xdr_guestfs_message_header failed"));
-    return -1;
+    return NULL;
   }
 
   /* Serialize the args.  If any, because some message types
@@ -291,7 +328,7 @@ guestfs_int_send (guestfs_h *g, int proc_nr,
   if (xdrp) {
     if (!(*xdrp) (&xdr, args, 0)) {
       error (g, _("dispatch failed to marshal args"));
-      return -1;
+      return NULL;
     }
   }
 
@@ -301,17 +338,28 @@ guestfs_int_send (guestfs_h *g, int proc_nr,
   len = xdr_getpos (&xdr);
   xdr_destroy (&xdr);
 
-  msg_out = safe_realloc (g, msg_out, len + 4);
-  msg_out_size = len + 4;
+  ret = safe_realloc (g, msg_out, len + 4);
+  msg_out = NULL;
+  *size_r = len + 4;
 
-  xdrmem_create (&xdr, msg_out, 4, XDR_ENCODE);
+  xdrmem_create (&xdr, ret, 4, XDR_ENCODE);
   xdr_uint32_t (&xdr, &len);
 
-  /* Look for stray daemon cancellation messages from earlier calls
-   * and ignore them.
-   */
-  r = check_daemon_socket (g);
-  /* r == -2 (cancellation) is ignored */
+  return ret;
+}
+
+/**
+ * Write a complete message to the daemon.
+ *
+ * Returns C<0> on success or C<-1> on error (including the appliance
+ * having gone away).
+ */
+static int
+write_message (guestfs_h *g, const char *msg, size_t size)
+{
+  ssize_t r;
+
+  r = g->conn->ops->write_data (g, g->conn, msg, size);
   if (r == -1)
     return -1;
   if (r == 0) {
@@ -320,8 +368,43 @@ guestfs_int_send (guestfs_h *g, int proc_nr,
     return -1;
   }
 
-  /* Send the message. */
-  r = g->conn->ops->write_data (g, g->conn, msg_out, msg_out_size);
+  return 0;
+}
+
+int
+guestfs_int_send (guestfs_h *g, int proc_nr,
+		  uint64_t progress_hint, uint64_t optargs_bitmask,
+		  xdrproc_t xdrp, char *args)
+{
+  const int serial = g->msg_next_serial++;
+  ssize_t r;
+  CLEANUP_FREE char *msg_out = NULL;
+  size_t msg_out_size;
+
+  if (!g->conn) {
+    guestfs_int_unexpected_close_error (g);
+    return -1;
+  }
+
+  /* Replies to pipelined requests would be confused with the reply
+   * to this request.
+   */
+  if (g->pipeline_outstanding > 0 || g->pipeline_replies != NULL) {
+    error (g, "internal error: %s called with pipelined requests outstanding",
+           __func__);
+    return -1;
+  }
+
+  msg_out = encode_request (g, proc_nr, serial, progress_hint,
+                            optargs_bitmask, xdrp, args, &msg_out_size);
+  if (msg_out == NULL)
+    return -1;
+
+  /* Look for stray daemon cancellation messages from earlier calls
+   * and ignore them.
+   */
+  r = check_daemon_socket (g);
+  /* r == -2 (cancellation) is ignored */
   if (r == -1)
     return -1;
   if (r == 0) {
@@ -330,9 +413,52 @@ guestfs_int_send (guestfs_h *g, int proc_nr,
     return -1;
   }
 
+  /* Send the message. */
+  if (write_message (g, msg_out, msg_out_size) == -1)
+    return -1;
+
   return serial;
 }
 
+/**
+ * Return the size of FileIn/FileOut chunks to use on this handle.
+ * This is the size negotiated with the daemon by
+ * C<guestfs_int_negotiate_chunk_size>, or the default size if that
+ * has not happened (or the daemon did not support it).
+ */
+size_t
+guestfs_int_chunk_size (guestfs_h *g)
+{
+  return g->chunk_size > 0 ? g->chunk_size : GUESTFS_DEFAULT_CHUNK_SIZE;
+}
+
+/**
+ * Called after launch to agree with the daemon on a larger chunk
+ * size for FileIn and FileOut transfers.  An 8K chunk costs a
+ * cancellation check, a syscall and an XDR framing step on each
+ * side, which caps throughput well below what the virtio-serial
+ * channel can carry.
+ *
+ * Old daemons do not implement C<internal_set_chunk_size>, in which
+ * case we silently stay at C<GUESTFS_DEFAULT_CHUNK_SIZE>.
+ */
+void
+guestfs_int_negotiate_chunk_size (guestfs_h *g)
+{
+  int r;
+
+  guestfs_push_error_handler (g, NULL, NULL);
+  r = guestfs_internal_set_chunk_size (g, GUESTFS_MAX_CHUNK_SIZE);
+  guestfs_pop_error_handler (g);
+
+  if (r > 0)
+    g->chunk_size = r;
+  else
+    g->chunk_size = 0;
+
+  debug (g, "using chunk size %zu", guestfs_int_chunk_size (g));
+}
+
 static int send_file_chunk (guestfs_h *g, int cancel, const char *buf, size_t len);
 static int send_file_data (guestfs_h *g, const char *buf, size_t len);
 static int send_file_cancellation (guestfs_h *g);
@@ -347,7 +473,8 @@ static int send_file_complete (guestfs_h *g);
 int
 guestfs_int_send_file (guestfs_h *g, const char *filename)
 {
-  CLEANUP_FREE char *buf = safe_malloc (g, GUESTFS_MAX_CHUNK_SIZE);
+  const size_t chunk_size = guestfs_int_chunk_size (g);
+  CLEANUP_FREE char *buf = safe_malloc (g, chunk_size);
   int fd, r = 0, err;
 
   g->user_cancel = 0;
@@ -363,7 +490,7 @@ guestfs_int_send_file (guestfs_h *g, const char *filename)
 
   /* Send file in chunked encoding. */
   while (!g->user_cancel) {
-    r = read (fd, buf, GUESTFS_MAX_CHUNK_SIZE);
+    r = read (fd, buf, chunk_size);
     if (r == -1 && (errno == EINTR || errno == EAGAIN))
       continue;
     if (r <= 0) break;
@@ -437,44 +564,46 @@ send_file_complete (guestfs_h *g)
   return send_file_chunk (g, 0, buf, 0);
 }
 
+/**
+ * Send a single chunk.
+ *
+ * The chunk is encoded by hand rather than with
+ * C<xdr_guestfs_chunk>, so that the data can be written straight
+ * from the caller's buffer.  The wire format is the same: the length
+ * word, the C<cancel> field, the C<data> length, then the data padded
+ * with zeroes to a multiple of 4 bytes.  The header and padding are
+ * gathered with the data in a single C<write_datav> call.
+ */
 static int
 send_file_chunk (guestfs_h *g, int cancel, const char *buf, size_t buflen)
 {
-  uint32_t len;
+  static const char padding[4] = { 0, 0, 0, 0 };
+  char hdr[12];
+  uint32_t len, data_len;
+  const size_t padlen = (4 - (buflen & 3)) & 3;
+  struct iovec iov[3];
   ssize_t r;
-  guestfs_chunk chunk;
   XDR xdr;
-  CLEANUP_FREE char *msg_out = NULL;
-  size_t msg_out_size;
-
-  /* Allocate the chunk buffer.  Don't use the stack to avoid
-   * excessive stack usage and unnecessary copies.
-   */
-  msg_out = safe_malloc (g, GUESTFS_MAX_CHUNK_SIZE + 4 + 48);
-  xdrmem_create (&xdr, msg_out + 4, GUESTFS_MAX_CHUNK_SIZE + 48, XDR_ENCODE);
 
-  /* Serialize the chunk. */
-  chunk.cancel = cancel;
-  chunk.data.data_len = buflen;
-  chunk.data.data_val = (char *) buf;
-
-  if (!xdr_guestfs_chunk (&xdr, &chunk)) {
-    error (g, _("xdr_guestfs_chunk failed (buf = %p, buflen = %zu)"),
+  if (buflen > GUESTFS_MAX_CHUNK_SIZE) {
+    error (g, _("send_file_chunk: chunk too large (buf = %p, buflen = %zu)"),
            buf, buflen);
-    xdr_destroy (&xdr);
     return -1;
   }
 
-  len = xdr_getpos (&xdr);
+  /* Serialize the chunk header. */
+  len = 8 + buflen + padlen;
+  data_len = buflen;
+  xdrmem_create (&xdr, hdr, sizeof hdr, XDR_ENCODE);
+  if (!xdr_uint32_t (&xdr, &len) ||
+      !xdr_int (&xdr, &cancel) ||
+      !xdr_uint32_t (&xdr, &data_len)) {
+    error (g, _("send_file_chunk: failed to encode chunk header"));
+    xdr_destroy (&xdr);
+    return -1;
+  }
   xdr_destroy (&xdr);
 
-  /* Reduce the size of the outgoing message buffer to the real length. */
-  msg_out = safe_realloc (g, msg_out, len + 4);
-  msg_out_size = len + 4;
-
-  xdrmem_create (&xdr, msg_out, 4, XDR_ENCODE);
-  xdr_uint32_t (&xdr, &len);
-
   /* Did the daemon send a cancellation message? */
   r = check_daemon_socket (g);
   if (r == -2) {
@@ -490,7 +619,13 @@ send_file_chunk (guestfs_h *g, int cancel, const char *buf, size_t buflen)
   }
 
   /* Send the chunk. */
-  r = g->conn->ops->write_data (g, g->conn, msg_out, msg_out_size);
+  iov[0].iov_base = hdr;
+  iov[0].iov_len = sizeof hdr;
+  iov[1].iov_base = (char *) buf;
+  iov[1].iov_len = buflen;
+  iov[2].iov_base = (char *) padding;
+  iov[2].iov_len = padlen;
+  r = g->conn->ops->write_datav (g, g->conn, iov, 3);
   if (r == -1)
     return -1;
   if (r == 0) {
@@ -668,6 +803,42 @@ guestfs_int_recv_from_daemon (guestfs_h *g, uint32_t *size_rtn, void **buf_rtn)
   return 0;
 }
 
+/**
+ * Decode a reply message (header, then either error or return
+ * value) which has been read from the daemon.
+ */
+static int
+decode_reply (guestfs_h *g, const char *fn, void *buf, uint32_t size,
+              guestfs_message_header *hdr, guestfs_message_error *err,
+              xdrproc_t xdrp, char *ret)
+{
+  XDR xdr;
+
+  xdrmem_create (&xdr, buf, size, XDR_DECODE);
+
+  if (!xdr_guestfs_message_header (&xdr, hdr)) {
+    error (g, "%s: failed to parse reply header", fn);
+    xdr_destroy (&xdr);
+    return -1;
+  }
+  if (hdr->status == GUESTFS_STATUS_ERROR) {
+    if (!xdr_guestfs_message_error (&xdr, err)) {
+      error (g, "%s: failed to parse reply error", fn);
+      xdr_destroy (&xdr);
+      return -1;
+    }
+  } else {
+    if (xdrp && ret && !xdrp (&xdr, ret, 0)) {
+      error (g, "%s: failed to parse reply", fn);
+      xdr_destroy (&xdr);
+      return -1;
+    }
+  }
+  xdr_destroy (&xdr);
+
+  return 0;
+}
+
 /**
  * Receive a reply.
  */
@@ -677,7 +848,6 @@ guestfs_int_recv (guestfs_h *g, const char *fn,
 		  guestfs_message_error *err,
 		  xdrproc_t xdrp, char *ret)
 {
-  XDR xdr;
   CLEANUP_FREE void *buf = NULL;
   uint32_t size;
   int r;
@@ -699,29 +869,7 @@ guestfs_int_recv (guestfs_h *g, const char *fn,
     return -1;
   }
 
-  xdrmem_create (&xdr, buf, size, XDR_DECODE);
-
-  if (!xdr_guestfs_message_header (&xdr, hdr)) {
-    error (g, "%s: failed to parse reply header", fn);
-    xdr_destroy (&xdr);
-    return -1;
-  }
-  if (hdr->status == GUESTFS_STATUS_ERROR) {
-    if (!xdr_guestfs_message_error (&xdr, err)) {
-      error (g, "%s: failed to parse reply error", fn);
-      xdr_destroy (&xdr);
-      return -1;
-    }
-  } else {
-    if (xdrp && ret && !xdrp (&xdr, ret, 0)) {
-      error (g, "%s: failed to parse reply", fn);
-      xdr_destroy (&xdr);
-      return -1;
-    }
-  }
-  xdr_destroy (&xdr);
-
-  return 0;
+  return decode_reply (g, fn, buf, size, hdr, err, xdrp, ret);
 }
 
 /**
@@ -788,7 +936,7 @@ xwrite (int fd, const void *v_buf, size_t len)
   return 0;
 }
 
-static ssize_t receive_file_data (guestfs_h *g, void **buf);
+static ssize_t receive_file_data (guestfs_h *g, void **buf, const char **data);
 
 /**
  * Returns C<-1> = error, C<0> = EOF, C<E<gt>0> = more data
@@ -797,6 +945,7 @@ int
 guestfs_int_recv_file (guestfs_h *g, const char *filename)
 {
   void *buf;
+  const char *data;
   int fd, r;
 
   g->user_cancel = 0;
@@ -819,8 +968,8 @@ guestfs_int_recv_file (guestfs_h *g, const char *filename)
   guestfs_int_fadvise_sequential (fd);
 
   /* Receive the file in chunked encoding. */
-  while ((r = receive_file_data (g, &buf)) > 0) {
-    if (xwrite (fd, buf, r) == -1) {
+  while ((r = receive_file_data (g, &buf, &data)) > 0) {
+    if (xwrite (fd, data, r) == -1) {
       perrorf (g, "%s: write", filename);
       free (buf);
       close (fd);
@@ -866,7 +1015,7 @@ guestfs_int_recv_file (guestfs_h *g, const char *filename)
     return -1;
   }
 
-  while (receive_file_data (g, NULL) > 0)
+  while (receive_file_data (g, NULL, NULL) > 0)
     ;                           /* just discard it */
 
   return -1;
@@ -875,16 +1024,21 @@ guestfs_int_recv_file (guestfs_h *g, const char *filename)
 /**
  * Receive a chunk of file data.
  *
+ * The chunk is decoded in place: C<*data_r> is set to point to the
+ * data inside the message buffer, which is returned in C<*buf_r> and
+ * must be freed by the caller.  This avoids copying the data out of
+ * the message (which C<xdr_guestfs_chunk> would do).
+ *
  * Returns C<-1> = error, C<0> = EOF, C<E<gt>0> = more data
  */
 static ssize_t
-receive_file_data (guestfs_h *g, void **buf_r)
+receive_file_data (guestfs_h *g, void **buf_r, const char **data_r)
 {
   int r;
   CLEANUP_FREE void *buf = NULL;
-  uint32_t len;
+  uint32_t len, data_len;
+  int cancel;
   XDR xdr;
-  guestfs_chunk chunk;
 
   r = guestfs_int_recv_from_daemon (g, &len, &buf);
   if (r == -1)
@@ -895,33 +1049,355 @@ receive_file_data (guestfs_h *g, void **buf_r)
     return -1;
   }
 
-  memset (&chunk, 0, sizeof chunk);
-
+  /* Decode the chunk header (see send_file_chunk). */
   xdrmem_create (&xdr, buf, len, XDR_DECODE);
-  if (!xdr_guestfs_chunk (&xdr, &chunk)) {
+  if (!xdr_int (&xdr, &cancel) ||
+      !xdr_uint32_t (&xdr, &data_len) ||
+      data_len > GUESTFS_MAX_CHUNK_SIZE ||
+      data_len > len - 8) {
     error (g, _("failed to parse file chunk"));
+    xdr_destroy (&xdr);
     return -1;
   }
   xdr_destroy (&xdr);
 
-  if (chunk.cancel) {
+  if (cancel) {
     if (g->user_cancel)
       guestfs_int_error_errno (g, EINTR, _("operation cancelled by user"));
     else
       error (g, _("file receive cancelled by daemon"));
-    free (chunk.data.data_val);
     return -1;
   }
 
-  if (chunk.data.data_len == 0) { /* end of transfer */
-    free (chunk.data.data_val);
+  if (data_len == 0)            /* end of transfer */
     return 0;
+
+  if (buf_r) {                  /* else discard it */
+    *buf_r = buf;
+    *data_r = (const char *) buf + 8;
+    buf = NULL;                 /* caller frees */
+  }
+
+  return data_len;
+}
+
+/* State of a streamed reply, passed to stream_read. */
+struct stream_state {
+  guestfs_h *g;
+  void *buf;                    /* Current chunk (see receive_file_data). */
+  const char *data;             /* Unread data in the current chunk. */
+  size_t len;
+  int eof;                      /* Saw the end of transfer. */
+  int error;                    /* Error reading chunks, error is set. */
+};
+
+static int
+stream_read (void *handle, void *buf, int len)
+{
+  struct stream_state *state = handle;
+  ssize_t r;
+  size_t n;
+
+  if (state->len == 0) {
+    if (state->eof || state->error)
+      return -1;
+    free (state->buf);
+    state->buf = NULL;
+    r = receive_file_data (state->g, &state->buf, &state->data);
+    if (r == 0)
+      state->eof = 1;
+    if (r == -1)
+      state->error = 1;
+    if (r <= 0)
+      return -1;
+    state->len = r;
+  }
+
+  n = MIN ((size_t) len, state->len);
+  memcpy (buf, state->data, n);
+  state->data += n;
+  state->len -= n;
+  return n;
+}
+
+/**
+ * Receive the return value of a function with a streamed reply
+ * (C<stream_reply> in F<generator/actions.ml>).
+ *
+ * This is called after C<guestfs_int_recv> has received the reply
+ * message, which for these functions has no body.  The daemon then
+ * sends the return value encoded as an XDR record stream in file
+ * chunks, so unlike an ordinary reply it is not limited by
+ * C<GUESTFS_MESSAGE_MAX>.  The chunks are decoded as they arrive,
+ * without first collecting the whole encoded reply.
+ */
+int
+guestfs_int_recv_stream (guestfs_h *g, const char *fn,
+                         xdrproc_t xdrp, char *ret)
+{
+  struct stream_state state = { .g = g };
+  XDR xdr;
+  int ok;
+  ssize_t r;
+
+  /* The cast is because the type of the callback differs between
+   * glibc and libtirpc.
+   */
+  xdrrec_create (&xdr, 0, 0, (void *) &state,
+                 (int (*) ()) stream_read, NULL);
+  xdr.x_op = XDR_DECODE;
+  ok = xdrrec_skiprecord (&xdr) && xdrp (&xdr, ret, 0);
+  xdr_destroy (&xdr);
+  free (state.buf);
+
+  if (!ok) {
+    if (!state.error)
+      error (g, "%s: failed to parse reply", fn);
+    goto error;
+  }
+
+  /* The record should be followed by the end of transfer. */
+  if (state.len > 0) {
+    error (g, "%s: unexpected data after reply", fn);
+    goto error;
+  }
+  if (!state.eof) {
+    r = receive_file_data (g, NULL, NULL);
+    if (r == -1)
+      goto error;
+    if (r > 0) {
+      error (g, "%s: unexpected data after reply", fn);
+      goto error;
+    }
+  }
+
+  return 0;
+
+ error:
+  xdr_free (xdrp, ret);
+  if (!state.eof && !state.error) {
+    while (receive_file_data (g, NULL, NULL) > 0)
+      ;                         /* discard the rest of the reply */
+  }
+  return -1;
+}
+
+/**
+ * Send a pipelined request.
+ *
+ * This is like C<guestfs_int_send>, except that the caller does not
+ * have to read the reply before sending further requests.  Replies
+ * are collected, in the same order that the requests were sent, by
+ * calling C<guestfs_int_pipeline_recv> once for each request.
+ *
+ * Only simple calls (without C<FileIn> or C<FileOut> parameters,
+ * and without a streamed reply) may be pipelined, and no other call
+ * may be made on the handle until all replies have been collected.
+ *
+ * If too many requests are in flight then this reads (and queues)
+ * replies before sending the new request, so it never blocks waiting
+ * for the daemon to read from the channel.
+ *
+ * Returns the serial number of the request, or C<-1> on error.
+ */
+int
+guestfs_int_pipeline_send (guestfs_h *g, int proc_nr,
+                           uint64_t optargs_bitmask,
+                           xdrproc_t xdrp, char *args)
+{
+  const int serial = g->msg_next_serial++;
+  ssize_t r;
+  CLEANUP_FREE char *msg_out = NULL;
+  size_t msg_out_size;
+
+  if (!g->conn) {
+    guestfs_int_unexpected_close_error (g);
+    return -1;
+  }
+
+  msg_out = encode_request (g, proc_nr, serial, 0,
+                            optargs_bitmask, xdrp, args, &msg_out_size);
+  if (msg_out == NULL)
+    return -1;
+
+  if (g->pipeline_outstanding == 0 && g->pipeline_replies == NULL) {
+    /* Nothing in flight, so look for stray daemon cancellation
+     * messages from earlier calls and ignore them, just like
+     * guestfs_int_send.
+     */
+    r = check_daemon_socket (g);
+    if (r == -1)
+      return -1;
+    if (r == 0) {
+      guestfs_int_unexpected_close_error (g);
+      child_cleanup (g);
+      return -1;
+    }
+  }
+
+  /* Make room in the pipeline. */
+  while (g->pipeline_outstanding > 0 &&
+         (g->pipeline_outstanding >= PIPELINE_MAX_REQUESTS ||
+          g->pipeline_bytes + msg_out_size > PIPELINE_MAX_BYTES)) {
+    if (pipeline_read_reply (g) == -1)
+      return -1;
   }
 
-  if (buf_r) *buf_r = chunk.data.data_val;
-  else free (chunk.data.data_val); /* else caller frees */
+  if (write_message (g, msg_out, msg_out_size) == -1)
+    return -1;
+
+  g->pipeline_sizes[g->pipeline_outstanding] = msg_out_size;
+  g->pipeline_outstanding++;
+  g->pipeline_bytes += msg_out_size;
+
+  return serial;
+}
+
+/**
+ * Read the reply to the oldest outstanding pipelined request from
+ * the daemon and append it to the queue of replies.
+ */
+static int
+pipeline_read_reply (guestfs_h *g)
+{
+  struct pipeline_reply *reply, **rp;
+  void *buf;
+  uint32_t size;
+  size_t i;
+
+  assert (g->pipeline_outstanding > 0);
 
-  return chunk.data.data_len;
+ again:
+  if (guestfs_int_recv_from_daemon (g, &size, &buf) == -1)
+    return -1;
+
+  /* A stray cancellation flag (see guestfs_int_recv). */
+  if (size == GUESTFS_CANCEL_FLAG)
+    goto again;
+
+  if (size == GUESTFS_LAUNCH_FLAG) {
+    error (g, _("received unexpected launch flag from daemon when expecting reply"));
+    return -1;
+  }
+
+  reply = safe_malloc (g, sizeof *reply);
+  reply->next = NULL;
+  reply->size = size;
+  reply->buf = buf;
+  for (rp = &g->pipeline_replies; *rp != NULL; rp = &(*rp)->next)
+    ;
+  *rp = reply;
+
+  g->pipeline_bytes -= g->pipeline_sizes[0];
+  g->pipeline_outstanding--;
+  for (i = 0; i < g->pipeline_outstanding; ++i)
+    g->pipeline_sizes[i] = g->pipeline_sizes[i+1];
+
+  return 0;
+}
+
+/**
+ * Receive the reply to a pipelined request.
+ *
+ * Replies must be collected in the same order as the requests were
+ * sent by C<guestfs_int_pipeline_send>.  C<serial> is the serial
+ * number returned by that function, and C<proc_nr> is the procedure
+ * that was called.
+ *
+ * If the daemon returned an error, this sets the error in the handle
+ * (in the same way as the generated actions) and returns C<-1>.  On
+ * success the reply is decoded into C<ret> and C<0> is returned.
+ */
+int
+guestfs_int_pipeline_recv (guestfs_h *g, const char *fn,
+                           int proc_nr, int serial,
+                           xdrproc_t xdrp, char *ret)
+{
+  struct pipeline_reply *reply;
+  guestfs_message_header hdr;
+  guestfs_message_error err;
+  CLEANUP_FREE void *buf = NULL;
+  uint32_t size;
+
+  if (g->pipeline_replies == NULL) {
+    if (g->pipeline_outstanding == 0) {
+      error (g, "internal error: %s: no pipelined request outstanding", fn);
+      return -1;
+    }
+    if (pipeline_read_reply (g) == -1)
+      return -1;
+  }
+
+  reply = g->pipeline_replies;
+  g->pipeline_replies = reply->next;
+  buf = reply->buf;
+  size = reply->size;
+  free (reply);
+
+  memset (&hdr, 0, sizeof hdr);
+  memset (&err, 0, sizeof err);
+
+  if (decode_reply (g, fn, buf, size, &hdr, &err, xdrp, ret) == -1)
+    return -1;
+
+  if (guestfs_int_check_reply_header (g, &hdr, proc_nr, serial) == -1) {
+    if (hdr.status == GUESTFS_STATUS_ERROR)
+      xdr_free ((xdrproc_t) xdr_guestfs_message_error, (char *) &err);
+    else if (xdrp && ret)
+      xdr_free (xdrp, ret);
+    return -1;
+  }
+
+  if (hdr.status == GUESTFS_STATUS_ERROR) {
+    int errnum = 0;
+
+    if (err.errno_string[0] != '\0')
+      errnum = guestfs_int_string_to_errno (err.errno_string);
+    if (errnum <= 0)
+      error (g, "%s: %s", fn, err.error_message);
+    else
+      guestfs_int_error_errno (g, errnum, "%s: %s", fn, err.error_message);
+    free (err.error_message);
+    free (err.errno_string);
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * Read and discard the replies to all outstanding pipelined
+ * requests.  Callers use this on error paths so that the protocol
+ * stays in sync.  Any error already set in the handle is preserved.
+ */
+void
+guestfs_int_pipeline_drain (guestfs_h *g)
+{
+  while (g->pipeline_outstanding > 0 && g->conn) {
+    if (pipeline_read_reply (g) == -1)
+      break;
+  }
+  guestfs_int_free_pipeline (g);
+}
+
+/**
+ * Free any pipelined replies which were never collected, and forget
+ * about outstanding pipelined requests.  This is called when the
+ * connection to the daemon is closed.
+ */
+void
+guestfs_int_free_pipeline (guestfs_h *g)
+{
+  struct pipeline_reply *reply, *next;
+
+  for (reply = g->pipeline_replies; reply != NULL; reply = next) {
+    next = reply->next;
+    free (reply->buf);
+    free (reply);
+  }
+  g->pipeline_replies = NULL;
+  g->pipeline_outstanding = 0;
+  g->pipeline_bytes = 0;
 }
 
 int
@@ -27,6 +27,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <assert.h>
 #include <unistd.h>
@@ -433,6 +434,150 @@ test_stringsbuf (void)
   guestfs_close (g);
 }
 
+/**
+ * Test C<guestfs_int_is_zero>.
+ *
+ * Every length and alignment around the vector sizes is tried, with
+ * a single non-zero byte in every position.
+ */
+static void
+test_is_zero (void)
+{
+  const size_t bufsize = 1024;
+  unsigned char *buf;
+  size_t offset, len, i;
+
+  buf = calloc (bufsize, 1);
+  assert (buf);
+
+  for (offset = 0; offset < 64; ++offset) {
+    for (len = 0; len <= 300; ++len) {
+      assert (guestfs_int_is_zero (buf + offset, len));
+      assert (guestfs_int_is_zero_portable (buf + offset, len));
+
+      for (i = 0; i < len; ++i) {
+        buf[offset+i] = 1;
+        assert (!guestfs_int_is_zero (buf + offset, len));
+        assert (!guestfs_int_is_zero_portable (buf + offset, len));
+        buf[offset+i] = 0;
+      }
+    }
+  }
+
+  /* Non-zero bytes just outside the buffer must be ignored. */
+  buf[99] = buf[200] = 1;
+  assert (guestfs_int_is_zero (buf + 100, 100));
+  assert (guestfs_int_is_zero_portable (buf + 100, 100));
+
+  free (buf);
+}
+
+/**
+ * Test C<guestfs_int_read_db_dump>.
+ *
+ * A small Berkeley DB hash database is written out by hand, with and
+ * without page checksums, since checksums change the size of the
+ * page header.
+ */
+#define DB_PAGESIZE 512
+
+static void
+put_db_item (unsigned char *page, size_t overhead, uint16_t *end,
+             size_t indx, const char *data)
+{
+  const size_t len = strlen (data);
+
+  *end -= len + 1;
+  page[*end] = 1;               /* H_KEYDATA */
+  memcpy (&page[*end + 1], data, len);
+  memcpy (&page[overhead + 2*indx], end, sizeof *end);
+}
+
+static int
+read_db_dump_cb (guestfs_h *g,
+                 const unsigned char *key, size_t keylen,
+                 const unsigned char *value, size_t valuelen,
+                 void *opaque)
+{
+  char *str = opaque;
+  size_t n = strlen (str);
+
+  memcpy (&str[n], key, keylen);
+  n += keylen;
+  str[n++] = '=';
+  memcpy (&str[n], value, valuelen);
+  n += valuelen;
+  str[n++] = ';';
+  str[n] = '\0';
+  return 0;
+}
+
+static void
+test_read_db_dump (void)
+{
+  guestfs_h *g;
+  unsigned char db[2 * DB_PAGESIZE];
+  unsigned char *page = &db[DB_PAGESIZE];
+  const uint32_t magic = 0x061561, version = 9, pagesize = DB_PAGESIZE;
+  const uint32_t pgno = 1;
+  const uint16_t nent = 4;
+  uint16_t end;
+  size_t overhead;
+  char result[64];
+  ssize_t n;
+  int chksum, fd, r;
+
+  g = guestfs_create ();
+  assert (g);
+
+  for (chksum = 0; chksum <= 1; ++chksum) {
+    char tmpfile[] = "/tmp/dbdumpXXXXXX";
+
+    memset (db, 0, sizeof db);
+
+    /* Metadata page. */
+    memcpy (&db[12], &magic, sizeof magic);
+    memcpy (&db[16], &version, sizeof version);
+    memcpy (&db[20], &pagesize, sizeof pagesize);
+    db[25] = 8;                 /* P_HASHMETA */
+    db[26] = chksum;            /* DBMETA_CHKSUM */
+    memcpy (&db[32], &pgno, sizeof pgno); /* last page */
+
+    /* Hash page.  With checksums, the page header is followed by 2
+     * unused bytes and the checksum, and then by the item offsets.
+     */
+    overhead = chksum ? 32 : 26;
+    memcpy (&page[8], &pgno, sizeof pgno);
+    memcpy (&page[20], &nent, sizeof nent);
+    page[25] = 13;              /* P_HASH */
+    if (chksum)
+      memset (&page[28], 0xff, 4);
+    end = DB_PAGESIZE;
+    put_db_item (page, overhead, &end, 0, "one");
+    put_db_item (page, overhead, &end, 1, "1");
+    put_db_item (page, overhead, &end, 2, "two");
+    put_db_item (page, overhead, &end, 3, "2");
+    memcpy (&page[22], &end, sizeof end);
+
+    fd = mkstemp (tmpfile);
+    assert (fd >= 0);
+    n = write (fd, db, sizeof db);
+    assert (n == sizeof db);
+    r = close (fd);
+    assert (r == 0);
+
+    result[0] = '\0';
+    r = guestfs_int_read_db_dump (g, tmpfile, result, read_db_dump_cb);
+    assert (r == 0);
+    assert (STREQ (result, "one=1;two=2;"));
+
+    r = unlink (tmpfile);
+    assert (r == 0);
+  }
+
+  guestfs_close (g);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -448,6 +593,8 @@ main (int argc, char *argv[])
   test_timeval_diff ();
   test_match ();
   test_stringsbuf ();
+  test_is_zero ();
+  test_read_db_dump ();
 
   exit (EXIT_SUCCESS);
 }
@@ -0,0 +1,125 @@
+/* libguestfs
+ * Copyright (C) 2016 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * Implementation of C<guestfs_walk>.
+ *
+ * The daemon walks the tree and streams one XDR-encoded
+ * C<guestfs_int_walk_entry> record per file and per extended
+ * attribute.  The stream is downloaded to a temporary file and
+ * decoded here.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <string.h>
+#include <libintl.h>
+#include <rpc/xdr.h>
+#include <rpc/types.h>
+
+#include "guestfs.h"
+#include "guestfs_protocol.h"
+#include "guestfs-internal.h"
+#include "guestfs-internal-all.h"
+#include "guestfs-internal-actions.h"
+
+static struct guestfs_walk_entry_list *parse_walk_file (guestfs_h *, const char *);
+
+struct guestfs_walk_entry_list *
+guestfs_impl_walk (guestfs_h *g, const char *directory)
+{
+  CLEANUP_UNLINK_FREE char *tmpfile = NULL;
+
+  tmpfile = guestfs_int_make_temp_path (g, "walk");
+  if (tmpfile == NULL)
+    return NULL;
+
+  if (guestfs_internal_walk (g, directory, tmpfile) == -1)
+    return NULL;
+
+  return parse_walk_file (g, tmpfile); /* caller frees */
+}
+
+/* Decode the records in the file.  Return a list of walk_entry on
+ * success, NULL on error.
+ */
+static struct guestfs_walk_entry_list *
+parse_walk_file (guestfs_h *g, const char *tmpfile)
+{
+  CLEANUP_FCLOSE FILE *fp = NULL;
+  struct guestfs_walk_entry_list *entries;
+  struct stat statbuf;
+  size_t alloc;
+  XDR xdr;
+  int ok = 1;
+
+  fp = fopen (tmpfile, "r");
+  if (fp == NULL) {
+    perrorf (g, "fopen: %s", tmpfile);
+    return NULL;
+  }
+
+  if (fstat (fileno (fp), &statbuf) == -1) {
+    perrorf (g, "fstat: %s", tmpfile);
+    return NULL;
+  }
+
+  entries = safe_malloc (g, sizeof *entries);
+  entries->len = 0;
+  alloc = 64;
+  entries->val = safe_malloc (g, alloc * sizeof (*entries->val));
+
+  xdrstdio_create (&xdr, fp, XDR_DECODE);
+
+  while (xdr_getpos (&xdr) < statbuf.st_size) {
+    if (entries->len == alloc) {
+      alloc *= 2;
+      entries->val = safe_realloc (g, entries->val,
+                                   alloc * sizeof (*entries->val));
+    }
+
+    /* Clear the entry so xdr logic will allocate necessary memory.
+     * The XDR struct has the same layout as the public struct.
+     */
+    memset (&entries->val[entries->len], 0, sizeof (*entries->val));
+    if (!xdr_guestfs_int_walk_entry (&xdr, (guestfs_int_walk_entry *)
+                                     &entries->val[entries->len])) {
+      xdr_free ((xdrproc_t) xdr_guestfs_int_walk_entry,
+                (char *) &entries->val[entries->len]);
+      ok = 0;
+      break;
+    }
+    entries->len++;
+  }
+
+  xdr_destroy (&xdr);
+
+  if (!ok) {
+    error (g, _("%s: failed to parse walk records"), tmpfile);
+    guestfs_free_walk_entry_list (entries);
+    return NULL;
+  }
+
+  return entries;
+}
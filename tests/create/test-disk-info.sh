@@ -0,0 +1,84 @@
+#!/bin/bash
+# Copyright (C) 2016 Red Hat Inc.
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+# Test disk-format, disk-virtual-size and disk-has-backing-file on
+# the formats whose headers are parsed by the library, and on a
+# format which is left to qemu-img.
+
+export LANG=C
+
+set -e
+
+if [ -n "$SKIP_TEST_DISK_INFO_SH" ]; then
+    echo "$0: test skipped because environment variable is set."
+    exit 77
+fi
+
+rm -f info*.img
+
+for fmt in vmdk vdi vhdx qed; do
+    if ! qemu-img create -f $fmt info-$fmt.img 1M >/dev/null 2>&1; then
+        echo "$0: test skipped because qemu-img cannot create $fmt images."
+        rm -f info*.img
+        exit 77
+    fi
+done
+qemu-img create -f vmdk -b info-vmdk.img -F vmdk info-vmdk-backing.img \
+    >/dev/null
+
+output="$(guestfish <<EOF
+  disk-format info-vmdk.img
+  disk-format info-vdi.img
+  disk-format info-vhdx.img
+  disk-format info-qed.img
+  disk-format info-vmdk-backing.img
+
+  disk-has-backing-file info-vmdk.img
+  disk-has-backing-file info-vdi.img
+  disk-has-backing-file info-vhdx.img
+  disk-has-backing-file info-qed.img
+  disk-has-backing-file info-vmdk-backing.img
+
+  disk-virtual-size info-vmdk.img
+  disk-virtual-size info-vdi.img
+  disk-virtual-size info-vhdx.img
+  disk-virtual-size info-qed.img
+  disk-virtual-size info-vmdk-backing.img
+EOF
+)"
+
+if [ "$output" != "vmdk
+vdi
+vhdx
+qed
+vmdk
+false
+false
+false
+false
+true
+1048576
+1048576
+1048576
+1048576
+1048576" ]; then
+    echo "$0: unexpected output:"
+    echo "$output"
+    exit 1
+fi
+
+rm info*.img
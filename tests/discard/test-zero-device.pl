@@ -0,0 +1,111 @@
+#!/usr/bin/env perl
+# Copyright (C) 2016 Red Hat Inc.
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+# Test that zero-device discards the device when it can, and that
+# is-zero and is-zero-device skip holes but still find data after
+# them.
+
+use strict;
+use warnings;
+
+use Sys::Guestfs;
+
+# Since we read error messages, we want to ensure they are printed
+# in English, hence:
+$ENV{"LANG"} = "C";
+
+$| = 1;
+
+if ($ENV{SKIP_TEST_ZERO_DEVICE_PL}) {
+    print "$0: skipped test because environment variable is set\n";
+    exit 77;
+}
+
+my $g = Sys::Guestfs->new ();
+
+# Discard is only supported when using qemu.
+if ($g->get_backend () ne "libvirt" &&
+    $g->get_backend () !~ /^libvirt:/ &&
+    $g->get_backend () ne "direct") {
+    print "$0: skipped test because discard is only supported when using qemu\n";
+    exit 77;
+}
+
+my $disk = "test-zero-device.img";
+my $size = 64 * 1024 * 1024;
+
+$g->disk_create ($disk, "raw", $size, preallocation => "sparse");
+END { unlink ($disk); };
+
+eval {
+    $g->add_drive ($disk, format => "raw", readonly => 0, discard => "enable");
+    $g->launch ();
+};
+if ($@) {
+    if ($@ =~ /discard cannot be enabled on this drive/) {
+        print "$0: skipped test: $@\n";
+        exit 77;
+    }
+    die # propagate the unexpected error
+}
+
+# Sparse files: a hole is zero, but data after a hole must be found.
+$g->part_disk ("/dev/sda", "mbr");
+$g->mkfs ("ext4", "/dev/sda1");
+$g->mount ("/dev/sda1", "/");
+
+$g->truncate_size ("/sparse", 32 * 1024 * 1024);
+die "$0: is_zero: sparse file is not zero\n"
+    unless $g->is_zero ("/sparse");
+$g->pwrite ("/sparse", "x", 31 * 1024 * 1024);
+die "$0: is_zero: missed data after a hole\n"
+    if $g->is_zero ("/sparse");
+$g->pwrite ("/sparse", "\0", 31 * 1024 * 1024);
+die "$0: is_zero: overwritten data is not zero\n"
+    unless $g->is_zero ("/sparse");
+
+$g->umount_all ();
+
+# Non-zero data near the end of an otherwise empty device.
+$g->zero_device ("/dev/sda1");
+die "$0: is_zero_device: device is not zero after zero_device\n"
+    unless $g->is_zero_device ("/dev/sda1");
+$g->pwrite_device ("/dev/sda1", "x", $g->blockdev_getsize64 ("/dev/sda1") - 1);
+die "$0: is_zero_device: missed data at the end of the device\n"
+    if $g->is_zero_device ("/dev/sda1");
+
+# Fill the whole device with random data, then zero it.
+$g->copy_device_to_device ("/dev/urandom", "/dev/sda", size => $size);
+$g->sync ();
+
+my $full_size = (stat ($disk))[12];
+print "full size:\t$full_size (blocks)\n";
+
+$g->zero_device ("/dev/sda");
+die "$0: is_zero_device: device is not zero after zero_device\n"
+    unless $g->is_zero_device ("/dev/sda");
+
+$g->shutdown ();
+$g->close ();
+
+# If zero_device discarded the device (instead of writing zeroes over
+# it), the disk image should now be sparse again.
+my $zeroed_size = (stat ($disk))[12];
+print "zeroed size:\t$zeroed_size (blocks)\n";
+
+die "$0: looks like zero_device did not discard the device\n"
+    if $full_size - $zeroed_size < 1000;
@@ -78,6 +78,38 @@ eval {
         die "unexpected data: got ", $fieldname, "=", $actual,
         ", expected ", $fieldname, "=", $expected unless $actual eq $expected;
     }
+    # Export the same journal in one call, keeping only two fields.
+    my $tmpfile = "test-journal-export.tmp";
+    $g->journal_export ($tmpfile, fields => ["PRIORITY", "_UID"]);
+    open my $fh, "<", $tmpfile or die "$tmpfile: $!";
+    binmode $fh;
+    my $data = do { local $/; <$fh> };
+    close $fh;
+    unlink $tmpfile;
+
+    # Read a big-endian 64 bit integer (the high word is always 0 here).
+    my $pos = 0;
+    my $be64 = sub {
+        my ($hi, $lo) = unpack "NN", substr ($data, $pos, 8);
+        $pos += 8;
+        return $hi * 4294967296 + $lo;
+    };
+    my $exported = 0;
+    while ($pos < length $data) {
+        $exported++;
+        $be64->();              # timestamp
+        my $nr_fields = $be64->();
+        for (my $i = 0; $i < $nr_fields; ++$i) {
+            my $len = $be64->();
+            my $field = substr ($data, $pos, $len);
+            $pos += $len;
+            die "unexpected field exported: $field"
+                unless $field =~ /^(PRIORITY|_UID)=/;
+        }
+    }
+
+    die "incorrect # exported journal entries (got $exported, expecting 2459)"
+        unless $exported == 2459;
 };
 my $error = $@;
 $g->journal_close ();
@@ -0,0 +1,64 @@
+#!/bin/bash -
+# libguestfs
+# Copyright (C) 2016 Red Hat Inc.
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+# Test that inspection follows absolute symlinks such as /bin -> /usr/bin
+# inside the guest, and not inside the appliance.
+
+set -e
+export LANG=C
+
+if [ "$(guestfish get-backend)" = "uml" ]; then
+    echo "$0: skipping test because uml backend does not support qcow2"
+    exit 77
+fi
+
+rm -f inspect-abs-symlinks.qcow2 inspect-abs-symlinks.output
+
+guestfish -- \
+  disk-create inspect-abs-symlinks.qcow2 qcow2 -1 \
+    backingfile:../../test-data/phony-guests/fedora.img backingformat:raw
+
+# Move /bin and /etc/redhat-release under /usr, and replace them with
+# absolute symlinks, as a guest with a merged /usr would have.
+guestfish --format=qcow2 -a inspect-abs-symlinks.qcow2 <<'EOF'
+  run
+  mount /dev/VG/Root /
+  mv /bin /usr/bin
+  ln-s /usr/bin /bin
+  mv /etc/redhat-release /usr/share/redhat-release
+  ln-s /usr/share/redhat-release /etc/redhat-release
+EOF
+
+guestfish --ro --format=qcow2 -a inspect-abs-symlinks.qcow2 <<'EOF' > inspect-abs-symlinks.output
+  run
+  inspect-os
+  inspect-get-distro /dev/VG/Root
+  inspect-get-major-version /dev/VG/Root
+  inspect-get-arch /dev/VG/Root
+EOF
+
+if [ "$(cat inspect-abs-symlinks.output)" != "/dev/VG/Root
+fedora
+14
+x86_64" ]; then
+    echo "$0: unexpected output from inspection:"
+    cat inspect-abs-symlinks.output
+    exit 1
+fi
+
+rm inspect-abs-symlinks.qcow2 inspect-abs-symlinks.output
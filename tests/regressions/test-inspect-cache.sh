@@ -0,0 +1,88 @@
+#!/bin/bash -
+# libguestfs
+# Copyright (C) 2016 Red Hat Inc.
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+# Test the inspection cache (set-inspect-cache): a second inspection
+# of the same disk must load the same results from the cache, and
+# changing the disk must invalidate the cached results.
+
+set -e
+export LANG=C
+
+if [ "$(guestfish get-backend)" = "uml" ]; then
+    echo "$0: skipping test because uml backend does not support qcow2"
+    exit 77
+fi
+
+rm -f inspect-cache.qcow2 inspect-cache-*.out inspect-cache-*.log
+
+guestfish -- \
+  disk-create inspect-cache.qcow2 qcow2 -1 \
+    backingfile:../../test-data/phony-guests/fedora.img backingformat:raw
+
+inspect ()
+{
+    guestfish -v --ro --format=qcow2 -a inspect-cache.qcow2 \
+        > inspect-cache-$1.out 2> inspect-cache-$1.log <<'EOF'
+  set-inspect-cache true
+  run
+  inspect-os
+  inspect-get-distro /dev/VG/Root
+  inspect-get-product-name /dev/VG/Root
+  inspect-get-hostname /dev/VG/Root
+  inspect-get-mountpoints /dev/VG/Root
+EOF
+}
+
+# The first inspection saves the results.
+inspect 1
+if ! grep -sq "inspect cache: saved results" inspect-cache-1.log; then
+    echo "$0: error: results of the first inspection were not saved"
+    exit 1
+fi
+
+# The second inspection loads the same results.
+inspect 2
+if ! grep -sq "inspect cache: loaded results" inspect-cache-2.log; then
+    echo "$0: error: results of the second inspection were not loaded"
+    exit 1
+fi
+if ! cmp inspect-cache-1.out inspect-cache-2.out; then
+    echo "$0: error: cached results differ from the original results"
+    diff -u inspect-cache-1.out inspect-cache-2.out
+    exit 1
+fi
+
+# Changing the disk invalidates the cached results.
+guestfish --format=qcow2 -a inspect-cache.qcow2 <<'EOF'
+  run
+  mount /dev/VG/Root /
+  write /etc/hostname "changed.invalid"
+EOF
+
+inspect 3
+if grep -sq "inspect cache: loaded results" inspect-cache-3.log; then
+    echo "$0: error: stale results were loaded after changing the disk"
+    exit 1
+fi
+if [ "$(sed -n 4p inspect-cache-3.out)" != "changed.invalid" ]; then
+    echo "$0: error: unexpected hostname after changing the disk:"
+    cat inspect-cache-3.out
+    exit 1
+fi
+
+rm inspect-cache.qcow2 inspect-cache-*.out inspect-cache-*.log
@@ -0,0 +1,173 @@
+/* libguestfs
+ * Copyright (C) 2016 Red Hat Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Benchmark the zero-detection functions in src/is-zero.c against
+ * the simple byte loop which they replaced.  All three are run over
+ * an all-zero buffer of each size (which is the worst case, since
+ * the whole buffer has to be read), and the rate is printed.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <getopt.h>
+#include <limits.h>
+#include <sys/time.h>
+
+#include "guestfs.h"
+#include "guestfs-internal-frontend.h"
+
+#include "getprogname.h"
+
+/* The amount of data checked by each test. */
+static int64_t total_size = INT64_C(4) * 1024 * 1024 * 1024;
+
+static void
+usage (int exitcode)
+{
+  fprintf (stderr,
+           "is-zero-benchmark: Benchmark zero-detection functions.\n"
+           "\n"
+           "Options:\n"
+           "  --help                       Display help output and exit\n"
+           "  -s <GB> | --size=<GB>        Amount of data to check (default 4)\n"
+           );
+  exit (exitcode);
+}
+
+/* This is the implementation used before src/is-zero.c.  The
+ * attribute stops gcc from turning it into a call to the real
+ * function or from vectorizing it.
+ */
+static int __attribute__((noinline))
+is_zero_loop (const char *buffer, size_t size)
+{
+  size_t i;
+
+  for (i = 0; i < size; ++i) {
+    if (buffer[i] != 0)
+      return 0;
+  }
+
+  return 1;
+}
+
+static int
+is_zero_loop_wrapper (const void *buffer, size_t size)
+{
+  return is_zero_loop (buffer, size);
+}
+
+/* Compute Y - X and return the result in milliseconds. */
+static int64_t
+timeval_diff (const struct timeval *x, const struct timeval *y)
+{
+  int64_t msec;
+
+  msec = (y->tv_sec - x->tv_sec) * 1000;
+  msec += (y->tv_usec - x->tv_usec) / 1000;
+  return msec;
+}
+
+static void
+run_test (const char *name, int (*f) (const void *, size_t),
+          const char *buf, size_t bufsize)
+{
+  struct timeval start, end;
+  int64_t i, n, ms;
+
+  n = total_size / bufsize;
+  gettimeofday (&start, NULL);
+  for (i = 0; i < n; ++i) {
+    if (!f (buf, bufsize)) {
+      fprintf (stderr, "%s: %s: buffer is not zero\n", getprogname (), name);
+      exit (EXIT_FAILURE);
+    }
+  }
+  gettimeofday (&end, NULL);
+
+  ms = timeval_diff (&start, &end);
+  if (ms <= 0)
+    ms = 1;
+
+  printf ("%-12s %8zu %10" PRIi64 " Mbytes/sec\n",
+          name, bufsize, n * (int64_t) bufsize * 1000 / ms / 1024 / 1024);
+  fflush (stdout);
+}
+
+int
+main (int argc, char *argv[])
+{
+  enum { HELP_OPTION = CHAR_MAX + 1 };
+  static const char options[] = "s:";
+  static const struct option long_options[] = {
+    { "help", 0, 0, HELP_OPTION },
+    { "size", 1, 0, 's' },
+    { 0, 0, 0, 0 }
+  };
+  static const size_t sizes[] = { 512, 4096, 65536, 1024*1024 };
+  int c, option_index, gb;
+  size_t i;
+  char *buf;
+
+  for (;;) {
+    c = getopt_long (argc, argv, options, long_options, &option_index);
+    if (c == -1) break;
+
+    switch (c) {
+    case 's':
+      if (sscanf (optarg, "%d", &gb) != 1 || gb <= 0) {
+        fprintf (stderr, "%s: -s: argument is not a positive integer\n",
+                 getprogname ());
+        exit (EXIT_FAILURE);
+      }
+      total_size = (int64_t) gb * 1024 * 1024 * 1024;
+      break;
+
+    case HELP_OPTION:
+      usage (EXIT_SUCCESS);
+
+    default:
+      usage (EXIT_FAILURE);
+    }
+  }
+
+  if (optind != argc) {
+    fprintf (stderr, "%s: extra arguments found on the command line\n",
+             getprogname ());
+    exit (EXIT_FAILURE);
+  }
+
+  buf = calloc (sizes[sizeof sizes / sizeof sizes[0] - 1], 1);
+  if (buf == NULL) {
+    perror ("calloc");
+    exit (EXIT_FAILURE);
+  }
+
+  for (i = 0; i < sizeof sizes / sizeof sizes[0]; ++i) {
+    run_test ("loop", is_zero_loop_wrapper, buf, sizes[i]);
+    run_test ("portable", guestfs_int_is_zero_portable, buf, sizes[i]);
+    run_test ("is_zero", guestfs_int_is_zero, buf, sizes[i]);
+  }
+
+  free (buf);
+  exit (EXIT_SUCCESS);
+}